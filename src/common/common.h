@@ -11,11 +11,30 @@ using json = nlohmann::json;
 
 namespace vectordb {
 
-enum IndexType { INDEX_TYPE_FLAT = 100, INDEX_TYPE_HNSW };
+enum IndexType {
+  INDEX_TYPE_FLAT = 100,
+  INDEX_TYPE_HNSW,
+  INDEX_TYPE_DISKANN,
+  INDEX_TYPE_PQ,
+};
 
 enum DistanceType {
   DISTANCE_TYPE_L2 = 200,
   DISTANCE_TYPE_INNER_PRODUCT,
+  DISTANCE_TYPE_HAMMING,
+  DISTANCE_TYPE_COSINE,
+};
+
+enum SegmentState {
+  SEGMENT_STATE_GROWING = 300,
+  SEGMENT_STATE_SEALING,
+  SEGMENT_STATE_SEALED,
+};
+
+enum ImportFormat {
+  IMPORT_FORMAT_FVECS = 400,
+  IMPORT_FORMAT_NPY,
+  IMPORT_FORMAT_RAW,
 };
 
 }  // namespace vectordb
@@ -9,6 +9,13 @@ enum RetNo {
   RET_OK = 0,
   RET_NOT_FOUND,
   RET_ERROR,
+
+  // the search stopped at its deadline or distance budget, the results are
+  // the best ones found so far
+  RET_PARTIAL,
+
+  // the request was already past its deadline and got no result
+  RET_TIMEOUT,
 };
 
 inline std::string RetNoToString(RetNo retno) {
@@ -19,11 +26,34 @@ inline std::string RetNoToString(RetNo retno) {
       return "not found";
     case RET_ERROR:
       return "error";
+    case RET_PARTIAL:
+      return "partial";
+    case RET_TIMEOUT:
+      return "timeout";
     default:
       return "unknown";
   }
 }
 
+// result of a search fanned out over shards or segments: an error wins,
+// all timed out is a timeout, otherwise any cut short or timed out part
+// makes it partial
+inline RetNo MergeSearchRet(RetNo a, RetNo b) {
+  auto limited = [](RetNo r) {
+    return r == RET_OK || r == RET_PARTIAL || r == RET_TIMEOUT;
+  };
+  if (!limited(a)) {
+    return a;
+  }
+  if (!limited(b)) {
+    return b;
+  }
+  if (a == b) {
+    return a;
+  }
+  return RET_PARTIAL;
+}
+
 }  // namespace vectordb
 
 #endif
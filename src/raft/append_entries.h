@@ -26,7 +26,10 @@ struct AppendEntries : public Message {
   RaftIndex pre_log_index;
   RaftTerm pre_log_term;
   RaftIndex commit_index;
-  std::vector<LogEntry> entries;
+  std::vector<LogEntryPtr> entries;  // sent: shared with the log cache
+
+  // entries follow pre-log one by one, terms never go down or over term
+  bool EntriesValid() const;
 
   int32_t MaxBytes() override;
   int32_t ToString(std::string &s) override;
@@ -39,6 +42,28 @@ struct AppendEntries : public Message {
   std::string ToJsonString(bool tiny, bool one_line) override;
 };
 
+// A message carries at most max_entries entries of at most max_bytes, but
+// always the first entry, or a large one would never be sent.
+inline bool BatchHasRoom(int32_t count, int32_t bytes, int32_t entry_bytes,
+                         int32_t max_entries, int32_t max_bytes) {
+  return count == 0 ||
+         (count < max_entries && bytes + entry_bytes <= max_bytes);
+}
+
+inline bool AppendEntries::EntriesValid() const {
+  RaftIndex index = pre_log_index;
+  RaftTerm last_term = pre_log_term;
+  for (auto &entry : entries) {
+    ++index;
+    if (entry->index != index || entry->append_entry.term < last_term ||
+        entry->append_entry.term > term) {
+      return false;
+    }
+    last_term = entry->append_entry.term;
+  }
+  return true;
+}
+
 inline int32_t AppendEntries::MaxBytes() {
   int32_t size = 0;
   size += sizeof(uint64_t);
@@ -52,14 +77,7 @@ inline int32_t AppendEntries::MaxBytes() {
   size += sizeof(commit_index);
   size += 2 * sizeof(int32_t);
   for (auto &e : entries) {
-    size += sizeof(e.index);
-    size += sizeof(e.pre_chk_all);
-    size += sizeof(e.chk_ths);
-    size += sizeof(e.chk_all);
-    size += sizeof(e.append_entry.term);
-    size += sizeof(e.append_entry.type);
-    size += 2 * sizeof(int32_t);
-    size += e.append_entry.value.size();
+    size += e->MaxBytes();
   }
   return size;
 }
@@ -123,7 +141,7 @@ inline int32_t AppendEntries::ToString(const char *ptr, int32_t len) {
   size += sizeof(entries_size);
 
   for (int32_t i = 0; i < entries_size; ++i) {
-    int32_t bytes = entries[i].ToString(p, len - size);
+    int32_t bytes = entries[i]->ToString(p, len - size);
     assert(bytes > 0);
     p += bytes;
     size += bytes;
@@ -193,14 +211,15 @@ inline int32_t AppendEntries::FromString(const char *ptr, int32_t len) {
   size += sizeof(entries_size);
   len2 -= sizeof(entries_size);
 
-  LogEntry entry;
+  entries.reserve(entries_size);
   for (int32_t i = 0; i < entries_size; ++i) {
-    int32_t bytes = entry.FromString(p, len2);
+    LogEntryPtr entry = std::make_shared<LogEntry>();
+    int32_t bytes = entry->FromString(p, len2);
     assert(bytes > 0);
     p += bytes;
     size += bytes;
     len2 -= bytes;
-    entries.push_back(entry);
+    entries.push_back(std::move(entry));
   }
   assert(len2 >= 0);
 
@@ -219,13 +238,13 @@ inline nlohmann::json AppendEntries::ToJson() {
   j[1]["entry-count"] = entries.size();
 #if 0
   for (size_t i = 0; i < entries.size(); ++i) {
-    j[2]["entries"][i] = entries[i].ToJson();
+    j[2]["entries"][i] = entries[i]->ToJson();
   }
 #endif
   for (size_t i = 0; i < entries.size(); ++i) {
-    j[2]["entries"][i]["tm"] = entries[i].append_entry.term;
-    j[2]["entries"][i]["tp"] = EntryTypeToStr(entries[i].append_entry.type);
-    j[2]["entries"][i]["sz"] = entries[i].append_entry.value.size();
+    j[2]["entries"][i]["tm"] = entries[i]->append_entry.term;
+    j[2]["entries"][i]["tp"] = EntryTypeToStr(entries[i]->append_entry.type);
+    j[2]["entries"][i]["sz"] = entries[i]->append_entry.value.size();
   }
   j[3]["send_ts"] = send_ts;
   j[3]["elapse"] = elapse;
@@ -243,7 +262,7 @@ inline nlohmann::json AppendEntries::ToJsonTiny() {
   j[1]["cmt"] = commit_index;
   j[1]["cnt"] = entries.size();
   for (size_t i = 0; i < entries.size(); ++i) {
-    j[2]["etr"][i] = entries[i].ToJsonTiny();
+    j[2]["etr"][i] = entries[i]->ToJsonTiny();
   }
   j[3]["send"] = send_ts;
   j[3]["elapse"] = elapse;
@@ -27,6 +27,7 @@ struct AppendEntriesReply : public Message {
   RaftIndex req_pre_index;  // from leader
   int32_t req_num_entries;  // from leader
   RaftTerm req_term;        // from leader
+  uint64_t req_send_ts;     // from leader, confirms leadership for reads
 
   int32_t MaxBytes() override;
   int32_t ToString(std::string &s) override;
@@ -52,6 +53,7 @@ inline int32_t AppendEntriesReply::MaxBytes() {
   size += sizeof(req_pre_index);
   size += sizeof(req_num_entries);
   size += sizeof(req_term);
+  size += sizeof(req_send_ts);
   return size;
 }
 
@@ -116,6 +118,10 @@ inline int32_t AppendEntriesReply::ToString(const char *ptr, int32_t len) {
   p += sizeof(req_term);
   size += sizeof(req_term);
 
+  EncodeFixed64(p, req_send_ts);
+  p += sizeof(req_send_ts);
+  size += sizeof(req_send_ts);
+
   assert(size <= len);
   return size;
 }
@@ -175,6 +181,10 @@ inline int32_t AppendEntriesReply::FromString(const char *ptr, int32_t len) {
   p += sizeof(req_term);
   size += sizeof(req_term);
 
+  req_send_ts = DecodeFixed64(p);
+  p += sizeof(req_send_ts);
+  size += sizeof(req_send_ts);
+
   return size;
 }
 
@@ -189,6 +199,7 @@ inline nlohmann::json AppendEntriesReply::ToJson() {
   j[2]["req-pre"] = req_pre_index;
   j[2]["req-entry-count"] = req_num_entries;
   j[2]["req-term"] = req_term;
+  j[2]["req-send_ts"] = req_send_ts;
   j[3]["send_ts"] = send_ts;
   j[3]["elapse"] = elapse;
   return j;
@@ -205,6 +216,7 @@ inline nlohmann::json AppendEntriesReply::ToJsonTiny() {
   j["req-pre"] = req_pre_index;
   j["req-cnt"] = req_num_entries;
   j["req-tm"] = req_term;
+  j["req-send"] = req_send_ts;
   j["send"] = send_ts;
   j["elapse"] = elapse;
   return j;
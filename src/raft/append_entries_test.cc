@@ -0,0 +1,118 @@
+#include "append_entries.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+// 按 DoSendAppendEntries 的方式切一批，返回带走的条数
+int32_t Cut(const std::vector<int32_t> &entry_bytes, int32_t max_entries,
+            int32_t max_bytes) {
+  int32_t count = 0;
+  int32_t bytes = 0;
+  for (int32_t b : entry_bytes) {
+    if (!vraft::BatchHasRoom(count, bytes, b, max_entries, max_bytes)) {
+      break;
+    }
+    ++count;
+    bytes += b;
+  }
+  return count;
+}
+
+vraft::LogEntryPtr Entry(vraft::RaftIndex index, vraft::RaftTerm term) {
+  vraft::LogEntryPtr entry = std::make_shared<vraft::LogEntry>();
+  entry->index = index;
+  entry->append_entry.term = term;
+  entry->append_entry.type = vraft::kData;
+  entry->append_entry.value = std::string(index, 'v');
+  entry->pre_chk_all = 0;
+  entry->CheckSum();
+  return entry;
+}
+
+// pre-log 是 (10, 2)，消息的任期是 3
+vraft::AppendEntries Msg(std::vector<vraft::LogEntryPtr> entries) {
+  vraft::AppendEntries msg;
+  msg.term = 3;
+  msg.pre_log_index = 10;
+  msg.pre_log_term = 2;
+  msg.entries = std::move(entries);
+  return msg;
+}
+
+}  // namespace
+
+// 条数和字节数先到哪个就在哪里切
+TEST(AppendEntriesTest, BatchLimits) {
+  std::vector<int32_t> sizes(10, 100);
+  EXPECT_EQ(4, Cut(sizes, 4, 10000));
+  EXPECT_EQ(3, Cut(sizes, 8, 350));
+  EXPECT_EQ(3, Cut(sizes, 8, 300));
+  EXPECT_EQ(10, Cut(sizes, 100, 100000));
+  EXPECT_EQ(0, Cut({}, 4, 10000));
+
+  // 中间一条超过剩下的字节数，后面小的也不再带
+  EXPECT_EQ(1, Cut({100, 500, 10}, 8, 400));
+}
+
+// 第一条总是带上，单条超过字节限制也照发
+TEST(AppendEntriesTest, BatchAtLeastOne) {
+  EXPECT_EQ(1, Cut({1000, 10}, 8, 100));
+  EXPECT_EQ(1, Cut({10, 10}, 1, 100));
+  EXPECT_EQ(1, Cut({10, 10}, 0, 0));
+  EXPECT_TRUE(vraft::BatchHasRoom(0, 0, 1 << 20, 1, 1));
+  EXPECT_FALSE(vraft::BatchHasRoom(1, 10, 1, 1, 1 << 20));
+}
+
+TEST(AppendEntriesTest, EntriesValid) {
+  EXPECT_TRUE(Msg({}).EntriesValid());
+  EXPECT_TRUE(Msg({Entry(11, 2), Entry(12, 2), Entry(13, 3)}).EntriesValid());
+  EXPECT_TRUE(Msg({Entry(11, 3)}).EntriesValid());
+}
+
+// 有一条不对整批都拒绝
+TEST(AppendEntriesTest, EntriesInvalid) {
+  // 第一条没有接上 pre-log
+  EXPECT_FALSE(Msg({Entry(12, 2)}).EntriesValid());
+  EXPECT_FALSE(Msg({Entry(10, 2)}).EntriesValid());
+
+  // 中间有空洞或者重复
+  EXPECT_FALSE(Msg({Entry(11, 2), Entry(13, 2)}).EntriesValid());
+  EXPECT_FALSE(Msg({Entry(11, 2), Entry(11, 2)}).EntriesValid());
+
+  // 任期变小，小于 pre-log 的任期，大于消息的任期
+  EXPECT_FALSE(Msg({Entry(11, 3), Entry(12, 2)}).EntriesValid());
+  EXPECT_FALSE(Msg({Entry(11, 1)}).EntriesValid());
+  EXPECT_FALSE(Msg({Entry(11, 2), Entry(12, 4)}).EntriesValid());
+}
+
+// 发送时直接编码共享的日志，对端解出各自的一份
+TEST(AppendEntriesTest, EncodeShared) {
+  vraft::AppendEntries msg = Msg({Entry(11, 2), Entry(12, 3)});
+  msg.src = vraft::RaftAddr(0x7F000001, 9001, 1);
+  msg.dest = vraft::RaftAddr(0x7F000001, 9002, 2);
+  msg.uid = 7;
+  msg.send_ts = 100;
+  msg.elapse = 0;
+  msg.commit_index = 11;
+
+  std::string s;
+  int32_t bytes = msg.ToString(s);
+  EXPECT_EQ(static_cast<int32_t>(s.size()), bytes);
+  EXPECT_GE(msg.MaxBytes(), bytes);
+
+  vraft::AppendEntries msg2;
+  EXPECT_EQ(bytes, msg2.FromString(s));
+  EXPECT_EQ(11u, msg2.commit_index);
+  ASSERT_EQ(2u, msg2.entries.size());
+  EXPECT_TRUE(msg2.EntriesValid());
+  for (size_t i = 0; i < msg.entries.size(); ++i) {
+    EXPECT_NE(msg.entries[i], msg2.entries[i]);
+    EXPECT_EQ(msg.entries[i]->index, msg2.entries[i]->index);
+    EXPECT_EQ(msg.entries[i]->append_entry.value,
+              msg2.entries[i]->append_entry.value);
+    EXPECT_EQ(msg.entries[i]->chk_all, msg2.entries[i]->chk_all);
+  }
+}
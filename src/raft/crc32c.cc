@@ -0,0 +1,190 @@
+#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace vraft {
+
+// reflected Castagnoli polynomial
+const uint32_t kCrc32cPoly = 0x82f63b78;
+
+static inline uint32_t LoadU32(const unsigned char *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// slicing-by-8, table[k][b] is the crc of b followed by k zero bytes
+struct Crc32cTable {
+  uint32_t table[8][256];
+
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int32_t j = 0; j < 8; ++j) {
+        crc = (crc & 1) ? (crc >> 1) ^ kCrc32cPoly : crc >> 1;
+      }
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (int32_t k = 1; k < 8; ++k) {
+        uint32_t crc = table[k - 1][i];
+        table[k][i] = (crc >> 8) ^ table[0][crc & 0xff];
+      }
+    }
+  }
+};
+
+uint32_t Crc32cExtendSoftware(uint32_t crc, const char *data, size_t n) {
+  static const Crc32cTable tables;
+  const uint32_t(*t)[256] = tables.table;
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+
+  uint32_t c = ~crc;
+  while (n >= 8) {
+    uint32_t lo = c ^ LoadU32(p);
+    uint32_t hi = LoadU32(p + 4);
+    c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^
+        t[4][lo >> 24] ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+        t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    c = (c >> 8) ^ t[0][(c ^ *p) & 0xff];
+    ++p;
+    --n;
+  }
+  return ~c;
+}
+
+#if defined(__x86_64__)
+
+// the crc instruction has a latency of 3 cycles and a throughput of 1, so
+// long data is cut into 3 blocks checksummed side by side, then the crcs
+// are combined. block bytes, long for the main loop, short for the tail
+const size_t kCrc32cLong = 8192;
+const size_t kCrc32cShort = 256;
+
+// a * b modulo the polynomial, in the reflected bit order
+static uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kCrc32cPoly : b >> 1;
+  }
+  return p;
+}
+
+// x^(8 * bytes) modulo the polynomial, multiplying a crc by it is the same
+// as running the crc over that many zero bytes
+static uint32_t ZerosOp(size_t bytes) {
+  uint32_t x2n = 1u << 30;  // x^1, then x^2, x^4 ...
+  uint32_t p = 1u << 31;    // x^0
+  size_t bits = bytes * 8;
+  while (bits > 0) {
+    if (bits & 1) {
+      p = MultModP(x2n, p);
+    }
+    x2n = MultModP(x2n, x2n);
+    bits >>= 1;
+  }
+  return p;
+}
+
+struct Crc32cZeros {
+  uint32_t long_op;
+  uint32_t short_op;
+
+  Crc32cZeros()
+      : long_op(ZerosOp(kCrc32cLong)), short_op(ZerosOp(kCrc32cShort)) {}
+};
+
+static inline uint64_t LoadU64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// crc0..crc2 are running over 3 adjacent blocks of block bytes each
+__attribute__((target("sse4.2"))) static inline const unsigned char *
+Crc32cBlocks(uint64_t &crc0, const unsigned char *p, size_t block,
+             uint32_t op) {
+  uint64_t crc1 = 0;
+  uint64_t crc2 = 0;
+  const unsigned char *end = p + block;
+  do {
+    crc0 = _mm_crc32_u64(crc0, LoadU64(p));
+    crc1 = _mm_crc32_u64(crc1, LoadU64(p + block));
+    crc2 = _mm_crc32_u64(crc2, LoadU64(p + block * 2));
+    p += 8;
+  } while (p < end);
+
+  crc0 = MultModP(op, static_cast<uint32_t>(crc0)) ^ crc1;
+  crc0 = MultModP(op, static_cast<uint32_t>(crc0)) ^ crc2;
+  return p + block * 2;
+}
+
+__attribute__((target("sse4.2"))) static uint32_t Crc32cExtendHardware(
+    uint32_t crc, const char *data, size_t n) {
+  static const Crc32cZeros zeros;
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+
+  uint64_t c = ~crc;
+  while (n > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+    c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+    ++p;
+    --n;
+  }
+
+  while (n >= kCrc32cLong * 3) {
+    p = Crc32cBlocks(c, p, kCrc32cLong, zeros.long_op);
+    n -= kCrc32cLong * 3;
+  }
+  while (n >= kCrc32cShort * 3) {
+    p = Crc32cBlocks(c, p, kCrc32cShort, zeros.short_op);
+    n -= kCrc32cShort * 3;
+  }
+
+  while (n >= 8) {
+    c = _mm_crc32_u64(c, LoadU64(p));
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+    ++p;
+    --n;
+  }
+  return ~static_cast<uint32_t>(c);
+}
+
+#endif
+
+using Crc32cExtendFunc = uint32_t (*)(uint32_t, const char *, size_t);
+
+static Crc32cExtendFunc ChooseCrc32cExtend() {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    return Crc32cExtendHardware;
+  }
+#endif
+  return Crc32cExtendSoftware;
+}
+
+uint32_t Crc32cExtend(uint32_t crc, const char *data, size_t n) {
+  static const Crc32cExtendFunc extend = ChooseCrc32cExtend();
+  return extend(crc, data, n);
+}
+
+}  // namespace vraft
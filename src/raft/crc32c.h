@@ -0,0 +1,25 @@
+#ifndef VRAFT_CRC32C_H_
+#define VRAFT_CRC32C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vraft {
+
+// CRC-32C (Castagnoli). Uses the SSE4.2 crc32 instruction when the cpu
+// has it, a table otherwise, both give the same result.
+
+// crc of data appended to the data crc was computed over, so pieces not
+// contiguous in memory can be checksummed without copying
+uint32_t Crc32cExtend(uint32_t crc, const char *data, size_t n);
+
+inline uint32_t Crc32c(const char *data, size_t n) {
+  return Crc32cExtend(0, data, n);
+}
+
+// table version, for portability and tests
+uint32_t Crc32cExtendSoftware(uint32_t crc, const char *data, size_t n);
+
+}  // namespace vraft
+
+#endif
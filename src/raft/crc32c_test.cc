@@ -0,0 +1,56 @@
+#include "crc32c.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+static std::string RandomBytes(size_t n) {
+  std::mt19937 rng(1);
+  std::string s(n, 0);
+  for (auto &c : s) {
+    c = static_cast<char>(rng());
+  }
+  return s;
+}
+
+// RFC 3720 B.4 的标准值
+TEST(Crc32cTest, KnownValues) {
+  EXPECT_EQ(0xE3069283u, vraft::Crc32c("123456789", 9));
+  EXPECT_EQ(0xE3069283u, vraft::Crc32cExtendSoftware(0, "123456789", 9));
+  EXPECT_EQ(0u, vraft::Crc32c("", 0));
+
+  std::string zeros(32, 0);
+  EXPECT_EQ(0x8A9136AAu, vraft::Crc32c(zeros.data(), zeros.size()));
+  std::string ones(32, '\xff');
+  EXPECT_EQ(0x62A8AB43u, vraft::Crc32c(ones.data(), ones.size()));
+}
+
+// 硬件和查表的结果一样，起始地址不对齐、长度跨过分块边界也一样
+TEST(Crc32cTest, HardwareMatchesSoftware) {
+  std::string data = RandomBytes(200000);
+  std::mt19937 rng(2);
+  for (int i = 0; i < 2000; ++i) {
+    size_t offset = rng() % 64;
+    size_t n = rng() % (i % 2 == 0 ? 256 : data.size() - offset);
+    const char *p = data.data() + offset;
+    ASSERT_EQ(vraft::Crc32cExtendSoftware(0, p, n), vraft::Crc32c(p, n))
+        << "offset " << offset << " n " << n;
+  }
+}
+
+// 分两段算再接上，和整段一起算的结果一样
+TEST(Crc32cTest, Extend) {
+  std::string data = RandomBytes(100000);
+  std::mt19937 rng(3);
+  for (int i = 0; i < 1000; ++i) {
+    size_t offset = rng() % 64;
+    size_t n = rng() % (i % 2 == 0 ? 256 : data.size() - offset);
+    size_t a = rng() % (n + 1);
+    const char *p = data.data() + offset;
+    uint32_t whole = vraft::Crc32c(p, n);
+    EXPECT_EQ(whole, vraft::Crc32cExtend(vraft::Crc32c(p, a), p + a, n - a));
+    EXPECT_EQ(whole, vraft::Crc32cExtendSoftware(
+                         vraft::Crc32cExtendSoftware(0, p, a), p + a, n - a));
+  }
+}
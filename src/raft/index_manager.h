@@ -13,6 +13,18 @@ namespace vraft {
 struct IndexItem {
   RaftIndex next;
   RaftIndex match;
+
+  // flow control
+  // probe: next is not known, at most one message with entries in flight,
+  //        next moves on reply
+  // pipeline: next moves on send, at most window messages in flight
+  bool probe;
+  int32_t inflight;
+
+  // metrics
+  uint64_t sent_msgs;  // with entries
+  uint64_t sent_entries;
+  uint64_t rejects;
 };
 
 class IndexManager final {
@@ -39,6 +51,17 @@ class IndexManager final {
   void SetMatch(uint64_t addr, RaftIndex index);
   RaftIndex GetMatch(uint64_t addr);
 
+  // flow control
+  void ResetFlow();
+  bool CanSend(uint64_t addr, int32_t window);
+  void OnSend(uint64_t addr, int32_t num_entries);
+  void OnReply(uint64_t addr, int32_t num_entries);
+  void Replicated(uint64_t addr);
+  void BecomeProbe(uint64_t addr);
+  void RetryProbe(uint64_t addr);
+  bool Probing(uint64_t addr);
+  bool StaleReject(uint64_t addr, RaftIndex pre_index);
+
  public:
   std::unordered_map<uint64_t, IndexItem> indices;
 
@@ -69,6 +92,11 @@ inline void IndexManager::Reset(const std::vector<RaftAddr> &peers) {
     IndexItem item;
     item.next = 1;
     item.match = 0;
+    item.probe = true;
+    item.inflight = 0;
+    item.sent_msgs = 0;
+    item.sent_entries = 0;
+    item.rejects = 0;
     indices[addr.ToU64()] = item;
   }
 }
@@ -123,12 +151,85 @@ inline RaftIndex IndexManager::GetMatch(uint64_t addr) {
   return indices[addr].match;
 }
 
+inline void IndexManager::ResetFlow() {
+  for (auto &peer : indices) {
+    peer.second.probe = true;
+    peer.second.inflight = 0;
+  }
+}
+
+inline bool IndexManager::CanSend(uint64_t addr, int32_t window) {
+  IndexItem &item = indices[addr];
+  if (item.probe) {
+    return item.inflight == 0;
+  }
+  return item.inflight < window;
+}
+
+inline void IndexManager::OnSend(uint64_t addr, int32_t num_entries) {
+  IndexItem &item = indices[addr];
+  ++item.inflight;
+  ++item.sent_msgs;
+  item.sent_entries += num_entries;
+  if (!item.probe) {
+    item.next += num_entries;
+  }
+}
+
+inline void IndexManager::OnReply(uint64_t addr, int32_t num_entries) {
+  IndexItem &item = indices[addr];
+  if (num_entries > 0 && item.inflight > 0) {
+    --item.inflight;
+  }
+}
+
+// match moved, next follows it and pipeline starts
+inline void IndexManager::Replicated(uint64_t addr) {
+  IndexItem &item = indices[addr];
+  if (item.probe) {
+    item.probe = false;
+    item.inflight = 0;
+    item.next = item.match + 1;
+  } else if (item.next < item.match + 1) {
+    item.next = item.match + 1;
+  }
+}
+
+// rejected, the messages in flight will be rejected too
+inline void IndexManager::BecomeProbe(uint64_t addr) {
+  IndexItem &item = indices[addr];
+  item.probe = true;
+  item.inflight = 0;
+  ++item.rejects;
+}
+
+// heartbeat timeout, the probe may be lost
+inline void IndexManager::RetryProbe(uint64_t addr) {
+  IndexItem &item = indices[addr];
+  if (item.probe) {
+    item.inflight = 0;
+  }
+}
+
+inline bool IndexManager::Probing(uint64_t addr) { return indices[addr].probe; }
+
+// a reject sent before the last match or for an older probe, drop it
+inline bool IndexManager::StaleReject(uint64_t addr, RaftIndex pre_index) {
+  IndexItem &item = indices[addr];
+  return pre_index < item.match || (item.probe && pre_index + 1 != item.next);
+}
+
 inline nlohmann::json IndexManager::ToJson() {
   nlohmann::json j;
   for (auto peer : indices) {
     RaftAddr addr(peer.first);
     j[addr.ToString()]["next"] = peer.second.next;
     j[addr.ToString()]["match"] = peer.second.match;
+    j[addr.ToString()]["probe"] = peer.second.probe;
+    j[addr.ToString()]["inflight"] = peer.second.inflight;
+    j[addr.ToString()]["sent-msgs"] = peer.second.sent_msgs;
+    j[addr.ToString()]["sent-entries"] = peer.second.sent_entries;
+    j[addr.ToString()]["rejects"] = peer.second.rejects;
   }
   return j;
 }
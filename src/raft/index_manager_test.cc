@@ -0,0 +1,157 @@
+#include "index_manager.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+const int32_t kWindow = 4;
+
+std::vector<vraft::RaftAddr> Peers() {
+  std::vector<vraft::RaftAddr> peers;
+  for (uint16_t i = 1; i <= 2; ++i) {
+    peers.push_back(vraft::RaftAddr(0x7F000001, 9000 + i, i));
+  }
+  return peers;
+}
+
+uint64_t Addr(int i) { return Peers()[i].ToU64(); }
+
+int32_t Inflight(vraft::IndexManager &mgr, uint64_t addr) {
+  return mgr.indices[addr].inflight;
+}
+
+}  // namespace
+
+// 新的 leader 不知道 next，从探测开始，同时只有一条带日志的消息
+TEST(IndexManagerTest, Probe) {
+  vraft::IndexManager mgr(Peers());
+  uint64_t addr = Addr(0);
+  mgr.SetNext(addr, 11);
+  EXPECT_TRUE(mgr.Probing(addr));
+  EXPECT_TRUE(mgr.CanSend(addr, kWindow));
+
+  // 探测时发送不推进 next
+  mgr.OnSend(addr, 3);
+  EXPECT_EQ(11u, mgr.GetNext(addr));
+  EXPECT_EQ(1, Inflight(mgr, addr));
+  EXPECT_FALSE(mgr.CanSend(addr, kWindow));
+
+  // 心跳的应答不占窗口
+  mgr.OnReply(addr, 0);
+  EXPECT_EQ(1, Inflight(mgr, addr));
+  mgr.OnReply(addr, 3);
+  EXPECT_EQ(0, Inflight(mgr, addr));
+  EXPECT_TRUE(mgr.CanSend(addr, kWindow));
+
+  // 另一个 peer 不受影响
+  EXPECT_EQ(1u, mgr.GetNext(Addr(1)));
+  EXPECT_EQ(3u, mgr.indices[addr].sent_entries);
+  EXPECT_EQ(1u, mgr.indices[addr].sent_msgs);
+}
+
+// 探测成功后进入流水线，next 跟上 match，inflight 清零
+TEST(IndexManagerTest, ProbeToPipeline) {
+  vraft::IndexManager mgr(Peers());
+  uint64_t addr = Addr(0);
+  mgr.SetNext(addr, 11);
+  mgr.OnSend(addr, 3);
+
+  // 探测超时重发，前一条的应答晚到
+  mgr.RetryProbe(addr);
+  EXPECT_EQ(0, Inflight(mgr, addr));
+  mgr.OnSend(addr, 3);
+  EXPECT_EQ(1, Inflight(mgr, addr));
+
+  mgr.OnReply(addr, 3);
+  mgr.SetMatch(addr, 13);
+  mgr.Replicated(addr);
+  EXPECT_FALSE(mgr.Probing(addr));
+  EXPECT_EQ(0, Inflight(mgr, addr));
+  EXPECT_EQ(14u, mgr.GetNext(addr));
+
+  // 重发那条的应答不会让 inflight 变成负数
+  mgr.OnReply(addr, 3);
+  EXPECT_EQ(0, Inflight(mgr, addr));
+}
+
+// 流水线：发送即推进 next，最多 window 条在途，应答空出一个位置
+TEST(IndexManagerTest, Pipeline) {
+  vraft::IndexManager mgr(Peers());
+  uint64_t addr = Addr(0);
+  mgr.SetMatch(addr, 10);
+  mgr.Replicated(addr);
+  ASSERT_FALSE(mgr.Probing(addr));
+  ASSERT_EQ(11u, mgr.GetNext(addr));
+
+  for (int32_t i = 0; i < kWindow; ++i) {
+    EXPECT_TRUE(mgr.CanSend(addr, kWindow));
+    mgr.OnSend(addr, 2);
+  }
+  EXPECT_FALSE(mgr.CanSend(addr, kWindow));
+  EXPECT_EQ(19u, mgr.GetNext(addr));
+  EXPECT_EQ(kWindow, Inflight(mgr, addr));
+
+  mgr.OnReply(addr, 0);
+  EXPECT_FALSE(mgr.CanSend(addr, kWindow));
+  mgr.OnReply(addr, 2);
+  EXPECT_TRUE(mgr.CanSend(addr, kWindow));
+
+  // 流水线中 match 推进不动在途计数，next 已经在前面就不回退
+  mgr.SetMatch(addr, 12);
+  mgr.Replicated(addr);
+  EXPECT_EQ(kWindow - 1, Inflight(mgr, addr));
+  EXPECT_EQ(19u, mgr.GetNext(addr));
+
+  // next 落后于 match 时跟上
+  mgr.SetNext(addr, 5);
+  mgr.Replicated(addr);
+  EXPECT_EQ(13u, mgr.GetNext(addr));
+
+  // 流水线中探测超时不起作用
+  mgr.RetryProbe(addr);
+  EXPECT_EQ(kWindow - 1, Inflight(mgr, addr));
+}
+
+// 被拒绝后在途的消息也会被拒绝，回到探测
+TEST(IndexManagerTest, BecomeProbe) {
+  vraft::IndexManager mgr(Peers());
+  uint64_t addr = Addr(0);
+  mgr.SetMatch(addr, 10);
+  mgr.Replicated(addr);
+  mgr.OnSend(addr, 1);
+  mgr.OnSend(addr, 1);
+
+  mgr.BecomeProbe(addr);
+  EXPECT_TRUE(mgr.Probing(addr));
+  EXPECT_EQ(0, Inflight(mgr, addr));
+  EXPECT_EQ(1u, mgr.indices[addr].rejects);
+  EXPECT_TRUE(mgr.CanSend(addr, kWindow));
+
+  mgr.OnSend(addr, 1);
+  EXPECT_FALSE(mgr.CanSend(addr, kWindow));
+  mgr.ResetFlow();
+  EXPECT_TRUE(mgr.Probing(addr));
+  EXPECT_EQ(0, Inflight(mgr, addr));
+}
+
+// 比 match 旧的拒绝，或者不是当前探测的拒绝，都丢掉
+TEST(IndexManagerTest, StaleReject) {
+  vraft::IndexManager mgr(Peers());
+  uint64_t addr = Addr(0);
+  mgr.SetMatch(addr, 10);
+  mgr.Replicated(addr);
+  mgr.OnSend(addr, 5);
+  mgr.OnSend(addr, 5);
+
+  EXPECT_TRUE(mgr.StaleReject(addr, 9));
+  EXPECT_FALSE(mgr.StaleReject(addr, 10));
+  EXPECT_FALSE(mgr.StaleReject(addr, 15));
+
+  // 第一条的拒绝让 next 回到 11 重新探测，第二条的拒绝就过时了
+  mgr.BecomeProbe(addr);
+  mgr.SetNext(addr, 11);
+  EXPECT_FALSE(mgr.StaleReject(addr, 10));
+  EXPECT_TRUE(mgr.StaleReject(addr, 15));
+}
@@ -0,0 +1,318 @@
+#include "log_storage.h"
+
+#include <cassert>
+
+#include "coding.h"
+#include "leveldb/write_batch.h"
+#include "segment_log_storage.h"
+#include "vraft_logger.h"
+
+namespace vraft {
+
+LogStorageUPtr CreateLogStorage(LogStorageType type, const std::string &path) {
+  switch (type) {
+    case kLogStorageLevelDB:
+      return std::make_unique<LevelDBLogStorage>(path + "/log");
+    case kLogStorageSegment:
+      return std::make_unique<SegmentLogStorage>(path + "/segment",
+                                                 kSegmentBytes);
+    default:
+      assert(0);
+  }
+  return nullptr;
+}
+
+// meta key and data key of an index are next to each other
+class LevelDBLogReader final : public LogReader {
+ public:
+  LevelDBLogReader(leveldb::DB *db, RaftIndex first);
+  ~LevelDBLogReader();
+
+  int32_t Read(RaftIndex index, LogEntry &entry) override;
+
+ private:
+  leveldb::Iterator *it_;
+};
+
+LevelDBLogReader::LevelDBLogReader(leveldb::DB *db, RaftIndex first) {
+  leveldb::ReadOptions ro;
+  it_ = db->NewIterator(ro);
+
+  char meta_key[sizeof(RaftIndex)];
+  EncodeMetaKey(meta_key, sizeof(RaftIndex), first);
+  it_->Seek(leveldb::Slice(meta_key, sizeof(meta_key)));
+}
+
+LevelDBLogReader::~LevelDBLogReader() { delete it_; }
+
+int32_t LevelDBLogReader::Read(RaftIndex index, LogEntry &entry) {
+  if (!it_->Valid()) {
+    return -1;
+  }
+
+  // meta key 在前，data key 紧跟其后
+  RaftIndex key = DecodeFixed32(it_->key().data());
+  if (key != LogIndexToMetaIndex(index)) {
+    return -1;
+  }
+  MetaValue meta;
+  leveldb::Slice meta_value = it_->value();
+  assert(static_cast<int32_t>(meta_value.size()) == MetaValueBytes());
+  DecodeMetaValue(meta_value.data(), meta_value.size(), meta);
+
+  it_->Next();
+  if (!it_->Valid() ||
+      DecodeFixed32(it_->key().data()) != LogIndexToDataIndex(index)) {
+    return -1;
+  }
+  entry.append_entry.value.assign(it_->value().data(), it_->value().size());
+  it_->Next();
+
+  entry.index = index;
+  entry.pre_chk_all = meta.pre_chk_all;
+  entry.chk_ths = meta.chk_ths;
+  entry.chk_all = meta.chk_all;
+  entry.append_entry.term = meta.term;
+  entry.append_entry.type = meta.type;
+  return 0;
+}
+
+LevelDBLogStorage::LevelDBLogStorage(const std::string &path)
+    : path_(path), first_(0), last_(0) {}
+
+LevelDBLogStorage::~LevelDBLogStorage() {}
+
+int32_t LevelDBLogStorage::Open(LogStorageState &state) {
+  db_options_.create_if_missing = true;
+  db_options_.error_if_exists = false;
+  db_options_.comparator = U32Comparator();
+
+  leveldb::DB *dbptr;
+  leveldb::Status status = leveldb::DB::Open(db_options_, path_, &dbptr);
+  if (!status.ok()) {
+    vraft_logger.FError("leveldb open %s error, %s", path_.c_str(),
+                        status.ToString().c_str());
+    assert(0);
+  }
+  db_.reset(dbptr);
+
+  leveldb::ReadOptions ro;
+  leveldb::Iterator *it = db_->NewIterator(ro);
+
+  // maybe init first
+  it->SeekToFirst();
+  if (!it->Valid()) {
+    leveldb::WriteBatch batch;
+    char zero_value[sizeof(RaftIndex) + sizeof(uint32_t)];
+    EncodeZeroValue(zero_value, 1, 0);
+    batch.Put(leveldb::Slice(kZeroKey, sizeof(kZeroKey)),
+              leveldb::Slice(zero_value, sizeof(zero_value)));
+    leveldb::WriteOptions wo;
+    wo.sync = true;
+    leveldb::Status s = db_->Write(wo, &batch);
+    assert(s.ok());
+  }
+  delete it;
+
+  // init
+  it = db_->NewIterator(ro);
+  it->SeekToLast();
+  assert(it->Valid());
+  assert(it->key().size() == sizeof(RaftIndex));
+  RaftIndex index = DecodeFixed32(it->key().data());
+
+  if (index == 0) {
+    // no value
+    state.first = 0;
+    state.last = 0;
+
+    // get zero value
+    assert(it->value().size() == sizeof(RaftIndex) + sizeof(uint32_t));
+
+    // append, checksum
+    DecodeZeroValue(it->value().data(), state.append, state.checksum);
+
+  } else {  // has value
+    // last, data index
+    state.last = DataIndexToLogIndex(index);
+
+    // first, meta index
+    it->SeekToFirst();
+    it->Next();
+    RaftIndex meta_index = DecodeFixed32(it->key().data());
+    state.first = MetaIndexToLogIndex(meta_index);
+
+    // append
+    state.append = state.last + 1;
+
+    // checksum
+    MetaValue meta;
+    int32_t rv = GetMeta(state.last, meta);
+    assert(rv == 0);
+    state.checksum = meta.chk_all;
+  }
+  delete it;
+
+  first_ = state.first;
+  last_ = state.last;
+  return 0;
+}
+
+int32_t LevelDBLogStorage::Append(const std::vector<LogEntryPtr> &entries,
+                                  bool sync) {
+  leveldb::WriteBatch batch;
+  for (auto &entry : entries) {
+    assert(last_ == 0 || entry->index == last_ + 1);
+
+    char meta_key[sizeof(RaftIndex)];
+    EncodeMetaKey(meta_key, sizeof(RaftIndex), entry->index);
+
+    MetaValue mv;
+    mv.term = entry->append_entry.term;
+    mv.type = entry->append_entry.type;
+    mv.pre_chk_all = entry->pre_chk_all;
+    mv.chk_ths = entry->chk_ths;
+    mv.chk_all = entry->chk_all;
+    char meta_value[sizeof(MetaValue)];
+    EncodeMetaValue(meta_value, sizeof(MetaValue), mv);
+
+    char data_key[sizeof(RaftIndex)];
+    EncodeDataKey(data_key, sizeof(RaftIndex), entry->index);
+
+    const std::string &value = entry->append_entry.value;
+    batch.Put(leveldb::Slice(meta_key, sizeof(meta_key)),
+              leveldb::Slice(meta_value, sizeof(meta_value)));
+    batch.Put(leveldb::Slice(data_key, sizeof(data_key)),
+              leveldb::Slice(value.c_str(), value.size()));
+
+    if (first_ == 0) {
+      first_ = entry->index;
+    }
+    last_ = entry->index;
+  }
+
+  // leveldb 切换日志文件时不 fsync 旧文件，之后的 sync 写只同步新文件，
+  // 旧文件里没同步的写入在 memtable 落盘前掉电会丢，所以每次写都同步
+  leveldb::WriteOptions wo;
+  wo.sync = true;
+  leveldb::Status s = db_->Write(wo, &batch);
+  assert(s.ok());
+  return 0;
+}
+
+// every write is synced, see Append
+int32_t LevelDBLogStorage::Sync() { return 0; }
+
+int32_t LevelDBLogStorage::GetMeta(RaftIndex index, MetaValue &meta) {
+  char meta_key[sizeof(RaftIndex)];
+  EncodeMetaKey(meta_key, sizeof(RaftIndex), index);
+  leveldb::ReadOptions ro;
+  leveldb::Status s;
+  std::string meta_value;
+  s = db_->Get(ro, leveldb::Slice(meta_key, sizeof(meta_key)), &meta_value);
+  if (s.ok()) {
+    assert(static_cast<int32_t>(meta_value.size()) == MetaValueBytes());
+    DecodeMetaValue(meta_value.c_str(), meta_value.size(), meta);
+    return 0;
+
+  } else {
+    return -1;
+  }
+}
+
+int32_t LevelDBLogStorage::GetValue(RaftIndex index, std::string *value) {
+  char data_key[sizeof(RaftIndex)];
+  EncodeDataKey(data_key, sizeof(RaftIndex), index);
+  leveldb::ReadOptions ro;
+  leveldb::Status s;
+  s = db_->Get(ro, leveldb::Slice(data_key, sizeof(data_key)), value);
+  if (s.ok()) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+LogReaderUPtr LevelDBLogStorage::NewReader(RaftIndex first) {
+  return std::make_unique<LevelDBLogReader>(db_.get(), first);
+}
+
+int32_t LevelDBLogStorage::DeleteFrom(RaftIndex from_index, RaftIndex append,
+                                      uint32_t checksum) {
+  if (last_ == 0 || from_index > last_) {
+    return 0;
+  }
+  if (from_index < first_) {
+    from_index = first_;
+  }
+
+  bool empty = (from_index == first_);
+  DeleteRange(from_index, last_, empty, append, checksum);
+
+  if (empty) {
+    first_ = 0;
+    last_ = 0;
+  } else {
+    last_ = from_index - 1;
+  }
+  return 0;
+}
+
+int32_t LevelDBLogStorage::DeleteUtil(RaftIndex to_index, RaftIndex append,
+                                      uint32_t checksum) {
+  if (last_ == 0 || to_index < first_) {
+    return 0;
+  }
+  if (to_index > last_) {
+    to_index = last_;
+  }
+
+  bool empty = (to_index == last_);
+  DeleteRange(first_, to_index, empty, append, checksum);
+
+  if (empty) {
+    first_ = 0;
+    last_ = 0;
+  } else {
+    first_ = to_index + 1;
+  }
+  return 0;
+}
+
+void LevelDBLogStorage::DeleteRange(RaftIndex from_index, RaftIndex to_index,
+                                    bool empty, RaftIndex append,
+                                    uint32_t checksum) {
+  leveldb::WriteBatch batch;
+  for (RaftIndex i = from_index; i <= to_index; ++i) {
+    char meta_key[sizeof(RaftIndex)];
+    EncodeMetaKey(meta_key, sizeof(RaftIndex), i);
+    batch.Delete(leveldb::Slice(meta_key, sizeof(meta_key)));
+
+    char data_key[sizeof(RaftIndex)];
+    EncodeDataKey(data_key, sizeof(RaftIndex), i);
+    batch.Delete(leveldb::Slice(data_key, sizeof(data_key)));
+  }
+
+  // need to persist append index
+  if (empty) {
+    char zero_value[sizeof(RaftIndex) + sizeof(uint32_t)];
+    EncodeZeroValue(zero_value, append, checksum);
+    batch.Put(leveldb::Slice(kZeroKey, sizeof(kZeroKey)),
+              leveldb::Slice(zero_value, sizeof(zero_value)));
+  }
+
+  // 与 Append 相同，删除也同步写，否则截断的日志掉电后可能重新出现
+  leveldb::WriteOptions wo;
+  wo.sync = true;
+  leveldb::Status s = db_->Write(wo, &batch);
+  assert(s.ok());
+}
+
+nlohmann::json LevelDBLogStorage::ToJson() {
+  nlohmann::json j;
+  j["type"] = "leveldb";
+  j["path"] = path_;
+  return j;
+}
+
+}  // namespace vraft
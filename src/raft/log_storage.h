@@ -0,0 +1,114 @@
+#ifndef VRAFT_LOG_STORAGE_H_
+#define VRAFT_LOG_STORAGE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "leveldb/db.h"
+#include "raft_log.h"
+
+namespace vraft {
+
+// Where the log is after a restart. If the log is empty, first and last
+// are 0, append is the next index and checksum the chk_all before it.
+struct LogStorageState {
+  RaftIndex first;
+  RaftIndex last;
+  RaftIndex append;
+  uint32_t checksum;
+};
+
+// Reads entries one after another from a start index.
+class LogReader {
+ public:
+  LogReader() {}
+  virtual ~LogReader() {}
+  LogReader(const LogReader &t) = delete;
+  LogReader &operator=(const LogReader &t) = delete;
+
+  // index must follow the last one read, return -1 if not found
+  virtual int32_t Read(RaftIndex index, LogEntry &entry) = 0;
+};
+
+using LogReaderUPtr = std::unique_ptr<LogReader>;
+
+// Keeps the entries of RaftLog. RaftLog decides the indices and the
+// checksums, the storage only persists them. Not thread safe except Sync,
+// RaftLog locks it for the appends in the log I/O thread.
+class LogStorage {
+ public:
+  LogStorage() {}
+  virtual ~LogStorage() {}
+  LogStorage(const LogStorage &t) = delete;
+  LogStorage &operator=(const LogStorage &t) = delete;
+
+  virtual int32_t Open(LogStorageState &state) = 0;
+
+  // entries follow the last one, sync false: call Sync later
+  virtual int32_t Append(const std::vector<LogEntryPtr> &entries,
+                         bool sync) = 0;
+
+  // thread safe, all appended entries are durable after it returns
+  virtual int32_t Sync() = 0;
+
+  virtual int32_t GetMeta(RaftIndex index, MetaValue &meta) = 0;
+  virtual int32_t GetValue(RaftIndex index, std::string *value) = 0;
+  virtual LogReaderUPtr NewReader(RaftIndex first) = 0;
+
+  // delete [from_index, last] or [first, to_index], if the log becomes
+  // empty, append and checksum are kept for the next Open
+  virtual int32_t DeleteFrom(RaftIndex from_index, RaftIndex append,
+                             uint32_t checksum) = 0;
+  virtual int32_t DeleteUtil(RaftIndex to_index, RaftIndex append,
+                             uint32_t checksum) = 0;
+
+  virtual nlohmann::json ToJson() = 0;
+};
+
+using LogStorageUPtr = std::unique_ptr<LogStorage>;
+
+LogStorageUPtr CreateLogStorage(LogStorageType type, const std::string &path);
+
+// log_index: 1 2 3
+// term_key : 1 3 5
+// value_key: 2 4 6
+// key 0 keeps append and checksum when the log is empty.
+// Every write is synced, leveldb does not fsync a log file it switches
+// away from, a later synced write would not cover it.
+class LevelDBLogStorage final : public LogStorage {
+ public:
+  explicit LevelDBLogStorage(const std::string &path);
+  ~LevelDBLogStorage();
+
+  int32_t Open(LogStorageState &state) override;
+  int32_t Append(const std::vector<LogEntryPtr> &entries, bool sync) override;
+  int32_t Sync() override;
+
+  int32_t GetMeta(RaftIndex index, MetaValue &meta) override;
+  int32_t GetValue(RaftIndex index, std::string *value) override;
+  LogReaderUPtr NewReader(RaftIndex first) override;
+
+  int32_t DeleteFrom(RaftIndex from_index, RaftIndex append,
+                     uint32_t checksum) override;
+  int32_t DeleteUtil(RaftIndex to_index, RaftIndex append,
+                     uint32_t checksum) override;
+
+  nlohmann::json ToJson() override;
+
+ private:
+  void DeleteRange(RaftIndex from_index, RaftIndex to_index, bool empty,
+                   RaftIndex append, uint32_t checksum);
+
+ private:
+  std::string path_;
+  leveldb::Options db_options_;
+  std::shared_ptr<leveldb::DB> db_;
+  RaftIndex first_;
+  RaftIndex last_;
+};
+
+}  // namespace vraft
+
+#endif
@@ -72,6 +72,8 @@ enum MsgType {
   kInstallSnapshot,
   kInstallSnapshotReply,
   kTimeoutNow,
+  kReadIndex,
+  kReadIndexReply,
 
   kMsgNum,
 };
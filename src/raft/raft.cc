@@ -33,6 +33,13 @@ void Tick(Timer *timer) {
     //   r->SendPing(dest_addr.ToU64(), nullptr);
   }
 
+  // 等太久的读请求按失败返回，由调用方重试
+  uint64_t read_timeout_ns = 2ull * r->timer_mgr_.election_ms() * 1000 * 1000;
+  uint64_t now = Clock::NSec();
+  if (now > read_timeout_ns) {
+    r->FailReads(r->read_mgr_.TakeExpired(now - read_timeout_ns));
+  }
+
   if (r->print_screen()) {
     printf("%s %s\n", NsToString(Clock::NSec()).c_str(),
            r->ToJsonString(true, true).c_str());
@@ -58,6 +65,7 @@ Raft::Raft(const std::string &path, const RaftConfig &rc)
       config_mgr_(rc),
       vote_mgr_(rc.peers),
       index_mgr_(rc.peers),
+      read_mgr_(rc.peers),
       sm_(nullptr),
       snapshot_mgr_(rc.peers),
       timer_mgr_(rc.peers),
@@ -71,6 +79,7 @@ Raft::Raft(const std::string &path, const RaftConfig &rc)
       disable_send_func_(nullptr),
       enable_recv_func_(nullptr),
       disable_recv_func_(nullptr),
+      log_io_(nullptr),
       enable_send_(true),
       enable_recv_(true),
       leader_times_(0),
@@ -80,6 +89,10 @@ Raft::Raft(const std::string &path, const RaftConfig &rc)
       leader_transfer_(false),
       transfer_max_term_(0),
       interval_check_(true),
+      enable_lease_read_(false),
+      max_entries_per_msg_(kMaxEntriesPerMsg),
+      max_bytes_per_msg_(kMaxBytesPerMsg),
+      max_inflight_msgs_(kMaxInflightMsgs),
       last_heartbeat_timestamp_(0),
       changing_index_(0),
       standby_(false) {
@@ -119,6 +132,7 @@ int32_t Raft::Start() {
   timer_mgr_.set_election_func(Elect);
   timer_mgr_.set_requestvote_func(RequestVoteRpc);
   timer_mgr_.set_heartbeat_func(HeartBeat);
+  timer_mgr_.set_propose_func(GroupPropose);
   timer_mgr_.set_data(this);
   timer_mgr_.MakeTimer();
 
@@ -310,6 +324,7 @@ RaftTerm Raft::GetTerm(RaftIndex index) {
 void Raft::ResetManagerPeers(const std::vector<RaftAddr> &peers) {
   // reset managers
   index_mgr_.Reset(peers);
+  read_mgr_.Reset(peers);
   vote_mgr_.Reset(peers);
   snapshot_mgr_.Reset(peers);
   timer_mgr_.Reset(peers);
@@ -684,6 +699,13 @@ nlohmann::json Raft::ToJson() {
   j["transfer"] = leader_transfer_;
   j["tsf-max-term"] = transfer_max_term_;
   j["interval-chk"] = interval_check_;
+  j["lease-read"] = enable_lease_read_;
+  j["max-entries-msg"] = max_entries_per_msg_;
+  j["max-bytes-msg"] = max_bytes_per_msg_;
+  j["max-inflight"] = max_inflight_msgs_;
+  j["proposals"] = proposals_.size();
+  j["sync-pending"] = log_.PersistPending();
+  j["synced"] = SyncedIndex();
   j["run"] = started_;
   if (leader_.ToU64() == 0) {
     j["leader"] = 0;
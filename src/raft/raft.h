@@ -19,6 +19,9 @@
 #include "ping_reply.h"
 #include "raft_addr.h"
 #include "raft_log.h"
+#include "read_index.h"
+#include "read_index_reply.h"
+#include "read_manager.h"
 #include "request_vote.h"
 #include "request_vote_reply.h"
 #include "simple_random.h"
@@ -41,11 +44,22 @@ enum State {
   STATE_ERROR,
 };
 
+// limits of entries in one AppendEntries, at least one entry is sent
+const int32_t kMaxEntriesPerMsg = 64;
+const int32_t kMaxBytesPerMsg = 1024 * 1024;
+
+// AppendEntries with entries in flight to one peer, not acked yet
+const int32_t kMaxInflightMsgs = 8;
+
+// run work in the log I/O thread, then done in the raft loop thread
+using LogIoFunc = std::function<void(Functor work, Functor done)>;
+
 const char *StateToStr(enum State state);
 void Tick(Timer *timer);
 void Elect(Timer *timer);
 void RequestVoteRpc(Timer *timer);
 void HeartBeat(Timer *timer);
+void GroupPropose(Timer *timer);
 
 class Raft final {
  public:
@@ -66,6 +80,11 @@ class Raft final {
   int32_t AddServer(const RaftAddr &addr);
   int32_t RemoveServer(const RaftAddr &addr);
 
+  // read on this node, cb runs in the loop thread when the local state
+  // machine may serve the read, -1: not started or no leader known,
+  // cb is not called
+  int32_t Read(const ReadOptions &options, ReadFunc cb);
+
   // on message
   int32_t OnPing(struct Ping &msg);
   int32_t OnPingReply(struct PingReply &msg);
@@ -76,6 +95,8 @@ class Raft final {
   int32_t OnInstallSnapshot(struct InstallSnapshot &msg);
   int32_t OnInstallSnapshotReply(struct InstallSnapshotReply &msg);
   int32_t OnTimeoutNow(struct TimeoutNow &msg);
+  int32_t OnReadIndex(struct ReadIndex &msg);
+  int32_t OnReadIndexReply(struct ReadIndexReply &msg);
   int32_t OnClientRequest(struct ClientRequest &msg,
                           vraft::TcpConnectionSPtr conn);
 
@@ -83,11 +104,15 @@ class Raft final {
   int32_t SendPing(uint64_t dest, Tracer *tracer);
   int32_t SendRequestVote(uint64_t dest, Tracer *tracer);
   int32_t SendAppendEntries(uint64_t dest, Tracer *tracer);
+  int32_t SendHeartBeat(uint64_t dest, Tracer *tracer);
   int32_t SendInstallSnapshot(uint64_t dest, Tracer *tracer);
   int32_t SendRequestVoteReply(RequestVoteReply &msg, Tracer *tracer);
   int32_t SendAppendEntriesReply(AppendEntriesReply &msg, Tracer *tracer);
   int32_t SendInstallSnapshotReply(InstallSnapshotReply &msg, Tracer *tracer);
   int32_t SendTimeoutNow(uint64_t dest, bool force, Tracer *tracer);
+  int32_t SendReadIndex(uint64_t dest, uint64_t seq, Tracer *tracer);
+  int32_t SendReadIndexReply(RaftAddr dest, uint64_t req_seq, bool success,
+                             RaftIndex read_index, Tracer *tracer);
 
   // utils
   int16_t Id() { return config_mgr_.Current()->me.id(); }
@@ -115,6 +140,7 @@ class Raft final {
   void set_disable_send_func(Functor func);
   void set_enable_recv_func(Functor func);
   void set_disable_recv_func(Functor func);
+  void set_log_io(LogIoFunc func);
 
   int32_t leader_times() const;
   bool print_screen() const;
@@ -127,6 +153,14 @@ class Raft final {
   void set_pre_voting(bool pre_voting);
   bool interval_check() const;
   void set_interval_check(bool interval_check);
+  bool enable_lease_read() const;
+  void set_enable_lease_read(bool enable_lease_read);
+  int32_t max_entries_per_msg() const;
+  void set_max_entries_per_msg(int32_t max_entries_per_msg);
+  int32_t max_bytes_per_msg() const;
+  void set_max_bytes_per_msg(int32_t max_bytes_per_msg);
+  int32_t max_inflight_msgs() const;
+  void set_max_inflight_msgs(int32_t max_inflight_msgs);
   StateMachineSPtr sm();
   RaftLog &log();
   SolidData &meta();
@@ -166,6 +200,29 @@ class Raft final {
   void AgainElection() { timer_mgr_.AgainElection(); }
 
   int32_t DoPropose(const std::string &value, EntryType type, Tracer *tracer);
+  void FlushProposals(Tracer *tracer);
+
+  // leader, write the log in the log I/O thread while replicating
+  void PersistLog(std::vector<LogEntryPtr> &&entries, uint64_t seq,
+                  Tracer *tracer);
+  void OnLogPersisted(RaftIndex index, uint64_t seq);
+  RaftIndex SyncedIndex();
+
+  // heartbeat: send even if the window is full, without entries then
+  int32_t DoSendAppendEntries(uint64_t dest, bool heartbeat, Tracer *tracer);
+
+  // send append entries until the window is full or dest has all the log,
+  // return the number of messages sent
+  int32_t FillWindow(uint64_t dest, Tracer *tracer);
+
+  // read
+  bool ReadFreshEnough(uint32_t max_stale_ms, uint64_t now);
+  bool LeaseValid(uint64_t now);
+  int32_t DoReadIndex(uint64_t now, ReadFunc cb, Tracer *tracer);
+  void BroadcastHeartBeat(Tracer *tracer);
+  void ConfirmReads(Tracer *tracer);
+  void ApplyReads();
+  void FailReads(std::vector<PendingRead> reads);
 
  private:
   bool started_;
@@ -194,6 +251,9 @@ class Raft final {
   // raft state: leader
   IndexManager index_mgr_;
 
+  // reads waiting for leadership confirm or state machine apply
+  ReadManager read_mgr_;
+
   // raft state: state machine
   StateMachineSPtr sm_;
 
@@ -213,6 +273,7 @@ class Raft final {
   Functor disable_send_func_;
   Functor enable_recv_func_;
   Functor disable_recv_func_;
+  LogIoFunc log_io_;
   bool enable_send_;
   bool enable_recv_;
   int32_t leader_times_;
@@ -223,6 +284,11 @@ class Raft final {
   bool leader_transfer_;
   RaftTerm transfer_max_term_;
   bool interval_check_;
+  bool enable_lease_read_;  // lease works only with interval_check_
+  int32_t max_entries_per_msg_;
+  int32_t max_bytes_per_msg_;
+  int32_t max_inflight_msgs_;  // pipeline window per peer
+  std::vector<AppendEntry> proposals_;  // appended together in next loop
   int64_t last_heartbeat_timestamp_;
   RaftIndex changing_index_;  // config changing index
 
@@ -235,6 +301,7 @@ class Raft final {
   friend void Elect(Timer *timer);
   friend void RequestVoteRpc(Timer *timer);
   friend void HeartBeat(Timer *timer);
+  friend void GroupPropose(Timer *timer);
 };
 
 inline bool Raft::started() const { return started_; }
@@ -277,6 +344,8 @@ inline void Raft::set_disable_recv_func(Functor func) {
   disable_recv_func_ = func;
 }
 
+inline void Raft::set_log_io(LogIoFunc func) { log_io_ = func; }
+
 inline int32_t Raft::leader_times() const { return leader_times_; }
 
 inline bool Raft::print_screen() const { return print_screen_; }
@@ -307,6 +376,32 @@ inline void Raft::set_interval_check(bool interval_check) {
   interval_check_ = interval_check;
 }
 
+inline bool Raft::enable_lease_read() const { return enable_lease_read_; }
+
+inline void Raft::set_enable_lease_read(bool enable_lease_read) {
+  enable_lease_read_ = enable_lease_read;
+}
+
+inline int32_t Raft::max_entries_per_msg() const {
+  return max_entries_per_msg_;
+}
+
+inline void Raft::set_max_entries_per_msg(int32_t max_entries_per_msg) {
+  max_entries_per_msg_ = max_entries_per_msg;
+}
+
+inline int32_t Raft::max_bytes_per_msg() const { return max_bytes_per_msg_; }
+
+inline void Raft::set_max_bytes_per_msg(int32_t max_bytes_per_msg) {
+  max_bytes_per_msg_ = max_bytes_per_msg;
+}
+
+inline int32_t Raft::max_inflight_msgs() const { return max_inflight_msgs_; }
+
+inline void Raft::set_max_inflight_msgs(int32_t max_inflight_msgs) {
+  max_inflight_msgs_ = max_inflight_msgs;
+}
+
 inline StateMachineSPtr Raft::sm() { return sm_; }
 
 inline RaftLog &Raft::log() { return log_; }
@@ -102,6 +102,7 @@ int32_t Raft::OnAppendEntries(struct AppendEntries &msg) {
     reply.req_pre_index = msg.pre_log_index;
     reply.req_num_entries = msg.entries.size();
     reply.req_term = msg.term;
+    reply.req_send_ts = msg.send_ts;
 
     // stale term, send reply
     if (msg.term < meta_.term()) {
@@ -161,6 +162,12 @@ int32_t Raft::OnAppendEntries(struct AppendEntries &msg) {
       }
     }
 
+    // check the whole batch before changing the log, accept all or none
+    if (!msg.EntriesValid()) {
+      tracer.PrepareEvent(kEventOther, std::string("reject, bad entries"));
+      goto end;
+    }
+
     // if we get here, means accept
     reply.success = true;
 
@@ -169,7 +176,7 @@ int32_t Raft::OnAppendEntries(struct AppendEntries &msg) {
     index = msg.pre_log_index;
     for (auto it = msg.entries.begin(); it != msg.entries.end(); ++it) {
       ++index;
-      LogEntry &entry = *it;
+      LogEntry &entry = **it;
       assert(entry.index == index);
 
       // maybe snapshot, continue
@@ -198,16 +205,14 @@ int32_t Raft::OnAppendEntries(struct AppendEntries &msg) {
         tracer.PrepareEvent(kEventOther, std::string(buf));
       }
 
-      // append this and all following entries.
-      do {
-        LogEntry &entry_to_append = *it;
-        int32_t rv = log_.AppendOne(entry_to_append.append_entry, &tracer);
-        assert(rv == 0);
-
-        ++it;
-        ++index;
-
-      } while (it != msg.entries.end());
+      // append this and all following entries, one write and one fsync
+      std::vector<AppendEntry> to_append;
+      to_append.reserve(msg.entries.end() - it);
+      for (; it != msg.entries.end(); ++it) {
+        to_append.push_back(std::move((*it)->append_entry));
+      }
+      int32_t rv = log_.AppendSome(to_append, &tracer);
+      assert(rv == 0);
 
       // process over
       break;
@@ -296,10 +301,17 @@ int32_t Raft::OnAppendEntriesReply(struct AppendEntriesReply &msg) {
       assert(msg.term == meta_.term());
       assert(msg.req_term == meta_.term());
 
+      // follower still follows me when the request was sent, success or not
+      read_mgr_.Ack(msg.src.ToU64(), msg.req_send_ts);
+      ConfirmReads(&tracer);
+
+      // one message in flight answered
+      index_mgr_.OnReply(msg.src.ToU64(), msg.req_num_entries);
+
       if (msg.success) {  // follower return match
         if (index_mgr_.GetMatch(msg.src) >
             msg.req_pre_index + msg.req_num_entries) {
-          // maybe pipeline ?
+          // pipeline, an earlier message answered later
 
         } else {
           assert(index_mgr_.GetMatch(msg.src) <=
@@ -310,10 +322,18 @@ int32_t Raft::OnAppendEntriesReply(struct AppendEntriesReply &msg) {
           MaybeCommit(&tracer);
         }
 
-        // increase next index
-        index_mgr_.SetNext(msg.src, index_mgr_.GetMatch(msg.src) + 1);
+        // increase next index, leave probe
+        index_mgr_.Replicated(msg.src.ToU64());
+
+      } else if (index_mgr_.StaleReject(msg.src.ToU64(), msg.req_pre_index)) {
+        // stale reject, sent before the last match or the current probe
+        tracer.PrepareEvent(kEventOther, std::string("drop stale reject"));
 
       } else {  // follower return not match
+        // messages in flight behind it are rejected too, probe again
+        index_mgr_.BecomeProbe(msg.src.ToU64());
+        index_mgr_.SetNext(msg.src, msg.req_pre_index + 1);
+
         // decrease next index
         if (index_mgr_.GetNext(msg.src) > 1) {
           index_mgr_.DecrNext(msg.src);
@@ -325,10 +345,9 @@ int32_t Raft::OnAppendEntriesReply(struct AppendEntriesReply &msg) {
         }
       }
 
-      // send msg immediately
-      if (index_mgr_.GetNext(msg.src) <= LastIndex()) {
-        SendAppendEntries(msg.src.ToU64(), &tracer);
-
+      // send msg immediately, the reply frees one slot of the window but
+      // a single message may be far behind LastIndex, fill the whole window
+      if (FillWindow(msg.src.ToU64(), &tracer) > 0) {
         // reset heartbeat timer
         timer_mgr_.AgainHeartBeat(msg.src.ToU64());
       }
@@ -342,6 +361,32 @@ int32_t Raft::OnAppendEntriesReply(struct AppendEntriesReply &msg) {
 }
 
 int32_t Raft::SendAppendEntries(uint64_t dest, Tracer *tracer) {
+  return DoSendAppendEntries(dest, false, tracer);
+}
+
+int32_t Raft::FillWindow(uint64_t dest, Tracer *tracer) {
+  int32_t sent = 0;
+  while (index_mgr_.CanSend(dest, max_inflight_msgs_) &&
+         index_mgr_.GetNext(dest) <= LastIndex()) {
+    RaftIndex next_index = index_mgr_.GetNext(dest);
+    int32_t rv = SendAppendEntries(dest, tracer);
+    assert(rv == 0);
+    ++sent;
+
+    // 探测状态或者发了快照时 next 不前进，一次只发一条
+    if (index_mgr_.GetNext(dest) == next_index) {
+      break;
+    }
+  }
+  return sent;
+}
+
+int32_t Raft::SendHeartBeat(uint64_t dest, Tracer *tracer) {
+  return DoSendAppendEntries(dest, true, tracer);
+}
+
+int32_t Raft::DoSendAppendEntries(uint64_t dest, bool heartbeat,
+                                  Tracer *tracer) {
   RaftIndex last_index = LastIndex();
   RaftIndex next_index = index_mgr_.GetNext(dest);
   RaftIndex pre_index = next_index - 1;
@@ -380,11 +425,30 @@ int32_t Raft::SendAppendEntries(uint64_t dest, Tracer *tracer) {
   msg.pre_log_index = pre_index;
   msg.pre_log_term = pre_term;
 
-  if (log_.IndexValid(next_index)) {
-    LogEntry entry;
-    int32_t rv = log_.Get(next_index, entry);
-    assert(rv == 0);
-    msg.entries.push_back(entry);
+  // 窗口满了，等应答再发；心跳照发，不带日志
+  bool window_ok = index_mgr_.CanSend(dest, max_inflight_msgs_);
+  if (!window_ok && !heartbeat) {
+    return 0;
+  }
+
+  // 一条消息带多条日志，条数和字节数不超过限制，至少带一条
+  if (window_ok && log_.IndexValid(next_index)) {
+    int32_t bytes = 0;
+    RaftLogIteratorUPtr it = log_.NewIterator(next_index, last_index);
+    for (; it->Valid(); it->Next()) {
+      int32_t entry_bytes = it->entry()->MaxBytes();
+      int32_t count = msg.entries.size();
+      if (!BatchHasRoom(count, bytes, entry_bytes, max_entries_per_msg_,
+                        max_bytes_per_msg_)) {
+        break;
+      }
+      msg.entries.push_back(it->entry());
+      bytes += entry_bytes;
+    }
+    assert(!msg.entries.empty());
+
+    // 流水线模式下发送即推进 next
+    index_mgr_.OnSend(dest, msg.entries.size());
   }
 
   // tla+
@@ -7,7 +7,6 @@
 #include "raft_server.h"
 #include "util.h"
 #include "vraft_logger.h"
-#include "vstore_sm.h"
 
 namespace vraft {
 
@@ -45,10 +44,9 @@ int32_t Raft::OnClientRequest(struct ClientRequest &msg,
       }
 
       case kCmdGet: {
-        vstore::VstoreSm *sm = reinterpret_cast<vstore::VstoreSm *>(sm_.get());
-        assert(sm);
+        assert(sm_);
         std::string value;
-        rv = sm->Get(msg.data, value);
+        rv = sm_->Get(msg.data, value);
 
         {
           // reply
@@ -75,28 +73,119 @@ int32_t Raft::OnClientRequest(struct ClientRequest &msg,
   return rv;
 }
 
+void GroupPropose(Timer *timer) {
+  Raft *r = reinterpret_cast<Raft *>(timer->data());
+  if (r->proposals_.empty()) {
+    return;
+  }
+  assert(r->state_ == STATE_LEADER);
+
+  Tracer tracer(r, true, r->tracer_cb_);
+  tracer.PrepareState0();
+
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%s propose-timer timeout, proposals:%lu",
+           r->Me().ToString().c_str(), r->proposals_.size());
+  tracer.PrepareEvent(kEventTimer, std::string(buf));
+  r->FlushProposals(&tracer);
+
+  tracer.PrepareState1();
+  tracer.Finish();
+}
+
 int32_t Raft::DoPropose(const std::string &value, EntryType type,
                         Tracer *tracer) {
   AppendEntry entry;
   entry.term = meta_.term();
   entry.type = type;
   entry.value = value;
-  int32_t rv = log_.AppendOne(entry, tracer);
-  assert(rv == 0);
+
+  // 排在还没写入的提案后面，保持提案顺序
+  proposals_.push_back(std::move(entry));
+  FlushProposals(tracer);
+  return 0;
+}
+
+// group commit: one write and one fsync for all proposals, then replicate
+void Raft::FlushProposals(Tracer *tracer) {
+  if (proposals_.empty()) {
+    return;
+  }
+  timer_mgr_.StopPropose();
+
+  // 有日志 I/O 线程时写盘和 fsync 都交给它，日志先进缓存，马上从缓存复制，
+  // 写盘和网络同时进行
+  int32_t rv = 0;
+  if (log_io_) {
+    std::vector<LogEntryPtr> to_persist;
+    uint64_t seq = 0;
+    rv = log_.AppendAsync(proposals_, to_persist, seq, tracer);
+    assert(rv == 0);
+    if (!to_persist.empty()) {
+      PersistLog(std::move(to_persist), seq, tracer);
+    }
+
+  } else {
+    rv = log_.AppendSome(proposals_, tracer);
+    assert(rv == 0);
+  }
+  proposals_.clear();
 
   MaybeCommit(tracer);
   if (config_mgr_.Current()->peers.size() > 0) {
+    // 一批提案可能超过一条消息的上限，窗口内连续发完
     for (auto &peer : config_mgr_.Current()->peers) {
-      rv = SendAppendEntries(peer.ToU64(), tracer);
-      assert(rv == 0);
-
-      timer_mgr_.AgainHeartBeat(peer.ToU64());
+      if (FillWindow(peer.ToU64(), tracer) > 0) {
+        timer_mgr_.AgainHeartBeat(peer.ToU64());
+      }
     }
   }
+}
 
-  return rv;
+void Raft::PersistLog(std::vector<LogEntryPtr> &&entries, uint64_t seq,
+                      Tracer *tracer) {
+  RaftIndex last = entries.back()->index;
+  auto batch = std::make_shared<std::vector<LogEntryPtr>>(std::move(entries));
+  log_io_(
+      [this, batch]() {
+        int32_t rv = log_.Persist(*batch);
+        assert(rv == 0);
+      },
+      [this, last, seq]() { OnLogPersisted(last, seq); });
+
+  if (tracer) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "log-persist start, seq:%lu, last:%u, "
+             "pending:%d", seq, last, log_.PersistPending());
+    tracer->PrepareEvent(kEventOther, std::string(buf));
+  }
+}
+
+void Raft::OnLogPersisted(RaftIndex index, uint64_t seq) {
+  // 截断或同步写之前等过所有批次，那之前的完成通知已经过时
+  bool fresh = log_.OnPersisted(seq);
+
+  // leader 自己落盘后才算进多数派
+  if (fresh && started_ && state_ == STATE_LEADER) {
+    Tracer tracer(this, true, tracer_cb_);
+    tracer.PrepareState0();
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s log-persist done, seq:%lu, last:%u, "
+             "pending:%d", Me().ToString().c_str(), seq, index,
+             log_.PersistPending());
+    tracer.PrepareEvent(kEventOther, std::string(buf));
+    MaybeCommit(&tracer);
+
+    tracer.PrepareState1();
+    tracer.Finish();
+  }
 }
 
+// the last index on local disk, entries after it are still in the log
+// I/O thread
+RaftIndex Raft::SyncedIndex() { return log_.Durable(); }
+
 /********************************************************************************************
 \* Leader i receives a client request to add v to the log.
 ClientRequest(i, v) ==
@@ -126,7 +215,17 @@ int32_t Raft::Propose(std::string value, Functor cb) {
     goto end;
   }
 
-  rv = DoPropose(value, kData, &tracer);
+  // 本轮事件循环里的提案先攒起来，下一轮一起写盘和复制
+  {
+    AppendEntry entry;
+    entry.term = meta_.term();
+    entry.type = kData;
+    entry.value = std::move(value);
+    proposals_.push_back(std::move(entry));
+    if (proposals_.size() == 1) {
+      timer_mgr_.StartPropose();
+    }
+  }
 
 end:
   tracer.PrepareState1();
@@ -160,7 +160,9 @@ void HeartBeat(Timer *timer) {
   std::string str =
       r->Me().ToString() + std::string(" heartbeat-timer timeout");
   tracer.PrepareEvent(kEventTimer, str);
-  int32_t rv = r->SendAppendEntries(timer->dest_addr(), &tracer);
+  // a probe without reply in a heartbeat may be lost, send it again
+  r->index_mgr_.RetryProbe(timer->dest_addr());
+  int32_t rv = r->SendHeartBeat(timer->dest_addr(), &tracer);
   assert(rv == 0);
 
   tracer.PrepareState1();
@@ -206,6 +208,7 @@ void Raft::StepDown(RaftTerm new_term, Tracer *tracer) {
   State old_state = state_;
 
   assert(meta_.term() <= new_term);
+  bool leader_changed = (meta_.term() < new_term || state_ == STATE_LEADER);
   if (meta_.term() < new_term) {  // larger term
     meta_.SetTerm(new_term);
     meta_.SetVote(0);
@@ -221,6 +224,10 @@ void Raft::StepDown(RaftTerm new_term, Tracer *tracer) {
   // close heartbeat timer
   timer_mgr_.StopHeartBeat();
 
+  // 还没写入日志的提案直接丢掉，和没提交的日志被覆盖一样
+  proposals_.clear();
+  timer_mgr_.StopPropose();
+
   // start election timer
   timer_mgr_.StopRequestVote();
   timer_mgr_.AgainElection();
@@ -229,6 +236,11 @@ void Raft::StepDown(RaftTerm new_term, Tracer *tracer) {
     last_heartbeat_timestamp_ = 0;
   }
 
+  // 等待 leader 确认的读请求失败，已经拿到读索引的继续等待应用
+  if (leader_changed) {
+    FailReads(read_mgr_.TakeWaitLeader());
+  }
+
   if (tracer != nullptr) {
     RaftTerm old_term = meta_.term();
     char buf[128];
@@ -277,6 +289,11 @@ void Raft::BecomeLeader(Tracer *tracer) {
   // reset leader state, index-manager
   index_mgr_.ResetNext(LastIndex() + 1);
   index_mgr_.ResetMatch(0);
+  index_mgr_.ResetFlow();
+
+  // reset leader state, read-manager
+  read_mgr_.ResetAck();
+  read_mgr_.ResumeLease();
 
   // start heartbeat timer
   timer_mgr_.StartHeartBeat();
@@ -302,6 +319,9 @@ void Raft::BecomeCandidate(Tracer *tracer) {
   // reset candidate state, vote-manager
   vote_mgr_.Clear();
 
+  // no leader now
+  FailReads(read_mgr_.TakeWaitLeader());
+
   if (tracer != nullptr) {
     char buf[128];
     snprintf(buf, sizeof(buf), "%s become-candidate term:%lu %s_to_%s",
@@ -337,7 +357,7 @@ AdvanceCommitIndex(i) ==
 ********************************************************************************************/
 void Raft::MaybeCommit(Tracer *tracer) {
   assert(state_ == STATE_LEADER);
-  uint64_t new_commit = index_mgr_.MajorityMax(LastIndex());
+  uint64_t new_commit = index_mgr_.MajorityMax(SyncedIndex());
   if (commit_ >= new_commit) {
     return;
   }
@@ -378,25 +398,27 @@ void Raft::StateMachineApply(Tracer *tracer) {
 
   // state machine apply
   if (commit_ > last_apply_) {
+    bool applied = false;
     for (RaftIndex i = last_apply_ + 1; i <= commit_; ++i) {
-      LogEntry log_entry;
-      int32_t rv = log_.Get(i, log_entry);
-      assert(rv == 0);
+      // 最近的日志直接用缓存里的，不复制
+      LogEntryPtr log_entry = log_.GetEntry(i);
+      assert(log_entry);
 
-      if (log_entry.append_entry.type == kData) {
+      if (log_entry->append_entry.type == kData) {
         if (sm_) {
-          rv = sm_->Apply(&log_entry, Me());
+          int32_t rv = sm_->Apply(log_entry.get(), Me());
           assert(rv == 0);
+          applied = true;
         }
         // propose call back with rv
 
-      } else if (log_entry.append_entry.type == kConfig) {
-        if (changing_index_ == log_entry.index) {
+      } else if (log_entry->append_entry.type == kConfig) {
+        if (changing_index_ == log_entry->index) {
           changing_index_ = 0;
 
           if (tracer) {
             RaftConfig rc;
-            rc.FromString(log_entry.append_entry.value);
+            rc.FromString(log_entry->append_entry.value);
 
             char buf[256];
             snprintf(buf, sizeof(buf), "%s config-change-finish index:%u %s",
@@ -410,13 +432,20 @@ void Raft::StateMachineApply(Tracer *tracer) {
 
         // cb
 
-      } else if (log_entry.append_entry.type == kNoop) {
+      } else if (log_entry->append_entry.type == kNoop) {
       } else {
         assert(0);
       }
     }
 
+    // 一轮应用的所有日志一起落盘
+    if (applied) {
+      int32_t rv = sm_->Flush();
+      assert(rv == 0);
+    }
+
     last_apply_ = commit_;
+    ApplyReads();
   }
 }
 
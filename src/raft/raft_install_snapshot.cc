@@ -180,6 +180,7 @@ int32_t Raft::OnInstallSnapshotReply(struct InstallSnapshotReply &msg) {
       if (msg.stored == reader->offset() - 1 && reader->done()) {
         index_mgr_.SetMatch(msg.src, reader->last_index());
         index_mgr_.SetNext(msg.src, index_mgr_.GetMatch(msg.src) + 1);
+        index_mgr_.Replicated(msg.src.ToU64());
 
         MaybeCommit(&tracer);
 
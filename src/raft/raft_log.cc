@@ -5,6 +5,7 @@
 #include "coding.h"
 #include "config_manager.h"
 #include "leveldb/write_batch.h"
+#include "log_storage.h"
 #include "tracer.h"
 
 namespace vraft {
@@ -134,22 +135,20 @@ void U32ComparatorImpl::FindShortSuccessor(std::string *key) const {
   if (key->size() == 0) return;
 }
 
-// index    : 1 2 3
-// term_key : 1 3 5
-// value_key: 2 4 6
 void RaftLog::Init() {
+  storage_ = CreateLogStorage(storage_type_, path_);
+  LogStorageState state;
+  int32_t rv = storage_->Open(state);
+  assert(rv == 0);
+  first_ = state.first;
+  last_ = state.last;
+  append_ = state.append;
+  last_checksum_ = state.checksum;
+
   db_options_.create_if_missing = true;
   db_options_.error_if_exists = false;
   db_options_.comparator = U32Comparator();
 
-  {
-    leveldb::DB *dbptr;
-    leveldb::Status status = leveldb::DB::Open(db_options_, path_, &dbptr);
-    std::string err_str = status.ToString();
-    assert(status.ok());
-    db_.reset(dbptr);
-  }
-
   {
     leveldb::DB *dbptr;
     leveldb::Status status =
@@ -159,69 +158,6 @@ void RaftLog::Init() {
     config_db_.reset(dbptr);
   }
 
-  leveldb::ReadOptions ro;
-  leveldb::Iterator *it = db_->NewIterator(ro);
-
-  // maybe init first
-  it->SeekToFirst();
-  if (!it->Valid()) {
-    leveldb::WriteBatch batch;
-    char zero_value[sizeof(RaftIndex) + sizeof(uint32_t)];
-    EncodeZeroValue(zero_value, 1, 0);
-    batch.Put(leveldb::Slice(kZeroKey, sizeof(kZeroKey)),
-              leveldb::Slice(zero_value, sizeof(zero_value)));
-    leveldb::WriteOptions wo;
-    wo.sync = true;
-    leveldb::Status s = db_->Write(wo, &batch);
-    assert(s.ok());
-
-    first_ = 0;
-    last_ = 0;
-    append_ = 1;
-  }
-  delete it;
-
-  // init
-  it = db_->NewIterator(ro);
-  it->SeekToLast();
-  assert(it->Valid());
-  assert(it->key().ToString().size() == sizeof(RaftIndex));
-  RaftIndex index = DecodeFixed32(it->key().ToString().c_str());
-
-  if (index == 0) {
-    // no value
-    first_ = 0;
-    last_ = 0;
-
-    // get zero value
-    assert(it->value().ToString().size() ==
-           sizeof(RaftIndex) + sizeof(uint32_t));
-
-    // append, checksum
-    DecodeZeroValue(it->value().ToString().c_str(), append_, last_checksum_);
-
-  } else {  // has value
-    // last, data index
-    RaftIndex data_index = DecodeFixed32(it->key().ToString().c_str());
-    last_ = DataIndexToLogIndex(data_index);
-
-    // first, meta index
-    it->SeekToFirst();
-    it->Next();
-    RaftIndex meta_index = DecodeFixed32(it->key().ToString().c_str());
-    first_ = MetaIndexToLogIndex(meta_index);
-
-    // append
-    append_ = last_ + 1;
-
-    // checksum
-    MetaValuePtr ptr = LastMeta();
-    assert(ptr);
-    last_checksum_ = ptr->chk_all;
-  }
-
-  delete it;
-
   // init configs
   {
     leveldb::ReadOptions ro;
@@ -282,18 +218,24 @@ bool RaftLog::IndexValid(RaftIndex index) {
   }
 }
 
-RaftLog::RaftLog(const std::string &path)
+RaftLog::RaftLog(const std::string &path, LogStorageType storage_type)
     : first_(0),
       last_(0),
       append_(0),
       checksum_(true),
       last_checksum_(0),
-      path_(path + "/log"),
-      config_path_(path + "/config") {
+      path_(path),
+      config_path_(path + "/config"),
+      storage_type_(storage_type),
+      persisting_(0),
+      cache_(kLogCacheEntries, kLogCacheBytes),
+      persist_seq_(0) {
   std::string cmd = "mkdir -p " + path;
   system(cmd.c_str());
 }
 
+RaftLog::~RaftLog() {}
+
 nlohmann::json RaftLog::ToJson() {
   nlohmann::json j;
   j["first"] = first_;
@@ -315,6 +257,13 @@ nlohmann::json RaftLog::ToJson() {
   } else {
     j["configs"] = "null";
   }
+  j["cache"] = cache_.ToJson();
+  j["persist_pending"] = PersistPending();
+  j["durable"] = Durable();
+  if (storage_) {
+    std::unique_lock<std::mutex> ulk(storage_mu_);
+    j["storage"] = storage_->ToJson();
+  }
 
   RaftConfig rc;
   MetaValue meta;
@@ -374,40 +323,102 @@ int32_t RaftLog::LastConfig(RaftConfig &rc, MetaValue &meta) {
 int32_t RaftLog::GetMeta(RaftIndex index, MetaValue &meta) {
   Check();
 
-  char meta_key[sizeof(RaftIndex)];
-  EncodeMetaKey(meta_key, sizeof(RaftIndex), index);
-  leveldb::ReadOptions ro;
-  leveldb::Status s;
-  std::string meta_value;
-  s = db_->Get(ro, leveldb::Slice(meta_key, sizeof(meta_key)), &meta_value);
-  if (s.ok()) {
-    assert(static_cast<int32_t>(meta_value.size()) == MetaValueBytes());
-    DecodeMetaValue(meta_value.c_str(), meta_value.size(), meta);
+  LogEntryPtr ptr = cache_.Get(index);
+  if (ptr) {
+    meta.term = ptr->append_entry.term;
+    meta.type = ptr->append_entry.type;
+    meta.pre_chk_all = ptr->pre_chk_all;
+    meta.chk_ths = ptr->chk_ths;
+    meta.chk_all = ptr->chk_all;
     return 0;
-
-  } else {
-    return -1;
   }
+  std::unique_lock<std::mutex> ulk(storage_mu_);
+  return storage_->GetMeta(index, meta);
 }
 
 int32_t RaftLog::GetValue(RaftIndex index, std::string *value) {
   Check();
 
-  char data_key[sizeof(RaftIndex)];
-  EncodeDataKey(data_key, sizeof(RaftIndex), index);
-  leveldb::ReadOptions ro;
-  leveldb::Status s;
-  s = db_->Get(ro, leveldb::Slice(data_key, sizeof(data_key)), value);
-  if (s.ok()) {
+  LogEntryPtr ptr = cache_.Get(index);
+  if (ptr) {
+    *value = ptr->append_entry.value;
     return 0;
-  } else {
-    return -1;
   }
+  std::unique_lock<std::mutex> ulk(storage_mu_);
+  return storage_->GetValue(index, value);
+}
+
+RaftLogIteratorUPtr RaftLog::NewIterator(RaftIndex from, RaftIndex to) {
+  Check();
+
+  if (from < first_) {
+    from = first_;
+  }
+  if (to > last_) {
+    to = last_;
+  }
+
+  // 空日志或者区间为空，返回无效的迭代器
+  if (first_ == 0 || from > to) {
+    return std::make_unique<RaftLogIterator>(nullptr, nullptr, nullptr, 1, 0);
+  }
+  return std::make_unique<RaftLogIterator>(storage_.get(), &storage_mu_,
+                                           &cache_, from, to);
+}
+
+RaftLogIterator::RaftLogIterator(LogStorage *storage, std::mutex *storage_mu,
+                                 const LogCache *cache, RaftIndex first,
+                                 RaftIndex last)
+    : storage_(storage), cache_(cache), last_(last), valid_(false) {
+  if (storage_mu != nullptr) {
+    storage_lock_ = std::unique_lock<std::mutex>(*storage_mu, std::defer_lock);
+  }
+  if (storage == nullptr || first > last) {
+    return;
+  }
+  Load(first);
+}
+
+RaftLogIterator::~RaftLogIterator() {}
+
+void RaftLogIterator::Next() {
+  assert(valid_);
+  Load(entry_->index + 1);
+}
+
+void RaftLogIterator::Load(RaftIndex index) {
+  valid_ = false;
+  if (index > last_) {
+    return;
+  }
+
+  // 缓存是日志的后缀，命中后后面的也都在缓存里
+  entry_ = cache_ ? cache_->Get(index) : nullptr;
+  if (entry_) {
+    valid_ = true;
+    return;
+  }
+
+  // 没有落盘的日志一定在缓存里，读存储时等正在进行的 Persist
+  if (!reader_) {
+    if (storage_lock_.mutex() != nullptr) {
+      storage_lock_.lock();
+    }
+    reader_ = storage_->NewReader(index);
+  }
+  entry_ = std::make_shared<LogEntry>();
+  valid_ = (reader_->Read(index, *entry_) == 0);
 }
 
 int32_t RaftLog::Get(RaftIndex index, LogEntry &entry) {
   Check();
 
+  LogEntryPtr ptr = cache_.Get(index);
+  if (ptr) {
+    entry = *ptr;
+    return 0;
+  }
+
   MetaValue meta;
   int32_t rv = GetMeta(index, meta);
   if (rv == 0) {
@@ -426,6 +437,20 @@ int32_t RaftLog::Get(RaftIndex index, LogEntry &entry) {
   }
 }
 
+LogEntryPtr RaftLog::GetEntry(RaftIndex index) {
+  LogEntryPtr ptr = cache_.Get(index);
+  if (ptr) {
+    return ptr;
+  }
+
+  ptr = std::make_shared<LogEntry>();
+  int32_t rv = Get(index, *(ptr.get()));
+  if (rv != 0) {
+    return nullptr;
+  }
+  return ptr;
+}
+
 LogEntryPtr RaftLog::LastEntry() {
   Check();
   if (last_ == 0) {
@@ -489,110 +514,154 @@ int32_t RaftLog::AppendFirstConfig(RaftConfig &rc, RaftTerm term,
 }
 
 int32_t RaftLog::AppendOne(AppendEntry &entry, Tracer *tracer) {
-  Check();
-  RaftIndex tmp_first, tmp_last, tmp_append;
-  uint32_t tmp_checksum = 0;
+  std::vector<AppendEntry> entries(1, entry);
+  return AppendSome(entries, tracer);
+}
 
-  if (first_ == last_ && first_ == 0) {
-    // no value
-    tmp_first = append_;
-    tmp_last = append_;
-    tmp_append = append_ + 1;
+int32_t RaftLog::AppendSome(std::vector<AppendEntry> &entries,
+                            Tracer *tracer) {
+  return DoAppend(entries, false, nullptr, nullptr, tracer);
+}
 
-  } else {
-    // has value
-    // do not need to persist append index every time
+int32_t RaftLog::AppendAsync(std::vector<AppendEntry> &entries,
+                             std::vector<LogEntryPtr> &to_persist,
+                             uint64_t &seq, Tracer *tracer) {
+  return DoAppend(entries, true, &to_persist, &seq, tracer);
+}
 
-    tmp_first = first_;
-    tmp_last = last_ + 1;
-    tmp_append = tmp_last + 1;
+int32_t RaftLog::DoAppend(std::vector<AppendEntry> &entries, bool async,
+                          std::vector<LogEntryPtr> *to_persist, uint64_t *seq,
+                          Tracer *tracer) {
+  Check();
+  if (entries.empty()) {
+    return 0;
   }
 
-  leveldb::WriteBatch batch;
-  RaftIndex log_index = tmp_last;
-
-  char meta_key[sizeof(RaftIndex)];
-  EncodeMetaKey(meta_key, sizeof(RaftIndex), log_index);
-
-  char meta_value[sizeof(MetaValue)];
-  if (checksum_) {
-    LogEntry log_entry;
-    log_entry.index = append_;
-    log_entry.append_entry = entry;
-
-    log_entry.pre_chk_all = last_checksum_;
-    log_entry.CheckSum();
-
-    // save tmp_checksum
-    tmp_checksum = log_entry.chk_all;
+  // 有没有值，新日志都从 append_ 开始
+  RaftIndex start = append_;
+  RaftIndex tmp_first = (first_ == last_ && first_ == 0) ? append_ : first_;
+  RaftIndex tmp_last = start + static_cast<RaftIndex>(entries.size()) - 1;
+  RaftIndex tmp_append = tmp_last + 1;
+  uint32_t tmp_checksum = 0;
+  uint32_t pre_checksum = last_checksum_;
+
+  // 配置日志再单独写一份到 config db
+  leveldb::WriteBatch config_batch;
+  std::vector<RaftIndex> config_indices;
+
+  // 日志值移进缓存条目，写盘和缓存用同一份
+  std::vector<LogEntryPtr> log_entries;
+  log_entries.reserve(entries.size());
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    RaftIndex log_index = start + static_cast<RaftIndex>(i);
+    LogEntryPtr log_entry = std::make_shared<LogEntry>();
+    log_entry->index = log_index;
+    log_entry->append_entry = std::move(entries[i]);
+    log_entries.push_back(log_entry);
+
+    if (checksum_) {
+      // 校验和逐条串起来
+      log_entry->pre_chk_all = pre_checksum;
+      log_entry->CheckSum();
+      pre_checksum = log_entry->chk_all;
+      tmp_checksum = log_entry->chk_all;
 
-    MetaValue mv;
-    mv.term = entry.term;
-    mv.type = entry.type;
-    mv.pre_chk_all = log_entry.pre_chk_all;
-    mv.chk_ths = log_entry.chk_ths;
-    mv.chk_all = log_entry.chk_all;
-    EncodeMetaValue(meta_value, sizeof(MetaValue), mv);
+    } else {
+      log_entry->pre_chk_all = 0;
+      log_entry->chk_ths = 0;
+      log_entry->chk_all = 0;
+    }
 
-  } else {
-    MetaValue mv;
-    mv.term = entry.term;
-    mv.type = entry.type;
-    mv.pre_chk_all = 0;
-    mv.chk_ths = 0;
-    mv.chk_all = 0;
-    EncodeMetaValue(meta_value, sizeof(MetaValue), mv);
+    AppendEntry &entry = log_entry->append_entry;
+    if (entry.type == kConfig) {
+      char meta_key[sizeof(RaftIndex)];
+      EncodeMetaKey(meta_key, sizeof(RaftIndex), log_index);
+
+      MetaValue mv;
+      mv.term = entry.term;
+      mv.type = entry.type;
+      mv.pre_chk_all = log_entry->pre_chk_all;
+      mv.chk_ths = log_entry->chk_ths;
+      mv.chk_all = log_entry->chk_all;
+      char meta_value[sizeof(MetaValue)];
+      EncodeMetaValue(meta_value, sizeof(MetaValue), mv);
+
+      char data_key[sizeof(RaftIndex)];
+      EncodeDataKey(data_key, sizeof(RaftIndex), log_index);
+
+      config_batch.Put(leveldb::Slice(meta_key, sizeof(meta_key)),
+                       leveldb::Slice(meta_value, sizeof(meta_value)));
+      config_batch.Put(leveldb::Slice(data_key, sizeof(data_key)),
+                       leveldb::Slice(entry.value.c_str(), entry.value.size()));
+      config_indices.push_back(log_index);
+    }
   }
 
-  batch.Put(leveldb::Slice(meta_key, sizeof(meta_key)),
-            leveldb::Slice(meta_value, sizeof(meta_value)));
-
-  char data_key[sizeof(RaftIndex)];
-  EncodeDataKey(data_key, sizeof(RaftIndex), log_index);
-  batch.Put(leveldb::Slice(data_key, sizeof(data_key)),
-            leveldb::Slice(entry.value.c_str(), entry.value.size()));
-
+  // 所有日志一次写一次 fsync，配置日志和 config db 一起落盘。
+  // 异步时只放进缓存，由日志 I/O 线程写盘，写完之前复制从缓存读
   leveldb::WriteOptions wo;
   wo.sync = true;
-  leveldb::Status s = db_->Write(wo, &batch);
-  assert(s.ok());
+  async = async && config_indices.empty();
+  if (async) {
+    {
+      std::unique_lock<std::mutex> ulk(storage_mu_);
+      ++persisting_;
+    }
+    *seq = ++persist_seq_;
+    *to_persist = log_entries;
+    persist_batches_.push_back({*seq, start, tmp_last});
+
+  } else {
+    std::unique_lock<std::mutex> ulk = WaitPersisted();
+    int32_t rv = storage_->Append(log_entries, true);
+    assert(rv == 0);
+  }
 
   // write to config db
-  if (entry.type == kConfig) {
-    leveldb::WriteOptions wo;
-    wo.sync = true;
-    leveldb::Status s = config_db_->Write(wo, &batch);
+  if (!config_indices.empty()) {
+    leveldb::Status s = config_db_->Write(wo, &config_batch);
     assert(s.ok());
 
-    config_indices_.insert(log_index);
+    for (auto log_index : config_indices) {
+      config_indices_.insert(log_index);
 
-    // update config mgr
-    RaftConfig rc;
-    rc.FromString(entry.value);
-    if (insert_cb_) {
-      insert_cb_(rc, append_);
-    }
+      // update config mgr
+      AppendEntry &entry = log_entries[log_index - start]->append_entry;
+      RaftConfig rc;
+      rc.FromString(entry.value);
+      if (insert_cb_) {
+        insert_cb_(rc, log_index);
+      }
 
-    if (tracer) {
-      char buf[128];
-      snprintf(buf, sizeof(buf), "%s config-change-begin index:%u %s",
-               me.ToString().c_str(), append_,
-               rc.ToJsonString(true, true).c_str());
-      tracer->PrepareEvent(kEventOther, std::string(buf));
+      if (tracer) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%s config-change-begin index:%u %s",
+                 me.ToString().c_str(), log_index,
+                 rc.ToJsonString(true, true).c_str());
+        tracer->PrepareEvent(kEventOther, std::string(buf));
+      }
     }
   }
 
   if (tracer) {
     char buf[128];
     snprintf(buf, sizeof(buf),
-             "append one log, term:%lu, index:%u, type:%s, value-len:%lu",
-             entry.term, append_, EntryTypeToStr(entry.type),
-             entry.value.size());
+             "append some logs, count:%lu, index:%u-%u, last-term:%lu, "
+             "async:%d",
+             log_entries.size(), start, tmp_last,
+             log_entries.back()->append_entry.term, async);
     tracer->PrepareEvent(kEventOther, std::string(buf));
   }
 
+  if (!persist_batches_.empty()) {
+    cache_.Pin(persist_batches_.front().first);
+  }
+  for (auto &log_entry : log_entries) {
+    cache_.Put(log_entry);
+  }
+
   // update index after persist value
-  // do not need to persist append index every time
   first_ = tmp_first;
   last_ = tmp_last;
   append_ = tmp_append;
@@ -604,7 +673,41 @@ int32_t RaftLog::AppendOne(AppendEntry &entry, Tracer *tracer) {
   return 0;
 }
 
-int32_t RaftLog::AppendSome(std::vector<AppendEntry> &entries) { return 0; }
+int32_t RaftLog::Persist(const std::vector<LogEntryPtr> &entries) {
+  std::unique_lock<std::mutex> ulk(storage_mu_);
+  int32_t rv = storage_->Append(entries, true);
+  --persisting_;
+  persist_cv_.notify_all();
+  return rv;
+}
+
+bool RaftLog::OnPersisted(uint64_t seq) {
+  // 等过所有 Persist 之后批次已经清空，迟到的完成通知直接忽略
+  if (persist_batches_.empty() || persist_batches_.front().seq > seq) {
+    return false;
+  }
+  // 日志 I/O 线程按顺序写，之前的批次也都已经落盘
+  while (!persist_batches_.empty() && persist_batches_.front().seq <= seq) {
+    persist_batches_.pop_front();
+  }
+  cache_.Pin(persist_batches_.empty() ? 0 : persist_batches_.front().first);
+  return true;
+}
+
+RaftIndex RaftLog::Durable() const {
+  if (persist_batches_.empty()) {
+    return last_;
+  }
+  return persist_batches_.front().first - 1;
+}
+
+std::unique_lock<std::mutex> RaftLog::WaitPersisted() {
+  std::unique_lock<std::mutex> ulk(storage_mu_);
+  persist_cv_.wait(ulk, [this]() { return persisting_ == 0; });
+  persist_batches_.clear();
+  cache_.Pin(0);
+  return ulk;
+}
 
 int32_t RaftLog::DeleteFrom(RaftIndex from_index, Tracer *tracer) {
   Check();
@@ -654,39 +757,32 @@ int32_t RaftLog::DeleteFrom(RaftIndex from_index, Tracer *tracer) {
   assert(rv == 0);
   tmp_checksum = meta.pre_chk_all;
 
-  leveldb::WriteBatch batch;
   leveldb::WriteBatch delete_config_batch;
   std::vector<RaftIndex> delete_config_indices;
   for (RaftIndex i = from_index; i <= last_; ++i) {
-    char meta_key[sizeof(RaftIndex)];
-    EncodeMetaKey(meta_key, sizeof(RaftIndex), i);
-    batch.Delete(leveldb::Slice(meta_key, sizeof(meta_key)));
-
-    char data_key[sizeof(RaftIndex)];
-    EncodeDataKey(data_key, sizeof(RaftIndex), i);
-    batch.Delete(leveldb::Slice(data_key, sizeof(data_key)));
-
     // delete config db
     auto config_it = config_indices_.find(i);
     if (config_it != config_indices_.end()) {
+      char meta_key[sizeof(RaftIndex)];
+      EncodeMetaKey(meta_key, sizeof(RaftIndex), i);
       delete_config_batch.Delete(leveldb::Slice(meta_key, sizeof(meta_key)));
+
+      char data_key[sizeof(RaftIndex)];
+      EncodeDataKey(data_key, sizeof(RaftIndex), i);
       delete_config_batch.Delete(leveldb::Slice(data_key, sizeof(data_key)));
 
       delete_config_indices.push_back(i);
     }
   }
 
-  // need to persist append index
-  if (from_index == first_) {
-    char zero_value[sizeof(RaftIndex) + sizeof(uint32_t)];
-    EncodeZeroValue(zero_value, tmp_append, tmp_checksum);
-    batch.Put(leveldb::Slice(kZeroKey, sizeof(kZeroKey)),
-              leveldb::Slice(zero_value, sizeof(zero_value)));
+  // 日志变空时由存储层记住 append 和 checksum。
+  // 先等正在写的批次，截断不能和它们乱序
+  {
+    std::unique_lock<std::mutex> ulk = WaitPersisted();
+    rv = storage_->DeleteFrom(from_index, tmp_append, tmp_checksum);
+    assert(rv == 0);
   }
 
-  leveldb::Status s = db_->Write(leveldb::WriteOptions(), &batch);
-  assert(s.ok());
-
   // delete config db
   {
     leveldb::Status s =
@@ -708,6 +804,8 @@ int32_t RaftLog::DeleteFrom(RaftIndex from_index, Tracer *tracer) {
     }
   }
 
+  cache_.DeleteFrom(from_index);
+
   // update index
   first_ = tmp_first;
   last_ = tmp_last;
@@ -771,27 +869,14 @@ int32_t RaftLog::DeleteUtil(RaftIndex to_index) {
     tmp_checksum = meta.chk_all;
   }
 
-  leveldb::WriteBatch batch;
-  for (RaftIndex i = first_; i <= to_index; ++i) {
-    char meta_key[sizeof(RaftIndex)];
-    EncodeMetaKey(meta_key, sizeof(RaftIndex), i);
-    batch.Delete(leveldb::Slice(meta_key, sizeof(meta_key)));
-
-    char data_key[sizeof(RaftIndex)];
-    EncodeDataKey(data_key, sizeof(RaftIndex), i);
-    batch.Delete(leveldb::Slice(data_key, sizeof(data_key)));
-  }
-
-  // need to persist append index
-  if (to_index == last_) {
-    char zero_value[sizeof(RaftIndex) + sizeof(uint32_t)];
-    EncodeZeroValue(zero_value, tmp_append, tmp_checksum);
-    batch.Put(leveldb::Slice(kZeroKey, sizeof(kZeroKey)),
-              leveldb::Slice(zero_value, sizeof(zero_value)));
+  // 日志变空时由存储层记住 append 和 checksum
+  {
+    std::unique_lock<std::mutex> ulk = WaitPersisted();
+    int32_t rv = storage_->DeleteUtil(to_index, tmp_append, tmp_checksum);
+    assert(rv == 0);
   }
 
-  leveldb::Status s = db_->Write(leveldb::WriteOptions(), &batch);
-  assert(s.ok());
+  cache_.DeleteUtil(to_index);
 
   // update index
   first_ = tmp_first;
@@ -803,4 +888,103 @@ int32_t RaftLog::DeleteUtil(RaftIndex to_index) {
   return 0;
 }
 
+LogCache::LogCache(int32_t max_entries, int64_t max_bytes)
+    : ring_(max_entries),
+      first_(1),
+      last_(0),
+      pinned_(0),
+      bytes_(0),
+      max_bytes_(max_bytes) {
+  assert(max_entries > 0);
+}
+
+LogCache::~LogCache() {}
+
+int64_t LogCache::Bytes(const LogEntryPtr &entry) const {
+  return sizeof(LogEntry) + entry->append_entry.value.size();
+}
+
+void LogCache::Put(LogEntryPtr entry) {
+  if (!Empty() && entry->index != last_ + 1) {
+    Clear();
+  }
+  if (Empty()) {
+    first_ = entry->index;
+    last_ = entry->index - 1;
+  }
+
+  // 满了从最旧的开始淘汰，没落盘的不能淘汰，环不够时扩大
+  int64_t bytes = Bytes(entry);
+  while (!Empty() && (pinned_ == 0 || first_ < pinned_) &&
+         (last_ - first_ + 1 >= ring_.size() || bytes_ + bytes > max_bytes_)) {
+    PopFront();
+  }
+  if (!Empty() && last_ - first_ + 1 >= ring_.size()) {
+    Grow();
+  }
+
+  last_ = entry->index;
+  ring_[Slot(last_)] = std::move(entry);
+  bytes_ += bytes;
+}
+
+LogEntryPtr LogCache::Get(RaftIndex index) const {
+  if (Empty() || index < first_ || index > last_) {
+    return nullptr;
+  }
+  return ring_[Slot(index)];
+}
+
+void LogCache::DeleteFrom(RaftIndex from_index) {
+  while (!Empty() && last_ >= from_index) {
+    PopBack();
+  }
+}
+
+void LogCache::DeleteUtil(RaftIndex to_index) {
+  while (!Empty() && first_ <= to_index) {
+    PopFront();
+  }
+}
+
+void LogCache::Clear() {
+  while (!Empty()) {
+    PopBack();
+  }
+  first_ = 1;
+  last_ = 0;
+}
+
+void LogCache::Grow() {
+  std::vector<LogEntryPtr> ring(ring_.size() * 2);
+  for (RaftIndex i = first_; i <= last_; ++i) {
+    ring[i % ring.size()] = std::move(ring_[Slot(i)]);
+  }
+  ring_.swap(ring);
+}
+
+void LogCache::PopFront() {
+  LogEntryPtr &ptr = ring_[Slot(first_)];
+  bytes_ -= Bytes(ptr);
+  ptr.reset();
+  ++first_;
+}
+
+void LogCache::PopBack() {
+  LogEntryPtr &ptr = ring_[Slot(last_)];
+  bytes_ -= Bytes(ptr);
+  ptr.reset();
+  --last_;
+}
+
+nlohmann::json LogCache::ToJson() {
+  nlohmann::json j;
+  j["first"] = first_;
+  j["last"] = last_;
+  j["count"] = Empty() ? 0 : last_ - first_ + 1;
+  j["bytes"] = bytes_;
+  return j;
+}
+
 }  // namespace vraft
+
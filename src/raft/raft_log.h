@@ -4,14 +4,19 @@
 #include <stdint.h>
 
 #include <cassert>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "allocator.h"
 #include "coding.h"
 #include "common.h"
+#include "crc32c.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "nlohmann/json.hpp"
@@ -127,53 +132,43 @@ inline void LogEntry::CheckSum() {
   CheckAll();
 }
 
-// checksum [index + term + type + value]
+// checksum [index + term + type + index + value], the fixed fields are
+// encoded on the stack and the value is checksummed in place
 inline void LogEntry::CheckThis() {
-  int32_t max_bytes = sizeof(RaftIndex) + sizeof(append_entry.term) +
-                      sizeof(uint32_t) + 2 * sizeof(int32_t) +
-                      append_entry.value.size();
-  char *ptr = reinterpret_cast<char *>(DefaultAllocator().Malloc(max_bytes));
-  char *p = ptr;
-  int32_t size = 0;
+  char buf[sizeof(RaftIndex) * 2 + sizeof(append_entry.term) +
+           sizeof(uint32_t) + 5];
+  char *p = buf;
 
   EncodeFixed32(p, index);
   p += sizeof(index);
-  size += sizeof(index);
 
   EncodeFixed64(p, append_entry.term);
   p += sizeof(append_entry.term);
-  size += sizeof(append_entry.term);
 
   EncodeFixed32(p, append_entry.type);
   p += sizeof(append_entry.type);
-  size += sizeof(append_entry.type);
 
   EncodeFixed32(p, index);
   p += sizeof(index);
-  size += sizeof(index);
 
-  Slice sls(append_entry.value.c_str(), append_entry.value.size());
-  char *p2 = EncodeString2(p, max_bytes - size, sls);
-  size += (p2 - p);
+  p = EncodeVarint32(p, append_entry.value.size());
 
-  chk_ths = Crc32(ptr, size);
-  DefaultAllocator().Free(ptr);
+  uint32_t crc = Crc32c(buf, p - buf);
+  chk_ths = Crc32cExtend(crc, append_entry.value.c_str(),
+                         append_entry.value.size());
 }
 
 inline void LogEntry::CheckAll() {
   char buf[sizeof(uint32_t) * 2];
   char *p = buf;
-  int32_t size = 0;
 
   EncodeFixed32(p, pre_chk_all);
   p += sizeof(pre_chk_all);
-  size += sizeof(pre_chk_all);
 
   EncodeFixed32(p, chk_ths);
   p += sizeof(chk_ths);
-  size += sizeof(chk_ths);
 
-  chk_all = Crc32(buf, sizeof(uint32_t) * 2);
+  chk_all = Crc32c(buf, sizeof(buf));
 }
 
 inline int32_t LogEntry::MaxBytes() {
@@ -365,10 +360,100 @@ class U32ComparatorImpl : public leveldb::Comparator {
 class Tracer;
 class RaftLog;
 using RaftLogUPtr = std::unique_ptr<RaftLog>;
+class LogStorage;
+class LogReader;
+
+enum LogStorageType {
+  kLogStorageLevelDB = 0,  // meta and data key spaces in leveldb
+  kLogStorageSegment,      // append-only segment files
+};
+
+// bounds of the recent-entry cache, whichever is reached first
+const int32_t kLogCacheEntries = 4096;
+const int64_t kLogCacheBytes = 64 * 1024 * 1024;
+
+// Recent log entries in a ring, slot = index % max_entries. The cached
+// entries are always a suffix of the log, [first, last]. The entries are
+// shared with readers and must not be modified. Entries from the pinned
+// index on are not in the storage yet, they are never evicted and the
+// ring grows for them if needed.
+class LogCache final {
+ public:
+  LogCache(int32_t max_entries, int64_t max_bytes);
+  ~LogCache();
+  LogCache(const LogCache &t) = delete;
+  LogCache &operator=(const LogCache &t) = delete;
+
+  // entry->index must follow last, otherwise the cache restarts from it
+  void Put(LogEntryPtr entry);
+  LogEntryPtr Get(RaftIndex index) const;
+
+  void DeleteFrom(RaftIndex from_index);  // drop [from_index, last]
+  void DeleteUtil(RaftIndex to_index);    // drop [first, to_index]
+  void Clear();
+
+  // 0: nothing pinned
+  void Pin(RaftIndex index) { pinned_ = index; }
+
+  bool Empty() const { return first_ > last_; }
+  RaftIndex first() const { return first_; }
+  RaftIndex last() const { return last_; }
+  int64_t bytes() const { return bytes_; }
+
+  nlohmann::json ToJson();
+
+ private:
+  int32_t Slot(RaftIndex index) const { return index % ring_.size(); }
+  int64_t Bytes(const LogEntryPtr &entry) const;
+  void PopFront();
+  void PopBack();
+  void Grow();
+
+ private:
+  std::vector<LogEntryPtr> ring_;
+  RaftIndex first_;  // empty if first_ > last_
+  RaftIndex last_;
+  RaftIndex pinned_;
+  int64_t bytes_;
+  int64_t max_bytes_;
+};
+
+class RaftLogIterator;
+using RaftLogIteratorUPtr = std::unique_ptr<RaftLogIterator>;
+
+// Reads log entries [first, last] in order, shared with the cache if there,
+// otherwise with one storage reader. The entries must not be modified. The
+// log must not change while iterating. The storage is locked from the first
+// cache miss on.
+class RaftLogIterator final {
+ public:
+  RaftLogIterator(LogStorage *storage, std::mutex *storage_mu,
+                  const LogCache *cache, RaftIndex first, RaftIndex last);
+  ~RaftLogIterator();
+  RaftLogIterator(const RaftLogIterator &t) = delete;
+  RaftLogIterator &operator=(const RaftLogIterator &t) = delete;
+
+  bool Valid() const { return valid_; }
+  void Next();
+  const LogEntryPtr &entry() const { return entry_; }
+
+ private:
+  void Load(RaftIndex index);
+
+ private:
+  LogStorage *storage_;
+  std::unique_lock<std::mutex> storage_lock_;
+  const LogCache *cache_;
+  std::unique_ptr<LogReader> reader_;  // created at the first cache miss
+  RaftIndex last_;
+  bool valid_;
+  LogEntryPtr entry_;
+};
 
 class RaftLog final {
  public:
-  RaftLog(const std::string &path);
+  RaftLog(const std::string &path,
+          LogStorageType storage_type = kLogStorageLevelDB);
   ~RaftLog();
   RaftLog(const RaftLog &t) = delete;
   RaftLog &operator=(const RaftLog &t) = delete;
@@ -378,12 +463,41 @@ class RaftLog final {
 
   int32_t AppendFirstConfig(RaftConfig &rc, RaftTerm term, Tracer *tracer);
   int32_t AppendOne(AppendEntry &entry, Tracer *tracer);
-  int32_t AppendSome(std::vector<AppendEntry> &entries);
+
+  // one synced write for all entries, waits for the batches in Persist.
+  // entry values are moved into the cache
+  int32_t AppendSome(std::vector<AppendEntry> &entries, Tracer *tracer);
+
+  // like AppendSome, but the entries only go to the cache and to_persist,
+  // pass them to Persist in the log I/O thread and seq to OnPersisted when
+  // it returns. A batch with a config entry is written at once, to_persist
+  // is empty then.
+  int32_t AppendAsync(std::vector<AppendEntry> &entries,
+                      std::vector<LogEntryPtr> &to_persist, uint64_t &seq,
+                      Tracer *tracer);
+
+  // thread safe, the synced write of a batch of AppendAsync
+  int32_t Persist(const std::vector<LogEntryPtr> &entries);
+
+  // in the raft loop thread after Persist of seq returned, false if the
+  // batch was already waited for (stale)
+  bool OnPersisted(uint64_t seq);
+
+  // entries up to it are on disk
+  RaftIndex Durable() const;
+  int32_t PersistPending() const { return persist_batches_.size(); }
+
   int32_t DeleteFrom(RaftIndex from_index, Tracer *tracer);
   int32_t DeleteUtil(RaftIndex to_index);
   int32_t Get(RaftIndex index, LogEntry &entry);
+
+  // shared with the cache if there, do not modify; nullptr if not found
+  LogEntryPtr GetEntry(RaftIndex index);
   int32_t GetMeta(RaftIndex index, MetaValue &meta);
   int32_t GetValue(RaftIndex index, std::string *value);
+
+  // iterate entries [from, to], cut to the log
+  RaftLogIteratorUPtr NewIterator(RaftIndex from, RaftIndex to);
   LogEntryPtr LastEntry();
   MetaValuePtr LastMeta();
 
@@ -400,6 +514,19 @@ class RaftLog final {
   nlohmann::json ToJsonTiny();
   std::string ToJsonString(bool tiny, bool one_line);
 
+ private:
+  int32_t DoAppend(std::vector<AppendEntry> &entries, bool async,
+                   std::vector<LogEntryPtr> *to_persist, uint64_t *seq,
+                   Tracer *tracer);
+
+  // wait until every Persist returned, then the whole log is on disk,
+  // return the storage lock
+  std::unique_lock<std::mutex> WaitPersisted();
+
+ public:
+  // before Init
+  void set_storage_type(LogStorageType type) { storage_type_ = type; }
+
   void set_insert_cb(AppendConfigFunc cb) { insert_cb_ = cb; }
   void set_delete_cb(DeleteConfigFunc cb) { delete_cb_ = cb; }
 
@@ -416,17 +543,31 @@ class RaftLog final {
 
   std::string path_;
   std::string config_path_;
-
+  LogStorageType storage_type_;
+
+  // entries in storage_, config entries also in config_db_.
+  // storage_mu_ guards storage_ against Persist in the log I/O thread
+  std::unique_ptr<LogStorage> storage_;
+  std::mutex storage_mu_;
+  std::condition_variable persist_cv_;
+  int32_t persisting_;  // Persist not returned yet, under storage_mu_
   leveldb::Options db_options_;
-  std::shared_ptr<leveldb::DB> db_;
   std::shared_ptr<leveldb::DB> config_db_;
+  LogCache cache_;
+
+  // batches of AppendAsync not reported to OnPersisted, in index order
+  struct PersistBatch {
+    uint64_t seq;
+    RaftIndex first;
+    RaftIndex last;
+  };
+  std::deque<PersistBatch> persist_batches_;
+  uint64_t persist_seq_;
 
   AppendConfigFunc insert_cb_;
   DeleteConfigFunc delete_cb_;
 };
 
-inline RaftLog::~RaftLog() {}
-
 inline nlohmann::json RaftLog::ToJsonTiny() {
   nlohmann::json j;
   j[0] = first_;
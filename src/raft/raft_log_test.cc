@@ -0,0 +1,468 @@
+#include "raft_log.h"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "log_storage.h"
+
+const std::string kTestDir = "/tmp/raft_log_test";
+
+static vraft::RaftConfig TestConfig(uint16_t peers) {
+  vraft::RaftConfig rc;
+  rc.me = vraft::RaftAddr(0x7F000001, 9000, 0);
+  for (uint16_t i = 1; i <= peers; ++i) {
+    rc.peers.push_back(vraft::RaftAddr(0x7F000001, 9000 + i, i));
+  }
+  return rc;
+}
+
+static vraft::AppendEntry DataEntry(vraft::RaftTerm term,
+                                    const std::string &value) {
+  vraft::AppendEntry entry;
+  entry.term = term;
+  entry.type = vraft::kData;
+  entry.value = value;
+  return entry;
+}
+
+static vraft::AppendEntry ConfigEntry(vraft::RaftTerm term, uint16_t peers) {
+  vraft::AppendEntry entry;
+  entry.term = term;
+  entry.type = vraft::kConfig;
+  TestConfig(peers).ToString(entry.value);
+  return entry;
+}
+
+// 校验和从 pre_chk_all 串起来，每条都能按内容重算出来
+static void CheckChain(vraft::RaftLog &log, vraft::RaftIndex first,
+                       vraft::RaftIndex last, uint32_t pre_chk_all) {
+  for (vraft::RaftIndex i = first; i <= last; ++i) {
+    vraft::LogEntry entry;
+    ASSERT_EQ(0, log.Get(i, entry));
+    EXPECT_EQ(i, entry.index);
+    EXPECT_EQ(pre_chk_all, entry.pre_chk_all);
+
+    vraft::LogEntry copy = entry;
+    copy.CheckSum();
+    EXPECT_EQ(copy.chk_ths, entry.chk_ths);
+    EXPECT_EQ(copy.chk_all, entry.chk_all);
+    pre_chk_all = entry.chk_all;
+  }
+  EXPECT_EQ(pre_chk_all, log.LastCheck());
+}
+
+// 一批日志一次写盘，配置日志另写一份，每条配置回调一次
+TEST(RaftLogTest, AppendSome) {
+  fs::remove_all(kTestDir);
+  std::vector<vraft::RaftIndex> inserted;
+  {
+    vraft::RaftLog log(kTestDir);
+    log.Init();
+    log.set_insert_cb([&inserted](const vraft::RaftConfig &rc,
+                                  vraft::RaftIndex i) {
+      EXPECT_EQ(i == 3 ? 2u : 3u, rc.peers.size());
+      inserted.push_back(i);
+    });
+
+    std::vector<vraft::AppendEntry> entries;
+    entries.push_back(DataEntry(1, "a"));
+    entries.push_back(DataEntry(1, "bb"));
+    entries.push_back(ConfigEntry(1, 2));
+    entries.push_back(DataEntry(2, "ccc"));
+    entries.push_back(ConfigEntry(2, 3));
+    ASSERT_EQ(0, log.AppendSome(entries, nullptr));
+
+    EXPECT_EQ(1u, log.First());
+    EXPECT_EQ(5u, log.Last());
+    EXPECT_EQ(6u, log.Append());
+    EXPECT_EQ(0, log.PersistPending());
+    EXPECT_EQ(5u, log.Durable());
+    EXPECT_EQ(std::vector<vraft::RaftIndex>({3, 5}), inserted);
+    CheckChain(log, 1, 5, 0);
+
+    vraft::RaftConfig rc;
+    vraft::MetaValue meta;
+    EXPECT_EQ(1, log.LastConfig(rc, meta));
+    EXPECT_EQ(3u, rc.peers.size());
+    EXPECT_EQ(2u, meta.term);
+    EXPECT_EQ(vraft::kConfig, meta.type);
+
+    // 下一批接着上一批的校验和
+    uint32_t pre_chk_all = log.LastCheck();
+    std::vector<vraft::AppendEntry> more(1, DataEntry(2, "dddd"));
+    ASSERT_EQ(0, log.AppendSome(more, nullptr));
+    CheckChain(log, 6, 6, pre_chk_all);
+    EXPECT_EQ(2u, inserted.size());
+  }
+
+  // 重启后日志、校验和和配置都还在，打开时不回调
+  vraft::RaftLog log(kTestDir);
+  log.set_insert_cb([&inserted](const vraft::RaftConfig &rc,
+                                vraft::RaftIndex i) { inserted.push_back(i); });
+  log.Init();
+  EXPECT_EQ(1u, log.First());
+  EXPECT_EQ(6u, log.Last());
+  CheckChain(log, 1, 6, 0);
+  EXPECT_EQ(2u, inserted.size());
+
+  vraft::RaftConfig rc;
+  vraft::MetaValue meta;
+  EXPECT_EQ(1, log.LastConfig(rc, meta));
+  EXPECT_EQ(3u, rc.peers.size());
+  EXPECT_EQ(std::vector<vraft::RaftIndex>({3, 5}),
+            log.ToJson()["configs"].get<std::vector<vraft::RaftIndex>>());
+
+  vraft::LogEntry entry;
+  ASSERT_EQ(0, log.Get(4, entry));
+  EXPECT_EQ("ccc", entry.append_entry.value);
+  EXPECT_EQ(2u, entry.append_entry.term);
+}
+
+// 带配置的异步批次直接写盘，不交给日志 I/O 线程
+TEST(RaftLogTest, AsyncConfig) {
+  fs::remove_all(kTestDir);
+  vraft::RaftLog log(kTestDir);
+  log.Init();
+  int32_t calls = 0;
+  log.set_insert_cb(
+      [&calls](const vraft::RaftConfig &rc, vraft::RaftIndex i) { ++calls; });
+
+  std::vector<vraft::AppendEntry> entries;
+  entries.push_back(DataEntry(1, "a"));
+  entries.push_back(ConfigEntry(1, 2));
+  std::vector<vraft::LogEntryPtr> to_persist;
+  uint64_t seq = 0;
+  ASSERT_EQ(0, log.AppendAsync(entries, to_persist, seq, nullptr));
+  EXPECT_TRUE(to_persist.empty());
+  EXPECT_EQ(0, log.PersistPending());
+  EXPECT_EQ(2u, log.Durable());
+  EXPECT_EQ(1, calls);
+  CheckChain(log, 1, 2, 0);
+}
+
+static uint64_t AppendAsync(vraft::RaftLog &log, int32_t n,
+                            std::vector<vraft::LogEntryPtr> &to_persist) {
+  std::vector<vraft::AppendEntry> entries(n, DataEntry(1, "v"));
+  uint64_t seq = 0;
+  EXPECT_EQ(0, log.AppendAsync(entries, to_persist, seq, nullptr));
+  EXPECT_EQ(n, static_cast<int32_t>(to_persist.size()));
+  return seq;
+}
+
+// 按批次顺序落盘，一个完成通知也说明之前的批次都落盘了
+TEST(RaftLogTest, DurableBatches) {
+  fs::remove_all(kTestDir);
+  vraft::RaftLog log(kTestDir);
+  log.Init();
+
+  std::vector<vraft::LogEntryPtr> b1, b2, b3;
+  uint64_t s1 = AppendAsync(log, 2, b1);
+  uint64_t s2 = AppendAsync(log, 3, b2);
+  uint64_t s3 = AppendAsync(log, 1, b3);
+  EXPECT_LT(s1, s2);
+  EXPECT_LT(s2, s3);
+  EXPECT_EQ(6u, log.Last());
+  EXPECT_EQ(0u, log.Durable());
+  EXPECT_EQ(3, log.PersistPending());
+
+  ASSERT_EQ(0, log.Persist(b1));
+  ASSERT_EQ(0, log.Persist(b2));
+  EXPECT_TRUE(log.OnPersisted(s2));
+  EXPECT_EQ(5u, log.Durable());
+  EXPECT_EQ(1, log.PersistPending());
+
+  // 之前批次的通知晚到
+  EXPECT_FALSE(log.OnPersisted(s1));
+  EXPECT_EQ(5u, log.Durable());
+
+  ASSERT_EQ(0, log.Persist(b3));
+  EXPECT_TRUE(log.OnPersisted(s3));
+  EXPECT_EQ(6u, log.Durable());
+  EXPECT_EQ(0, log.PersistPending());
+  CheckChain(log, 1, 6, 0);
+}
+
+// 同步写先等所有批次落盘，之后到的完成通知过时了
+TEST(RaftLogTest, StaleSeq) {
+  fs::remove_all(kTestDir);
+  vraft::RaftLog log(kTestDir);
+  log.Init();
+
+  std::vector<vraft::LogEntryPtr> b1, b2;
+  uint64_t s1 = AppendAsync(log, 2, b1);
+  uint64_t s2 = AppendAsync(log, 2, b2);
+  ASSERT_EQ(0, log.Persist(b1));
+  ASSERT_EQ(0, log.Persist(b2));
+
+  std::vector<vraft::AppendEntry> entries(1, DataEntry(1, "sync"));
+  ASSERT_EQ(0, log.AppendSome(entries, nullptr));
+  EXPECT_EQ(0, log.PersistPending());
+  EXPECT_EQ(5u, log.Durable());
+
+  EXPECT_FALSE(log.OnPersisted(s1));
+  EXPECT_FALSE(log.OnPersisted(s2));
+  EXPECT_EQ(5u, log.Durable());
+
+  // 截断也先等批次落盘
+  std::vector<vraft::LogEntryPtr> b3;
+  uint64_t s3 = AppendAsync(log, 2, b3);
+  ASSERT_EQ(0, log.Persist(b3));
+  ASSERT_EQ(0, log.DeleteFrom(7, nullptr));
+  EXPECT_FALSE(log.OnPersisted(s3));
+  EXPECT_EQ(6u, log.Durable());
+  CheckChain(log, 1, 6, 0);
+}
+
+// 没落盘的日志不会被淘汰，缓存放不下时扩大，落盘之后照常淘汰
+TEST(RaftLogTest, PinUnpersisted) {
+  fs::remove_all(kTestDir);
+  vraft::RaftLog log(kTestDir);
+  log.Init();
+
+  std::vector<std::vector<vraft::LogEntryPtr>> batches(3);
+  uint64_t seq = 0;
+  for (auto &batch : batches) {
+    seq = AppendAsync(log, vraft::kLogCacheEntries / 2, batch);
+  }
+  vraft::RaftIndex last = vraft::kLogCacheEntries / 2 * 3;
+  EXPECT_EQ(last, log.Last());
+  EXPECT_EQ(0u, log.Durable());
+
+  nlohmann::json cache = log.ToJson()["cache"];
+  EXPECT_EQ(1u, cache["first"].get<vraft::RaftIndex>());
+  EXPECT_EQ(last, cache["count"].get<vraft::RaftIndex>());
+
+  // 复制读到的就是交给 Persist 的那一份
+  EXPECT_EQ(batches[0][0], log.GetEntry(1));
+  EXPECT_EQ(batches[2].back(), log.GetEntry(last));
+  vraft::RaftLogIteratorUPtr it = log.NewIterator(1, last);
+  vraft::RaftIndex count = 0;
+  for (; it->Valid(); it->Next()) {
+    ++count;
+  }
+  EXPECT_EQ(last, count);
+  it.reset();
+
+  for (auto &batch : batches) {
+    ASSERT_EQ(0, log.Persist(batch));
+  }
+  EXPECT_TRUE(log.OnPersisted(seq));
+  EXPECT_EQ(last, log.Durable());
+
+  // 扩大后的环装满了，从最旧的开始淘汰
+  std::vector<vraft::AppendEntry> entries(vraft::kLogCacheEntries,
+                                          DataEntry(1, "sync"));
+  ASSERT_EQ(0, log.AppendSome(entries, nullptr));
+  last += vraft::kLogCacheEntries;
+
+  cache = log.ToJson()["cache"];
+  EXPECT_EQ(last, cache["last"].get<vraft::RaftIndex>());
+  EXPECT_EQ(static_cast<vraft::RaftIndex>(vraft::kLogCacheEntries * 2),
+            cache["count"].get<vraft::RaftIndex>());
+  EXPECT_LT(1u, cache["first"].get<vraft::RaftIndex>());
+
+  vraft::LogEntryPtr entry = log.GetEntry(1);
+  ASSERT_TRUE(entry);
+  EXPECT_NE(batches[0][0], entry);
+  EXPECT_EQ("v", entry->append_entry.value);
+}
+
+static vraft::LogEntryPtr CacheEntry(vraft::RaftIndex index,
+                                     int32_t value_bytes = 8) {
+  vraft::LogEntryPtr entry = std::make_shared<vraft::LogEntry>();
+  entry->index = index;
+  entry->append_entry.term = 1;
+  entry->append_entry.type = vraft::kData;
+  entry->append_entry.value = std::string(value_bytes, 'a' + index % 26);
+  entry->pre_chk_all = 0;
+  entry->CheckSum();
+  return entry;
+}
+
+static int64_t CacheBytes(int32_t value_bytes) {
+  return sizeof(vraft::LogEntry) + value_bytes;
+}
+
+// 按条数淘汰最旧的，不连续的日志让缓存从它重新开始
+TEST(LogCacheTest, Put) {
+  vraft::LogCache cache(4, 1 << 20);
+  EXPECT_TRUE(cache.Empty());
+  EXPECT_EQ(nullptr, cache.Get(1));
+
+  std::vector<vraft::LogEntryPtr> entries;
+  for (vraft::RaftIndex i = 1; i <= 6; ++i) {
+    entries.push_back(CacheEntry(i));
+    cache.Put(entries.back());
+  }
+  EXPECT_EQ(3u, cache.first());
+  EXPECT_EQ(6u, cache.last());
+  EXPECT_EQ(4 * CacheBytes(8), cache.bytes());
+  EXPECT_EQ(nullptr, cache.Get(2));
+  EXPECT_EQ(entries[2], cache.Get(3));
+  EXPECT_EQ(entries[5], cache.Get(6));
+  EXPECT_EQ(nullptr, cache.Get(7));
+
+  cache.Put(CacheEntry(10));
+  EXPECT_EQ(10u, cache.first());
+  EXPECT_EQ(10u, cache.last());
+  EXPECT_EQ(CacheBytes(8), cache.bytes());
+  EXPECT_EQ(nullptr, cache.Get(6));
+
+  cache.Clear();
+  EXPECT_TRUE(cache.Empty());
+  EXPECT_EQ(0, cache.bytes());
+}
+
+// 按字节数淘汰，单条超过上限也放得进去
+TEST(LogCacheTest, Bytes) {
+  vraft::LogCache cache(100, CacheBytes(100) * 3);
+  for (vraft::RaftIndex i = 1; i <= 5; ++i) {
+    cache.Put(CacheEntry(i, 100));
+  }
+  EXPECT_EQ(3u, cache.first());
+  EXPECT_EQ(5u, cache.last());
+  EXPECT_EQ(3 * CacheBytes(100), cache.bytes());
+
+  cache.Put(CacheEntry(6, 1000));
+  EXPECT_EQ(6u, cache.first());
+  EXPECT_EQ(CacheBytes(1000), cache.bytes());
+}
+
+TEST(LogCacheTest, Delete) {
+  vraft::LogCache cache(8, 1 << 20);
+  for (vraft::RaftIndex i = 1; i <= 8; ++i) {
+    cache.Put(CacheEntry(i));
+  }
+
+  cache.DeleteFrom(6);
+  EXPECT_EQ(1u, cache.first());
+  EXPECT_EQ(5u, cache.last());
+  EXPECT_EQ(nullptr, cache.Get(6));
+
+  cache.DeleteUtil(2);
+  EXPECT_EQ(3u, cache.first());
+  EXPECT_EQ(5u, cache.last());
+  EXPECT_EQ(3 * CacheBytes(8), cache.bytes());
+
+  // 截断之后接着 last 放
+  cache.Put(CacheEntry(6));
+  EXPECT_EQ(3u, cache.first());
+  EXPECT_EQ(6u, cache.last());
+
+  cache.DeleteFrom(1);
+  EXPECT_TRUE(cache.Empty());
+  EXPECT_EQ(0, cache.bytes());
+  cache.DeleteUtil(100);
+  EXPECT_TRUE(cache.Empty());
+}
+
+// 钉住的日志不淘汰，环扩大后原来的日志都还在
+TEST(LogCacheTest, PinGrow) {
+  vraft::LogCache cache(4, CacheBytes(8) * 4);
+  std::vector<vraft::LogEntryPtr> entries;
+  for (vraft::RaftIndex i = 1; i <= 3; ++i) {
+    entries.push_back(CacheEntry(i));
+    cache.Put(entries.back());
+  }
+  cache.Pin(2);
+  for (vraft::RaftIndex i = 4; i <= 10; ++i) {
+    entries.push_back(CacheEntry(i));
+    cache.Put(entries.back());
+  }
+  EXPECT_EQ(2u, cache.first());
+  EXPECT_EQ(10u, cache.last());
+  EXPECT_EQ(9 * CacheBytes(8), cache.bytes());
+  for (vraft::RaftIndex i = 2; i <= 10; ++i) {
+    EXPECT_EQ(entries[i - 1], cache.Get(i));
+  }
+
+  // 落盘之后照常淘汰到字节上限
+  cache.Pin(0);
+  entries.push_back(CacheEntry(11));
+  cache.Put(entries.back());
+  EXPECT_EQ(8u, cache.first());
+  EXPECT_EQ(11u, cache.last());
+  EXPECT_EQ(4 * CacheBytes(8), cache.bytes());
+  EXPECT_EQ(entries[7], cache.Get(8));
+}
+
+class RaftLogIteratorTest : public ::testing::Test {
+ protected:
+  // 存储里有 [1, 10]，缓存里是同一批日志的 [7, 10]
+  void SetUp() override {
+    fs::remove_all(kTestDir);
+    fs::create_directories(kTestDir);
+    storage_ = vraft::CreateLogStorage(vraft::kLogStorageSegment, kTestDir);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage_->Open(state));
+    for (vraft::RaftIndex i = 1; i <= 10; ++i) {
+      entries_.push_back(CacheEntry(i));
+    }
+    ASSERT_EQ(0, storage_->Append(entries_, true));
+    for (vraft::RaftIndex i = 7; i <= 10; ++i) {
+      cache_.Put(entries_[i - 1]);
+    }
+  }
+
+  vraft::RaftLogIteratorUPtr NewIterator(vraft::RaftIndex first,
+                                         vraft::RaftIndex last) {
+    return std::make_unique<vraft::RaftLogIterator>(storage_.get(), &mu_,
+                                                    &cache_, first, last);
+  }
+
+  vraft::LogStorageUPtr storage_;
+  std::mutex mu_;
+  vraft::LogCache cache_{16, 1 << 20};
+  std::vector<vraft::LogEntryPtr> entries_;
+};
+
+// 缓存里的日志直接共享，不复制，也不锁存储
+TEST_F(RaftLogIteratorTest, FromCache) {
+  vraft::RaftLogIteratorUPtr it = NewIterator(7, 9);
+  vraft::RaftIndex index = 7;
+  for (; it->Valid(); it->Next()) {
+    EXPECT_EQ(entries_[index - 1], it->entry());
+    EXPECT_TRUE(mu_.try_lock());
+    mu_.unlock();
+    ++index;
+  }
+  EXPECT_EQ(10u, index);
+}
+
+// 缓存没有的从存储读，读到缓存的部分后改为共享
+TEST_F(RaftLogIteratorTest, FromStorage) {
+  vraft::RaftLogIteratorUPtr it = NewIterator(3, 10);
+  EXPECT_FALSE(mu_.try_lock());
+  vraft::RaftIndex index = 3;
+  for (; it->Valid(); it->Next()) {
+    const vraft::LogEntryPtr &entry = it->entry();
+    EXPECT_EQ(index, entry->index);
+    EXPECT_EQ(entries_[index - 1]->append_entry.value,
+              entry->append_entry.value);
+    EXPECT_EQ(entries_[index - 1]->chk_all, entry->chk_all);
+    EXPECT_EQ(index >= 7, entries_[index - 1] == entry);
+    ++index;
+  }
+  EXPECT_EQ(11u, index);
+  it.reset();
+  EXPECT_TRUE(mu_.try_lock());
+  mu_.unlock();
+}
+
+// 区间超出日志时停在最后一条，空区间一开始就无效
+TEST_F(RaftLogIteratorTest, Range) {
+  vraft::RaftLogIteratorUPtr it = NewIterator(9, 20);
+  vraft::RaftIndex count = 0;
+  for (; it->Valid(); it->Next()) {
+    ++count;
+  }
+  EXPECT_EQ(2u, count);
+  it.reset();
+
+  EXPECT_FALSE(NewIterator(5, 4)->Valid());
+  EXPECT_FALSE(NewIterator(11, 20)->Valid());
+}
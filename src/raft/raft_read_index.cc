@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#include "clock.h"
+#include "raft.h"
+#include "raft_server.h"
+#include "util.h"
+#include "vraft_logger.h"
+
+namespace vraft {
+
+int32_t Raft::Read(const ReadOptions &options, ReadFunc cb) {
+  if (assert_loop_) {
+    assert_loop_();
+  }
+
+  Tracer tracer(this, true, tracer_cb_);
+  tracer.PrepareState0();
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%s read consistency:%d max-stale-ms:%u",
+           Me().ToString().c_str(), options.consistency, options.max_stale_ms);
+  tracer.PrepareEvent(kEventOther, std::string(buf));
+
+  int32_t rv = 0;
+  uint64_t now = Clock::NSec();
+  if (!started_) {
+    rv = -1;
+    goto end;
+  }
+
+  // 有界过期读直接读本地，不够新时退化为线性一致读
+  if (options.consistency == kReadBoundedStale &&
+      ReadFreshEnough(options.max_stale_ms, now)) {
+    cb(0, last_apply_);
+    goto end;
+  }
+
+  if (state_ == STATE_LEADER) {
+    rv = DoReadIndex(now, cb, &tracer);
+
+  } else if (leader_.ToU64() != 0) {
+    // 向 leader 要读索引
+    PendingRead read = {now, 0, cb};
+    uint64_t seq = read_mgr_.AddForwarded(std::move(read));
+    rv = SendReadIndex(leader_.ToU64(), seq, &tracer);
+
+  } else {
+    rv = -1;
+  }
+
+end:
+  tracer.PrepareState1();
+  tracer.Finish();
+  return rv;
+}
+
+int32_t Raft::OnReadIndex(struct ReadIndex &msg) {
+  if (started_) {
+    Tracer tracer(this, true, tracer_cb_);
+    tracer.PrepareState0();
+    tracer.PrepareEvent(kEventRecv, msg.ToJsonString(false, true));
+
+    // maybe step down first
+    if (msg.term > meta_.term()) {
+      StepDown(msg.term, &tracer);
+    }
+
+    int32_t rv = -1;
+    if (state_ == STATE_LEADER && msg.term == meta_.term()) {
+      // 确认后不用等本地应用，leader 提交后立刻应用
+      RaftAddr src = msg.src;
+      uint64_t seq = msg.seq;
+      rv = DoReadIndex(
+          Clock::NSec(),
+          [this, src, seq](int32_t read_rv, RaftIndex read_index) {
+            SendReadIndexReply(src, seq, read_rv == 0, read_index, nullptr);
+          },
+          &tracer);
+    }
+
+    if (rv != 0) {
+      SendReadIndexReply(msg.src, msg.seq, false, 0, &tracer);
+    }
+
+    tracer.PrepareState1();
+    tracer.Finish();
+  }
+  return 0;
+}
+
+int32_t Raft::OnReadIndexReply(struct ReadIndexReply &msg) {
+  if (started_) {
+    Tracer tracer(this, true, tracer_cb_);
+    tracer.PrepareState0();
+    tracer.PrepareEvent(kEventRecv, msg.ToJsonString(false, true));
+
+    PendingRead read;
+    if (!read_mgr_.TakeForwarded(msg.req_seq, read)) {
+      // timeout, or leader changed
+      tracer.PrepareEvent(kEventOther, std::string("drop read-index-reply"));
+
+    } else if (!msg.success) {
+      read.cb(-1, 0);
+
+    } else {
+      // 等本地状态机应用到读索引
+      read.read_index = msg.read_index;
+      read_mgr_.AddApplying(std::move(read));
+      ApplyReads();
+    }
+
+    tracer.PrepareState1();
+    tracer.Finish();
+  }
+  return 0;
+}
+
+int32_t Raft::SendReadIndex(uint64_t dest, uint64_t seq, Tracer *tracer) {
+  ReadIndex msg;
+  msg.src = Me();
+  msg.dest = RaftAddr(dest);
+  msg.term = meta_.term();
+  msg.uid = UniqId(&msg);
+  msg.send_ts = Clock::NSec();
+  msg.elapse = 0;
+  msg.seq = seq;
+
+  std::string body_str;
+  int32_t bytes = msg.ToString(body_str);
+
+  MsgHeader header;
+  header.body_bytes = bytes;
+  header.type = kReadIndex;
+  std::string header_str;
+  header.ToString(header_str);
+
+  if (send_) {
+    header_str.append(std::move(body_str));
+    int32_t rv = send_(dest, header_str.data(), header_str.size());
+
+    if (tracer != nullptr && rv == 0) {
+      tracer->PrepareEvent(kEventSend, msg.ToJsonString(false, true));
+    }
+  }
+  return 0;
+}
+
+int32_t Raft::SendReadIndexReply(RaftAddr dest, uint64_t req_seq,
+                                 bool success, RaftIndex read_index,
+                                 Tracer *tracer) {
+  ReadIndexReply msg;
+  msg.src = Me();
+  msg.dest = dest;
+  msg.term = meta_.term();
+  msg.uid = UniqId(&msg);
+  msg.send_ts = Clock::NSec();
+  msg.elapse = 0;
+  msg.success = success;
+  msg.read_index = read_index;
+  msg.req_seq = req_seq;
+
+  std::string body_str;
+  int32_t bytes = msg.ToString(body_str);
+
+  MsgHeader header;
+  header.body_bytes = bytes;
+  header.type = kReadIndexReply;
+  std::string header_str;
+  header.ToString(header_str);
+
+  if (send_) {
+    header_str.append(std::move(body_str));
+    int32_t rv = send_(dest.ToU64(), header_str.data(), header_str.size());
+
+    if (tracer != nullptr && rv == 0) {
+      tracer->PrepareEvent(kEventSend, msg.ToJsonString(false, true));
+    }
+  }
+  return 0;
+}
+
+bool Raft::ReadFreshEnough(uint32_t max_stale_ms, uint64_t now) {
+  uint64_t max_stale_ns = static_cast<uint64_t>(max_stale_ms) * 1000 * 1000;
+
+  if (state_ == STATE_LEADER) {
+    // 被取代之前本地数据就是最新的，最晚在多数派最后一次应答时还是 leader
+    return GetTerm(commit_) == meta_.term() &&
+           now - read_mgr_.MajorityAck(now) <= max_stale_ns;
+
+  } else if (state_ == STATE_FOLLOWER) {
+    // 收到心跳时已经应用到 leader 当时的提交点
+    int64_t last = last_heartbeat_timestamp_;
+    return last > 0 && last_apply_ >= commit_ &&
+           now - static_cast<uint64_t>(last) <= max_stale_ns;
+  }
+  return false;
+}
+
+/********************************************************************************************
+\* lease: a follower checking interval does not vote in election_ms after it
+\* hears from the leader, so no new leader can come up in election_ms after a
+\* majority acked a heartbeat. The lease is a bit shorter for clock drift, and
+\* is paused after leader transfer, whose vote request skips the check.
+********************************************************************************************/
+bool Raft::LeaseValid(uint64_t now) {
+  return enable_lease_read_ &&
+         read_mgr_.LeaseValid(now, timer_mgr_.election_ms(), interval_check_);
+}
+
+/********************************************************************************************
+\* ReadIndex, raft thesis 6.4:
+\* 1. the leader has committed an entry in its term, commit index is up to date
+\* 2. save commit index as read index
+\* 3. a heartbeat round acked by a majority confirms the leadership
+\* 4. serve the read after the state machine applies read index
+********************************************************************************************/
+int32_t Raft::DoReadIndex(uint64_t now, ReadFunc cb, Tracer *tracer) {
+  assert(state_ == STATE_LEADER);
+
+  // 刚当选时 noop 还没提交，提交点可能落后，读请求让调用方重试
+  if (GetTerm(commit_) != meta_.term()) {
+    if (tracer) {
+      tracer->PrepareEvent(kEventOther,
+                           std::string("read-index reject, noop not commit"));
+    }
+    return -1;
+  }
+
+  PendingRead read = {now, commit_, cb};
+  if (LeaseValid(now)) {
+    read_mgr_.AddApplying(std::move(read));
+    ApplyReads();
+    return 0;
+  }
+
+  // 已经有一轮心跳在路上，确认它之后再发下一轮，读多时合并成一轮
+  bool need_round = !read_mgr_.HasConfirming();
+  read_mgr_.AddConfirming(std::move(read));
+  if (need_round) {
+    BroadcastHeartBeat(tracer);
+  }
+
+  // 单节点直接确认
+  ConfirmReads(tracer);
+  return 0;
+}
+
+void Raft::BroadcastHeartBeat(Tracer *tracer) {
+  for (auto &peer : config_mgr_.Current()->peers) {
+    int32_t rv = SendHeartBeat(peer.ToU64(), tracer);
+    assert(rv == 0);
+
+    timer_mgr_.AgainHeartBeat(peer.ToU64());
+  }
+}
+
+void Raft::ConfirmReads(Tracer *tracer) {
+  if (!read_mgr_.HasConfirming()) {
+    return;
+  }
+
+  int32_t count = read_mgr_.Confirm(read_mgr_.MajorityAck(Clock::NSec()));
+  if (count > 0) {
+    if (tracer) {
+      char buf[128];
+      snprintf(buf, sizeof(buf), "read-index confirm %d reads", count);
+      tracer->PrepareEvent(kEventOther, std::string(buf));
+    }
+
+    // 确认期间新来的读请求需要下一轮心跳
+    if (read_mgr_.HasConfirming()) {
+      BroadcastHeartBeat(tracer);
+    }
+    ApplyReads();
+  }
+}
+
+void Raft::ApplyReads() {
+  std::vector<PendingRead> reads = read_mgr_.TakeApplied(last_apply_);
+  for (auto &read : reads) {
+    read.cb(0, read.read_index);
+  }
+}
+
+void Raft::FailReads(std::vector<PendingRead> reads) {
+  for (auto &read : reads) {
+    read.cb(-1, 0);
+  }
+}
+
+}  // namespace vraft
@@ -174,6 +174,32 @@ void RaftServer::OnMessage(const vraft::TcpConnectionSPtr &conn,
           break;
         }
 
+        case kReadIndex: {
+          ReadIndex msg;
+          int32_t bytes = msg.FromString(buf->BeginRead(), body_bytes);
+          assert(bytes > 0);
+          diff_ms = (recv_ns - msg.send_ts) / (1000 * 1000);
+          msg.elapse = diff_ms;
+          buf->Retrieve(body_bytes);
+          if (enable_recv_) {
+            raft_->OnReadIndex(msg);
+          }
+          break;
+        }
+
+        case kReadIndexReply: {
+          ReadIndexReply msg;
+          int32_t bytes = msg.FromString(buf->BeginRead(), body_bytes);
+          assert(bytes > 0);
+          diff_ms = (recv_ns - msg.send_ts) / (1000 * 1000);
+          msg.elapse = diff_ms;
+          buf->Retrieve(body_bytes);
+          if (enable_recv_) {
+            raft_->OnReadIndexReply(msg);
+          }
+          break;
+        }
+
         case kClientRequet: {
           ClientRequest msg;
           int32_t bytes = msg.FromString(buf->BeginRead(), body_bytes);
@@ -231,6 +257,10 @@ void RaftServer::Init() {
   raft_->EnableRecv();
 
   raft_->set_assert_loop(std::bind(&RaftServer::AssertInLoopThread, this));
+
+  log_thread_ = std::make_shared<WorkThread>("raft-log-io");
+  raft_->set_log_io(std::bind(&RaftServer::RunInLogThread, this,
+                              std::placeholders::_1, std::placeholders::_2));
 }
 
 int32_t RaftServer::Start() {
@@ -238,6 +268,9 @@ int32_t RaftServer::Start() {
   rv = server_->Start();
   assert(rv == 0);
 
+  rv = log_thread_->Start();
+  assert(rv == 0);
+
   rv = raft_->Start();
   assert(rv == 0);
 
@@ -248,6 +281,10 @@ int32_t RaftServer::Stop() {
   int32_t rv = raft_->Stop();
   assert(rv == 0);
 
+  // fsync in flight finishes, its done functor goes to the loop
+  log_thread_->Stop();
+  log_thread_->Join();
+
   for (auto &c : clients_) {
     c.second->Stop();
   }
@@ -338,6 +375,17 @@ TcpClientSPtr RaftServer::GetClientOrCreate(uint64_t dest_addr) {
   return ptr;
 }
 
+void RaftServer::RunInLogThread(Functor work, Functor done) {
+  EventLoopWPtr loop = loop_;
+  log_thread_->Push([work, done, loop]() {
+    work();
+    auto sptr = loop.lock();
+    if (sptr) {
+      sptr->RunFunctor(done);
+    }
+  });
+}
+
 void RaftServer::AssertInLoopThread() {
   auto sptr = loop_.lock();
   if (sptr) {
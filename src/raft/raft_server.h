@@ -10,6 +10,7 @@
 #include "raft.h"
 #include "tcp_client.h"
 #include "tcp_server.h"
+#include "work_thread.h"
 
 namespace vraft {
 
@@ -52,6 +53,7 @@ class RaftServer final {
   int32_t Send(uint64_t dest_addr, const char *buf, unsigned int size);
 
   TimerSPtr MakeTimer(TimerParam &param);
+  void RunInLogThread(Functor work, Functor done);
   TcpClientSPtr GetClient(uint64_t dest_addr);
 
  private:
@@ -59,6 +61,7 @@ class RaftServer final {
   EventLoopWPtr loop_;
   TcpServerSPtr server_;
   std::unordered_map<uint64_t, TcpClientSPtr> clients_;
+  WorkThreadSPtr log_thread_;  // fsync of the leader log
 
   bool enable_send_;
   bool enable_recv_;
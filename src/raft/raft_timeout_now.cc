@@ -58,6 +58,10 @@ int32_t Raft::SendTimeoutNow(uint64_t dest, bool force, Tracer *tracer) {
   msg.last_log_term = LastTerm();
   msg.force = force;
 
+  // dest starts election without waiting for election timeout,
+  // my lease is not safe any more
+  read_mgr_.PauseLease();
+
   std::string body_str;
   int32_t bytes = msg.ToString(body_str);
 
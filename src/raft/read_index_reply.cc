@@ -0,0 +1,169 @@
+#include "read_index_reply.h"
+
+namespace vraft {
+
+int32_t ReadIndexReply::MaxBytes() {
+  int32_t size = 0;
+  size += sizeof(uint64_t);
+  size += sizeof(uint64_t);
+  size += sizeof(term);
+  size += sizeof(uid);
+  size += sizeof(send_ts);
+  size += sizeof(elapse);
+  size += sizeof(uint8_t);  // bool success;
+  size += sizeof(read_index);
+  size += sizeof(req_seq);
+  return size;
+}
+
+int32_t ReadIndexReply::ToString(std::string &s) {
+  s.clear();
+  int32_t max_bytes = MaxBytes();
+  char *ptr = reinterpret_cast<char *>(DefaultAllocator().Malloc(max_bytes));
+  int32_t size = ToString(ptr, max_bytes);
+  s.append(ptr, size);
+  DefaultAllocator().Free(ptr);
+  return size;
+}
+
+int32_t ReadIndexReply::ToString(const char *ptr, int32_t len) {
+  char *p = const_cast<char *>(ptr);
+  int32_t size = 0;
+  uint64_t u64 = 0;
+
+  u64 = src.ToU64();
+  EncodeFixed64(p, u64);
+  p += sizeof(u64);
+  size += sizeof(u64);
+
+  u64 = dest.ToU64();
+  EncodeFixed64(p, u64);
+  p += sizeof(u64);
+  size += sizeof(u64);
+
+  EncodeFixed64(p, term);
+  p += sizeof(term);
+  size += sizeof(term);
+
+  EncodeFixed32(p, uid);
+  p += sizeof(uid);
+  size += sizeof(uid);
+
+  EncodeFixed64(p, send_ts);
+  p += sizeof(send_ts);
+  size += sizeof(send_ts);
+
+  EncodeFixed64(p, elapse);
+  p += sizeof(elapse);
+  size += sizeof(elapse);
+
+  EncodeFixed8(p, success);
+  p += sizeof(uint8_t);
+  size += sizeof(uint8_t);
+
+  EncodeFixed32(p, read_index);
+  p += sizeof(read_index);
+  size += sizeof(read_index);
+
+  EncodeFixed64(p, req_seq);
+  p += sizeof(req_seq);
+  size += sizeof(req_seq);
+
+  assert(size <= len);
+  return size;
+}
+
+int32_t ReadIndexReply::FromString(std::string &s) {
+  return FromString(s.c_str(), s.size());
+}
+
+int32_t ReadIndexReply::FromString(const char *ptr, int32_t len) {
+  char *p = const_cast<char *>(ptr);
+  uint64_t u64 = 0;
+  int32_t size = 0;
+
+  u64 = DecodeFixed64(p);
+  src.FromU64(u64);
+  p += sizeof(u64);
+  size += sizeof(u64);
+
+  u64 = DecodeFixed64(p);
+  dest.FromU64(u64);
+  p += sizeof(u64);
+  size += sizeof(u64);
+
+  term = DecodeFixed64(p);
+  p += sizeof(term);
+  size += sizeof(term);
+
+  uid = DecodeFixed32(p);
+  p += sizeof(uid);
+  size += sizeof(uid);
+
+  send_ts = DecodeFixed64(p);
+  p += sizeof(send_ts);
+  size += sizeof(send_ts);
+
+  elapse = DecodeFixed64(p);
+  p += sizeof(elapse);
+  size += sizeof(elapse);
+
+  success = DecodeFixed8(p);
+  p += sizeof(uint8_t);
+  size += sizeof(uint8_t);
+
+  read_index = DecodeFixed32(p);
+  p += sizeof(read_index);
+  size += sizeof(read_index);
+
+  req_seq = DecodeFixed64(p);
+  p += sizeof(req_seq);
+  size += sizeof(req_seq);
+
+  return size;
+}
+
+nlohmann::json ReadIndexReply::ToJson() {
+  nlohmann::json j;
+  j[0]["src"] = src.ToString();
+  j[0]["dest"] = dest.ToString();
+  j[0]["term"] = term;
+  j[0]["uid"] = U32ToHexStr(uid);
+  j[1]["success"] = success;
+  j[1]["read-index"] = read_index;
+  j[2]["req-seq"] = req_seq;
+  j[3]["send_ts"] = send_ts;
+  j[3]["elapse"] = elapse;
+  return j;
+}
+
+nlohmann::json ReadIndexReply::ToJsonTiny() {
+  nlohmann::json j;
+  j["src"] = src.ToString();
+  j["dst"] = dest.ToString();
+  j["tm"] = term;
+  j["suc"] = success;
+  j["ri"] = read_index;
+  j["rseq"] = req_seq;
+  j["uid"] = U32ToHexStr(uid);
+  j["send"] = send_ts;
+  j["elapse"] = elapse;
+  return j;
+}
+
+std::string ReadIndexReply::ToJsonString(bool tiny, bool one_line) {
+  nlohmann::json j;
+  if (tiny) {
+    j["ri-r"] = ToJsonTiny();
+  } else {
+    j["read-index-reply"] = ToJson();
+  }
+
+  if (one_line) {
+    return j.dump();
+  } else {
+    return j.dump(JSON_TAB);
+  }
+}
+
+}  // namespace vraft
@@ -0,0 +1,180 @@
+#include "read_manager.h"
+
+#include <algorithm>
+
+namespace vraft {
+
+ReadManager::ReadManager(const std::vector<RaftAddr> &peers)
+    : lease_paused_(false), next_seq_(1) {
+  Reset(peers);
+}
+
+ReadManager::~ReadManager() {}
+
+void ReadManager::Reset(const std::vector<RaftAddr> &peers) {
+  acks_.clear();
+  for (auto addr : peers) {
+    acks_[addr.ToU64()] = 0;
+  }
+}
+
+void ReadManager::Ack(uint64_t addr, uint64_t send_ts) {
+  auto it = acks_.find(addr);
+  if (it != acks_.end() && it->second < send_ts) {
+    it->second = send_ts;
+  }
+}
+
+void ReadManager::ResetAck() {
+  for (auto &ack : acks_) {
+    ack.second = 0;
+  }
+}
+
+uint64_t ReadManager::MajorityAck(uint64_t now) {
+  std::vector<uint64_t> ts;
+  ts.push_back(now);
+  for (auto &ack : acks_) {
+    ts.push_back(ack.second);
+  }
+
+  // 从大到小排，第 quorum 个就是多数派都确认过的最早发送时间
+  std::sort(ts.begin(), ts.end(), std::greater<uint64_t>());
+  return ts.at(ts.size() / 2);
+}
+
+bool ReadManager::LeaseValid(uint64_t now, uint32_t election_ms,
+                             bool interval_check) {
+  if (!interval_check || lease_paused_) {
+    return false;
+  }
+
+  uint64_t lease_ns = static_cast<uint64_t>(election_ms) * 1000 * 1000 *
+                      LEASE_RATIO_PERCENT / 100;
+  return now < MajorityAck(now) + lease_ns;
+}
+
+void ReadManager::AddConfirming(PendingRead read) {
+  confirming_.push_back(std::move(read));
+}
+
+int32_t ReadManager::Confirm(uint64_t ack_ts) {
+  int32_t count = 0;
+  while (!confirming_.empty() && confirming_.front().start_ts <= ack_ts) {
+    AddApplying(std::move(confirming_.front()));
+    confirming_.pop_front();
+    ++count;
+  }
+  return count;
+}
+
+uint64_t ReadManager::AddForwarded(PendingRead read) {
+  uint64_t seq = next_seq_++;
+  forwarded_[seq] = std::move(read);
+  return seq;
+}
+
+bool ReadManager::TakeForwarded(uint64_t seq, PendingRead &read) {
+  auto it = forwarded_.find(seq);
+  if (it == forwarded_.end()) {
+    return false;
+  }
+  read = std::move(it->second);
+  forwarded_.erase(it);
+  return true;
+}
+
+void ReadManager::AddApplying(PendingRead read) {
+  RaftIndex read_index = read.read_index;
+  applying_.emplace(read_index, std::move(read));
+}
+
+std::vector<PendingRead> ReadManager::TakeApplied(RaftIndex last_apply) {
+  std::vector<PendingRead> reads;
+  auto end = applying_.upper_bound(last_apply);
+  for (auto it = applying_.begin(); it != end; ++it) {
+    reads.push_back(std::move(it->second));
+  }
+  applying_.erase(applying_.begin(), end);
+  return reads;
+}
+
+std::vector<PendingRead> ReadManager::TakeWaitLeader() {
+  std::vector<PendingRead> reads;
+  for (auto &read : confirming_) {
+    reads.push_back(std::move(read));
+  }
+  confirming_.clear();
+
+  for (auto &item : forwarded_) {
+    reads.push_back(std::move(item.second));
+  }
+  forwarded_.clear();
+  return reads;
+}
+
+std::vector<PendingRead> ReadManager::TakeExpired(uint64_t ts) {
+  std::vector<PendingRead> reads;
+  while (!confirming_.empty() && confirming_.front().start_ts < ts) {
+    reads.push_back(std::move(confirming_.front()));
+    confirming_.pop_front();
+  }
+
+  for (auto it = forwarded_.begin(); it != forwarded_.end();) {
+    if (it->second.start_ts < ts) {
+      reads.push_back(std::move(it->second));
+      it = forwarded_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto it = applying_.begin(); it != applying_.end();) {
+    if (it->second.start_ts < ts) {
+      reads.push_back(std::move(it->second));
+      it = applying_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return reads;
+}
+
+nlohmann::json ReadManager::ToJson() {
+  nlohmann::json j;
+  for (auto &ack : acks_) {
+    RaftAddr addr(ack.first);
+    j["ack"][addr.ToString()] = ack.second;
+  }
+  j["lease-paused"] = lease_paused_;
+  j["confirming"] = confirming_.size();
+  j["forwarded"] = forwarded_.size();
+  j["applying"] = applying_.size();
+  return j;
+}
+
+nlohmann::json ReadManager::ToJsonTiny() {
+  nlohmann::json j;
+  j["lp"] = lease_paused_;
+  j["cf"] = confirming_.size();
+  j["fw"] = forwarded_.size();
+  j["ap"] = applying_.size();
+  return j;
+}
+
+std::string ReadManager::ToJsonString(bool tiny, bool one_line) {
+  nlohmann::json j;
+  if (tiny) {
+    j["rd_mgr"] = ToJsonTiny();
+  } else {
+    j["read_manager"] = ToJson();
+  }
+
+  if (one_line) {
+    return j.dump();
+  } else {
+    return j.dump(JSON_TAB);
+  }
+}
+
+}  // namespace vraft
@@ -0,0 +1,115 @@
+#ifndef VRAFT_READ_MANAGER_H_
+#define VRAFT_READ_MANAGER_H_
+
+#include <functional>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "nlohmann/json.hpp"
+#include "raft_addr.h"
+
+namespace vraft {
+
+// leader lease is a bit shorter than the election timeout,
+// leaves room for clock drift
+#define LEASE_RATIO_PERCENT 90
+
+enum ReadConsistency {
+  // ReadIndex: the leader confirms it is still leader by a heartbeat round
+  // (or its lease), the read waits until the local state machine applies
+  // the leader's commit index
+  kReadLinearizable = 0,
+
+  // served by the local state machine at once if it heard from the leader
+  // within max_stale_ms, otherwise the same as kReadLinearizable
+  kReadBoundedStale,
+};
+
+struct ReadOptions {
+  ReadConsistency consistency = kReadLinearizable;
+  uint32_t max_stale_ms = 0;
+};
+
+// rv 0: the local state machine has applied read_index, it can serve the
+// read now; rv -1: leadership lost or timeout, retry later
+using ReadFunc = std::function<void(int32_t rv, RaftIndex read_index)>;
+
+struct PendingRead {
+  uint64_t start_ts;  // nanosecond
+  RaftIndex read_index;
+  ReadFunc cb;
+};
+
+// Reads waiting in raft, used in the raft loop thread only.
+//
+// A read goes through (some of) three stages:
+//   confirming  leader, waits for a majority to ack a heartbeat sent after
+//               the read started
+//   forwarded   follower, waits for the read index from the leader
+//   applying    waits for the state machine to apply the read index
+class ReadManager final {
+ public:
+  ReadManager(const std::vector<RaftAddr> &peers);
+  ~ReadManager();
+  ReadManager(const ReadManager &t) = delete;
+  ReadManager &operator=(const ReadManager &t) = delete;
+
+  void Reset(const std::vector<RaftAddr> &peers);
+
+  // leader, peer acked an AppendEntries sent at send_ts in this term
+  void Ack(uint64_t addr, uint64_t send_ts);
+  void ResetAck();
+
+  // leader, a majority (the leader included, acking at now) acked
+  // AppendEntries sent at or after the return value
+  uint64_t MajorityAck(uint64_t now);
+
+  // lease is paused from leader transfer till the next term,
+  // the target does not wait for the election timeout
+  void PauseLease() { lease_paused_ = true; }
+  void ResumeLease() { lease_paused_ = false; }
+  bool lease_paused() const { return lease_paused_; }
+
+  // leader, a majority acked within the lease (a bit shorter than
+  // election_ms). Only followers checking the interval keep the lease
+  bool LeaseValid(uint64_t now, uint32_t election_ms, bool interval_check);
+
+  void AddConfirming(PendingRead read);
+  bool HasConfirming() const { return !confirming_.empty(); }
+
+  // move reads started at or before ack_ts to applying, return the count
+  int32_t Confirm(uint64_t ack_ts);
+
+  // return the seq to send to the leader
+  uint64_t AddForwarded(PendingRead read);
+  bool TakeForwarded(uint64_t seq, PendingRead &read);
+
+  void AddApplying(PendingRead read);
+  std::vector<PendingRead> TakeApplied(RaftIndex last_apply);
+
+  // reads waiting for the leader, in confirming or forwarded
+  std::vector<PendingRead> TakeWaitLeader();
+
+  // reads started before ts, in any stage
+  std::vector<PendingRead> TakeExpired(uint64_t ts);
+
+  nlohmann::json ToJson();
+  nlohmann::json ToJsonTiny();
+  std::string ToJsonString(bool tiny, bool one_line);
+
+ private:
+  std::unordered_map<uint64_t, uint64_t> acks_;  // addr -> send_ts
+  bool lease_paused_;
+
+  std::list<PendingRead> confirming_;  // ordered by start_ts
+  std::unordered_map<uint64_t, PendingRead> forwarded_;
+  std::multimap<RaftIndex, PendingRead> applying_;
+  uint64_t next_seq_;
+};
+
+}  // namespace vraft
+
+#endif
@@ -0,0 +1,166 @@
+#include "read_manager.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const uint64_t kMs = 1000 * 1000;
+
+// 5 个节点的集群，除 leader 外的 4 个 peer
+std::vector<vraft::RaftAddr> Peers() {
+  std::vector<vraft::RaftAddr> peers;
+  for (uint16_t i = 1; i <= 4; ++i) {
+    peers.push_back(vraft::RaftAddr(0x7F000001, 9000 + i, i));
+  }
+  return peers;
+}
+
+uint64_t Addr(int i) { return Peers()[i].ToU64(); }
+
+// 回调时记下 read_index
+vraft::PendingRead MakeRead(uint64_t start_ts, vraft::RaftIndex read_index,
+                            std::vector<vraft::RaftIndex> &done) {
+  return {start_ts, read_index, [&done](int32_t rv, vraft::RaftIndex index) {
+            done.push_back(index);
+          }};
+}
+
+std::vector<uint64_t> StartTs(const std::vector<vraft::PendingRead> &reads) {
+  std::vector<uint64_t> ts;
+  for (auto &read : reads) {
+    ts.push_back(read.start_ts);
+  }
+  return ts;
+}
+
+}  // namespace
+
+// 多数派确认的发送时间：leader 自己算作在 now 确认，5 个节点中第 3 大的
+TEST(ReadManagerTest, MajorityAck) {
+  vraft::ReadManager mgr(Peers());
+  EXPECT_EQ(0u, mgr.MajorityAck(100));
+
+  mgr.Ack(Addr(0), 50);
+  EXPECT_EQ(0u, mgr.MajorityAck(100));
+  mgr.Ack(Addr(1), 70);
+  EXPECT_EQ(50u, mgr.MajorityAck(100));
+  mgr.Ack(Addr(2), 60);
+  EXPECT_EQ(60u, mgr.MajorityAck(100));
+
+  // 旧心跳的应答不会让确认时间倒退，不在集群中的地址被忽略
+  mgr.Ack(Addr(1), 10);
+  mgr.Ack(vraft::RaftAddr(0x7F000001, 8000, 9).ToU64(), 99);
+  EXPECT_EQ(60u, mgr.MajorityAck(100));
+
+  mgr.ResetAck();
+  EXPECT_EQ(0u, mgr.MajorityAck(100));
+
+  // 单节点集群只有 leader 自己
+  vraft::ReadManager single({});
+  EXPECT_EQ(100u, single.MajorityAck(100));
+}
+
+// 只确认在多数派应答的心跳发出之前开始的读，按开始时间依次进入 applying
+TEST(ReadManagerTest, Confirm) {
+  vraft::ReadManager mgr(Peers());
+  std::vector<vraft::RaftIndex> done;
+  EXPECT_FALSE(mgr.HasConfirming());
+  mgr.AddConfirming(MakeRead(10, 5, done));
+  mgr.AddConfirming(MakeRead(20, 6, done));
+  mgr.AddConfirming(MakeRead(30, 7, done));
+  EXPECT_TRUE(mgr.HasConfirming());
+
+  mgr.Ack(Addr(0), 25);
+  mgr.Ack(Addr(1), 25);
+  EXPECT_EQ(2, mgr.Confirm(mgr.MajorityAck(40)));
+  EXPECT_TRUE(mgr.HasConfirming());
+  EXPECT_EQ(0, mgr.Confirm(mgr.MajorityAck(40)));
+
+  // 应用到 read_index 之前不回调
+  EXPECT_TRUE(mgr.TakeApplied(4).empty());
+  std::vector<vraft::PendingRead> reads = mgr.TakeApplied(5);
+  ASSERT_EQ(1u, reads.size());
+  EXPECT_EQ(10u, reads[0].start_ts);
+  reads[0].cb(0, reads[0].read_index);
+  EXPECT_EQ(std::vector<vraft::RaftIndex>({5}), done);
+
+  mgr.Ack(Addr(2), 30);
+  mgr.Ack(Addr(3), 30);
+  EXPECT_EQ(1, mgr.Confirm(mgr.MajorityAck(40)));
+  EXPECT_FALSE(mgr.HasConfirming());
+  EXPECT_EQ(std::vector<uint64_t>({20, 30}), StartTs(mgr.TakeApplied(100)));
+}
+
+// 租约：多数派在 election_ms * 90% 内应答过，需要 interval_check 且没有暂停
+TEST(ReadManagerTest, Lease) {
+  vraft::ReadManager mgr(Peers());
+  uint64_t start = 1000 * kMs;
+  mgr.Ack(Addr(0), start);
+  mgr.Ack(Addr(1), start);
+
+  EXPECT_TRUE(mgr.LeaseValid(start + 89 * kMs, 100, true));
+  EXPECT_FALSE(mgr.LeaseValid(start + 90 * kMs, 100, true));
+  EXPECT_FALSE(mgr.LeaseValid(start + 1, 100, false));
+
+  mgr.PauseLease();
+  EXPECT_TRUE(mgr.lease_paused());
+  EXPECT_FALSE(mgr.LeaseValid(start + 1, 100, true));
+  mgr.ResumeLease();
+  EXPECT_TRUE(mgr.LeaseValid(start + 1, 100, true));
+
+  // 只有少数派应答过
+  mgr.ResetAck();
+  mgr.Ack(Addr(0), start);
+  EXPECT_FALSE(mgr.LeaseValid(start + 1, 100, true));
+}
+
+// 超时的读从所有阶段中取出，由调用方按失败回调
+TEST(ReadManagerTest, TakeExpired) {
+  vraft::ReadManager mgr(Peers());
+  std::vector<vraft::RaftIndex> done;
+  mgr.AddConfirming(MakeRead(10, 1, done));
+  mgr.AddConfirming(MakeRead(40, 2, done));
+  uint64_t old_seq = mgr.AddForwarded(MakeRead(20, 0, done));
+  uint64_t new_seq = mgr.AddForwarded(MakeRead(50, 0, done));
+  EXPECT_NE(old_seq, new_seq);
+  mgr.AddApplying(MakeRead(30, 3, done));
+  mgr.AddApplying(MakeRead(60, 4, done));
+
+  std::vector<uint64_t> ts = StartTs(mgr.TakeExpired(35));
+  std::sort(ts.begin(), ts.end());
+  EXPECT_EQ(std::vector<uint64_t>({10, 20, 30}), ts);
+  EXPECT_TRUE(mgr.TakeExpired(35).empty());
+
+  // 超时之后 leader 的应答被丢弃，没超时的照常取出
+  vraft::PendingRead read;
+  EXPECT_FALSE(mgr.TakeForwarded(old_seq, read));
+  ASSERT_TRUE(mgr.TakeForwarded(new_seq, read));
+  EXPECT_EQ(50u, read.start_ts);
+  EXPECT_FALSE(mgr.TakeForwarded(new_seq, read));
+
+  EXPECT_TRUE(mgr.HasConfirming());
+  EXPECT_EQ(std::vector<uint64_t>({60}), StartTs(mgr.TakeApplied(4)));
+  EXPECT_TRUE(done.empty());
+}
+
+// 失去 leader 时等 leader 的读都失败，已经拿到读索引的继续等应用
+TEST(ReadManagerTest, TakeWaitLeader) {
+  vraft::ReadManager mgr(Peers());
+  std::vector<vraft::RaftIndex> done;
+  mgr.AddConfirming(MakeRead(10, 1, done));
+  uint64_t seq = mgr.AddForwarded(MakeRead(20, 0, done));
+  mgr.AddApplying(MakeRead(30, 3, done));
+
+  std::vector<uint64_t> ts = StartTs(mgr.TakeWaitLeader());
+  std::sort(ts.begin(), ts.end());
+  EXPECT_EQ(std::vector<uint64_t>({10, 20}), ts);
+  EXPECT_FALSE(mgr.HasConfirming());
+  vraft::PendingRead read;
+  EXPECT_FALSE(mgr.TakeForwarded(seq, read));
+
+  EXPECT_TRUE(mgr.TakeWaitLeader().empty());
+  EXPECT_EQ(std::vector<uint64_t>({30}), StartTs(mgr.TakeApplied(3)));
+}
@@ -0,0 +1,637 @@
+#include "segment_log_storage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include "coding.h"
+#include "crc32c.h"
+#include "vraft_logger.h"
+
+namespace vraft {
+
+const char kSegmentSuffix[] = ".seg";
+const char kTruncatedFile[] = "truncated";
+
+// record layout offsets
+const int32_t kRecordLenOffset = 4;
+const int32_t kRecordIndexOffset = 8;
+const int32_t kRecordTermOffset = 12;
+const int32_t kRecordTypeOffset = 20;
+const int32_t kRecordPreChkOffset = 24;
+const int32_t kRecordChkThsOffset = 28;
+const int32_t kRecordChkAllOffset = 32;
+
+static int64_t RecordBytes(const LogEntry &entry) {
+  return kRecordHeaderBytes + entry.append_entry.value.size();
+}
+
+static void EncodeRecord(char *p, const LogEntry &entry) {
+  const std::string &value = entry.append_entry.value;
+  EncodeFixed32(p + kRecordLenOffset, value.size());
+  EncodeFixed32(p + kRecordIndexOffset, entry.index);
+  EncodeFixed64(p + kRecordTermOffset, entry.append_entry.term);
+  EncodeFixed32(p + kRecordTypeOffset, entry.append_entry.type);
+  EncodeFixed32(p + kRecordPreChkOffset, entry.pre_chk_all);
+  EncodeFixed32(p + kRecordChkThsOffset, entry.chk_ths);
+  EncodeFixed32(p + kRecordChkAllOffset, entry.chk_all);
+  memcpy(p + kRecordHeaderBytes, value.data(), value.size());
+
+  // crc 覆盖 crc 之后的整条记录
+  uint32_t crc = Crc32c(p + kRecordLenOffset,
+                        kRecordHeaderBytes - kRecordLenOffset + value.size());
+  EncodeFixed32(p, crc);
+}
+
+static void DecodeRecordMeta(const char *p, MetaValue &meta) {
+  meta.term = DecodeFixed64(p + kRecordTermOffset);
+  meta.type = static_cast<EntryType>(DecodeFixed32(p + kRecordTypeOffset));
+  meta.pre_chk_all = DecodeFixed32(p + kRecordPreChkOffset);
+  meta.chk_ths = DecodeFixed32(p + kRecordChkThsOffset);
+  meta.chk_all = DecodeFixed32(p + kRecordChkAllOffset);
+}
+
+static uint32_t LastChecksum(const Segment &seg) {
+  if (seg.Empty()) {
+    return seg.pre_chk_all;
+  }
+  return DecodeFixed32(seg.base + seg.offsets.back() + kRecordChkAllOffset);
+}
+
+static int32_t WriteAll(int fd, const char *data, int64_t size,
+                        int64_t offset) {
+  while (size > 0) {
+    ssize_t n = pwrite(fd, data, size, offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+Segment::Segment()
+    : fd(-1), first(0), pre_chk_all(0), end(0), capacity(0), base(nullptr) {}
+
+Segment::~Segment() {
+  if (base != nullptr) {
+    munmap(base, capacity);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+class SegmentLogReader final : public LogReader {
+ public:
+  explicit SegmentLogReader(SegmentLogStorage *storage) : storage_(storage) {}
+
+  int32_t Read(RaftIndex index, LogEntry &entry) override {
+    return storage_->Get(index, entry);
+  }
+
+ private:
+  SegmentLogStorage *storage_;
+};
+
+SegmentLogStorage::SegmentLogStorage(const std::string &path,
+                                     int64_t segment_bytes)
+    : path_(path),
+      segment_bytes_(segment_bytes),
+      truncated_(0),
+      first_(0),
+      last_(0) {}
+
+SegmentLogStorage::~SegmentLogStorage() {}
+
+int32_t SegmentLogStorage::Open(LogStorageState &state) {
+  std::error_code ec;
+  fs::create_directories(path_, ec);
+  if (ec) {
+    vraft_logger.FError("create dir %s error, %s", path_.c_str(),
+                        ec.message().c_str());
+    assert(0);
+  }
+
+  int32_t rv = LoadTruncated();
+  assert(rv == 0);
+
+  // 文件名就是段里第一条日志的 index
+  std::map<RaftIndex, std::string> files;
+  for (auto &entry : fs::directory_iterator(path_)) {
+    std::string name = entry.path().filename().string();
+    size_t suffix_len = strlen(kSegmentSuffix);
+    if (name.size() <= suffix_len ||
+        name.compare(name.size() - suffix_len, suffix_len, kSegmentSuffix) !=
+            0) {
+      continue;
+    }
+    RaftIndex first = strtoul(name.c_str(), nullptr, 10);
+    files[first] = entry.path().string();
+  }
+
+  // 段之间必须首尾相接，断开之后的段是没写完的，删掉
+  bool broken = false;
+  for (auto &item : files) {
+    if (!broken && !segments_.empty() &&
+        item.first != segments_.rbegin()->second->Append()) {
+      broken = true;
+    }
+
+    SegmentSPtr seg;
+    if (!broken) {
+      seg = LoadSegment(item.second, item.first);
+    }
+    if (!seg) {
+      vraft_logger.FError("remove segment %s", item.second.c_str());
+      unlink(item.second.c_str());
+      broken = true;
+      continue;
+    }
+    segments_[item.first] = seg;
+  }
+
+  // 整段都在截断点之前的删掉，最后一段留着接着写
+  while (segments_.size() > 1 &&
+         segments_.begin()->second->Last() <= truncated_) {
+    RemoveSegment(segments_.begin()->second);
+    segments_.erase(segments_.begin());
+  }
+
+  if (segments_.empty()) {
+    NewSegment(truncated_ + 1, 0, segment_bytes_);
+  }
+  SetActive(segments_.rbegin()->second);
+  SyncDir();
+
+  state.append = active_->Append();
+  state.checksum = LastChecksum(*active_);
+  RaftIndex first = std::max(segments_.begin()->first, truncated_ + 1);
+  RaftIndex last = active_->Last();
+  if (first > last) {
+    state.first = 0;
+    state.last = 0;
+  } else {
+    state.first = first;
+    state.last = last;
+  }
+
+  first_ = state.first;
+  last_ = state.last;
+  return 0;
+}
+
+int32_t SegmentLogStorage::Append(const std::vector<LogEntryPtr> &entries,
+                                  bool sync) {
+  size_t i = 0;
+  while (i < entries.size()) {
+    Segment *seg = active_.get();
+
+    // 当前段放得下的一次写进去
+    std::string buf;
+    std::vector<int64_t> offsets;
+    size_t j = i;
+    for (; j < entries.size(); ++j) {
+      const LogEntry &entry = *entries[j];
+      assert(entry.index == seg->Append() + (j - i));
+      int64_t bytes = RecordBytes(entry);
+      if (seg->end + static_cast<int64_t>(buf.size()) + bytes >
+          seg->capacity) {
+        break;
+      }
+      offsets.push_back(seg->end + buf.size());
+      buf.resize(buf.size() + bytes);
+      EncodeRecord(&buf[buf.size() - bytes], entry);
+    }
+
+    if (j == i) {
+      // 一条都放不下，空段直接扩大，否则换新段
+      int64_t bytes = RecordBytes(*entries[i]);
+      if (seg->Empty()) {
+        int32_t rv = Grow(seg, seg->end + bytes);
+        assert(rv == 0);
+
+      } else {
+        // 老的段先落盘，之后 Sync 只管新段
+        if (fdatasync(seg->fd) != 0) {
+          vraft_logger.FError("fdatasync %s error, %s", seg->path.c_str(),
+                              strerror(errno));
+          assert(0);
+        }
+        int64_t capacity =
+            std::max(segment_bytes_, kSegmentHeaderBytes + bytes);
+        SegmentSPtr next =
+            NewSegment(seg->Append(), LastChecksum(*seg), capacity);
+        SetActive(next);
+      }
+      continue;
+    }
+
+    int32_t rv = WriteAll(seg->fd, buf.data(), buf.size(), seg->end);
+    if (rv != 0) {
+      vraft_logger.FError("write %s error, %s", seg->path.c_str(),
+                          strerror(errno));
+      assert(0);
+    }
+    seg->offsets.insert(seg->offsets.end(), offsets.begin(), offsets.end());
+    seg->end += buf.size();
+    i = j;
+  }
+
+  if (entries.size() > 0) {
+    if (first_ == 0) {
+      first_ = entries.front()->index;
+    }
+    last_ = entries.back()->index;
+  }
+
+  if (sync) {
+    return Sync();
+  }
+  return 0;
+}
+
+int32_t SegmentLogStorage::Sync() {
+  SegmentSPtr seg;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    seg = active_;
+  }
+
+  if (fdatasync(seg->fd) != 0) {
+    vraft_logger.FError("fdatasync %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+  return 0;
+}
+
+const char *SegmentLogStorage::Find(RaftIndex index) {
+  if (last_ == 0 || index < first_ || index > last_) {
+    return nullptr;
+  }
+
+  auto it = segments_.upper_bound(index);
+  assert(it != segments_.begin());
+  --it;
+  Segment *seg = it->second.get();
+  assert(index <= seg->Last());
+  return seg->base + seg->offsets[index - seg->first];
+}
+
+int32_t SegmentLogStorage::Get(RaftIndex index, LogEntry &entry) {
+  const char *p = Find(index);
+  if (p == nullptr) {
+    return -1;
+  }
+
+  MetaValue meta;
+  DecodeRecordMeta(p, meta);
+  uint32_t value_len = DecodeFixed32(p + kRecordLenOffset);
+
+  entry.index = index;
+  entry.pre_chk_all = meta.pre_chk_all;
+  entry.chk_ths = meta.chk_ths;
+  entry.chk_all = meta.chk_all;
+  entry.append_entry.term = meta.term;
+  entry.append_entry.type = meta.type;
+  entry.append_entry.value.assign(p + kRecordHeaderBytes, value_len);
+  return 0;
+}
+
+int32_t SegmentLogStorage::GetMeta(RaftIndex index, MetaValue &meta) {
+  const char *p = Find(index);
+  if (p == nullptr) {
+    return -1;
+  }
+  DecodeRecordMeta(p, meta);
+  return 0;
+}
+
+int32_t SegmentLogStorage::GetValue(RaftIndex index, std::string *value) {
+  const char *p = Find(index);
+  if (p == nullptr) {
+    return -1;
+  }
+  uint32_t value_len = DecodeFixed32(p + kRecordLenOffset);
+  value->assign(p + kRecordHeaderBytes, value_len);
+  return 0;
+}
+
+LogReaderUPtr SegmentLogStorage::NewReader(RaftIndex first) {
+  return std::make_unique<SegmentLogReader>(this);
+}
+
+// append and checksum follow from the records left
+int32_t SegmentLogStorage::DeleteFrom(RaftIndex from_index, RaftIndex append,
+                                      uint32_t checksum) {
+  if (last_ == 0 || from_index > last_) {
+    return 0;
+  }
+  if (from_index < first_) {
+    from_index = first_;
+  }
+
+  auto it = segments_.upper_bound(from_index);
+  assert(it != segments_.begin());
+  --it;
+  SegmentSPtr seg = it->second;
+
+  // 后面的段整个删掉，这一段从 from_index 截断
+  SetActive(seg);
+  for (auto later = std::next(it); later != segments_.end();) {
+    RemoveSegment(later->second);
+    later = segments_.erase(later);
+  }
+
+  int64_t offset = seg->offsets[from_index - seg->first];
+  if (ftruncate(seg->fd, offset) != 0 ||
+      posix_fallocate(seg->fd, offset, seg->capacity - offset) != 0 ||
+      fdatasync(seg->fd) != 0) {
+    vraft_logger.FError("truncate %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+  seg->offsets.resize(from_index - seg->first);
+  seg->end = offset;
+  SyncDir();
+
+  if (from_index == first_) {
+    first_ = 0;
+    last_ = 0;
+  } else {
+    last_ = from_index - 1;
+  }
+  return 0;
+}
+
+int32_t SegmentLogStorage::DeleteUtil(RaftIndex to_index, RaftIndex append,
+                                      uint32_t checksum) {
+  if (last_ == 0 || to_index < first_) {
+    return 0;
+  }
+  if (to_index > last_) {
+    to_index = last_;
+  }
+
+  // 先记下截断点，重启后不再读它之前的日志
+  int32_t rv = SaveTruncated(to_index);
+  assert(rv == 0);
+
+  if (to_index == last_) {
+    // 日志空了，从 append 开一个空段
+    if (!(active_->Empty() && active_->first == append)) {
+      SetActive(NewSegment(append, checksum, segment_bytes_));
+    }
+    for (auto it = segments_.begin(); it != segments_.end();) {
+      if (it->second == active_) {
+        ++it;
+      } else {
+        RemoveSegment(it->second);
+        it = segments_.erase(it);
+      }
+    }
+
+  } else {
+    while (segments_.begin()->second->Last() <= to_index) {
+      RemoveSegment(segments_.begin()->second);
+      segments_.erase(segments_.begin());
+    }
+  }
+  SyncDir();
+
+  if (to_index == last_) {
+    first_ = 0;
+    last_ = 0;
+  } else {
+    first_ = to_index + 1;
+  }
+  return 0;
+}
+
+nlohmann::json SegmentLogStorage::ToJson() {
+  nlohmann::json j;
+  j["type"] = "segment";
+  j["path"] = path_;
+  j["truncated"] = truncated_;
+  j["segments"] = segments_.size();
+  if (active_) {
+    j["active"] = active_->first;
+  }
+  return j;
+}
+
+SegmentSPtr SegmentLogStorage::NewSegment(RaftIndex first,
+                                          uint32_t pre_chk_all,
+                                          int64_t capacity) {
+  SegmentSPtr seg = std::make_shared<Segment>();
+  seg->path = SegmentFile(first);
+  seg->first = first;
+  seg->pre_chk_all = pre_chk_all;
+  seg->end = kSegmentHeaderBytes;
+  seg->capacity = capacity;
+
+  seg->fd = open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (seg->fd < 0) {
+    vraft_logger.FError("open %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+
+  // 预分配整个文件，追加时不改文件大小，fdatasync 不用刷元数据
+  char header[kSegmentHeaderBytes];
+  memset(header, 0, sizeof(header));
+  EncodeFixed32(header, kSegmentMagic);
+  EncodeFixed32(header + 4, kSegmentVersion);
+  EncodeFixed32(header + 8, first);
+  EncodeFixed32(header + 12, pre_chk_all);
+  if (posix_fallocate(seg->fd, 0, capacity) != 0 ||
+      WriteAll(seg->fd, header, sizeof(header), 0) != 0 ||
+      fsync(seg->fd) != 0) {
+    vraft_logger.FError("create %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+
+  void *base = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, seg->fd, 0);
+  if (base == MAP_FAILED) {
+    vraft_logger.FError("mmap %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+  seg->base = static_cast<char *>(base);
+
+  segments_[first] = seg;
+  SyncDir();
+  return seg;
+}
+
+// nullptr if the file is not a whole segment, the records are read until
+// the first bad one
+SegmentSPtr SegmentLogStorage::LoadSegment(const std::string &file,
+                                           RaftIndex first) {
+  SegmentSPtr seg = std::make_shared<Segment>();
+  seg->path = file;
+  seg->first = first;
+
+  seg->fd = open(file.c_str(), O_RDWR);
+  if (seg->fd < 0) {
+    vraft_logger.FError("open %s error, %s", file.c_str(), strerror(errno));
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(seg->fd, &st) != 0 || st.st_size < kSegmentHeaderBytes) {
+    return nullptr;
+  }
+  seg->capacity = st.st_size;
+
+  void *base = mmap(nullptr, seg->capacity, PROT_READ, MAP_SHARED, seg->fd, 0);
+  if (base == MAP_FAILED) {
+    vraft_logger.FError("mmap %s error, %s", file.c_str(), strerror(errno));
+    return nullptr;
+  }
+  seg->base = static_cast<char *>(base);
+
+  if (DecodeFixed32(seg->base) != kSegmentMagic ||
+      DecodeFixed32(seg->base + 4) != kSegmentVersion ||
+      DecodeFixed32(seg->base + 8) != first) {
+    return nullptr;
+  }
+  seg->pre_chk_all = DecodeFixed32(seg->base + 12);
+
+  // 预分配的部分是 0，crc 对不上就是结尾
+  int64_t offset = kSegmentHeaderBytes;
+  while (offset + kRecordHeaderBytes <= seg->capacity) {
+    char *p = seg->base + offset;
+    int64_t bytes = kRecordHeaderBytes + DecodeFixed32(p + kRecordLenOffset);
+    if (offset + bytes > seg->capacity) {
+      break;
+    }
+
+    uint32_t crc = Crc32c(p + kRecordLenOffset, bytes - kRecordLenOffset);
+    if (crc != DecodeFixed32(p) ||
+        DecodeFixed32(p + kRecordIndexOffset) != seg->Append()) {
+      break;
+    }
+    seg->offsets.push_back(offset);
+    offset += bytes;
+  }
+  seg->end = offset;
+  return seg;
+}
+
+int32_t SegmentLogStorage::Grow(Segment *seg, int64_t capacity) {
+  if (posix_fallocate(seg->fd, 0, capacity) != 0) {
+    vraft_logger.FError("fallocate %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    return -1;
+  }
+
+  void *base = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, seg->fd, 0);
+  if (base == MAP_FAILED) {
+    vraft_logger.FError("mmap %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+    return -1;
+  }
+  munmap(seg->base, seg->capacity);
+  seg->base = static_cast<char *>(base);
+  seg->capacity = capacity;
+  return 0;
+}
+
+// the file goes now, the fd closes with the last reference
+void SegmentLogStorage::RemoveSegment(const SegmentSPtr &seg) {
+  if (unlink(seg->path.c_str()) != 0) {
+    vraft_logger.FError("unlink %s error, %s", seg->path.c_str(),
+                        strerror(errno));
+  }
+}
+
+void SegmentLogStorage::SetActive(const SegmentSPtr &seg) {
+  std::lock_guard<std::mutex> lock(mu_);
+  active_ = seg;
+}
+
+std::string SegmentLogStorage::SegmentFile(RaftIndex first) const {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%010u%s", first, kSegmentSuffix);
+  return path_ + "/" + buf;
+}
+
+int32_t SegmentLogStorage::LoadTruncated() {
+  std::string file = path_ + "/" + kTruncatedFile;
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      truncated_ = 0;
+      return 0;
+    }
+    vraft_logger.FError("open %s error, %s", file.c_str(), strerror(errno));
+    return -1;
+  }
+
+  char buf[sizeof(RaftIndex) + sizeof(uint32_t)];
+  ssize_t n = pread(fd, buf, sizeof(buf), 0);
+  close(fd);
+  uint32_t crc = Crc32c(buf, sizeof(RaftIndex));
+  if (n != sizeof(buf) || crc != DecodeFixed32(buf + sizeof(RaftIndex))) {
+    vraft_logger.FError("bad truncated file %s", file.c_str());
+    return -1;
+  }
+  truncated_ = DecodeFixed32(buf);
+  return 0;
+}
+
+// write a tmp file then rename, the old value stays if crashed in between
+int32_t SegmentLogStorage::SaveTruncated(RaftIndex truncated) {
+  std::string file = path_ + "/" + kTruncatedFile;
+  std::string tmp_file = file + ".tmp";
+
+  char buf[sizeof(RaftIndex) + sizeof(uint32_t)];
+  EncodeFixed32(buf, truncated);
+  EncodeFixed32(buf + sizeof(RaftIndex), Crc32c(buf, sizeof(RaftIndex)));
+
+  int fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    vraft_logger.FError("open %s error, %s", tmp_file.c_str(),
+                        strerror(errno));
+    return -1;
+  }
+  int32_t rv = WriteAll(fd, buf, sizeof(buf), 0);
+  if (rv == 0) {
+    rv = fsync(fd);
+  }
+  close(fd);
+  if (rv != 0 || rename(tmp_file.c_str(), file.c_str()) != 0) {
+    vraft_logger.FError("save %s error, %s", file.c_str(), strerror(errno));
+    return -1;
+  }
+  SyncDir();
+
+  truncated_ = truncated;
+  return 0;
+}
+
+void SegmentLogStorage::SyncDir() {
+  int fd = open(path_.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0 || fsync(fd) != 0) {
+    vraft_logger.FError("fsync dir %s error, %s", path_.c_str(),
+                        strerror(errno));
+    assert(0);
+  }
+  close(fd);
+}
+
+}  // namespace vraft
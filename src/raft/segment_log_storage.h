@@ -0,0 +1,108 @@
+#ifndef VRAFT_SEGMENT_LOG_STORAGE_H_
+#define VRAFT_SEGMENT_LOG_STORAGE_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "log_storage.h"
+
+namespace vraft {
+
+// size a segment file is preallocated to
+const int64_t kSegmentBytes = 64 * 1024 * 1024;
+
+const uint32_t kSegmentMagic = 0x56534547;  // "VSEG"
+const uint32_t kSegmentVersion = 1;
+
+// magic(4) version(4) first(4) pre_chk_all(4) reserved(16)
+const int32_t kSegmentHeaderBytes = 32;
+
+// crc(4) value_len(4) index(4) term(8) type(4) pre_chk_all(4) chk_ths(4)
+// chk_all(4), then the value, crc covers the rest of the record
+const int32_t kRecordHeaderBytes = 36;
+
+// A preallocated file of records [first, first + offsets.size()), named
+// by its first index. The file is mapped for reads.
+struct Segment {
+  Segment();
+  ~Segment();
+  Segment(const Segment &t) = delete;
+  Segment &operator=(const Segment &t) = delete;
+
+  RaftIndex Append() const { return first + offsets.size(); }
+  RaftIndex Last() const { return Append() - 1; }
+  bool Empty() const { return offsets.empty(); }
+
+  std::string path;
+  int fd;
+  RaftIndex first;
+  uint32_t pre_chk_all;          // chk_all of first - 1
+  std::vector<int64_t> offsets;  // offsets[i] is the record of first + i
+  int64_t end;                   // end of the last record
+  int64_t capacity;              // file size
+  char *base;                    // mapped [0, capacity)
+};
+
+using SegmentSPtr = std::shared_ptr<Segment>;
+
+// Appends go to the last segment (active), one write for a batch. Suffix
+// truncation cuts the segment file, prefix truncation removes whole
+// segments and persists the truncation point, entries before it are
+// never read again.
+class SegmentLogStorage final : public LogStorage {
+ public:
+  SegmentLogStorage(const std::string &path, int64_t segment_bytes);
+  ~SegmentLogStorage();
+
+  int32_t Open(LogStorageState &state) override;
+  int32_t Append(const std::vector<LogEntryPtr> &entries, bool sync) override;
+  int32_t Sync() override;
+
+  int32_t GetMeta(RaftIndex index, MetaValue &meta) override;
+  int32_t GetValue(RaftIndex index, std::string *value) override;
+  LogReaderUPtr NewReader(RaftIndex first) override;
+
+  int32_t DeleteFrom(RaftIndex from_index, RaftIndex append,
+                     uint32_t checksum) override;
+  int32_t DeleteUtil(RaftIndex to_index, RaftIndex append,
+                     uint32_t checksum) override;
+
+  nlohmann::json ToJson() override;
+
+  int32_t Get(RaftIndex index, LogEntry &entry);
+
+ private:
+  // record of index, nullptr if not in the log
+  const char *Find(RaftIndex index);
+
+  SegmentSPtr NewSegment(RaftIndex first, uint32_t pre_chk_all,
+                         int64_t capacity);
+  SegmentSPtr LoadSegment(const std::string &file, RaftIndex first);
+  int32_t Grow(Segment *seg, int64_t capacity);
+  void RemoveSegment(const SegmentSPtr &seg);
+  void SetActive(const SegmentSPtr &seg);
+
+  std::string SegmentFile(RaftIndex first) const;
+  int32_t LoadTruncated();
+  int32_t SaveTruncated(RaftIndex truncated);
+  void SyncDir();
+
+ private:
+  std::string path_;
+  int64_t segment_bytes_;
+
+  std::map<RaftIndex, SegmentSPtr> segments_;  // first index -> segment
+  SegmentSPtr active_;
+  std::mutex mu_;  // guards active_, Sync runs in another thread
+
+  RaftIndex truncated_;  // entries <= truncated_ are deleted
+  RaftIndex first_;
+  RaftIndex last_;
+};
+
+}  // namespace vraft
+
+#endif
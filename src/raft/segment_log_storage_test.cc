@@ -0,0 +1,302 @@
+#include "segment_log_storage.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+const std::string kTestDir = "/tmp/segment_log_storage_test";
+
+// 每个段只放得下几条记录，测试里会换很多段
+const int64_t kTestSegmentBytes = 4096;
+const int32_t kValueBytes = 1000;
+
+static uint32_t TestChecksum(vraft::RaftIndex index) {
+  return index * 2654435761u;
+}
+
+static std::vector<vraft::LogEntryPtr> NewEntries(vraft::RaftIndex first,
+                                                  vraft::RaftIndex last,
+                                                  char fill = 'a') {
+  std::vector<vraft::LogEntryPtr> entries;
+  for (vraft::RaftIndex i = first; i <= last; ++i) {
+    auto entry = std::make_shared<vraft::LogEntry>();
+    entry->index = i;
+    entry->append_entry.term = 1 + i / 10;
+    entry->append_entry.type = vraft::kData;
+    entry->append_entry.value = std::string(kValueBytes, fill + i % 26);
+    entry->pre_chk_all = TestChecksum(i - 1);
+    entry->chk_ths = i;
+    entry->chk_all = TestChecksum(i);
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+static void CheckEntry(vraft::SegmentLogStorage &storage,
+                       vraft::RaftIndex index, char fill = 'a') {
+  vraft::LogEntry entry;
+  ASSERT_EQ(0, storage.Get(index, entry));
+  EXPECT_EQ(index, entry.index);
+  EXPECT_EQ(1 + index / 10, entry.append_entry.term);
+  EXPECT_EQ(vraft::kData, entry.append_entry.type);
+  EXPECT_EQ(std::string(kValueBytes, fill + index % 26),
+            entry.append_entry.value);
+  EXPECT_EQ(TestChecksum(index - 1), entry.pre_chk_all);
+  EXPECT_EQ(TestChecksum(index), entry.chk_all);
+}
+
+static int32_t SegmentCount(vraft::SegmentLogStorage &storage) {
+  return storage.ToJson()["segments"].get<int32_t>();
+}
+
+// 段文件名是第一条日志的 index
+static std::string SegmentFile(vraft::RaftIndex first) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%010u.seg", first);
+  return kTestDir + "/" + buf;
+}
+
+// 写满一段换新段，重启后所有段都能读到
+TEST(SegmentLogStorageTest, RollOver) {
+  fs::remove_all(kTestDir);
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(0u, state.first);
+    EXPECT_EQ(0u, state.last);
+    EXPECT_EQ(1u, state.append);
+
+    // 单条追加和一次写多段的批量追加
+    for (vraft::RaftIndex i = 1; i <= 10; ++i) {
+      ASSERT_EQ(0, storage.Append(NewEntries(i, i), false));
+    }
+    ASSERT_EQ(0, storage.Append(NewEntries(11, 30), true));
+    EXPECT_LT(1, SegmentCount(storage));
+
+    for (vraft::RaftIndex i = 1; i <= 30; ++i) {
+      CheckEntry(storage, i);
+    }
+    vraft::LogEntry entry;
+    EXPECT_EQ(-1, storage.Get(31, entry));
+  }
+
+  vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+  vraft::LogStorageState state;
+  ASSERT_EQ(0, storage.Open(state));
+  EXPECT_EQ(1u, state.first);
+  EXPECT_EQ(30u, state.last);
+  EXPECT_EQ(31u, state.append);
+  EXPECT_EQ(TestChecksum(30), state.checksum);
+  EXPECT_LT(1, SegmentCount(storage));
+
+  vraft::LogReaderUPtr reader = storage.NewReader(1);
+  for (vraft::RaftIndex i = 1; i <= 30; ++i) {
+    vraft::LogEntry entry;
+    ASSERT_EQ(0, reader->Read(i, entry));
+    EXPECT_EQ(i, entry.index);
+  }
+
+  vraft::MetaValue meta;
+  ASSERT_EQ(0, storage.GetMeta(17, meta));
+  EXPECT_EQ(2u, meta.term);
+  EXPECT_EQ(TestChecksum(17), meta.chk_all);
+  std::string value;
+  ASSERT_EQ(0, storage.GetValue(17, &value));
+  EXPECT_EQ(std::string(kValueBytes, 'a' + 17 % 26), value);
+}
+
+// 记录只写了一半，重启后丢掉它和之后的段，接着写
+TEST(SegmentLogStorageTest, TruncatedTail) {
+  fs::remove_all(kTestDir);
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    ASSERT_EQ(0, storage.Append(NewEntries(1, 10), true));
+  }
+
+  // 一段放 3 条记录，段是 [1, 3] [4, 6] [7, 9] [10]，截断 9
+  int64_t record_bytes = vraft::kRecordHeaderBytes + kValueBytes;
+  std::string file = SegmentFile(7);
+  ASSERT_TRUE(fs::exists(file));
+  ASSERT_EQ(0, truncate(file.c_str(), vraft::kSegmentHeaderBytes +
+                                          record_bytes * 2 + record_bytes / 2));
+
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(1u, state.first);
+    EXPECT_EQ(8u, state.last);
+    EXPECT_EQ(9u, state.append);
+    EXPECT_EQ(TestChecksum(8), state.checksum);
+    EXPECT_FALSE(fs::exists(SegmentFile(10)));
+    vraft::LogEntry entry;
+    EXPECT_EQ(-1, storage.Get(9, entry));
+
+    ASSERT_EQ(0, storage.Append(NewEntries(9, 12), true));
+  }
+
+  vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+  vraft::LogStorageState state;
+  ASSERT_EQ(0, storage.Open(state));
+  EXPECT_EQ(12u, state.last);
+  for (vraft::RaftIndex i = 1; i <= 12; ++i) {
+    CheckEntry(storage, i);
+  }
+}
+
+// 最后一条记录 crc 对不上，重启后丢掉它，重写的记录能读到
+TEST(SegmentLogStorageTest, CorruptTail) {
+  fs::remove_all(kTestDir);
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    ASSERT_EQ(0, storage.Append(NewEntries(1, 3), true));
+  }
+
+  // 改掉 3 的 value 中间的一个字节
+  int64_t record_bytes = vraft::kRecordHeaderBytes + kValueBytes;
+  int64_t offset = vraft::kSegmentHeaderBytes + record_bytes * 2 +
+                   vraft::kRecordHeaderBytes + kValueBytes / 2;
+  int fd = open(SegmentFile(1).c_str(), O_RDWR);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(1, pwrite(fd, "#", 1, offset));
+  close(fd);
+
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(1u, state.first);
+    EXPECT_EQ(2u, state.last);
+    EXPECT_EQ(3u, state.append);
+    EXPECT_EQ(TestChecksum(2), state.checksum);
+
+    ASSERT_EQ(0, storage.Append(NewEntries(3, 3, 'A'), true));
+  }
+
+  vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+  vraft::LogStorageState state;
+  ASSERT_EQ(0, storage.Open(state));
+  EXPECT_EQ(3u, state.last);
+  CheckEntry(storage, 2);
+  CheckEntry(storage, 3, 'A');
+}
+
+// 从中间一段截掉后缀，后面的段被删掉，重启后接着截断点写
+TEST(SegmentLogStorageTest, DeleteFrom) {
+  fs::remove_all(kTestDir);
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    ASSERT_EQ(0, storage.Append(NewEntries(1, 30), true));
+    int32_t segments = SegmentCount(storage);
+
+    // 段是 [1, 3] [4, 6] ...，5 在第二段中间
+    ASSERT_EQ(0, storage.DeleteFrom(5, 5, TestChecksum(4)));
+    EXPECT_EQ(2, SegmentCount(storage));
+    EXPECT_LT(2, segments);
+    EXPECT_FALSE(fs::exists(SegmentFile(7)));
+    CheckEntry(storage, 4);
+    vraft::LogEntry entry;
+    EXPECT_EQ(-1, storage.Get(5, entry));
+
+    ASSERT_EQ(0, storage.Append(NewEntries(5, 8, 'A'), true));
+  }
+
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(1u, state.first);
+    EXPECT_EQ(8u, state.last);
+    EXPECT_EQ(TestChecksum(8), state.checksum);
+    CheckEntry(storage, 4);
+    for (vraft::RaftIndex i = 5; i <= 8; ++i) {
+      CheckEntry(storage, i, 'A');
+    }
+
+    // 从第一条删掉，日志空了，重启后从 1 开始写
+    ASSERT_EQ(0, storage.DeleteFrom(1, 1, 0));
+    EXPECT_EQ(1, SegmentCount(storage));
+  }
+
+  vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+  vraft::LogStorageState state;
+  ASSERT_EQ(0, storage.Open(state));
+  EXPECT_EQ(0u, state.first);
+  EXPECT_EQ(0u, state.last);
+  EXPECT_EQ(1u, state.append);
+  EXPECT_EQ(0u, state.checksum);
+}
+
+// 截掉前缀，整段在截断点之前的被删掉，重启后截断点之前的读不到
+TEST(SegmentLogStorageTest, DeleteUtil) {
+  fs::remove_all(kTestDir);
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    ASSERT_EQ(0, storage.Append(NewEntries(1, 30), true));
+    int32_t segments = SegmentCount(storage);
+
+    // 段是 [1, 3] [4, 6] ...，8 所在的段留下
+    ASSERT_EQ(0, storage.DeleteUtil(8, 31, TestChecksum(30)));
+    EXPECT_EQ(segments - 2, SegmentCount(storage));
+    EXPECT_FALSE(fs::exists(SegmentFile(1)));
+    EXPECT_FALSE(fs::exists(SegmentFile(4)));
+    EXPECT_TRUE(fs::exists(SegmentFile(7)));
+    vraft::LogEntry entry;
+    EXPECT_EQ(-1, storage.Get(7, entry));
+    EXPECT_EQ(-1, storage.Get(8, entry));
+    CheckEntry(storage, 9);
+  }
+
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(9u, state.first);
+    EXPECT_EQ(30u, state.last);
+    EXPECT_EQ(31u, state.append);
+    vraft::LogEntry entry;
+    EXPECT_EQ(-1, storage.Get(8, entry));
+    for (vraft::RaftIndex i = 9; i <= 30; ++i) {
+      CheckEntry(storage, i);
+    }
+
+    // 全部删掉，append 和 checksum 留给下次 Open
+    ASSERT_EQ(0, storage.DeleteUtil(30, 31, TestChecksum(30)));
+    EXPECT_EQ(1, SegmentCount(storage));
+  }
+
+  {
+    vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+    vraft::LogStorageState state;
+    ASSERT_EQ(0, storage.Open(state));
+    EXPECT_EQ(0u, state.first);
+    EXPECT_EQ(0u, state.last);
+    EXPECT_EQ(31u, state.append);
+    EXPECT_EQ(TestChecksum(30), state.checksum);
+    ASSERT_EQ(0, storage.Append(NewEntries(31, 40), true));
+  }
+
+  vraft::SegmentLogStorage storage(kTestDir, kTestSegmentBytes);
+  vraft::LogStorageState state;
+  ASSERT_EQ(0, storage.Open(state));
+  EXPECT_EQ(31u, state.first);
+  EXPECT_EQ(40u, state.last);
+  for (vraft::RaftIndex i = 31; i <= 40; ++i) {
+    CheckEntry(storage, i);
+  }
+}
@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include "common.h"
 #include "nlohmann/json.hpp"
@@ -22,10 +23,20 @@ class StateMachine {
   StateMachine &operator=(const StateMachine &t) = delete;
 
   virtual int32_t Restore() = 0;
+  // entry may be shared with the log cache, do not modify it
   virtual int32_t Apply(LogEntry *entry, RaftAddr addr) = 0;
+  // called once after each round of Apply, the applied entries and
+  // LastIndex must be durable when it returns
+  virtual int32_t Flush() { return 0; }
   virtual RaftIndex LastIndex() = 0;
   virtual RaftTerm LastTerm() = 0;
 
+  // read a key for kCmdGet, 0: found, -2: not found, -1: error or not a
+  // key-value state machine
+  virtual int32_t Get(const std::string &key, std::string &value) {
+    return -1;
+  }
+
   virtual nlohmann::json ToJson() {
     nlohmann::json j;
     return j;
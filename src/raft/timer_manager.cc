@@ -7,6 +7,7 @@ void TimerManager::MakeTimer() {
   MakeElection();
   MakeElectionPpc();
   MakeHeartbeat();
+  MakePropose();
 }
 
 void TimerManager::MakeTick() {
@@ -31,6 +32,17 @@ void TimerManager::MakeElection() {
   election_ = maketimer_func_(param);
 }
 
+void TimerManager::MakePropose() {
+  assert(maketimer_func_);
+  TimerParam param;
+  param.timeout_ms = 0;
+  param.repeat_ms = 0;
+  param.cb = propose_func_;
+  param.data = data_;
+  param.name = "propose-timer";
+  propose_ = maketimer_func_(param);
+}
+
 void TimerManager::AddRpcTimer(const RaftAddr &dest, TimerSPtr sptr) {
   auto it = request_votes_.find(dest.ToU64());
   assert(it == request_votes_.end());
@@ -193,11 +205,15 @@ void TimerManager::AgainHeartBeat(uint64_t addr) {
   }
 }
 
+// 超时 0 毫秒，本轮事件循环里的提案在下一轮一起处理
+void TimerManager::StartPropose() { propose_->Again(0, 0); }
+
 void TimerManager::Stop() {
   StopTick();
   StopElection();
   StopRequestVote();
   StopHeartBeat();
+  StopPropose();
 }
 
 void TimerManager::StopTick() { tick_->Stop(); }
@@ -238,11 +254,14 @@ void TimerManager::StopHeartBeat(uint64_t addr) {
   }
 }
 
+void TimerManager::StopPropose() { propose_->Stop(); }
+
 void TimerManager::Close() {
   CloseTick();
   CloseElection();
   CloseRequestVote();
   CloseHeartBeat();
+  ClosePropose();
 }
 
 void TimerManager::CloseTick() { tick_->Close(); }
@@ -283,4 +302,6 @@ void TimerManager::CloseHeartBeat(uint64_t addr) {
   }
 }
 
+void TimerManager::ClosePropose() { propose_->Close(); }
+
 }  // namespace vraft
@@ -25,6 +25,7 @@ class TimerManager final {
   void MakeElection();
   void MakeElectionPpc();
   void MakeHeartbeat();
+  void MakePropose();
 
   void StartTick();
   void StartElection();
@@ -35,6 +36,7 @@ class TimerManager final {
   void StartHeartBeat(uint64_t addr);
   void AgainHeartBeat();
   void AgainHeartBeat(uint64_t addr);
+  void StartPropose();
 
   void Stop();
   void StopTick();
@@ -43,6 +45,7 @@ class TimerManager final {
   void StopRequestVote(uint64_t addr);
   void StopHeartBeat();
   void StopHeartBeat(uint64_t addr);
+  void StopPropose();
 
   void Close();
   void CloseTick();
@@ -51,12 +54,14 @@ class TimerManager final {
   void CloseRequestVote(uint64_t addr);
   void CloseHeartBeat();
   void CloseHeartBeat(uint64_t addr);
+  void ClosePropose();
 
   void set_data(void *data);
   void set_tick_func(TimerFunctor func);
   void set_election_func(TimerFunctor func);
   void set_requestvote_func(TimerFunctor func);
   void set_heartbeat_func(TimerFunctor func);
+  void set_propose_func(TimerFunctor func);
   void set_maketimer_func(MakeTimerFunc func);
 
   TimerFunctor requestvote_func() const;
@@ -83,6 +88,7 @@ class TimerManager final {
   TimerSPtr election_;
   std::unordered_map<uint64_t, TimerSPtr> request_votes_;
   std::unordered_map<uint64_t, TimerSPtr> heartbeats_;
+  TimerSPtr propose_;  // one-shot, fires in the next loop iteration
 
   uint32_t tick_ms_;
   uint32_t election_ms_;
@@ -97,6 +103,7 @@ class TimerManager final {
   TimerFunctor election_func_;
   TimerFunctor requestvote_func_;
   TimerFunctor heartbeat_func_;
+  TimerFunctor propose_func_;
   MakeTimerFunc maketimer_func_;
 };
 
@@ -141,6 +148,10 @@ inline void TimerManager::set_heartbeat_func(TimerFunctor func) {
   heartbeat_func_ = func;
 }
 
+inline void TimerManager::set_propose_func(TimerFunctor func) {
+  propose_func_ = func;
+}
+
 inline void TimerManager::set_maketimer_func(MakeTimerFunc func) {
   maketimer_func_ = func;
 }
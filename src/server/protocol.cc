@@ -0,0 +1,54 @@
+#include "protocol.h"
+
+#include <cstring>
+
+namespace vectordb {
+
+namespace {
+
+// 长度按小端编码，与 vraft 的 fixed32 一致，不依赖 seda
+void EncodeFixed32(char *dst, uint32_t value) {
+  uint8_t bytes[4] = {
+      static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+      static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+  memcpy(dst, bytes, sizeof(bytes));
+}
+
+uint32_t DecodeFixed32(const char *src) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(src);
+  return static_cast<uint32_t>(bytes[0]) |
+         (static_cast<uint32_t>(bytes[1]) << 8) |
+         (static_cast<uint32_t>(bytes[2]) << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+}  // namespace
+
+void AppendFrame(const google::protobuf::Message &msg, std::string &out) {
+  size_t body_bytes = msg.ByteSizeLong();
+  size_t offset = out.size();
+  out.resize(offset + kFrameHeaderBytes + body_bytes);
+  EncodeFixed32(&out[offset], static_cast<uint32_t>(body_bytes));
+  msg.SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8_t *>(&out[offset + kFrameHeaderBytes]));
+}
+
+int32_t TakeFrame(const char *data, size_t size, int32_t max_frame_bytes,
+                  std::string &body) {
+  if (size < static_cast<size_t>(kFrameHeaderBytes)) {
+    return 0;
+  }
+  int32_t body_bytes = static_cast<int32_t>(DecodeFixed32(data));
+  if (body_bytes < 0 || body_bytes > max_frame_bytes) {
+    return -1;
+  }
+  if (size < static_cast<size_t>(kFrameHeaderBytes) + body_bytes) {
+    return 0;
+  }
+
+  // 拷贝出帧体，解析放到工作线程，不占用 I/O 线程
+  body.assign(data + kFrameHeaderBytes, body_bytes);
+  return kFrameHeaderBytes + body_bytes;
+}
+
+}  // namespace vectordb
@@ -0,0 +1,28 @@
+#ifndef VECTORDB_SERVER_PROTOCOL_H
+#define VECTORDB_SERVER_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "google/protobuf/message.h"
+
+namespace vectordb {
+
+// frame = fixed32 body length (little endian) + serialized vdb message
+const int32_t kFrameHeaderBytes = sizeof(int32_t);
+const int32_t kMaxFrameBytes = 64 * 1024 * 1024;
+
+// append msg to out as one frame
+void AppendFrame(const google::protobuf::Message &msg, std::string &out);
+
+// take the body of the first complete frame in [data, data + size)
+// return > 0: a frame is taken into body, the bytes it used
+// return 0: need more bytes
+// return -1: bad frame, body length < 0 or > max_frame_bytes
+int32_t TakeFrame(const char *data, size_t size, int32_t max_frame_bytes,
+                  std::string &body);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SERVER_PROTOCOL_H
@@ -0,0 +1,77 @@
+#include "protocol.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "vdb.pb.h"
+
+vdb::RequestBatch TestBatch() {
+  vdb::RequestBatch batch;
+  vdb::Request *request = batch.add_requests();
+  request->set_seq(7);
+  vdb::SearchRequest *search = request->mutable_search();
+  search->set_table("t");
+  search->set_k(10);
+  search->add_vector(1.5f);
+  search->add_vector(2.5f);
+  batch.add_requests()->set_seq(8);
+  return batch;
+}
+
+// 多帧连续写入，逐帧取出
+TEST(ProtocolTest, Pipelined) {
+  vdb::RequestBatch batch = TestBatch();
+  std::string frames;
+  vectordb::AppendFrame(batch, frames);
+  vectordb::AppendFrame(batch, frames);
+
+  size_t offset = 0;
+  std::string body;
+  for (int i = 0; i < 2; ++i) {
+    int32_t rv = vectordb::TakeFrame(frames.data() + offset,
+                                     frames.size() - offset,
+                                     vectordb::kMaxFrameBytes, body);
+    ASSERT_EQ(static_cast<int32_t>(frames.size() / 2), rv);
+    offset += rv;
+    vdb::RequestBatch parsed;
+    ASSERT_TRUE(parsed.ParseFromString(body));
+    ASSERT_EQ(2, parsed.requests_size());
+    EXPECT_EQ(7u, parsed.requests(0).seq());
+    EXPECT_EQ(10, parsed.requests(0).search().k());
+    EXPECT_EQ(8u, parsed.requests(1).seq());
+  }
+  EXPECT_EQ(0, vectordb::TakeFrame(frames.data() + offset,
+                                   frames.size() - offset,
+                                   vectordb::kMaxFrameBytes, body));
+}
+
+// 帧不完整时等待更多数据
+TEST(ProtocolTest, Partial) {
+  std::string frame;
+  vectordb::AppendFrame(TestBatch(), frame);
+
+  std::string body;
+  EXPECT_EQ(0, vectordb::TakeFrame(frame.data(), 2, vectordb::kMaxFrameBytes,
+                                   body));
+  EXPECT_EQ(0, vectordb::TakeFrame(frame.data(), frame.size() - 1,
+                                   vectordb::kMaxFrameBytes, body));
+  EXPECT_EQ(static_cast<int32_t>(frame.size()),
+            vectordb::TakeFrame(frame.data(), frame.size(),
+                                vectordb::kMaxFrameBytes, body));
+  EXPECT_EQ(frame.size() - vectordb::kFrameHeaderBytes, body.size());
+}
+
+// 超过上限的帧
+TEST(ProtocolTest, TooLarge) {
+  std::string frame;
+  vectordb::AppendFrame(TestBatch(), frame);
+
+  std::string body;
+  EXPECT_EQ(-1, vectordb::TakeFrame(frame.data(), frame.size(), 4, body));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,302 @@
+#include "vectordb_client.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <future>
+
+#include "logger.h"
+#include "protocol.h"
+
+namespace vectordb {
+
+VectordbClient::VectordbClient(const std::string &host, uint16_t port)
+    : connected_(false), next_seq_(1) {
+  loop_thread_ = std::make_shared<vraft::LoopThread>("vectordb-client", false);
+  vraft::EventLoopSPtr loop = loop_thread_->loop();
+  struct vraft::TcpOptions options;
+  client_ = std::make_shared<vraft::TcpClient>(
+      loop, "vectordb-client", vraft::HostPort(host, port), options);
+  client_->set_on_connection_cb(
+      std::bind(&VectordbClient::OnConnection, this, std::placeholders::_1));
+  client_->set_on_message_cb(std::bind(&VectordbClient::OnMessage, this,
+                                       std::placeholders::_1,
+                                       std::placeholders::_2));
+}
+
+VectordbClient::~VectordbClient() {}
+
+RetNo VectordbClient::Start(int32_t timeout_ms) {
+  int32_t rv = loop_thread_->Start();
+  assert(rv == 0);
+  loop_thread_->WaitStarted();
+  loop_thread_->RunFunctor([this]() { client_->Connect(); });
+
+  std::unique_lock<std::mutex> ulk(mu_);
+  bool ok = connected_cv_.wait_for(ulk, std::chrono::milliseconds(timeout_ms),
+                                   [this] { return connected_; });
+  return ok ? RET_OK : RET_TIMEOUT;
+}
+
+void VectordbClient::Stop() {
+  client_->Stop();
+  loop_thread_->Stop();
+  loop_thread_->Join();
+
+  // 循环已经停止，未返回的请求都按失败处理
+  std::vector<uint64_t> seqs;
+  {
+    std::unique_lock<std::mutex> ulk(mu_);
+    for (const auto &pair : pending_) {
+      seqs.push_back(pair.first);
+    }
+  }
+  Fail(seqs);
+}
+
+void VectordbClient::AsyncCall(vdb::Request request, const Callback &cb) {
+  std::vector<vdb::Request> requests(1);
+  requests[0].Swap(&request);
+  Send(requests, std::vector<Callback>{cb});
+}
+
+void VectordbClient::AsyncBatch(std::vector<vdb::Request> requests,
+                                const BatchCallback &cb) {
+  DoAsyncBatch(requests, cb);
+}
+
+std::vector<uint64_t> VectordbClient::DoAsyncBatch(
+    std::vector<vdb::Request> &requests, const BatchCallback &cb) {
+  if (requests.empty()) {
+    cb(std::vector<vdb::Response>());
+    return std::vector<uint64_t>();
+  }
+
+  // 回调都在 I/O 线程上执行，收齐后一起返回
+  struct BatchState {
+    std::vector<vdb::Response> responses;
+    size_t left;
+    BatchCallback cb;
+  };
+  auto state = std::make_shared<BatchState>();
+  state->responses.resize(requests.size());
+  state->left = requests.size();
+  state->cb = cb;
+
+  std::vector<Callback> callbacks;
+  callbacks.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    callbacks.push_back([state, i](const vdb::Response &response) {
+      state->responses[i] = response;
+      if (--state->left == 0) {
+        state->cb(state->responses);
+      }
+    });
+  }
+  return Send(requests, callbacks);
+}
+
+RetNo VectordbClient::Call(vdb::Request request, vdb::Response &response,
+                           int32_t timeout_ms) {
+  std::vector<vdb::Response> responses;
+  std::vector<vdb::Request> requests(1);
+  requests[0].Swap(&request);
+  RetNo ret = Batch(std::move(requests), responses, timeout_ms);
+  if (ret == RET_OK) {
+    response.Swap(&responses[0]);
+  }
+  return ret;
+}
+
+RetNo VectordbClient::Batch(std::vector<vdb::Request> requests,
+                            std::vector<vdb::Response> &responses,
+                            int32_t timeout_ms) {
+  auto promise = std::make_shared<std::promise<std::vector<vdb::Response>>>();
+  std::future<std::vector<vdb::Response>> future = promise->get_future();
+  std::vector<uint64_t> seqs = DoAsyncBatch(
+      requests, [promise](const std::vector<vdb::Response> &results) {
+        promise->set_value(results);
+      });
+
+  // 超时后撤销等待，之后到达的响应被丢弃
+  if (future.wait_for(std::chrono::milliseconds(timeout_ms)) !=
+      std::future_status::ready) {
+    std::unique_lock<std::mutex> ulk(mu_);
+    for (uint64_t seq : seqs) {
+      pending_.erase(seq);
+    }
+    return RET_TIMEOUT;
+  }
+  responses = future.get();
+  return RET_OK;
+}
+
+RetNo VectordbClient::Add(const std::string &table, int64_t id,
+                          const std::vector<float> &vector,
+                          const std::string &scalar) {
+  vdb::Request request;
+  vdb::AddRequest *add = request.mutable_add();
+  add->set_table(table);
+  add->set_id(id);
+  add->mutable_vector()->Add(vector.begin(), vector.end());
+  add->set_scalar(scalar);
+
+  vdb::Response response;
+  RetNo ret = Call(std::move(request), response);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  return static_cast<RetNo>(response.ret());
+}
+
+RetNo VectordbClient::Get(const std::string &table, int64_t id,
+                          std::vector<float> &vector, std::string &scalar) {
+  vdb::Request request;
+  vdb::GetRequest *get = request.mutable_get();
+  get->set_table(table);
+  get->set_id(id);
+
+  vdb::Response response;
+  RetNo ret = Call(std::move(request), response);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  vector.assign(response.get().vector().begin(),
+                response.get().vector().end());
+  scalar = response.get().scalar();
+  return static_cast<RetNo>(response.ret());
+}
+
+RetNo VectordbClient::Search(const std::string &table,
+                             const std::vector<float> &v, int32_t k,
+                             std::vector<int64_t> &ids,
+                             std::vector<float> &distances,
+                             std::vector<std::string> &scalars,
+                             const ROptions &options) {
+  vdb::Request request;
+  vdb::SearchRequest *search = request.mutable_search();
+  search->set_table(table);
+  search->mutable_vector()->Add(v.begin(), v.end());
+  search->set_k(k);
+  search->set_ef(options.ef);
+  search->set_rerank(options.rerank);
+
+  // 截止时间换算成剩余时间，已经过期的请求不再发送
+  int32_t timeout_ms = kDefaultCallTimeoutMs;
+  if (options.HasDeadline()) {
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+        options.deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      return RET_TIMEOUT;
+    }
+    search->set_timeout_us(left.count());
+    timeout_ms = static_cast<int32_t>(
+        std::min<int64_t>(timeout_ms, left.count() / 1000 + 1));
+  }
+
+  vdb::Response response;
+  RetNo ret = Call(std::move(request), response, timeout_ms);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  const vdb::SearchResponse &result = response.search();
+  ids.assign(result.ids().begin(), result.ids().end());
+  distances.assign(result.distances().begin(), result.distances().end());
+  scalars.assign(result.scalars().begin(), result.scalars().end());
+  return static_cast<RetNo>(response.ret());
+}
+
+void VectordbClient::OnConnection(const vraft::TcpConnectionSPtr &conn) {
+  logger->info("vectordb-client on connection: {}", conn->name());
+  {
+    std::unique_lock<std::mutex> ulk(mu_);
+    connected_ = true;
+  }
+  connected_cv_.notify_all();
+}
+
+void VectordbClient::OnMessage(const vraft::TcpConnectionSPtr &conn,
+                               vraft::Buffer *buf) {
+  std::string body;
+  while (true) {
+    int32_t rv =
+        TakeFrame(buf->Peek(), buf->ReadableBytes(), kMaxFrameBytes, body);
+    if (rv == 0) {
+      break;
+    }
+
+    vdb::ResponseBatch batch;
+    if (rv < 0 || !batch.ParseFromString(body)) {
+      logger->error("vectordb-client bad frame from {}", conn->name());
+      conn->Close();
+      return;
+    }
+    buf->Retrieve(rv);
+
+    for (const auto &response : batch.responses()) {
+      Callback cb;
+      {
+        std::unique_lock<std::mutex> ulk(mu_);
+        auto it = pending_.find(response.seq());
+        if (it == pending_.end()) {
+          // 已经超时撤销的请求
+          continue;
+        }
+        cb = std::move(it->second);
+        pending_.erase(it);
+      }
+      cb(response);
+    }
+  }
+}
+
+std::vector<uint64_t> VectordbClient::Send(
+    std::vector<vdb::Request> &requests,
+    const std::vector<Callback> &callbacks) {
+  assert(requests.size() == callbacks.size());
+  vdb::RequestBatch batch;
+  std::vector<uint64_t> seqs;
+  seqs.reserve(requests.size());
+  {
+    std::unique_lock<std::mutex> ulk(mu_);
+    for (size_t i = 0; i < requests.size(); ++i) {
+      uint64_t seq = next_seq_++;
+      requests[i].set_seq(seq);
+      pending_[seq] = callbacks[i];
+      seqs.push_back(seq);
+    }
+  }
+  for (auto &request : requests) {
+    batch.add_requests()->CopyFrom(request);
+  }
+
+  std::string frame;
+  AppendFrame(batch, frame);
+  loop_thread_->RunFunctor([this, frame, seqs]() {
+    if (client_->CopySend(frame.data(), frame.size()) != 0) {
+      Fail(seqs);
+    }
+  });
+  return seqs;
+}
+
+void VectordbClient::Fail(const std::vector<uint64_t> &seqs) {
+  for (uint64_t seq : seqs) {
+    Callback cb;
+    {
+      std::unique_lock<std::mutex> ulk(mu_);
+      auto it = pending_.find(seq);
+      if (it == pending_.end()) {
+        continue;
+      }
+      cb = std::move(it->second);
+      pending_.erase(it);
+    }
+    vdb::Response response;
+    response.set_seq(seq);
+    response.set_ret(RET_ERROR);
+    cb(response);
+  }
+}
+
+}  // namespace vectordb
@@ -0,0 +1,106 @@
+#ifndef VECTORDB_SERVER_VECTORDB_CLIENT_H
+#define VECTORDB_SERVER_VECTORDB_CLIENT_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "loop_thread.h"
+#include "options.h"
+#include "retno.h"
+#include "tcp_client.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+const int32_t kDefaultCallTimeoutMs = 10000;
+
+// Client of vectordb_server, runs the connection on its own event loop
+// thread and is safe to use from any thread.
+//
+// Calls are pipelined on one connection, the async ones return at once
+// and their callbacks run in the client loop thread (they must not block).
+// A batch is sent as one frame and executed by one server worker. The sync
+// calls wait for the async ones.
+class VectordbClient final {
+ public:
+  using Callback = std::function<void(const vdb::Response &response)>;
+  using BatchCallback =
+      std::function<void(const std::vector<vdb::Response> &responses)>;
+
+  VectordbClient(const std::string &host, uint16_t port);
+  ~VectordbClient();
+  VectordbClient(const VectordbClient &) = delete;
+  VectordbClient &operator=(const VectordbClient &) = delete;
+
+  // connect, RET_TIMEOUT if not connected in timeout_ms
+  RetNo Start(int32_t timeout_ms = kDefaultCallTimeoutMs);
+  void Stop();
+
+  // request.seq is assigned by the client, cb gets a response with
+  // ret RET_ERROR if the request could not be sent
+  void AsyncCall(vdb::Request request, const Callback &cb);
+
+  // responses[i] answers requests[i]
+  void AsyncBatch(std::vector<vdb::Request> requests, const BatchCallback &cb);
+
+  // RET_TIMEOUT if the response does not come in timeout_ms, otherwise
+  // response.ret() tells how the request went
+  RetNo Call(vdb::Request request, vdb::Response &response,
+             int32_t timeout_ms = kDefaultCallTimeoutMs);
+  RetNo Batch(std::vector<vdb::Request> requests,
+              std::vector<vdb::Response> &responses,
+              int32_t timeout_ms = kDefaultCallTimeoutMs);
+
+  RetNo Add(const std::string &table, int64_t id,
+            const std::vector<float> &vector, const std::string &scalar);
+
+  // input: id
+  // output: vector, scalar
+  RetNo Get(const std::string &table, int64_t id, std::vector<float> &vector,
+            std::string &scalar);
+
+  // input: v, k
+  // output: ids, distances, scalars
+  // options.ef, options.rerank and options.deadline are sent to the server
+  RetNo Search(const std::string &table, const std::vector<float> &v,
+               int32_t k, std::vector<int64_t> &ids,
+               std::vector<float> &distances, std::vector<std::string> &scalars,
+               const ROptions &options = ROptions());
+
+ private:
+  // in loop thread
+  void OnConnection(const vraft::TcpConnectionSPtr &conn);
+  void OnMessage(const vraft::TcpConnectionSPtr &conn, vraft::Buffer *buf);
+
+  // assign seqs to requests and send them as one frame, return the seqs
+  std::vector<uint64_t> DoAsyncBatch(std::vector<vdb::Request> &requests,
+                                     const BatchCallback &cb);
+
+  // register the callbacks and send the requests as one frame
+  std::vector<uint64_t> Send(std::vector<vdb::Request> &requests,
+                             const std::vector<Callback> &callbacks);
+
+  // answer the pending seqs with RET_ERROR
+  void Fail(const std::vector<uint64_t> &seqs);
+
+ private:
+  vraft::LoopThreadSPtr loop_thread_;
+  vraft::TcpClientSPtr client_;
+
+  std::mutex mu_;
+  std::condition_variable connected_cv_;
+  bool connected_;                                  // guarded by mu_
+  uint64_t next_seq_;                               // guarded by mu_
+  std::unordered_map<uint64_t, Callback> pending_;  // guarded by mu_
+};
+
+using VectordbClientSPtr = std::shared_ptr<VectordbClient>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SERVER_VECTORDB_CLIENT_H
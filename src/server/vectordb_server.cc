@@ -0,0 +1,189 @@
+#include "vectordb_server.h"
+
+#include <cassert>
+#include <functional>
+
+#include "logger.h"
+#include "protocol.h"
+#include "search_context.h"
+
+namespace vectordb {
+
+VectordbServer::VectordbServer(vraft::EventLoopSPtr &loop, Vectordb &db,
+                               const ServerParam &param)
+    : param_(param),
+      db_(db),
+      loop_(loop),
+      workers_("vectordb-worker", param.worker_num),
+      next_worker_(0) {
+  Init();
+}
+
+VectordbServer::~VectordbServer() {}
+
+void VectordbServer::OnConnection(const vraft::TcpConnectionSPtr &conn) {
+  logger->info("vectordb-server on connection: {}", conn->name());
+}
+
+void VectordbServer::OnMessage(const vraft::TcpConnectionSPtr &conn,
+                               vraft::Buffer *buf) {
+  // 请求的超时从收到时开始计算，在工作线程排队的时间也算在内
+  auto received = std::chrono::steady_clock::now();
+  std::string body;
+  while (true) {
+    int32_t rv = TakeFrame(buf->Peek(), buf->ReadableBytes(),
+                           param_.max_frame_bytes, body);
+    if (rv == 0) {
+      break;
+    }
+    if (rv < 0) {
+      logger->warn("vectordb-server bad frame from {}, close it",
+                   conn->name());
+      conn->Close();
+      return;
+    }
+    buf->Retrieve(rv);
+
+    // 每帧轮转分给一个工作线程，同一连接流水线上的多帧并发执行
+    vraft::TcpConnectionSPtr c = conn;
+    workers_.Push(next_worker_.fetch_add(1),
+                  [this, c, body, received]() { Execute(c, body, received); });
+  }
+}
+
+int32_t VectordbServer::Start() {
+  int32_t rv = workers_.Start();
+  assert(rv == 0);
+
+  rv = server_->Start();
+  assert(rv == 0);
+
+  logger->info("vectordb-server start, {}:{}, workers: {}", param_.host,
+               param_.port, param_.worker_num);
+  return rv;
+}
+
+void VectordbServer::Stop() {
+  server_->Stop();
+  workers_.Stop();
+  workers_.Join();
+}
+
+void VectordbServer::Init() {
+  struct vraft::TcpOptions options;
+  auto sptr = loop_.lock();
+  assert(sptr);
+  server_ = std::make_shared<vraft::TcpServer>(
+      sptr, "vectordb-server", vraft::HostPort(param_.host, param_.port),
+      options);
+
+  server_->set_on_connection_cb(
+      std::bind(&VectordbServer::OnConnection, this, std::placeholders::_1));
+  server_->set_on_message_cb(std::bind(&VectordbServer::OnMessage, this,
+                                       std::placeholders::_1,
+                                       std::placeholders::_2));
+}
+
+void VectordbServer::Execute(
+    const vraft::TcpConnectionSPtr &conn, const std::string &body,
+    std::chrono::steady_clock::time_point received) {
+  vdb::RequestBatch batch;
+  if (!batch.ParseFromString(body)) {
+    logger->warn("vectordb-server parse request failed, close {}",
+                 conn->name());
+    auto sptr = loop_.lock();
+    if (sptr) {
+      sptr->RunFunctor([conn]() { conn->Close(); });
+    }
+    return;
+  }
+
+  // 一帧内的请求依次执行，响应合成一帧写回
+  vdb::ResponseBatch responses;
+  for (const auto &request : batch.requests()) {
+    DoRequest(request, *responses.add_responses(), received);
+  }
+
+  std::string frame;
+  AppendFrame(responses, frame);
+  Reply(conn, std::move(frame));
+}
+
+void VectordbServer::DoRequest(
+    const vdb::Request &request, vdb::Response &response,
+    std::chrono::steady_clock::time_point received) {
+  response.set_seq(request.seq());
+  switch (request.body_case()) {
+    case vdb::Request::kAdd: {
+      const vdb::AddRequest &add = request.add();
+      std::vector<float> vector(add.vector().begin(), add.vector().end());
+      response.set_ret(db_.Add(add.table(), add.id(), vector, add.scalar()));
+      break;
+    }
+
+    case vdb::Request::kGet: {
+      const vdb::GetRequest &get = request.get();
+      std::vector<float> vector;
+      std::string scalar;
+      RetNo ret = db_.Get(get.table(), get.id(), vector, scalar);
+      response.set_ret(ret);
+      if (ret == RET_OK) {
+        vdb::GetResponse *result = response.mutable_get();
+        result->mutable_vector()->Add(vector.begin(), vector.end());
+        result->set_scalar(std::move(scalar));
+      }
+      break;
+    }
+
+    case vdb::Request::kSearch: {
+      const vdb::SearchRequest &search = request.search();
+      ROptions options;
+      options.ef = search.ef();
+      options.rerank = search.rerank();
+      if (search.timeout_us() > 0) {
+        options.deadline =
+            received + std::chrono::microseconds(search.timeout_us());
+      }
+
+      // 每个工作线程复用查询向量和 context
+      thread_local std::vector<float> query;
+      thread_local SearchContext ctx;
+      query.assign(search.vector().begin(), search.vector().end());
+      RetNo ret = db_.Search(search.table(), query, search.k(), ctx, options);
+      response.set_ret(ret);
+      if (ret == RET_OK || ret == RET_PARTIAL) {
+        vdb::SearchResponse *result = response.mutable_search();
+        result->mutable_ids()->Add(ctx.ids.begin(), ctx.ids.end());
+        result->mutable_distances()->Add(ctx.distances.begin(),
+                                         ctx.distances.end());
+        for (size_t i = 0; i < ctx.size(); ++i) {
+          result->add_scalars(ctx.scalars[i].data(), ctx.scalars[i].size());
+        }
+      }
+      ctx.Reset();
+      break;
+    }
+
+    default: {
+      response.set_ret(RET_ERROR);
+      break;
+    }
+  }
+}
+
+void VectordbServer::Reply(const vraft::TcpConnectionSPtr &conn,
+                           std::string frame) {
+  auto sptr = loop_.lock();
+  if (!sptr) {
+    return;
+  }
+
+  // 连接只能在 I/O 线程上写，等待期间连接可能已经关闭
+  sptr->RunFunctor([conn, frame]() {
+    if (conn->Connected()) {
+      conn->CopySend(frame.data(), frame.size());
+    }
+  });
+}
+
+}  // namespace vectordb
@@ -0,0 +1,72 @@
+#ifndef VECTORDB_SERVER_VECTORDB_SERVER_H
+#define VECTORDB_SERVER_VECTORDB_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "eventloop.h"
+#include "protocol.h"
+#include "tcp_server.h"
+#include "vdb.pb.h"
+#include "vectordb.h"
+#include "work_thread.h"
+
+namespace vectordb {
+
+struct ServerParam {
+  std::string host = "127.0.0.1";
+  uint16_t port = 9900;
+  int32_t worker_num = 8;
+  int32_t max_frame_bytes = kMaxFrameBytes;
+};
+
+// Serves a Vectordb over tcp, see the protocol in vdb.proto.
+//
+// The event loop only cuts frames out of the connection buffers, every
+// frame (a RequestBatch) is handed to a worker thread which parses and
+// executes it and posts the ResponseBatch back to the loop. A connection
+// may pipeline any number of frames, they run concurrently on different
+// workers and responses are matched by seq.
+class VectordbServer final {
+ public:
+  VectordbServer(vraft::EventLoopSPtr &loop, Vectordb &db,
+                 const ServerParam &param);
+  ~VectordbServer();
+  VectordbServer(const VectordbServer &) = delete;
+  VectordbServer &operator=(const VectordbServer &) = delete;
+
+  // call back, in loop thread
+  void OnConnection(const vraft::TcpConnectionSPtr &conn);
+  void OnMessage(const vraft::TcpConnectionSPtr &conn, vraft::Buffer *buf);
+
+  // control
+  // call in loop thread
+  int32_t Start();
+  // call in any thread
+  void Stop();
+
+ private:
+  void Init();
+
+  // in worker thread
+  void Execute(const vraft::TcpConnectionSPtr &conn, const std::string &body,
+               std::chrono::steady_clock::time_point received);
+  void DoRequest(const vdb::Request &request, vdb::Response &response,
+                 std::chrono::steady_clock::time_point received);
+  void Reply(const vraft::TcpConnectionSPtr &conn, std::string frame);
+
+ private:
+  ServerParam param_;
+  Vectordb &db_;
+  vraft::EventLoopWPtr loop_;
+  vraft::TcpServerSPtr server_;
+
+  vraft::WorkThreadPool workers_;
+  std::atomic<uint64_t> next_worker_;
+};
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SERVER_VECTORDB_SERVER_H
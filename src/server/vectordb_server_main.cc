@@ -0,0 +1,42 @@
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+#include "eventloop.h"
+#include "vectordb.h"
+#include "vectordb_server.h"
+
+// usage: vectordb_server name path [host] [port] [worker_num]
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+              << " name path [host] [port] [worker_num]" << std::endl;
+    return 1;
+  }
+
+  vectordb::ServerParam param;
+  if (argc > 3) {
+    param.host = argv[3];
+  }
+  if (argc > 4) {
+    param.port = static_cast<uint16_t>(atoi(argv[4]));
+  }
+  if (argc > 5) {
+    param.worker_num = atoi(argv[5]);
+  }
+
+  vectordb::Vectordb db(argv[1], argv[2]);
+
+  // I/O 在主线程的事件循环上，请求在工作线程上执行
+  vraft::EventLoopSPtr loop =
+      std::make_shared<vraft::EventLoop>("vectordb-server");
+  int32_t rv = loop->Init();
+  if (rv != 0) {
+    std::cerr << "init event loop failed" << std::endl;
+    return 1;
+  }
+  vectordb::VectordbServer server(loop, db, param);
+  loop->RunFunctor(std::bind(&vectordb::VectordbServer::Start, &server));
+  loop->Loop();
+  return 0;
+}
@@ -0,0 +1,462 @@
+#include "vectordb_sm.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "raft.h"
+#include "raft_log.h"
+
+namespace vectordb {
+
+const std::string kVectordbSmName = "vectordb";
+
+// 快照中文件名的长度上限，超过说明数据已经错乱
+const uint32_t kMaxSnapshotNameBytes = 4096;
+
+namespace {
+
+// 快照头按小端编码，与 vraft 的 fixed32/fixed64 一致
+void EncodeFixed(char *dst, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    dst[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+uint64_t DecodeFixed(const char *src, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; ++i) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(src[i])) << (8 * i);
+  }
+  return value;
+}
+
+// 写入并 fsync 文件，改名后再 fsync 目录，改名本身也要落盘
+bool WriteFileSync(const std::string &file, const std::string &data) {
+  std::string tmp_file = file + ".tmp";
+  int fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      close(fd);
+      return false;
+    }
+    written += n;
+  }
+  bool ok = fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  if (!ok || std::rename(tmp_file.c_str(), file.c_str()) != 0) {
+    return false;
+  }
+
+  std::string dir = fs::path(file).parent_path().string();
+  fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+}  // namespace
+
+VectordbSm::VectordbSm(std::string path)
+    : vraft::StateMachine(path),
+      db_path_(path + "/db"),
+      apply_file_(path + "/apply"),
+      last_index_(0),
+      last_term_(0) {
+  Init();
+}
+
+VectordbSm::~VectordbSm() {}
+
+void VectordbSm::Init() {
+  db_ = std::make_shared<Vectordb>(kVectordbSmName, db_path_);
+  int32_t rv = LoadApply();
+  assert(rv == 0);
+}
+
+int32_t VectordbSm::Restore() { return LoadApply(); }
+
+int32_t VectordbSm::Apply(vraft::LogEntry *entry, vraft::RaftAddr addr) {
+  vdb::WriteBatch batch;
+  if (!batch.ParseFromString(entry->append_entry.value)) {
+    logger->error("vectordb-sm bad entry, index: {}", entry->index);
+    return -1;
+  }
+
+  // 每个副本对同一条日志得到同样的结果，单个操作失败（比如表不存在）
+  // 只记录下来，不影响同一批中后面的操作
+  for (int i = 0; i < batch.ops_size(); ++i) {
+    vdb::WriteOp &op = *batch.mutable_ops(i);
+    RetNo ret = DoApply(op);
+    if (ret != RET_OK) {
+      logger->warn("vectordb-sm apply op failed, index: {}, ret: {}",
+                   entry->index, RetNoToString(ret));
+    }
+  }
+
+  // 写入和应用点在 Flush 中一起落盘
+  last_index_ = entry->index;
+  last_term_ = entry->append_entry.term;
+  return 0;
+}
+
+int32_t VectordbSm::Flush() {
+  // 应用点落盘前写入必须先落盘，否则崩溃重启后会跳过丢失的写入。
+  // 一次 WAL fsync 包含这张表之前的所有写入。表在这一轮中被删除时
+  // 数据也一起删除了，不需要同步
+  for (const auto &table : unsynced_tables_) {
+    RetNo ret = db_->SyncWal(table);
+    if (ret != RET_OK && ret != RET_NOT_FOUND) {
+      logger->error("vectordb-sm sync table {} failed, ret: {}", table,
+                    RetNoToString(ret));
+      return -1;
+    }
+  }
+  unsynced_tables_.clear();
+
+  // 重放已经应用过的操作是幂等的，每轮只写一次应用点
+  return PersistApply(apply_file_);
+}
+
+RetNo VectordbSm::DoApply(vdb::WriteOp &op) {
+  switch (op.op_case()) {
+    case vdb::WriteOp::kAdd: {
+      const vdb::AddRequest &add = op.add();
+      std::vector<float> vector(add.vector().begin(), add.vector().end());
+
+      // 索引由每个副本在后台各自构建，不阻塞 raft 的循环
+      WOptions options;
+      options.async_index = true;
+      unsynced_tables_.insert(add.table());
+      return db_->Add(add.table(), add.id(), vector, add.scalar(), options);
+    }
+    case vdb::WriteOp::kCreateTable:
+      return db_->CreateTable(op.create_table());
+    case vdb::WriteOp::kDropTable:
+      // 数据一起删除，否则同名的表重新创建时会加载到旧数据
+      return db_->DropTable(op.drop_table(), true);
+    default:
+      return RET_ERROR;
+  }
+}
+
+vraft::RaftIndex VectordbSm::LastIndex() { return last_index_; }
+
+vraft::RaftTerm VectordbSm::LastTerm() { return last_term_; }
+
+int32_t VectordbSm::Checkpoint(const std::string &dir) {
+  RetNo ret = db_->Checkpoint(dir + "/db");
+  if (ret != RET_OK) {
+    logger->error("vectordb-sm checkpoint failed, ret: {}",
+                  RetNoToString(ret));
+    return -1;
+  }
+  return PersistApply(dir + "/apply");
+}
+
+int32_t VectordbSm::PersistApply(const std::string &file) {
+  json j;
+  j["last_index"] = last_index_;
+  j["last_term"] = last_term_;
+
+  // 先写临时文件再改名，崩溃时不会留下半个文件
+  if (!WriteFileSync(file, j.dump())) {
+    logger->error("vectordb-sm write {} failed, {}", file, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int32_t VectordbSm::LoadApply() {
+  if (!fs::exists(apply_file_)) {
+    last_index_ = 0;
+    last_term_ = 0;
+    return 0;
+  }
+
+  std::ifstream in(apply_file_);
+  json j = json::parse(in, nullptr, false);
+  if (j.is_discarded()) {
+    logger->error("vectordb-sm parse {} failed", apply_file_);
+    return -1;
+  }
+  last_index_ = j["last_index"].get<vraft::RaftIndex>();
+  last_term_ = j["last_term"].get<vraft::RaftTerm>();
+  return 0;
+}
+
+nlohmann::json VectordbSm::ToJson() {
+  nlohmann::json j;
+  j["path"] = path_;
+  j["last_index"] = last_index_;
+  j["last_term"] = last_term_;
+  return j;
+}
+
+nlohmann::json VectordbSm::ToJsonTiny() {
+  nlohmann::json j;
+  j["apply"] = std::to_string(last_index_) + "_" + std::to_string(last_term_);
+  return j;
+}
+
+std::string VectordbSm::ToJsonString(bool tiny, bool one_line) {
+  nlohmann::json j;
+  if (tiny) {
+    j["vdb-sm"] = ToJsonTiny();
+  } else {
+    j["vectordb-sm"] = ToJson();
+  }
+
+  if (one_line) {
+    return j.dump();
+  } else {
+    return j.dump(JSON_TAB);
+  }
+}
+
+VectordbSnapshotReader::VectordbSnapshotReader(VectordbSmSPtr sm,
+                                               std::string path,
+                                               int32_t max_read)
+    : vraft::SnapshotReader(path, max_read),
+      sm_(sm),
+      next_file_(0),
+      file_left_(0),
+      in_file_(false) {
+  last_index_ = 0;
+  last_term_ = 0;
+}
+
+VectordbSnapshotReader::~VectordbSnapshotReader() { Finish(); }
+
+int32_t VectordbSnapshotReader::Start() {
+  // 在 raft 的循环里做 checkpoint，期间不会有新的日志被应用
+  last_index_ = sm_->LastIndex();
+  last_term_ = sm_->LastTerm();
+  checkpoint_path_ =
+      path_ + "-checkpoint-" + std::to_string(TimeStamp().NanoSeconds());
+  if (sm_->Checkpoint(checkpoint_path_) != 0) {
+    return -1;
+  }
+
+  for (const auto &entry : fs::recursive_directory_iterator(checkpoint_path_)) {
+    if (fs::is_regular_file(entry.path())) {
+      files_.push_back(
+          entry.path().string().substr(checkpoint_path_.size() + 1));
+    }
+  }
+  std::sort(files_.begin(), files_.end());
+
+  // raft 约定 offset 从 1 开始，发送完后等于快照字节数加 1
+  offset_ = 1;
+  done_ = false;
+  logger->info("vectordb-snapshot start, {} files, last_index: {}",
+               files_.size(), last_index_);
+  return 0;
+}
+
+int32_t VectordbSnapshotReader::Read() {
+  data_.clear();
+  while (static_cast<int32_t>(data_.size()) < max_read_) {
+    if (!in_file_) {
+      int32_t rv = NextFile();
+      if (rv < 0) {
+        return -1;
+      }
+      if (rv == 0) {
+        done_ = true;
+        break;
+      }
+      // 文件头可能已经填满这一块
+      continue;
+    }
+
+    if (file_left_ == 0) {
+      file_.close();
+      in_file_ = false;
+      continue;
+    }
+
+    size_t bytes = std::min<uint64_t>(file_left_, max_read_ - data_.size());
+    size_t old_size = data_.size();
+    data_.resize(old_size + bytes);
+    file_.read(&data_[old_size], bytes);
+    if (static_cast<size_t>(file_.gcount()) != bytes) {
+      logger->error("vectordb-snapshot read {} failed",
+                    files_[next_file_ - 1]);
+      return -1;
+    }
+    file_left_ -= bytes;
+  }
+
+  offset_ += data_.size();
+  return done_ ? 0 : offset_;
+}
+
+int32_t VectordbSnapshotReader::NextFile() {
+  if (next_file_ >= files_.size()) {
+    return 0;
+  }
+
+  const std::string &name = files_[next_file_++];
+  std::string file = checkpoint_path_ + "/" + name;
+  file_.open(file, std::ios::binary);
+  if (!file_) {
+    logger->error("vectordb-snapshot open {} failed", file);
+    return -1;
+  }
+  file_left_ = fs::file_size(file);
+  in_file_ = true;
+
+  char buf[sizeof(uint64_t)];
+  EncodeFixed(buf, name.size(), sizeof(uint32_t));
+  data_.append(buf, sizeof(uint32_t));
+  data_.append(name);
+  EncodeFixed(buf, file_left_, sizeof(uint64_t));
+  data_.append(buf, sizeof(uint64_t));
+  return 1;
+}
+
+int32_t VectordbSnapshotReader::Finish() {
+  if (file_.is_open()) {
+    file_.close();
+  }
+  if (!checkpoint_path_.empty()) {
+    std::error_code ec;
+    fs::remove_all(checkpoint_path_, ec);
+    checkpoint_path_.clear();
+  }
+  return 0;
+}
+
+VectordbSnapshotWriter::VectordbSnapshotWriter(std::string path,
+                                               vraft::RaftIndex last_index,
+                                               vraft::RaftTerm last_term)
+    : vraft::SnapshotWriter(path, last_index, last_term),
+      file_left_(0),
+      in_file_(false) {}
+
+VectordbSnapshotWriter::~VectordbSnapshotWriter() {}
+
+int32_t VectordbSnapshotWriter::Start() {
+  if (fs::exists(path_)) {
+    logger->error("vectordb-snapshot {} already exists", path_);
+    return -1;
+  }
+  fs::create_directories(path_);
+  return 0;
+}
+
+int32_t VectordbSnapshotWriter::Write(const std::string &data) {
+  stored_ += static_cast<int32_t>(data.size());
+  pending_.append(data);
+
+  size_t pos = 0;
+  while (pos < pending_.size()) {
+    if (!in_file_) {
+      // 文件头可能被切在两次 Write 之间，凑齐了再解析
+      size_t left = pending_.size() - pos;
+      if (left < sizeof(uint32_t)) {
+        break;
+      }
+      uint32_t name_bytes = DecodeFixed(&pending_[pos], sizeof(uint32_t));
+      if (name_bytes == 0 || name_bytes > kMaxSnapshotNameBytes) {
+        logger->error("vectordb-snapshot bad name length {}", name_bytes);
+        return -1;
+      }
+      if (left < sizeof(uint32_t) + name_bytes + sizeof(uint64_t)) {
+        break;
+      }
+
+      std::string name = pending_.substr(pos + sizeof(uint32_t), name_bytes);
+      pos += sizeof(uint32_t) + name_bytes;
+      file_left_ = DecodeFixed(&pending_[pos], sizeof(uint64_t));
+      pos += sizeof(uint64_t);
+      if (name[0] == '/' || name.find("..") != std::string::npos) {
+        logger->error("vectordb-snapshot bad file name {}", name);
+        return -1;
+      }
+
+      fs::path file = path_ + "/" + name;
+      fs::create_directories(file.parent_path());
+      file_.open(file.string(), std::ios::binary | std::ios::trunc);
+      if (!file_) {
+        logger->error("vectordb-snapshot open {} failed", file.string());
+        return -1;
+      }
+      in_file_ = true;
+    }
+
+    size_t bytes = std::min<uint64_t>(file_left_, pending_.size() - pos);
+    file_.write(&pending_[pos], bytes);
+    pos += bytes;
+    file_left_ -= bytes;
+    if (file_left_ == 0) {
+      file_.close();
+      in_file_ = false;
+      if (!file_) {
+        logger->error("vectordb-snapshot write {} failed", path_);
+        return -1;
+      }
+    }
+  }
+
+  pending_.erase(0, pos);
+  return 0;
+}
+
+int32_t VectordbSnapshotWriter::Finish() {
+  // 最后一个文件必须完整
+  if (in_file_ || !pending_.empty()) {
+    logger->error("vectordb-snapshot {} truncated", path_);
+    return -1;
+  }
+  logger->info("vectordb-snapshot {} finish, {} bytes, last_index: {}", path_,
+               stored_, last_index_);
+  return 0;
+}
+
+void UseVectordbSm(vraft::Raft &raft) {
+  // 函数保存在 raft 里，用裸指针避免循环引用
+  vraft::Raft *raft_ptr = &raft;
+
+  raft.set_create_sm([](std::string &path) -> vraft::StateMachineSPtr {
+    return std::make_shared<VectordbSm>(path);
+  });
+
+  raft.set_reader_sm([raft_ptr](std::string &path, int32_t max_read)
+                         -> vraft::SnapshotReaderSPtr {
+    VectordbSmSPtr sm = std::dynamic_pointer_cast<VectordbSm>(raft_ptr->sm());
+    assert(sm);
+    auto reader = std::make_shared<VectordbSnapshotReader>(sm, path, max_read);
+    int32_t rv = reader->Start();
+    assert(rv == 0);
+    return reader;
+  });
+
+  raft.set_writer_sm(
+      [](std::string path, vraft::RaftIndex last_index,
+         vraft::RaftTerm last_term) -> vraft::SnapshotWriterSPtr {
+        auto writer = std::make_shared<VectordbSnapshotWriter>(
+            path, last_index, last_term);
+        int32_t rv = writer->Start();
+        assert(rv == 0);
+        return writer;
+      });
+}
+
+}  // namespace vectordb
@@ -0,0 +1,138 @@
+#ifndef VECTORDB_SERVER_VECTORDB_SM_H
+#define VECTORDB_SERVER_VECTORDB_SM_H
+
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// vraft 的目录在 include 路径中靠前，vectordb 同名的头文件按路径包含，
+// 之后 raft 头文件中的 "common.h" 解析到 vraft 的版本
+#include "src/common/common.h"
+#include "src/util/logger.h"
+#include "src/util/util.h"
+
+#include "snapshot.h"
+#include "state_machine.h"
+#include "vdb.pb.h"
+#include "vectordb.h"
+
+namespace vraft {
+class Raft;
+}  // namespace vraft
+
+namespace vectordb {
+
+// A Vectordb replicated by raft.
+//
+// Every data log entry is a serialized vdb::WriteBatch, its ops are applied
+// in order. Only the vectors are replicated, each replica inserts them into
+// its own indexes in the background (async_index). Apply does not sync,
+// Flush syncs the WAL of each written table and then the apply point once
+// per round of Apply. The directory of the state machine holds the db and
+// the apply point:
+//   path/db     the Vectordb
+//   path/apply  index and term of the last applied entry
+class VectordbSm final : public vraft::StateMachine {
+ public:
+  explicit VectordbSm(std::string path);
+  ~VectordbSm();
+  VectordbSm(const VectordbSm &) = delete;
+  VectordbSm &operator=(const VectordbSm &) = delete;
+
+  int32_t Restore() override;
+  int32_t Apply(vraft::LogEntry *entry, vraft::RaftAddr addr) override;
+  int32_t Flush() override;
+  vraft::RaftIndex LastIndex() override;
+  vraft::RaftTerm LastTerm() override;
+
+  nlohmann::json ToJson() override;
+  nlohmann::json ToJsonTiny() override;
+  std::string ToJsonString(bool tiny, bool one_line) override;
+
+  // the local data, gets and searches may use it from any thread, writes
+  // must go through raft::Propose. Search in the callback of raft::Read to
+  // see the committed writes (linearizable) or a bounded stale copy
+  VectordbSPtr db() const { return db_; }
+
+  // copy the db and the apply point into dir, in the raft loop thread
+  int32_t Checkpoint(const std::string &dir);
+
+ private:
+  void Init();
+  RetNo DoApply(vdb::WriteOp &op);
+  int32_t PersistApply(const std::string &file);
+  int32_t LoadApply();
+
+ private:
+  std::string db_path_;
+  std::string apply_file_;
+  VectordbSPtr db_;
+
+  // tables written since the last Flush
+  std::set<std::string> unsynced_tables_;
+
+  vraft::RaftIndex last_index_;
+  vraft::RaftTerm last_term_;
+};
+
+using VectordbSmSPtr = std::shared_ptr<VectordbSm>;
+
+// Streams a checkpoint of a VectordbSm to a follower. Every file of the
+// checkpoint is sent as
+//   name length (4 bytes) | name | file size (8 bytes) | content
+// with the name relative to the state machine directory.
+class VectordbSnapshotReader final : public vraft::SnapshotReader {
+ public:
+  VectordbSnapshotReader(VectordbSmSPtr sm, std::string path,
+                         int32_t max_read);
+  ~VectordbSnapshotReader();
+
+  // checkpoint the state machine, in the raft loop thread
+  int32_t Start() override;
+  int32_t Read() override;
+  int32_t Finish() override;
+
+ private:
+  // open the next file and append its header to data_,
+  // 1: opened, 0: no more files, -1: error
+  int32_t NextFile();
+
+ private:
+  VectordbSmSPtr sm_;
+  std::string checkpoint_path_;
+  std::vector<std::string> files_;
+  size_t next_file_;
+
+  std::ifstream file_;
+  uint64_t file_left_;
+  bool in_file_;
+};
+
+// Rebuilds the checkpoint streamed by VectordbSnapshotReader under path,
+// raft then moves it to the state machine directory.
+class VectordbSnapshotWriter final : public vraft::SnapshotWriter {
+ public:
+  VectordbSnapshotWriter(std::string path, vraft::RaftIndex last_index,
+                         vraft::RaftTerm last_term);
+  ~VectordbSnapshotWriter();
+
+  int32_t Start() override;
+  int32_t Write(const std::string &data) override;
+  int32_t Finish() override;
+
+ private:
+  // received bytes not parsed yet, a header may be cut in two
+  std::string pending_;
+  std::ofstream file_;
+  uint64_t file_left_;
+  bool in_file_;
+};
+
+// make raft create VectordbSm and its snapshot readers and writers
+void UseVectordbSm(vraft::Raft &raft);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SERVER_VECTORDB_SM_H
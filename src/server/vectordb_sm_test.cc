@@ -0,0 +1,208 @@
+#include "vectordb_sm.h"
+
+#include <gtest/gtest.h>
+
+#include "raft_log.h"
+
+const std::string kTestDir = "/tmp/vectordb_sm_test";
+
+namespace {
+
+vraft::LogEntry MakeEntry(vraft::RaftIndex index, vraft::RaftTerm term,
+                          const vdb::WriteBatch &batch) {
+  vraft::LogEntry entry;
+  entry.index = index;
+  entry.append_entry.term = term;
+  entry.append_entry.type = vraft::kData;
+  batch.SerializeToString(&entry.append_entry.value);
+  return entry;
+}
+
+vdb::WriteBatch CreateAndAdd(const std::string &table, int32_t dim,
+                             int64_t count) {
+  vdb::WriteBatch batch;
+  vdb::TableInfo *info = batch.add_ops()->mutable_create_table();
+  info->set_name(table);
+  info->mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  info->mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      vectordb::DefaultHnswParam(dim));
+
+  for (int64_t i = 0; i < count; ++i) {
+    vdb::AddRequest *add = batch.add_ops()->mutable_add();
+    add->set_table(table);
+    add->set_id(i);
+    for (int32_t j = 0; j < dim; ++j) {
+      add->add_vector(static_cast<float>(i * dim + j));
+    }
+    add->set_scalar("scalar_" + std::to_string(i));
+  }
+  return batch;
+}
+
+}  // namespace
+
+// 一条日志里的多个操作按顺序应用，应用点重启后还在
+TEST(VectordbSmTest, Apply) {
+  fs::remove_all(kTestDir);
+  fs::create_directories(kTestDir);
+
+  {
+    vectordb::VectordbSm sm(kTestDir);
+    EXPECT_EQ(sm.LastIndex(), 0u);
+
+    vraft::LogEntry entry = MakeEntry(1, 1, CreateAndAdd("t", 4, 10));
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.LastIndex(), 1u);
+    EXPECT_EQ(sm.LastTerm(), 1u);
+    EXPECT_EQ(sm.Flush(), 0);
+
+    // 表不存在的写入不影响同一批中后面的操作
+    vdb::WriteBatch batch;
+    batch.add_ops()->mutable_add()->set_table("not_exist");
+    batch.add_ops()->set_drop_table("t");
+    entry = MakeEntry(2, 2, batch);
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.LastIndex(), 2u);
+
+    // 数据损坏的日志
+    entry.index = 3;
+    entry.append_entry.value = "bad";
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), -1);
+    EXPECT_EQ(sm.LastIndex(), 2u);
+
+    entry = MakeEntry(3, 2, CreateAndAdd("t", 4, 3));
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.Flush(), 0);
+  }
+
+  vectordb::VectordbSm sm(kTestDir);
+  EXPECT_EQ(sm.Restore(), 0);
+  EXPECT_EQ(sm.LastIndex(), 3u);
+  EXPECT_EQ(sm.LastTerm(), 2u);
+
+  std::string scalar;
+  EXPECT_EQ(sm.db()->Get("t", 2, scalar), vectordb::RET_OK);
+  EXPECT_EQ(scalar, "scalar_2");
+  EXPECT_EQ(sm.db()->Get("t", 5, scalar), vectordb::RET_NOT_FOUND);
+
+  fs::remove_all(kTestDir);
+}
+
+// 应用点只在 Flush 时落盘，之前重启的副本从上一个应用点重放
+TEST(VectordbSmTest, Flush) {
+  fs::remove_all(kTestDir);
+  fs::create_directories(kTestDir);
+
+  {
+    vectordb::VectordbSm sm(kTestDir);
+    vraft::LogEntry entry = MakeEntry(1, 1, CreateAndAdd("t", 4, 3));
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.Flush(), 0);
+
+    vdb::WriteBatch batch;
+    vdb::AddRequest *add = batch.add_ops()->mutable_add();
+    add->set_table("t");
+    add->set_id(10);
+    for (int32_t j = 0; j < 4; ++j) {
+      add->add_vector(1.0f);
+    }
+    entry = MakeEntry(2, 1, batch);
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.LastIndex(), 2u);
+  }
+
+  {
+    vectordb::VectordbSm sm(kTestDir);
+    EXPECT_EQ(sm.LastIndex(), 1u);
+    EXPECT_EQ(sm.LastTerm(), 1u);
+
+    // 表在这一轮中被删除，Flush 跳过它
+    vdb::WriteBatch batch = CreateAndAdd("u", 4, 2);
+    batch.add_ops()->set_drop_table("u");
+    vraft::LogEntry entry = MakeEntry(2, 1, batch);
+    EXPECT_EQ(sm.Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm.Flush(), 0);
+  }
+
+  vectordb::VectordbSm sm(kTestDir);
+  EXPECT_EQ(sm.LastIndex(), 2u);
+
+  fs::remove_all(kTestDir);
+}
+
+// 快照按小块读出再写入，装到另一个目录后数据、索引和应用点都一样
+TEST(VectordbSmTest, Snapshot) {
+  const std::string sm_path = kTestDir + "/sm";
+  const std::string snapshot_path = kTestDir + "/sm-snapshot";
+  fs::remove_all(kTestDir);
+  fs::create_directories(sm_path);
+
+  std::vector<float> query = {4, 5, 6, 7};
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  {
+    auto sm = std::make_shared<vectordb::VectordbSm>(sm_path);
+    vraft::LogEntry entry = MakeEntry(7, 3, CreateAndAdd("t", 4, 100));
+    EXPECT_EQ(sm->Apply(&entry, vraft::RaftAddr()), 0);
+    EXPECT_EQ(sm->Flush(), 0);
+    EXPECT_EQ(sm->db()->BuildIndex("t"), vectordb::RET_OK);
+    EXPECT_EQ(sm->db()->Search("t", query, 5, ids, distances, scalars),
+              vectordb::RET_OK);
+
+    vectordb::VectordbSnapshotReader reader(sm, sm_path, 100);
+    ASSERT_EQ(reader.Start(), 0);
+    EXPECT_EQ(reader.last_index(), 7u);
+    EXPECT_EQ(reader.last_term(), 3u);
+
+    vectordb::VectordbSnapshotWriter writer(snapshot_path, reader.last_index(),
+                                            reader.last_term());
+    ASSERT_EQ(writer.Start(), 0);
+    while (true) {
+      EXPECT_EQ(reader.offset(), writer.stored() + 1);
+      int32_t rv = reader.Read();
+      ASSERT_GE(rv, 0);
+      EXPECT_LE(reader.data().size(), 100u + 64u);
+      ASSERT_EQ(writer.Write(reader.data()), 0);
+      if (rv == 0) {
+        break;
+      }
+    }
+    EXPECT_TRUE(reader.done());
+    EXPECT_EQ(reader.offset(), writer.stored() + 1);
+    EXPECT_EQ(writer.Finish(), 0);
+    EXPECT_EQ(reader.Finish(), 0);
+  }
+
+  // raft 把写好的快照目录换成状态机目录
+  fs::remove_all(sm_path);
+  fs::rename(snapshot_path, sm_path);
+
+  vectordb::VectordbSm sm(sm_path);
+  EXPECT_EQ(sm.LastIndex(), 7u);
+  EXPECT_EQ(sm.LastTerm(), 3u);
+  EXPECT_EQ(sm.db()->IndexIDs("t").size(), 1u);
+
+  std::vector<int64_t> copy_ids;
+  std::vector<float> copy_distances;
+  std::vector<std::string> copy_scalars;
+  EXPECT_EQ(sm.db()->Search("t", query, 5, copy_ids, copy_distances,
+                            copy_scalars),
+            vectordb::RET_OK);
+  EXPECT_EQ(copy_ids, ids);
+  EXPECT_EQ(copy_scalars, scalars);
+
+  // 截断的快照
+  vectordb::VectordbSnapshotWriter writer(kTestDir + "/truncated", 1, 1);
+  ASSERT_EQ(writer.Start(), 0);
+  EXPECT_EQ(writer.Write(std::string("\x05\x00\x00", 3)), 0);
+  EXPECT_EQ(writer.Finish(), -1);
+
+  fs::remove_all(kTestDir);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -20,6 +20,29 @@ json HnswParamToJson(const vdb::HnswParam &param) {
   return j;
 }
 
+json DiskAnnParamToJson(const vdb::DiskAnnParam &param) {
+  json j;
+  j["dim"] = param.dim();
+  j["max_elements"] = param.max_elements();
+  j["R"] = param.r();
+  j["L"] = param.l();
+  j["alpha"] = param.alpha();
+  j["pq_m"] = param.pq_m();
+  j["beam_width"] = param.beam_width();
+  j["distance_type"] = param.distance_type();
+  return j;
+}
+
+json PqParamToJson(const vdb::PqParam &param) {
+  json j;
+  j["dim"] = param.dim();
+  j["max_elements"] = param.max_elements();
+  j["m"] = param.m();
+  j["train_size"] = param.train_size();
+  j["distance_type"] = param.distance_type();
+  return j;
+}
+
 json IndexInfoToJson(const vdb::IndexInfo &param) {
   json j;
   j["index_type"] = param.index_type();
@@ -27,6 +50,10 @@ json IndexInfoToJson(const vdb::IndexInfo &param) {
     j["flat_param"] = FlatParamToJson(param.flat_param());
   } else if (param.has_hnsw_param()) {
     j["hnsw_param"] = HnswParamToJson(param.hnsw_param());
+  } else if (param.has_diskann_param()) {
+    j["diskann_param"] = DiskAnnParamToJson(param.diskann_param());
+  } else if (param.has_pq_param()) {
+    j["pq_param"] = PqParamToJson(param.pq_param());
   }
   return j;
 }
@@ -40,10 +67,19 @@ json IndexParamToJson(const vdb::IndexParam &param) {
   return j;
 }
 
+json SegmentParamToJson(const vdb::SegmentParam &param) {
+  json j;
+  j["seal_threshold"] = param.seal_threshold();
+  j["compact_threshold"] = param.compact_threshold();
+  return j;
+}
+
 json TableInfoToJson(const vdb::TableInfo &param) {
   json j;
   j["name"] = param.name();
   j["default_index_info"] = IndexInfoToJson(param.default_index_info());
+  j["segment_param"] = SegmentParamToJson(param.segment_param());
+  j["shard_num"] = param.shard_num();
   return j;
 }
 
@@ -58,6 +94,8 @@ json TableParamToJson(const vdb::TableParam &param) {
   for (const auto &index : param.indexes()) {
     j["indexes"].push_back(IndexParamToJson(index));
   }
+  j["segment_param"] = SegmentParamToJson(param.segment_param());
+  j["shard_num"] = param.shard_num();
   return j;
 }
 
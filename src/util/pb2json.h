@@ -11,10 +11,15 @@ json FlatParamToJson(const vdb::FlatParam &param);
 
 json HnswParamToJson(const vdb::HnswParam &param);
 
+json DiskAnnParamToJson(const vdb::DiskAnnParam &param);
+json PqParamToJson(const vdb::PqParam &param);
+
 json IndexInfoToJson(const vdb::IndexInfo &param);
 
 json IndexParamToJson(const vdb::IndexParam &param);
 
+json SegmentParamToJson(const vdb::SegmentParam &param);
+
 json TableInfoToJson(const vdb::TableInfo &param);
 
 json TableParamToJson(const vdb::TableParam &param);
@@ -76,6 +76,55 @@ TEST(Pb2JsonTest, IndexInfoToJson_HnswParam) {
   EXPECT_EQ(j["hnsw_param"]["distance_type"], DISTANCE_TYPE_INNER_PRODUCT);
 }
 
+TEST(Pb2JsonTest, IndexInfoToJson_DiskAnnParam) {
+  vdb::IndexInfo info;
+  info.set_index_type(INDEX_TYPE_DISKANN);
+  auto* diskann_param = info.mutable_diskann_param();
+  diskann_param->set_dim(96);
+  diskann_param->set_max_elements(100000);
+  diskann_param->set_r(64);
+  diskann_param->set_l(100);
+  diskann_param->set_alpha(1.2);
+  diskann_param->set_pq_m(24);
+  diskann_param->set_beam_width(4);
+  diskann_param->set_distance_type(DISTANCE_TYPE_L2);
+
+  json j = IndexInfoToJson(info);
+
+  EXPECT_EQ(j["index_type"], INDEX_TYPE_DISKANN);
+  EXPECT_FALSE(j.contains("hnsw_param"));
+  EXPECT_TRUE(j.contains("diskann_param"));
+  EXPECT_EQ(j["diskann_param"]["dim"], 96);
+  EXPECT_EQ(j["diskann_param"]["R"], 64);
+  EXPECT_EQ(j["diskann_param"]["L"], 100);
+  EXPECT_FLOAT_EQ(j["diskann_param"]["alpha"].get<float>(), 1.2f);
+  EXPECT_EQ(j["diskann_param"]["pq_m"], 24);
+  EXPECT_EQ(j["diskann_param"]["beam_width"], 4);
+  EXPECT_EQ(j["diskann_param"]["distance_type"], DISTANCE_TYPE_L2);
+}
+
+TEST(Pb2JsonTest, IndexInfoToJson_PqParam) {
+  vdb::IndexInfo info;
+  info.set_index_type(INDEX_TYPE_PQ);
+  auto* pq_param = info.mutable_pq_param();
+  pq_param->set_dim(128);
+  pq_param->set_max_elements(100000);
+  pq_param->set_m(16);
+  pq_param->set_train_size(20000);
+  pq_param->set_distance_type(DISTANCE_TYPE_INNER_PRODUCT);
+
+  json j = IndexInfoToJson(info);
+
+  EXPECT_EQ(j["index_type"], INDEX_TYPE_PQ);
+  EXPECT_FALSE(j.contains("diskann_param"));
+  EXPECT_TRUE(j.contains("pq_param"));
+  EXPECT_EQ(j["pq_param"]["dim"], 128);
+  EXPECT_EQ(j["pq_param"]["max_elements"], 100000);
+  EXPECT_EQ(j["pq_param"]["m"], 16);
+  EXPECT_EQ(j["pq_param"]["train_size"], 20000);
+  EXPECT_EQ(j["pq_param"]["distance_type"], DISTANCE_TYPE_INNER_PRODUCT);
+}
+
 TEST(Pb2JsonTest, IndexParamToJson) {
   vdb::IndexParam param;
   param.set_path("/path/to/index");
@@ -169,6 +218,8 @@ TEST(Pb2JsonTest, TableParamToJson) {
   EXPECT_EQ(j["indexes"].size(), static_cast<size_t>(2));
   EXPECT_EQ(j["indexes"][0]["id"], 1);
   EXPECT_EQ(j["indexes"][1]["id"], 2);
+  EXPECT_EQ(j["segment_param"]["seal_threshold"], 0);
+  EXPECT_EQ(j["shard_num"], 0);
 }
 
 }  // namespace vectordb
\ No newline at end of file
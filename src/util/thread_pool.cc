@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace vectordb {
+
+ThreadPool::ThreadPool(int32_t thread_num) : stop_(false) {
+  if (thread_num <= 0) {
+    thread_num = static_cast<int32_t>(std::thread::hardware_concurrency());
+  }
+  if (thread_num <= 0) {
+    thread_num = 1;
+  }
+
+  for (int32_t i = 0; i < thread_num; ++i) {
+    threads_.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> ulk(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+
+  for (auto &t : threads_) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+}
+
+void ThreadPool::Push(Task task) {
+  {
+    std::unique_lock<std::mutex> ulk(mu_);
+    tasks_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+
+void ThreadPool::Run() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> ulk(mu_);
+      cv_.wait(ulk, [this] { return stop_ || !tasks_.empty(); });
+      if (stop_ && tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end,
+                             const std::function<void(int64_t)> &func) {
+  if (begin >= end) {
+    return;
+  }
+
+  // 任务共享一个游标，每个线程循环领取下一个下标
+  struct State {
+    std::atomic<int64_t> next;
+    std::mutex mu;
+    std::condition_variable cv;
+    int32_t active = 0;
+    bool closed = false;
+  };
+  auto state = std::make_shared<State>();
+  state->next = begin;
+
+  auto work = [state, end, &func] {
+    while (true) {
+      int64_t i = state->next.fetch_add(1);
+      if (i >= end) {
+        break;
+      }
+      func(i);
+    }
+  };
+
+  int32_t workers =
+      static_cast<int32_t>(std::min<int64_t>(thread_num(), end - begin - 1));
+  for (int32_t i = 0; i < workers; ++i) {
+    Push([state, work] {
+      {
+        // 调用者已经完成时，排队中的任务直接退出
+        std::unique_lock<std::mutex> ulk(state->mu);
+        if (state->closed) {
+          return;
+        }
+        state->active++;
+      }
+
+      work();
+
+      std::unique_lock<std::mutex> ulk(state->mu);
+      if (--state->active == 0) {
+        state->cv.notify_all();
+      }
+    });
+  }
+
+  // 调用线程也参与计算，线程池被占满（如嵌套调用）时也不会死锁
+  work();
+
+  std::unique_lock<std::mutex> ulk(state->mu);
+  state->closed = true;
+  state->cv.wait(ulk, [state] { return state->active == 0; });
+}
+
+ThreadPool &DefaultThreadPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+}  // namespace vectordb
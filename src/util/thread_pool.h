@@ -0,0 +1,53 @@
+#ifndef VECTORDB_UTIL_THREAD_POOL_H
+#define VECTORDB_UTIL_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vectordb {
+
+using Task = std::function<void()>;
+
+class ThreadPool final {
+ public:
+  // thread_num <= 0 means std::thread::hardware_concurrency()
+  explicit ThreadPool(int32_t thread_num = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void Push(Task task);
+
+  // run func(i) for i in [begin, end), the caller thread also works,
+  // returns after all iterations are done
+  void ParallelFor(int64_t begin, int64_t end,
+                   const std::function<void(int64_t)> &func);
+
+  int32_t thread_num() const { return static_cast<int32_t>(threads_.size()); }
+
+ private:
+  void Run();
+
+ private:
+  bool stop_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Task> tasks_;
+  std::vector<std::thread> threads_;
+};
+
+using ThreadPoolSPtr = std::shared_ptr<ThreadPool>;
+
+// process wide pool shared by the vdb modules
+ThreadPool &DefaultThreadPool();
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_UTIL_THREAD_POOL_H
@@ -0,0 +1,44 @@
+#include "thread_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+namespace vectordb {
+
+TEST(ThreadPoolTest, Push) {
+  std::atomic<int32_t> count(0);
+  {
+    ThreadPool pool(4);
+    for (int32_t i = 0; i < 100; ++i) {
+      pool.Push([&count] { count++; });
+    }
+  }
+  // 析构时会执行完队列中的任务
+  EXPECT_EQ(count.load(), 100);
+}
+
+TEST(ThreadPoolTest, ParallelFor) {
+  ThreadPool pool(4);
+  std::vector<int32_t> v(1000, 0);
+  pool.ParallelFor(0, v.size(), [&v](int64_t i) { v[i] = i * 2; });
+  for (size_t i = 0; i < v.size(); ++i) {
+    EXPECT_EQ(v[i], static_cast<int32_t>(i * 2));
+  }
+
+  // 空区间
+  pool.ParallelFor(10, 10, [&v](int64_t i) { v[i] = -1; });
+  EXPECT_EQ(v[10], 20);
+}
+
+TEST(ThreadPoolTest, NestedParallelFor) {
+  ThreadPool pool(2);
+  std::atomic<int32_t> count(0);
+  pool.ParallelFor(0, 8, [&pool, &count](int64_t) {
+    pool.ParallelFor(0, 8, [&count](int64_t) { count++; });
+  });
+  EXPECT_EQ(count.load(), 64);
+}
+
+}  // namespace vectordb
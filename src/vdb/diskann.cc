@@ -0,0 +1,1228 @@
+#include "diskann.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+#include "search_profile.h"
+#include "thread_pool.h"
+
+namespace vectordb {
+
+namespace {
+
+const uint64_t kDataMagic = 0x4154414441534944ULL;  // "DISADATA"
+const uint64_t kMemMagic = 0x4d454d4e41534944ULL;   // "DISANMEM"
+
+const int32_t kDefaultR = 64;
+const int32_t kDefaultL = 100;
+const float kDefaultAlpha = 1.2;
+const int32_t kDefaultBeamWidth = 4;
+
+// 扫描整个图时每次读取的扇区数
+const size_t kScanSectors = 256;
+
+// 增量插入时每批的向量数，一批的修改在内存中攒齐后一次写回
+const size_t kInsertChunk = 1024;
+
+// first sector of diskann.data
+struct DataHeader {
+  uint64_t magic;
+  uint32_t dim;
+  uint32_t r;
+  uint32_t node_num;
+  uint32_t medoid;
+  uint64_t node_size;
+  uint32_t nodes_per_sector;
+  uint32_t sectors_per_node;
+};
+
+struct Candidate {
+  float distance;
+  uint32_t node;
+  bool expanded;
+};
+
+// pool is sorted by distance and keeps at most l candidates
+void InsertCandidate(std::vector<Candidate> &pool, const Candidate &c,
+                     size_t l) {
+  if (pool.size() >= l && c.distance >= pool.back().distance) {
+    return;
+  }
+  auto it = std::upper_bound(
+      pool.begin(), pool.end(), c.distance,
+      [](float d, const Candidate &other) { return d < other.distance; });
+  pool.insert(it, c);
+  if (pool.size() > l) {
+    pool.pop_back();
+  }
+}
+
+// O_DIRECT 要求缓冲区按扇区对齐
+std::unique_ptr<char, void (*)(void *)> AlignedAlloc(size_t size) {
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, DiskAnnIndex::kSectorSize, size) != 0) {
+    ptr = nullptr;
+  }
+  return std::unique_ptr<char, void (*)(void *)>(static_cast<char *>(ptr),
+                                                 free);
+}
+
+}  // namespace
+
+DiskAnnIndex::DiskAnnIndex(const std::string &path,
+                           const vdb::DiskAnnParam &param,
+                           int64_t max_pending)
+    : data_file_(path + "/diskann.data"),
+      mem_file_(path + "/diskann.mem"),
+      param_(param),
+      max_pending_(std::max<int64_t>(max_pending, 1)),
+      dim_(param.dim()),
+      r_(param.r() > 0 ? param.r() : kDefaultR),
+      dist_func_(nullptr),
+      dist_param_(nullptr),
+      fd_(-1),
+      node_num_(0),
+      medoid_(0),
+      node_size_(0),
+      nodes_per_sector_(1),
+      sectors_per_node_(1),
+      hops_(0),
+      sector_reads_(0),
+      distance_computations_(0) {
+  if (param_.l() <= 0) {
+    param_.set_l(kDefaultL);
+  }
+  if (param_.alpha() <= 0) {
+    param_.set_alpha(kDefaultAlpha);
+  }
+  if (param_.beam_width() <= 0) {
+    param_.set_beam_width(kDefaultBeamWidth);
+  }
+  if (param_.pq_m() <= 0) {
+    param_.set_pq_m(std::max(1, dim_ / 4));
+  }
+
+  if (param_.distance_type() == DISTANCE_TYPE_L2) {
+    space_ = std::make_unique<hnswlib::L2Space>(dim_);
+  } else {
+    space_ = std::make_unique<hnswlib::InnerProductSpace>(dim_);
+  }
+  dist_func_ = space_->get_dist_func();
+  dist_param_ = space_->get_dist_func_param();
+}
+
+DiskAnnIndex::~DiskAnnIndex() { CloseFiles(); }
+
+RetNo DiskAnnIndex::Load() {
+  if (!fs::exists(data_file_) || !fs::exists(mem_file_)) {
+    return RET_OK;
+  }
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  return OpenFiles();
+}
+
+RetNo DiskAnnIndex::Add(int64_t id, const std::vector<float> &vector) {
+  if (vector.size() != static_cast<size_t>(dim_)) {
+    return RET_ERROR;
+  }
+
+  bool full = false;
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    auto it = pending_pos_.find(id);
+    if (it != pending_pos_.end()) {
+      pending_live_[it->second] = false;
+    }
+    pending_pos_[id] = pending_ids_.size();
+    pending_ids_.push_back(id);
+    pending_vectors_.insert(pending_vectors_.end(), vector.begin(),
+                            vector.end());
+    pending_live_.push_back(true);
+    full = pending_ids_.size() >= static_cast<size_t>(max_pending_);
+  }
+
+  // 暂存区满时合并进图，限制暂存的内存和搜索时暴力扫描的开销
+  if (full) {
+    return Persist();
+  }
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::Persist() {
+  std::lock_guard<std::mutex> persist_lg(persist_mu_);
+
+  // 只合并当前已暂存的向量，构建期间的新写入留到下一次
+  std::vector<int64_t> ids;
+  std::vector<float> vectors;
+  size_t consumed = 0;
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    consumed = pending_ids_.size();
+    for (size_t i = 0; i < consumed; ++i) {
+      if (pending_live_[i]) {
+        ids.push_back(pending_ids_[i]);
+        vectors.insert(vectors.end(), pending_vectors_.begin() + i * dim_,
+                       pending_vectors_.begin() + (i + 1) * dim_);
+      }
+    }
+  }
+  if (consumed == 0) {
+    return RET_OK;
+  }
+
+  // 图不大于本批时在内存中重建，同时重新训练 PQ，否则增量插入，
+  // 两种方式的内存都只与本批的大小有关
+  uint32_t node_num = 0;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    node_num = node_num_;
+  }
+  RetNo ret = node_num <= ids.size() ? Rebuild(ids, vectors)
+                                     : Insert(ids, vectors);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  // 新图已经包含这些向量，从暂存区移除
+  std::lock_guard<std::mutex> lg(pending_mu_);
+  pending_ids_.erase(pending_ids_.begin(), pending_ids_.begin() + consumed);
+  pending_vectors_.erase(pending_vectors_.begin(),
+                         pending_vectors_.begin() + consumed * dim_);
+  pending_live_.erase(pending_live_.begin(),
+                      pending_live_.begin() + consumed);
+  pending_pos_.clear();
+  for (size_t i = 0; i < pending_ids_.size(); ++i) {
+    if (pending_live_[i]) {
+      pending_pos_[pending_ids_[i]] = i;
+    }
+  }
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::Rebuild(std::vector<int64_t> &ids,
+                            std::vector<float> &vectors) {
+  // 图中被覆盖写入的 id 以暂存的向量为准
+  std::unordered_set<int64_t> replaced(ids.begin(), ids.end());
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    RetNo ret = ScanNodes([&](uint32_t node, const float *vector) {
+      if (replaced.count(ids_[node]) == 0) {
+        ids.push_back(ids_[node]);
+        vectors.insert(vectors.end(), vector, vector + dim_);
+      }
+      return RET_OK;
+    });
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return Build(ids, vectors);
+}
+
+RetNo DiskAnnIndex::Build(const std::vector<int64_t> &ids,
+                          const std::vector<float> &vectors) {
+  uint32_t n = ids.size();
+
+  // 离中心最近的点作为入口
+  std::vector<float> center(dim_, 0);
+  for (uint32_t i = 0; i < n; ++i) {
+    for (int32_t d = 0; d < dim_; ++d) {
+      center[d] += vectors[static_cast<size_t>(i) * dim_ + d] / n;
+    }
+  }
+  uint32_t medoid = 0;
+  float best = std::numeric_limits<float>::max();
+  hnswlib::L2Space l2_space(dim_);
+  for (uint32_t i = 0; i < n; ++i) {
+    float distance =
+        l2_space.get_dist_func()(center.data(), vectors.data() + i * dim_,
+                                 l2_space.get_dist_func_param());
+    if (distance < best) {
+      best = distance;
+      medoid = i;
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> graph;
+  BuildGraph(vectors, n, medoid, graph);
+
+  // 先写临时文件，替换时只需要短暂持有写锁
+  const std::string suffix = ".tmp";
+  RetNo ret = WriteFiles(ids, vectors, graph, medoid, suffix);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  CloseFiles();
+  fs::rename(data_file_ + suffix, data_file_);
+  fs::rename(mem_file_ + suffix, mem_file_);
+  return OpenFiles();
+}
+
+template <typename VecFunc>
+std::vector<uint32_t> DiskAnnIndex::RobustPrune(
+    const VecFunc &vec, uint32_t node,
+    std::vector<std::pair<float, uint32_t>> &candidates, float alpha) {
+  // L2 距离是平方后的值，放宽系数也取平方；内积距离可能为负，不做放宽
+  float factor = 1.0f;
+  if (param_.distance_type() == DISTANCE_TYPE_L2) {
+    factor = alpha * alpha;
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  std::vector<uint32_t> result;
+  std::unordered_set<uint32_t> seen;
+  for (const auto &candidate : candidates) {
+    if (result.size() >= static_cast<size_t>(r_)) {
+      break;
+    }
+    if (candidate.second == node || !seen.insert(candidate.second).second) {
+      continue;
+    }
+
+    // 已选的邻居中有更近的点能到达它时，这条边可以省掉
+    bool keep = true;
+    for (uint32_t kept : result) {
+      float distance =
+          dist_func_(vec(kept), vec(candidate.second), dist_param_);
+      if (factor * distance <= candidate.first) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) {
+      result.push_back(candidate.second);
+    }
+  }
+  return result;
+}
+
+void DiskAnnIndex::BuildGraph(const std::vector<float> &vectors, uint32_t n,
+                              uint32_t medoid,
+                              std::vector<std::vector<uint32_t>> &graph) {
+  auto vec = [&vectors, this](uint32_t i) {
+    return vectors.data() + static_cast<size_t>(i) * dim_;
+  };
+  int32_t l = std::max(param_.l(), r_);
+
+  // 随机 R 正则图作为初始图
+  graph.assign(n, {});
+  std::vector<std::mutex> locks(n);
+  uint32_t degree = std::min<uint32_t>(r_, n - 1);
+  DefaultThreadPool().ParallelFor(0, n, [&](int64_t i) {
+    std::mt19937 rng(i);
+    std::uniform_int_distribution<uint32_t> pick(0, n - 1);
+    std::unordered_set<uint32_t> chosen;
+    while (chosen.size() < degree) {
+      uint32_t j = pick(rng);
+      if (j != i) {
+        chosen.insert(j);
+      }
+    }
+    graph[i].assign(chosen.begin(), chosen.end());
+  });
+
+  // 两轮 Vamana：第一轮 alpha = 1 收紧邻居，第二轮用 alpha 补充长边
+  std::vector<uint32_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(n);
+  for (float alpha : {1.0f, param_.alpha()}) {
+    std::shuffle(order.begin(), order.end(), rng);
+    DefaultThreadPool().ParallelFor(0, n, [&](int64_t i) {
+      uint32_t p = order[i];
+      std::vector<std::pair<float, uint32_t>> candidates;
+      GreedySearch(vectors, graph, locks, medoid, vec(p), l, candidates);
+      {
+        std::lock_guard<std::mutex> lg(locks[p]);
+        for (uint32_t neighbor : graph[p]) {
+          candidates.emplace_back(
+              dist_func_(vec(p), vec(neighbor), dist_param_), neighbor);
+        }
+      }
+
+      std::vector<uint32_t> neighbors =
+          RobustPrune(vec, p, candidates, alpha);
+      {
+        std::lock_guard<std::mutex> lg(locks[p]);
+        graph[p] = neighbors;
+      }
+
+      // 加反向边，邻居的出度超过 R 时重新剪枝
+      for (uint32_t neighbor : neighbors) {
+        std::lock_guard<std::mutex> lg(locks[neighbor]);
+        std::vector<uint32_t> &list = graph[neighbor];
+        if (std::find(list.begin(), list.end(), p) != list.end()) {
+          continue;
+        }
+        if (list.size() < static_cast<size_t>(r_)) {
+          list.push_back(p);
+          continue;
+        }
+
+        std::vector<std::pair<float, uint32_t>> pool;
+        pool.reserve(list.size() + 1);
+        for (uint32_t x : list) {
+          pool.emplace_back(dist_func_(vec(neighbor), vec(x), dist_param_), x);
+        }
+        pool.emplace_back(dist_func_(vec(neighbor), vec(p), dist_param_), p);
+        list = RobustPrune(vec, neighbor, pool, alpha);
+      }
+    });
+  }
+}
+
+void DiskAnnIndex::GreedySearch(
+    const std::vector<float> &vectors,
+    const std::vector<std::vector<uint32_t>> &graph,
+    std::vector<std::mutex> &locks, uint32_t medoid, const float *query,
+    int32_t l, std::vector<std::pair<float, uint32_t>> &expanded) {
+  auto distance_to = [&](uint32_t i) {
+    return dist_func_(query, vectors.data() + static_cast<size_t>(i) * dim_,
+                      dist_param_);
+  };
+
+  std::vector<Candidate> pool;
+  std::unordered_set<uint32_t> visited;
+  pool.push_back(Candidate{distance_to(medoid), medoid, false});
+  visited.insert(medoid);
+
+  std::vector<uint32_t> neighbors;
+  while (true) {
+    auto it = std::find_if(pool.begin(), pool.end(),
+                           [](const Candidate &c) { return !c.expanded; });
+    if (it == pool.end()) {
+      break;
+    }
+    it->expanded = true;
+    uint32_t node = it->node;
+    expanded.emplace_back(it->distance, node);
+
+    {
+      std::lock_guard<std::mutex> lg(locks[node]);
+      neighbors = graph[node];
+    }
+    for (uint32_t neighbor : neighbors) {
+      if (visited.insert(neighbor).second) {
+        InsertCandidate(pool, Candidate{distance_to(neighbor), neighbor, false},
+                        l);
+      }
+    }
+  }
+}
+
+RetNo DiskAnnIndex::WriteFiles(const std::vector<int64_t> &ids,
+                               const std::vector<float> &vectors,
+                               const std::vector<std::vector<uint32_t>> &graph,
+                               uint32_t medoid, const std::string &suffix) {
+  uint32_t n = ids.size();
+
+  ProductQuantizer pq(dim_, param_.pq_m(), param_.distance_type());
+  RetNo ret = pq.Train(vectors.data(), n);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  std::vector<uint8_t> codes(static_cast<size_t>(n) * pq.code_size());
+  DefaultThreadPool().ParallelFor(0, n, [&](int64_t i) {
+    pq.Encode(vectors.data() + i * dim_, codes.data() + i * pq.code_size());
+  });
+
+  // 节点记录：向量、出度、R 个邻居槽位
+  DataHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kDataMagic;
+  header.dim = dim_;
+  header.r = r_;
+  header.node_num = n;
+  header.medoid = medoid;
+  header.node_size = dim_ * sizeof(float) + sizeof(uint32_t) +
+                     r_ * sizeof(uint32_t);
+  if (header.node_size <= static_cast<uint64_t>(kSectorSize)) {
+    header.nodes_per_sector = kSectorSize / header.node_size;
+    header.sectors_per_node = 1;
+  } else {
+    header.nodes_per_sector = 1;
+    header.sectors_per_node =
+        (header.node_size + kSectorSize - 1) / kSectorSize;
+  }
+
+  std::ofstream data(data_file_ + suffix, std::ios::binary | std::ios::trunc);
+  std::vector<char> block(kSectorSize, 0);
+  memcpy(block.data(), &header, sizeof(header));
+  data.write(block.data(), block.size());
+
+  // 一个块是一个或多个扇区，文件按扇区补齐，对齐读不会越过文件尾
+  block.assign(header.sectors_per_node * kSectorSize, 0);
+  for (uint32_t first = 0; first < n; first += header.nodes_per_sector) {
+    std::fill(block.begin(), block.end(), 0);
+    uint32_t last = std::min(n, first + header.nodes_per_sector);
+    for (uint32_t i = first; i < last; ++i) {
+      char *record = block.data() + (i - first) * header.node_size;
+      memcpy(record, vectors.data() + static_cast<size_t>(i) * dim_,
+             dim_ * sizeof(float));
+      uint32_t degree = graph[i].size();
+      memcpy(record + dim_ * sizeof(float), &degree, sizeof(degree));
+      memcpy(record + dim_ * sizeof(float) + sizeof(degree), graph[i].data(),
+             degree * sizeof(uint32_t));
+    }
+    data.write(block.data(), block.size());
+  }
+  data.close();
+  if (!data) {
+    return RET_ERROR;
+  }
+
+  return WriteMem(ids, pq, codes, mem_file_ + suffix);
+}
+
+RetNo DiskAnnIndex::WriteMem(const std::vector<int64_t> &ids,
+                             const ProductQuantizer &pq,
+                             const std::vector<uint8_t> &codes,
+                             const std::string &file) const {
+  uint32_t n = ids.size();
+  std::ofstream mem(file, std::ios::binary | std::ios::trunc);
+  mem.write(reinterpret_cast<const char *>(&kMemMagic), sizeof(kMemMagic));
+  mem.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  mem.write(reinterpret_cast<const char *>(ids.data()),
+            ids.size() * sizeof(int64_t));
+  RetNo ret = pq.Save(mem);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  mem.write(reinterpret_cast<const char *>(codes.data()), codes.size());
+  mem.close();
+  return mem ? RET_OK : RET_ERROR;
+}
+
+RetNo DiskAnnIndex::Insert(const std::vector<int64_t> &ids,
+                           const std::vector<float> &vectors) {
+  for (size_t begin = 0; begin < ids.size(); begin += kInsertChunk) {
+    size_t end = std::min(ids.size(), begin + kInsertChunk);
+    RetNo ret = InsertChunk(ids, vectors, begin, end);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  // 数据文件已提交，mem 文件整体替换
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    RetNo ret = WriteMem(ids_, *pq_, codes_, mem_file_ + ".tmp");
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  fs::rename(mem_file_ + ".tmp", mem_file_);
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::InsertChunk(const std::vector<int64_t> &ids,
+                                const std::vector<float> &vectors,
+                                size_t begin, size_t end) {
+  size_t count = end - begin;
+  auto chunk_vec = [&](size_t i) {
+    return vectors.data() + (begin + i) * dim_;
+  };
+  int32_t l = std::max(param_.l(), r_);
+  float alpha = param_.alpha();
+
+  // 只有 Persist 修改图，而 Persist 已串行化，读锁之间图不会变化
+  std::shared_lock<std::shared_mutex> slk(mu_);
+
+  // 已在图中的 id 原地覆盖，新 id 追加到图尾
+  uint32_t node_num = node_num_;
+  std::vector<uint32_t> nodes(count);
+  std::unordered_map<uint32_t, size_t> chunk_pos;
+  for (size_t i = 0; i < count; ++i) {
+    auto it = id_to_node_.find(ids[begin + i]);
+    nodes[i] = it != id_to_node_.end() ? it->second : node_num++;
+    chunk_pos[nodes[i]] = i;
+  }
+
+  // 每个新节点在磁盘图上做贪心搜索，候选加上本批的其他节点后剪枝
+  std::vector<std::vector<uint32_t>> links(count);
+  std::vector<RetNo> rets(count, RET_OK);
+  DefaultThreadPool().ParallelFor(0, count, [&](int64_t i) {
+    std::vector<std::pair<float, uint32_t>> expanded;
+    std::unordered_map<uint32_t, std::vector<float>> seen;
+    rets[i] =
+        DiskSearch(chunk_vec(i), l, l, expanded, &seen, nullptr, nullptr);
+    if (rets[i] != RET_OK) {
+      return;
+    }
+
+    // 本批覆盖的节点在磁盘上还是旧向量，以本批为准
+    std::vector<std::pair<float, uint32_t>> candidates;
+    for (const auto &e : expanded) {
+      if (chunk_pos.count(e.second) == 0) {
+        candidates.push_back(e);
+      }
+    }
+    for (size_t j = 0; j < count; ++j) {
+      if (j != static_cast<size_t>(i)) {
+        candidates.emplace_back(
+            dist_func_(chunk_vec(i), chunk_vec(j), dist_param_), nodes[j]);
+      }
+    }
+    auto vec = [&](uint32_t node) -> const float * {
+      auto it = chunk_pos.find(node);
+      return it != chunk_pos.end() ? chunk_vec(it->second)
+                                   : seen[node].data();
+    };
+    links[i] = RobustPrune(vec, nodes[i], candidates, alpha);
+  });
+  for (RetNo ret : rets) {
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  std::map<uint32_t, NodeRecord> records;
+  std::vector<uint8_t> codes(count * pq_->code_size());
+  for (size_t i = 0; i < count; ++i) {
+    NodeRecord &record = records[nodes[i]];
+    record.vector.assign(chunk_vec(i), chunk_vec(i) + dim_);
+    record.neighbors = links[i];
+    pq_->Encode(chunk_vec(i), codes.data() + i * pq_->code_size());
+  }
+
+  // 反向边：被指向的节点加上新节点，出度超过 R 时重新剪枝
+  std::map<uint32_t, std::vector<uint32_t>> incoming;
+  for (size_t i = 0; i < count; ++i) {
+    for (uint32_t q : links[i]) {
+      incoming[q].push_back(nodes[i]);
+    }
+  }
+  std::vector<uint32_t> targets;
+  for (const auto &pair : incoming) {
+    targets.push_back(pair.first);
+  }
+  std::vector<NodeRecord> patched(targets.size());
+  rets.assign(targets.size(), RET_OK);
+  DefaultThreadPool().ParallelFor(0, targets.size(), [&](int64_t t) {
+    uint32_t q = targets[t];
+    NodeRecord &record = patched[t];
+    if (chunk_pos.count(q) > 0) {
+      record = records.at(q);
+    } else {
+      rets[t] = ReadNode(q, record);
+      if (rets[t] != RET_OK) {
+        return;
+      }
+    }
+    for (uint32_t p : incoming.at(q)) {
+      if (std::find(record.neighbors.begin(), record.neighbors.end(), p) ==
+          record.neighbors.end()) {
+        record.neighbors.push_back(p);
+      }
+    }
+    if (record.neighbors.size() <= static_cast<size_t>(r_)) {
+      return;
+    }
+
+    // 剪枝需要所有邻居的向量，不在本批的从磁盘读取
+    std::unordered_map<uint32_t, std::vector<float>> others;
+    for (uint32_t x : record.neighbors) {
+      if (chunk_pos.count(x) > 0) {
+        continue;
+      }
+      NodeRecord neighbor;
+      rets[t] = ReadNode(x, neighbor);
+      if (rets[t] != RET_OK) {
+        return;
+      }
+      others[x] = std::move(neighbor.vector);
+    }
+    auto vec = [&](uint32_t node) -> const float * {
+      if (node == q) {
+        return record.vector.data();
+      }
+      auto it = chunk_pos.find(node);
+      return it != chunk_pos.end() ? chunk_vec(it->second)
+                                   : others[node].data();
+    };
+    std::vector<std::pair<float, uint32_t>> pool;
+    for (uint32_t x : record.neighbors) {
+      pool.emplace_back(dist_func_(vec(q), vec(x), dist_param_), x);
+    }
+    record.neighbors = RobustPrune(vec, q, pool, alpha);
+  });
+  for (RetNo ret : rets) {
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  for (size_t t = 0; t < targets.size(); ++t) {
+    records[targets[t]] = std::move(patched[t]);
+  }
+  slk.unlock();
+
+  // 写回修改过的节点，最后提交节点数
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  RetNo ret = WriteNodes(records, node_num);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  ids_.resize(node_num);
+  codes_.resize(static_cast<size_t>(node_num) * pq_->code_size());
+  for (size_t i = 0; i < count; ++i) {
+    ids_[nodes[i]] = ids[begin + i];
+    id_to_node_[ids[begin + i]] = nodes[i];
+    memcpy(codes_.data() + static_cast<size_t>(nodes[i]) * pq_->code_size(),
+           codes.data() + i * pq_->code_size(), pq_->code_size());
+  }
+  node_num_ = node_num;
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::ReadNode(uint32_t node, NodeRecord &record) const {
+  auto buf = AlignedAlloc(NodeReadSize());
+  RetNo ret = ReadSectors(NodeSector(node), sectors_per_node_, buf.get());
+  if (ret != RET_OK) {
+    return ret;
+  }
+  sector_reads_ += sectors_per_node_;
+
+  const char *data = buf.get() + NodeOffset(node);
+  const float *vector = reinterpret_cast<const float *>(data);
+  record.vector.assign(vector, vector + dim_);
+  uint32_t degree = 0;
+  memcpy(&degree, data + dim_ * sizeof(float), sizeof(degree));
+  degree = std::min<uint32_t>(degree, r_);
+  const char *neighbors = data + dim_ * sizeof(float) + sizeof(degree);
+  record.neighbors.clear();
+  for (uint32_t j = 0; j < degree; ++j) {
+    uint32_t neighbor = 0;
+    memcpy(&neighbor, neighbors + j * sizeof(neighbor), sizeof(neighbor));
+    // 中途退出的合并可能留下指向未提交节点的边
+    if (neighbor < node_num_) {
+      record.neighbors.push_back(neighbor);
+    }
+  }
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::WriteNodes(const std::map<uint32_t, NodeRecord> &records,
+                               uint32_t node_num) {
+  int fd = open(data_file_.c_str(), O_RDWR);
+  if (fd < 0) {
+    return RET_ERROR;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return RET_ERROR;
+  }
+  uint64_t file_sectors = st.st_size / kSectorSize;
+
+  // 同一块内的节点一起读改写，map 按节点有序，同块的节点相邻
+  size_t block_size = NodeReadSize();
+  std::vector<char> block(block_size);
+  bool ok = true;
+  auto it = records.begin();
+  while (ok && it != records.end()) {
+    uint64_t sector = NodeSector(it->first);
+    if (sector < file_sectors) {
+      ok = pread(fd, block.data(), block_size, sector * kSectorSize) ==
+           static_cast<ssize_t>(block_size);
+    } else {
+      std::fill(block.begin(), block.end(), 0);
+    }
+    for (; ok && it != records.end() && NodeSector(it->first) == sector;
+         ++it) {
+      char *record = block.data() + NodeOffset(it->first);
+      memset(record, 0, node_size_);
+      memcpy(record, it->second.vector.data(), dim_ * sizeof(float));
+      uint32_t degree = it->second.neighbors.size();
+      memcpy(record + dim_ * sizeof(float), &degree, sizeof(degree));
+      memcpy(record + dim_ * sizeof(float) + sizeof(degree),
+             it->second.neighbors.data(), degree * sizeof(uint32_t));
+    }
+    ok = ok && pwrite(fd, block.data(), block_size, sector * kSectorSize) ==
+                   static_cast<ssize_t>(block_size);
+  }
+
+  // 节点记录落盘后再提交头部的节点数
+  DataHeader header;
+  ok = ok && fdatasync(fd) == 0 &&
+       pread(fd, &header, sizeof(header), 0) ==
+           static_cast<ssize_t>(sizeof(header));
+  if (ok) {
+    header.node_num = node_num;
+    ok = pwrite(fd, &header, sizeof(header), 0) ==
+             static_cast<ssize_t>(sizeof(header)) &&
+         fdatasync(fd) == 0;
+  }
+  close(fd);
+  return ok ? RET_OK : RET_ERROR;
+}
+
+RetNo DiskAnnIndex::OpenFiles() {
+  std::ifstream mem(mem_file_, std::ios::binary);
+  if (!mem) {
+    return RET_NOT_FOUND;
+  }
+  uint64_t magic = 0;
+  uint32_t n = 0;
+  mem.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  mem.read(reinterpret_cast<char *>(&n), sizeof(n));
+  if (!mem || magic != kMemMagic) {
+    return RET_ERROR;
+  }
+
+  ids_.resize(n);
+  mem.read(reinterpret_cast<char *>(ids_.data()), n * sizeof(int64_t));
+  pq_ = std::make_unique<ProductQuantizer>(dim_, param_.pq_m(),
+                                           param_.distance_type());
+  RetNo ret = pq_->Load(mem);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  codes_.resize(static_cast<size_t>(n) * pq_->code_size());
+  mem.read(reinterpret_cast<char *>(codes_.data()), codes_.size());
+  if (!mem) {
+    return RET_ERROR;
+  }
+
+  id_to_node_.clear();
+  id_to_node_.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    id_to_node_[ids_[i]] = i;
+  }
+
+  // O_DIRECT 绕过页缓存，文件系统不支持时退回普通读
+  fd_ = open(data_file_.c_str(), O_RDONLY | O_DIRECT);
+  if (fd_ < 0) {
+    fd_ = open(data_file_.c_str(), O_RDONLY);
+  }
+  if (fd_ < 0) {
+    return RET_ERROR;
+  }
+
+  auto buf = AlignedAlloc(kSectorSize);
+  ret = ReadSectors(0, 1, buf.get());
+  if (ret != RET_OK) {
+    return ret;
+  }
+  // 增量插入先提交数据文件再写 mem 文件，中途退出时数据文件中
+  // 多出的节点不在 mem 文件里，忽略它们
+  DataHeader header;
+  memcpy(&header, buf.get(), sizeof(header));
+  if (header.magic != kDataMagic || header.dim != static_cast<uint32_t>(dim_) ||
+      header.node_num < n) {
+    return RET_ERROR;
+  }
+
+  r_ = header.r;
+  node_num_ = n;
+  medoid_ = header.medoid;
+  node_size_ = header.node_size;
+  nodes_per_sector_ = header.nodes_per_sector;
+  sectors_per_node_ = header.sectors_per_node;
+  return RET_OK;
+}
+
+void DiskAnnIndex::CloseFiles() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  node_num_ = 0;
+  medoid_ = 0;
+  pq_.reset();
+  codes_.clear();
+  ids_.clear();
+  id_to_node_.clear();
+}
+
+uint64_t DiskAnnIndex::NodeSector(uint32_t node) const {
+  return 1 + static_cast<uint64_t>(node / nodes_per_sector_) *
+                 sectors_per_node_;
+}
+
+size_t DiskAnnIndex::NodeOffset(uint32_t node) const {
+  return (node % nodes_per_sector_) * node_size_;
+}
+
+RetNo DiskAnnIndex::ReadSectors(uint64_t sector, size_t count,
+                                char *buf) const {
+  size_t size = count * kSectorSize;
+  off_t offset = sector * kSectorSize;
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd_, buf + done, size - done, offset + done);
+    if (n <= 0) {
+      return RET_ERROR;
+    }
+    done += n;
+  }
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::ScanNodes(
+    const std::function<RetNo(uint32_t node, const float *vector)> &func)
+    const {
+  if (node_num_ == 0) {
+    return RET_OK;
+  }
+
+  // 按文件顺序成批读取扇区
+  size_t chunk_nodes =
+      nodes_per_sector_ *
+      std::max<size_t>(1, kScanSectors / sectors_per_node_);
+  size_t chunk_sectors = (chunk_nodes / nodes_per_sector_) * sectors_per_node_;
+  auto buf = AlignedAlloc(chunk_sectors * kSectorSize);
+
+  for (uint32_t first = 0; first < node_num_; first += chunk_nodes) {
+    uint32_t last = std::min<uint64_t>(node_num_, first + chunk_nodes);
+    uint64_t first_sector = NodeSector(first);
+    size_t sectors = NodeSector(last - 1) - first_sector + sectors_per_node_;
+    RetNo ret = ReadSectors(first_sector, sectors, buf.get());
+    if (ret != RET_OK) {
+      return ret;
+    }
+    sector_reads_ += sectors;
+
+    for (uint32_t node = first; node < last; ++node) {
+      const char *record = buf.get() +
+                           (NodeSector(node) - first_sector) * kSectorSize +
+                           NodeOffset(node);
+      ret = func(node, reinterpret_cast<const float *>(record));
+      if (ret != RET_OK) {
+        return ret;
+      }
+    }
+  }
+  return RET_OK;
+}
+
+RetNo DiskAnnIndex::Search(const float *query, int32_t k, int32_t l,
+                           std::vector<int64_t> &ids,
+                           std::vector<float> &distances,
+                           const ROptions &options) {
+  ids.clear();
+  distances.clear();
+  if (k <= 0) {
+    return RET_OK;
+  }
+  if (l <= 0) {
+    l = param_.l();
+  }
+
+  // 先扫描暂存区再搜索图，Persist 替换图期间的向量至少出现在一边。
+  // 暂存区有上限，扫描完再检查限制，超出时不再搜索图
+  SearchLimit limit(options);
+  bool exceeded = false;
+  // 本次查询的计数，结束时写入 options.profile
+  SearchProfile counts;
+  std::vector<std::pair<float, int64_t>> results;
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    for (size_t i = 0; i < pending_ids_.size(); ++i) {
+      if (pending_live_[i]) {
+        results.emplace_back(
+            dist_func_(query, pending_vectors_.data() + i * dim_, dist_param_),
+            pending_ids_[i]);
+      }
+    }
+    distance_computations_ += pending_ids_.size();
+    counts.distance_computations += results.size();
+    counts.visited += results.size();
+    exceeded = !pending_ids_.empty() && limit.Exceeded(pending_ids_.size());
+  }
+
+  std::vector<std::pair<float, int64_t>> graph_results;
+  if (!exceeded) {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    std::vector<std::pair<float, uint32_t>> expanded;
+    RetNo ret = DiskSearch(query, k, l, expanded, nullptr, &limit, &counts);
+    if (ret != RET_OK && ret != RET_PARTIAL) {
+      return ret;
+    }
+    exceeded = ret == RET_PARTIAL;
+    for (const auto &e : expanded) {
+      graph_results.emplace_back(e.first, ids_[e.second]);
+    }
+  }
+
+  // 在暂存区中的 id 说明图中的向量已被覆盖
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    for (const auto &result : graph_results) {
+      if (pending_pos_.count(result.second) == 0) {
+        results.push_back(result);
+      } else {
+        counts.filter_rejections++;
+      }
+    }
+  }
+  if (options.profile) {
+    options.profile->Add(counts);
+  }
+
+  std::sort(results.begin(), results.end());
+  std::unordered_set<int64_t> seen;
+  for (const auto &result : results) {
+    if (ids.size() >= static_cast<size_t>(k)) {
+      break;
+    }
+    if (seen.insert(result.second).second) {
+      ids.push_back(result.second);
+      distances.push_back(result.first);
+    }
+  }
+  return exceeded ? RET_PARTIAL : RET_OK;
+}
+
+RetNo DiskAnnIndex::DiskSearch(
+    const float *query, int32_t k, int32_t l,
+    std::vector<std::pair<float, uint32_t>> &expanded,
+    std::unordered_map<uint32_t, std::vector<float>> *vectors,
+    SearchLimit *limit, SearchProfile *counts) {
+  if (node_num_ == 0) {
+    return RET_OK;
+  }
+  size_t list_size = std::max(l, k);
+
+  // 内存中只有 PQ 编码，用查表距离决定下一步读哪些节点
+  std::vector<float> table(pq_->table_size());
+  pq_->ComputeTable(query, table.data());
+  auto pq_distance = [&](uint32_t node) {
+    return pq_->TableDistance(
+        table.data(),
+        codes_.data() + static_cast<size_t>(node) * pq_->code_size());
+  };
+
+  std::vector<Candidate> pool;
+  std::unordered_set<uint32_t> visited;
+  pool.push_back(Candidate{pq_distance(medoid_), medoid_, false});
+  visited.insert(medoid_);
+  if (counts) {
+    counts->visited++;
+    counts->distance_computations++;
+  }
+
+  size_t beam_width = param_.beam_width();
+  size_t read_size = NodeReadSize();
+  auto buf = AlignedAlloc(read_size * beam_width);
+  std::vector<uint32_t> beam;
+  std::vector<RetNo> rets;
+  bool exceeded = false;
+  while (!exceeded) {
+    beam.clear();
+    for (auto &c : pool) {
+      if (!c.expanded) {
+        c.expanded = true;
+        beam.push_back(c.node);
+        if (beam.size() == beam_width) {
+          break;
+        }
+      }
+    }
+    if (beam.empty()) {
+      break;
+    }
+
+    // 一轮内的节点并行读取，SSD 的队列深度越大吞吐越高
+    rets.assign(beam.size(), RET_OK);
+    auto read_one = [&](int64_t i) {
+      rets[i] = ReadSectors(NodeSector(beam[i]), sectors_per_node_,
+                            buf.get() + i * read_size);
+    };
+    if (beam.size() == 1) {
+      read_one(0);
+    } else {
+      DefaultThreadPool().ParallelFor(0, beam.size(), read_one);
+    }
+    hops_++;
+    sector_reads_ += beam.size() * sectors_per_node_;
+    if (counts) {
+      counts->hops++;
+    }
+
+    // 每轮检查一次限制，超出时返回已经展开的节点
+    int64_t computations = 0;
+    for (size_t i = 0; i < beam.size(); ++i) {
+      if (rets[i] != RET_OK) {
+        return rets[i];
+      }
+      const char *record = buf.get() + i * read_size + NodeOffset(beam[i]);
+
+      // 读到了原始向量，顺便算出精确距离
+      const float *vector = reinterpret_cast<const float *>(record);
+      expanded.emplace_back(dist_func_(query, vector, dist_param_), beam[i]);
+      if (vectors) {
+        (*vectors)[beam[i]].assign(vector, vector + dim_);
+      }
+
+      uint32_t degree = 0;
+      memcpy(&degree, record + dim_ * sizeof(float), sizeof(degree));
+      degree = std::min<uint32_t>(degree, r_);
+      const char *neighbors = record + dim_ * sizeof(float) + sizeof(degree);
+      for (uint32_t j = 0; j < degree; ++j) {
+        uint32_t neighbor = 0;
+        memcpy(&neighbor, neighbors + j * sizeof(neighbor), sizeof(neighbor));
+        if (neighbor < node_num_ && visited.insert(neighbor).second) {
+          InsertCandidate(pool,
+                          Candidate{pq_distance(neighbor), neighbor, false},
+                          list_size);
+          if (counts) {
+            counts->visited++;
+          }
+        }
+      }
+      distance_computations_ += degree + 1;
+      computations += degree + 1;
+    }
+    if (counts) {
+      counts->distance_computations += computations;
+    }
+    exceeded = limit && limit->Exceeded(computations);
+  }
+
+  return exceeded ? RET_PARTIAL : RET_OK;
+}
+
+RetNo DiskAnnIndex::GetVector(int64_t id, std::vector<float> &vector) {
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    auto it = pending_pos_.find(id);
+    if (it != pending_pos_.end()) {
+      vector.assign(pending_vectors_.begin() + it->second * dim_,
+                    pending_vectors_.begin() + (it->second + 1) * dim_);
+      return RET_OK;
+    }
+  }
+
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  auto it = id_to_node_.find(id);
+  if (it == id_to_node_.end()) {
+    return RET_NOT_FOUND;
+  }
+
+  auto buf = AlignedAlloc(NodeReadSize());
+  RetNo ret = ReadSectors(NodeSector(it->second), sectors_per_node_, buf.get());
+  if (ret != RET_OK) {
+    return ret;
+  }
+  sector_reads_ += sectors_per_node_;
+
+  const float *data =
+      reinterpret_cast<const float *>(buf.get() + NodeOffset(it->second));
+  vector.assign(data, data + dim_);
+  return RET_OK;
+}
+
+bool DiskAnnIndex::Contains(int64_t id) const {
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    if (pending_pos_.count(id) > 0) {
+      return true;
+    }
+  }
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  return id_to_node_.count(id) > 0;
+}
+
+RetNo DiskAnnIndex::ForEachVector(
+    const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+        &func) {
+  // 复制暂存区，回调中可以继续写入
+  std::vector<int64_t> ids;
+  std::vector<float> vectors;
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    for (size_t i = 0; i < pending_ids_.size(); ++i) {
+      if (pending_live_[i]) {
+        ids.push_back(pending_ids_[i]);
+        vectors.insert(vectors.end(), pending_vectors_.begin() + i * dim_,
+                       pending_vectors_.begin() + (i + 1) * dim_);
+      }
+    }
+  }
+  std::unordered_set<int64_t> replaced(ids.begin(), ids.end());
+
+  std::vector<float> v(dim_);
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    RetNo ret = ScanNodes([&](uint32_t node, const float *vector) {
+      if (replaced.count(ids_[node]) > 0) {
+        return RET_OK;
+      }
+      v.assign(vector, vector + dim_);
+      return func(ids_[node], v);
+    });
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    v.assign(vectors.begin() + i * dim_, vectors.begin() + (i + 1) * dim_);
+    RetNo ret = func(ids[i], v);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+int64_t DiskAnnIndex::Size() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  std::lock_guard<std::mutex> lg(pending_mu_);
+  int64_t size = node_num_;
+  for (const auto &pair : pending_pos_) {
+    if (id_to_node_.count(pair.first) == 0) {
+      size++;
+    }
+  }
+  return size;
+}
+
+int64_t DiskAnnIndex::MemoryUsage() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  int64_t bytes = codes_.size() + ids_.size() * sizeof(int64_t);
+  if (pq_) {
+    bytes += static_cast<int64_t>(pq_->table_size()) * pq_->dim() /
+             pq_->m() * sizeof(float);
+  }
+  bytes += id_to_node_.size() *
+           (sizeof(int64_t) + sizeof(uint32_t) + sizeof(void *));
+
+  std::lock_guard<std::mutex> lg(pending_mu_);
+  bytes += pending_vectors_.size() * sizeof(float) +
+           pending_ids_.size() * sizeof(int64_t);
+  return bytes;
+}
+
+json DiskAnnIndex::Stats() const {
+  json j;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    j["graph_size"] = node_num_;
+    j["R"] = r_;
+    j["pq_m"] = pq_ ? pq_->m() : 0;
+    j["disk_bytes"] =
+        node_num_ == 0 ? 0 : (NodeSector(node_num_ - 1) + sectors_per_node_) *
+                                 kSectorSize;
+  }
+  {
+    std::lock_guard<std::mutex> lg(pending_mu_);
+    j["pending"] = pending_pos_.size();
+  }
+  j["hops"] = hops_.load();
+  j["sector_reads"] = sector_reads_.load();
+  j["distance_computations"] = distance_computations_.load();
+  return j;
+}
+
+}  // namespace vectordb
@@ -0,0 +1,199 @@
+#ifndef VECTORDB_DISKANN_H
+#define VECTORDB_DISKANN_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "hnswlib/hnswlib.h"
+#include "options.h"
+#include "quantizer.h"
+#include "retno.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+// SSD resident Vamana graph, the DiskANN layout.
+//
+// path/diskann.data holds one record per node: the fp32 vector, the degree
+// and R neighbor slots. Records are packed into 4KB sectors and never
+// straddle a sector boundary, so one aligned read fetches a whole node.
+// path/diskann.mem holds what stays in RAM: the PQ codebook, the PQ code of
+// every node and the external ids.
+//
+// Search walks the graph with PQ distances, reading the beam_width closest
+// unexpanded nodes per round in parallel, and ranks the expanded nodes by
+// the exact distance of the vectors read from disk.
+//
+// Add stages vectors in memory, they are searched by brute force until
+// Persist merges them into the graph. At most max_pending are staged, the
+// Add that fills the buffer merges it. While the graph is no larger than
+// the staged batch it is rebuilt in memory. Otherwise the batch is
+// inserted in chunks, every new node is linked by a greedy search of the
+// disk graph, and only the records of the new nodes and of the neighbors
+// that gain a back edge are written to the data file.
+class DiskAnnIndex final {
+ public:
+  static const int32_t kSectorSize = 4096;
+  static const int64_t kDefaultMaxPending = 1 << 16;
+
+  DiskAnnIndex(const std::string &path, const vdb::DiskAnnParam &param,
+               int64_t max_pending = kDefaultMaxPending);
+  ~DiskAnnIndex();
+
+  DiskAnnIndex(const DiskAnnIndex &) = delete;
+  DiskAnnIndex &operator=(const DiskAnnIndex &) = delete;
+
+  // open the files under path if they exist
+  RetNo Load();
+
+  RetNo Add(int64_t id, const std::vector<float> &vector);
+
+  // merge the staged vectors into the graph
+  RetNo Persist();
+
+  // l is the candidate list length, <= 0 means param L. Under the deadline
+  // or distance budget of options the graph walk stops early and returns
+  // the best results so far with RET_PARTIAL
+  RetNo Search(const float *query, int32_t k, int32_t l,
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               const ROptions &options = ROptions());
+
+  RetNo GetVector(int64_t id, std::vector<float> &vector);
+
+  // id is staged or in the graph
+  bool Contains(int64_t id) const;
+
+  RetNo ForEachVector(
+      const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+          &func);
+
+  int64_t Size() const;
+  int64_t MemoryUsage() const;
+
+  // graph size, hops, sector reads, distance computations
+  json Stats() const;
+
+ private:
+  // a node record read from or written to the data file
+  struct NodeRecord {
+    std::vector<float> vector;
+    std::vector<uint32_t> neighbors;
+  };
+
+  // the graph vectors plus the staged ones, rebuilt in memory
+  RetNo Rebuild(std::vector<int64_t> &ids, std::vector<float> &vectors);
+  RetNo Build(const std::vector<int64_t> &ids,
+              const std::vector<float> &vectors);
+  void BuildGraph(const std::vector<float> &vectors, uint32_t n,
+                  uint32_t medoid, std::vector<std::vector<uint32_t>> &graph);
+  void GreedySearch(const std::vector<float> &vectors,
+                    const std::vector<std::vector<uint32_t>> &graph,
+                    std::vector<std::mutex> &locks, uint32_t medoid,
+                    const float *query, int32_t l,
+                    std::vector<std::pair<float, uint32_t>> &expanded);
+
+  // vec(node) is the vector of node
+  template <typename VecFunc>
+  std::vector<uint32_t> RobustPrune(
+      const VecFunc &vec, uint32_t node,
+      std::vector<std::pair<float, uint32_t>> &candidates, float alpha);
+  RetNo WriteFiles(const std::vector<int64_t> &ids,
+                   const std::vector<float> &vectors,
+                   const std::vector<std::vector<uint32_t>> &graph,
+                   uint32_t medoid, const std::string &suffix);
+  RetNo WriteMem(const std::vector<int64_t> &ids, const ProductQuantizer &pq,
+                 const std::vector<uint8_t> &codes,
+                 const std::string &file) const;
+
+  // insert the vectors into the disk graph chunk by chunk
+  RetNo Insert(const std::vector<int64_t> &ids,
+               const std::vector<float> &vectors);
+  RetNo InsertChunk(const std::vector<int64_t> &ids,
+                    const std::vector<float> &vectors, size_t begin,
+                    size_t end);
+
+  // mu_ must be held
+  RetNo ReadNode(uint32_t node, NodeRecord &record) const;
+
+  // write the records, then commit node_num in the header, mu_ must be
+  // held exclusive
+  RetNo WriteNodes(const std::map<uint32_t, NodeRecord> &records,
+                   uint32_t node_num);
+
+  RetNo OpenFiles();
+  void CloseFiles();
+
+  // sector of the first byte of node and the offset of node inside it
+  uint64_t NodeSector(uint32_t node) const;
+  size_t NodeOffset(uint32_t node) const;
+  size_t NodeReadSize() const { return sectors_per_node_ * kSectorSize; }
+  RetNo ReadSectors(uint64_t sector, size_t count, char *buf) const;
+
+  // read every node of the graph in file order, mu_ must be held
+  RetNo ScanNodes(
+      const std::function<RetNo(uint32_t node, const float *vector)> &func)
+      const;
+
+  // every expanded node of the graph walk with its exact distance, not cut
+  // to k so the caller can drop the ids replaced by staged vectors first,
+  // vectors gets the vectors read if not null, mu_ must be held.
+  // RET_PARTIAL when limit (if not null) stopped the walk, the work is
+  // added to counts if not null
+  RetNo DiskSearch(const float *query, int32_t k, int32_t l,
+                   std::vector<std::pair<float, uint32_t>> &expanded,
+                   std::unordered_map<uint32_t, std::vector<float>> *vectors,
+                   SearchLimit *limit, SearchProfile *counts);
+
+ private:
+  std::string data_file_;
+  std::string mem_file_;
+  vdb::DiskAnnParam param_;
+  int64_t max_pending_;
+  int32_t dim_;
+  int32_t r_;
+
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
+  hnswlib::DISTFUNC<float> dist_func_;
+  void *dist_param_;
+
+  // the graph on disk, swapped by Persist
+  mutable std::shared_mutex mu_;
+  int fd_;
+  uint32_t node_num_;
+  uint32_t medoid_;
+  size_t node_size_;
+  uint32_t nodes_per_sector_;
+  uint32_t sectors_per_node_;
+  std::unique_ptr<ProductQuantizer> pq_;
+  std::vector<uint8_t> codes_;
+  std::vector<int64_t> ids_;
+  std::unordered_map<int64_t, uint32_t> id_to_node_;
+
+  // vectors added since the last Persist in add order, a later add of the
+  // same id appends a new entry and marks the old one dead
+  mutable std::mutex pending_mu_;
+  std::vector<int64_t> pending_ids_;
+  std::vector<float> pending_vectors_;
+  std::vector<bool> pending_live_;
+  std::unordered_map<int64_t, size_t> pending_pos_;  // live entry of id
+
+  std::mutex persist_mu_;
+
+  mutable std::atomic<uint64_t> hops_;
+  mutable std::atomic<uint64_t> sector_reads_;
+  mutable std::atomic<uint64_t> distance_computations_;
+};
+
+using DiskAnnIndexUPtr = std::unique_ptr<DiskAnnIndex>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_DISKANN_H
@@ -0,0 +1,276 @@
+#include "diskann.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "distance.h"
+#include "quantizer.h"
+#include "search_profile.h"
+#include "test_util.h"
+
+const std::string kTestDir = "/tmp/diskann_test";
+const int32_t kDim = 16;
+
+vdb::DiskAnnParam TestParam() {
+  vdb::DiskAnnParam param;
+  param.set_dim(kDim);
+  param.set_max_elements(10000);
+  param.set_r(24);
+  param.set_l(64);
+  param.set_alpha(1.2);
+  param.set_pq_m(8);
+  param.set_beam_width(4);
+  param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  return param;
+}
+
+// PQ 解码后的向量与原向量接近，查表距离接近精确距离
+TEST(DiskAnnTest, ProductQuantizer) {
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(2000, kDim, 1, 0.0f, 1.0f);
+  std::vector<float> data;
+  for (const auto &vector : base) {
+    data.insert(data.end(), vector.begin(), vector.end());
+  }
+
+  // m 被调整为 dim 的约数
+  vectordb::ProductQuantizer odd(kDim, 5, vectordb::DISTANCE_TYPE_L2);
+  EXPECT_EQ(4, odd.m());
+
+  vectordb::ProductQuantizer pq(kDim, 8, vectordb::DISTANCE_TYPE_L2);
+  ASSERT_EQ(vectordb::RET_OK, pq.Train(data.data(), base.size()));
+  EXPECT_TRUE(pq.trained());
+
+  std::vector<uint8_t> code(pq.code_size());
+  std::vector<float> decoded(kDim);
+  std::vector<float> table(pq.table_size());
+  pq.ComputeTable(base[1].data(), table.data());
+  for (int32_t i = 0; i < 100; ++i) {
+    pq.Encode(base[i].data(), code.data());
+    pq.Decode(code.data(), decoded.data());
+    EXPECT_LT(vectordb::L2(base[i], decoded), 0.2f * kDim / 12);
+    EXPECT_NEAR(vectordb::L2(base[1], decoded),
+                pq.TableDistance(table.data(), code.data()), 1e-4);
+  }
+}
+
+// 构建图后的召回率，以及重新打开后的搜索结果
+TEST(DiskAnnTest, BuildSearchLoad) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+  fs::create_directories(kTestDir);
+
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(3000, kDim, 2, 0.0f, 1.0f);
+  std::vector<std::vector<float>> queries =
+      vectordb::RandomVectors(50, kDim, 3, 0.0f, 1.0f);
+  const int32_t k = 10;
+
+  std::vector<std::vector<int64_t>> before;
+  {
+    vectordb::DiskAnnIndex index(kTestDir, TestParam());
+    for (size_t i = 0; i < base.size(); ++i) {
+      ASSERT_EQ(vectordb::RET_OK, index.Add(i, base[i]));
+    }
+    EXPECT_EQ(3000, index.Size());
+    ASSERT_EQ(vectordb::RET_OK, index.Persist());
+    EXPECT_EQ(3000, index.Size());
+
+    int32_t hits = 0;
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    for (const auto &query : queries) {
+      ASSERT_EQ(vectordb::RET_OK, index.Search(query.data(), k, 100, ids,
+                                               distances));
+      ASSERT_EQ(static_cast<size_t>(k), ids.size());
+      EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+      std::set<int64_t> truth = vectordb::BruteForce(base, query, k);
+      for (int64_t id : ids) {
+        hits += truth.count(id);
+      }
+      before.push_back(ids);
+    }
+    EXPECT_GE(hits, 0.9 * k * queries.size());
+
+    json stats = index.Stats();
+    EXPECT_EQ(3000, stats["graph_size"].get<int64_t>());
+    EXPECT_EQ(0, stats["pending"].get<int64_t>());
+    EXPECT_GT(stats["sector_reads"].get<int64_t>(), 0);
+  }
+
+  vectordb::DiskAnnIndex index(kTestDir, TestParam());
+  ASSERT_EQ(vectordb::RET_OK, index.Load());
+  EXPECT_EQ(3000, index.Size());
+
+  std::vector<float> vector;
+  ASSERT_EQ(vectordb::RET_OK, index.GetVector(42, vector));
+  EXPECT_EQ(base[42], vector);
+  EXPECT_EQ(vectordb::RET_NOT_FOUND, index.GetVector(3000, vector));
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    index.Search(queries[i].data(), k, 100, ids, distances);
+    EXPECT_EQ(before[i], ids);
+  }
+
+  int64_t count = 0;
+  index.ForEachVector([&](int64_t id, const std::vector<float> &v) {
+    EXPECT_EQ(base[id], v);
+    count++;
+    return vectordb::RET_OK;
+  });
+  EXPECT_EQ(3000, count);
+}
+
+// 暂存区的向量在 Persist 前可以搜到，覆盖写入以新向量为准
+TEST(DiskAnnTest, PendingUpdates) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+  fs::create_directories(kTestDir);
+
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(500, kDim, 4, 0.0f, 1.0f);
+  vectordb::DiskAnnIndex index(kTestDir, TestParam());
+  for (size_t i = 0; i < base.size(); ++i) {
+    index.Add(i, base[i]);
+  }
+  ASSERT_EQ(vectordb::RET_OK, index.Persist());
+
+  std::vector<float> far(kDim, 10.0f);
+  index.Add(7, far);
+  index.Add(500, std::vector<float>(kDim, -10.0f));
+  EXPECT_EQ(501, index.Size());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  index.Search(far.data(), 1, 0, ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(7, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+
+  // 图中 id 7 的旧向量不再返回
+  index.Search(base[7].data(), 3, 0, ids, distances);
+  EXPECT_EQ(ids.end(), std::find(ids.begin(), ids.end(), 7));
+
+  ASSERT_EQ(vectordb::RET_OK, index.Persist());
+  EXPECT_EQ(501, index.Size());
+  EXPECT_EQ(0, index.Stats()["pending"].get<int64_t>());
+
+  std::vector<float> vector;
+  ASSERT_EQ(vectordb::RET_OK, index.GetVector(7, vector));
+  EXPECT_EQ(far, vector);
+  index.Search(far.data(), 1, 0, ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(7, ids[0]);
+}
+
+// 暂存区有上限，写满后增量插入图中，召回率和重新打开后的结果不变
+TEST(DiskAnnTest, IncrementalMerge) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+  fs::create_directories(kTestDir);
+
+  const int64_t max_pending = 200;
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(2000, kDim, 5, 0.0f, 1.0f);
+  std::vector<std::vector<float>> queries =
+      vectordb::RandomVectors(50, kDim, 6, 0.0f, 1.0f);
+  const int32_t k = 10;
+  {
+    vectordb::DiskAnnIndex index(kTestDir, TestParam(), max_pending);
+    for (size_t i = 0; i < base.size(); ++i) {
+      ASSERT_EQ(vectordb::RET_OK, index.Add(i, base[i]));
+      EXPECT_LT(index.Stats()["pending"].get<int64_t>(), max_pending);
+    }
+
+    // 覆盖图中已有的 id
+    std::vector<std::vector<float>> updates =
+        vectordb::RandomVectors(2, kDim, 7, 0.0f, 1.0f);
+    base[3] = updates[0];
+    base[1500] = updates[1];
+    index.Add(3, base[3]);
+    index.Add(1500, base[1500]);
+    ASSERT_EQ(vectordb::RET_OK, index.Persist());
+    EXPECT_EQ(2000, index.Size());
+    EXPECT_EQ(2000, index.Stats()["graph_size"].get<int64_t>());
+  }
+
+  vectordb::DiskAnnIndex index(kTestDir, TestParam(), max_pending);
+  ASSERT_EQ(vectordb::RET_OK, index.Load());
+  EXPECT_EQ(2000, index.Size());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  for (int64_t id : {3, 1500, 1999}) {
+    index.Search(base[id].data(), 1, 100, ids, distances);
+    ASSERT_EQ(1u, ids.size());
+    EXPECT_EQ(id, ids[0]);
+    EXPECT_FLOAT_EQ(0.0f, distances[0]);
+  }
+
+  int32_t hits = 0;
+  for (const auto &query : queries) {
+    index.Search(query.data(), k, 100, ids, distances);
+    std::set<int64_t> truth = vectordb::BruteForce(base, query, k);
+    for (int64_t id : ids) {
+      hits += truth.count(id);
+    }
+  }
+  EXPECT_GE(hits, 0.9 * k * queries.size());
+}
+
+// 距离计算预算耗尽时返回已经找到的结果
+TEST(DiskAnnTest, SearchLimit) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+  fs::create_directories(kTestDir);
+
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(2000, kDim, 8, 0.0f, 1.0f);
+  vectordb::DiskAnnIndex index(kTestDir, TestParam());
+  for (size_t i = 0; i < base.size(); ++i) {
+    index.Add(i, base[i]);
+  }
+  ASSERT_EQ(vectordb::RET_OK, index.Persist());
+
+  std::vector<int64_t> expected;
+  std::vector<float> expected_distances;
+  vectordb::ROptions options;
+  options.max_distance_computations = 1000000;
+  ASSERT_EQ(vectordb::RET_OK, index.Search(base[5].data(), 10, 100, expected,
+                                           expected_distances, options));
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  options.max_distance_computations = 1;
+  EXPECT_EQ(vectordb::RET_PARTIAL, index.Search(base[5].data(), 10, 100, ids,
+                                                distances, options));
+  EXPECT_FALSE(ids.empty());
+  EXPECT_LT(ids.size(), expected.size());
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+
+  // profile 记录图遍历的跳数和距离计算次数
+  vectordb::SearchProfile profile;
+  options.max_distance_computations = 0;
+  options.profile = &profile;
+  ASSERT_EQ(vectordb::RET_OK, index.Search(base[5].data(), 10, 100, ids,
+                                           distances, options));
+  EXPECT_GT(profile.hops, 0);
+  EXPECT_GT(profile.distance_computations, profile.hops);
+  EXPECT_GE(profile.visited, 10);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
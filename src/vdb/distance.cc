@@ -1,5 +1,13 @@
 #include "distance.h"
-#
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+#include "common.h"
 
 namespace vectordb {
 
@@ -50,25 +58,201 @@ float HnswLibIPDistance(const std::vector<float> &v1,
 }
 
 void Normalize(std::vector<float> &v) {
-  float norm = 0.0;
-  for (size_t i = 0; i < v.size(); i++) {
-    norm += v[i] * v[i];
+  Normalize(v.data(), v.data(), v.size());
+}
+
+float Norm(const std::vector<float> &v) {
+  return std::sqrt(SquaredNorm(v.data(), v.size()));
+}
+
+namespace {
+
+#if defined(__x86_64__)
+// x86-64 都有 sse2，不需要运行时检查
+float SquaredNormSse(const float *v, size_t dim) {
+  __m128 sum = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    __m128 x = _mm_loadu_ps(v + i);
+    sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, sum);
+  float total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for (; i < dim; i++) {
+    total += v[i] * v[i];
+  }
+  return total;
+}
+
+__attribute__((target("avx2,fma"))) float SquaredNormAvx2(const float *v,
+                                                         size_t dim) {
+  // 两组累加器隐藏 fma 的延迟
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= dim; i += 16) {
+    __m256 x0 = _mm256_loadu_ps(v + i);
+    __m256 x1 = _mm256_loadu_ps(v + i + 8);
+    sum0 = _mm256_fmadd_ps(x0, x0, sum0);
+    sum1 = _mm256_fmadd_ps(x1, x1, sum1);
   }
-  norm = std::sqrt(norm);
+  for (; i + 8 <= dim; i += 8) {
+    __m256 x = _mm256_loadu_ps(v + i);
+    sum0 = _mm256_fmadd_ps(x, x, sum0);
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, _mm256_add_ps(sum0, sum1));
+  float total = 0.0;
+  for (float lane : lanes) {
+    total += lane;
+  }
+  for (; i < dim; i++) {
+    total += v[i] * v[i];
+  }
+  return total;
+}
+#else
+float SquaredNormGeneric(const float *v, size_t dim) {
+  float sum = 0.0;
+  for (size_t i = 0; i < dim; i++) {
+    sum += v[i] * v[i];
+  }
+  return sum;
+}
+#endif
+
+using SquaredNormFunc = float (*)(const float *, size_t);
+
+SquaredNormFunc ChooseSquaredNorm() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SquaredNormAvx2;
+  }
+  return SquaredNormSse;
+#else
+  return SquaredNormGeneric;
+#endif
+}
+
+}  // namespace
+
+float SquaredNorm(const float *v, size_t dim) {
+  static const SquaredNormFunc func = ChooseSquaredNorm();
+  return func(v, dim);
+}
 
+void Normalize(const float *v, float *out, size_t dim) {
+  float norm = std::sqrt(SquaredNorm(v, dim));
   if (norm > 0) {
-    for (size_t i = 0; i < v.size(); i++) {
-      v[i] /= norm;
+    // 乘以倒数，循环可以被编译器向量化
+    float inv = 1.0f / norm;
+    for (size_t i = 0; i < dim; i++) {
+      out[i] = v[i] * inv;
     }
+  } else if (out != v) {
+    memcpy(out, v, dim * sizeof(float));
   }
 }
 
-float Norm(const std::vector<float> &v) {
-  float norm = 0.0;
-  for (size_t i = 0; i < v.size(); i++) {
-    norm += v[i] * v[i];
+int32_t VectorSize(int32_t dim, int32_t distance_type) {
+  if (distance_type == DISTANCE_TYPE_HAMMING) {
+    return dim / kBitsPerFloat;
+  }
+  return dim;
+}
+
+void BinaryToVector(const std::vector<uint8_t> &bits,
+                    std::vector<float> &vector) {
+  // 不足 4 字节的尾部补 0
+  vector.assign((bits.size() + sizeof(float) - 1) / sizeof(float), 0.0f);
+  memcpy(vector.data(), bits.data(), bits.size());
+}
+
+void VectorToBinary(const std::vector<float> &vector,
+                    std::vector<uint8_t> &bits) {
+  bits.resize(vector.size() * sizeof(float));
+  memcpy(bits.data(), vector.data(), bits.size());
+}
+
+namespace {
+
+// 逐 8 字节异或后计数，余下的字节单独处理
+inline uint64_t PopcountTail(const uint8_t *a, const uint8_t *b, size_t i,
+                             size_t size) {
+  uint64_t count = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t x = 0;
+    uint64_t y = 0;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    count += __builtin_popcountll(x ^ y);
+  }
+  for (; i < size; ++i) {
+    count += __builtin_popcount(a[i] ^ b[i]);
+  }
+  return count;
+}
+
+float HammingGeneric(const void *a, const void *b, const void *param) {
+  size_t size = *static_cast<const size_t *>(param);
+  return PopcountTail(static_cast<const uint8_t *>(a),
+                      static_cast<const uint8_t *>(b), 0, size);
+}
+
+#if defined(__x86_64__)
+// 与 hnswlib 一样在运行时按 cpu 选择实现，编译选项不需要 -march
+__attribute__((target("popcnt"))) float HammingPopcnt(const void *a,
+                                                      const void *b,
+                                                      const void *param) {
+  size_t size = *static_cast<const size_t *>(param);
+  return PopcountTail(static_cast<const uint8_t *>(a),
+                      static_cast<const uint8_t *>(b), 0, size);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) float
+HammingAvx512(const void *a, const void *b, const void *param) {
+  size_t size = *static_cast<const size_t *>(param);
+  const uint8_t *x = static_cast<const uint8_t *>(a);
+  const uint8_t *y = static_cast<const uint8_t *>(b);
+
+  // 每次 64 字节，8 个 64 位计数并行累加
+  __m512i sum = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    __m512i v = _mm512_xor_si512(_mm512_loadu_si512(x + i),
+                                 _mm512_loadu_si512(y + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(v));
+  }
+  alignas(64) uint64_t lanes[8];
+  _mm512_store_si512(lanes, sum);
+  uint64_t count = 0;
+  for (uint64_t lane : lanes) {
+    count += lane;
+  }
+  return count + PopcountTail(x, y, i, size);
+}
+#endif
+
+}  // namespace
+
+int32_t Hamming(const std::vector<uint8_t> &v1,
+                const std::vector<uint8_t> &v2) {
+  assert(v1.size() == v2.size());
+  return PopcountTail(v1.data(), v2.data(), 0, v1.size());
+}
+
+HammingSpace::HammingSpace(size_t dim)
+    : data_size_((dim + 7) / 8), dist_func_(HammingGeneric) {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vpopcntdq")) {
+    dist_func_ = HammingAvx512;
+  } else if (__builtin_cpu_supports("popcnt")) {
+    dist_func_ = HammingPopcnt;
   }
-  return std::sqrt(norm);
+#endif
 }
 
-}  // namespace vectordb
\ No newline at end of file
+}  // namespace vectordb
@@ -1,6 +1,7 @@
 #ifndef VDB_DISTANCE_H
 #define VDB_DISTANCE_H
 
+#include <cstdint>
 #include <vector>
 
 #include "hnswlib/hnswlib.h"
@@ -22,6 +23,46 @@ void Normalize(std::vector<float> &v);
 
 float Norm(const std::vector<float> &v);
 
+// squared l2 norm, uses avx2 or sse when the cpu has them
+float SquaredNorm(const float *v, size_t dim);
+
+// out = v / |v| in one pass after the norm, out may be v, a zero vector is
+// copied as it is
+void Normalize(const float *v, float *out, size_t dim);
+
+// binary vectors of dim bits are packed 32 bits per float so they can go
+// through the float vector paths unchanged, dim must be a multiple of 32
+const int32_t kBitsPerFloat = 32;
+
+// number of floats that carry a vector of dim under distance_type
+int32_t VectorSize(int32_t dim, int32_t distance_type);
+
+// bits: packed, bit i of the vector is bits[i / 8] >> (i % 8) & 1
+void BinaryToVector(const std::vector<uint8_t> &bits,
+                    std::vector<float> &vector);
+void VectorToBinary(const std::vector<float> &vector,
+                    std::vector<uint8_t> &bits);
+
+// number of different bits, v1 and v2 have the same size
+int32_t Hamming(const std::vector<uint8_t> &v1,
+                const std::vector<uint8_t> &v2);
+
+// hnswlib space of packed binary vectors of dim bits, the distance is the
+// hamming distance, computed with avx512 vpopcntdq or popcnt when the cpu
+// has them
+class HammingSpace : public hnswlib::SpaceInterface<float> {
+ public:
+  explicit HammingSpace(size_t dim);
+
+  size_t get_data_size() override { return data_size_; }
+  hnswlib::DISTFUNC<float> get_dist_func() override { return dist_func_; }
+  void *get_dist_func_param() override { return &data_size_; }
+
+ private:
+  size_t data_size_;
+  hnswlib::DISTFUNC<float> dist_func_;
+};
+
 }  // namespace vectordb
 
 #endif
\ No newline at end of file
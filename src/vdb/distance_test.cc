@@ -2,8 +2,12 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <random>
 #include <vector>
 
+#include "common.h"
+
 namespace vectordb {
 
 TEST(DistanceTest, L2Test) {
@@ -123,6 +127,65 @@ TEST(DistanceTest, NormalizeTest) {
   std::cout << "n2: " << n2 << std::endl;
 }
 
+TEST(DistanceTest, NormalizeOutTest) {
+  // 覆盖 simd 主循环和尾部
+  std::vector<float> v(37);
+  for (size_t i = 0; i < v.size(); ++i) {
+    v[i] = static_cast<float>(i) - 10.0f;
+  }
+  float expected = 0.0;
+  for (float x : v) {
+    expected += x * x;
+  }
+  EXPECT_FLOAT_EQ(expected, SquaredNorm(v.data(), v.size()));
+
+  // 输出到另一块内存时不修改输入
+  std::vector<float> copy = v;
+  std::vector<float> out(v.size());
+  Normalize(v.data(), out.data(), v.size());
+  EXPECT_EQ(copy, v);
+  EXPECT_NEAR(1.0f, Norm(out), 1e-6);
+  EXPECT_FLOAT_EQ(v[0] / std::sqrt(expected), out[0]);
+
+  // 零向量保持不变
+  std::vector<float> zero(5, 0.0f);
+  Normalize(zero.data(), out.data(), zero.size());
+  EXPECT_EQ(zero, std::vector<float>(out.begin(), out.begin() + 5));
+}
+
+TEST(DistanceTest, HammingTest) {
+  std::vector<uint8_t> v1 = {0x00, 0xff, 0x0f, 0x01};
+  std::vector<uint8_t> v2 = {0x00, 0x00, 0xff, 0x01};
+  EXPECT_EQ(0, Hamming(v1, v1));
+  EXPECT_EQ(12, Hamming(v1, v2));  // 8 + 4
+
+  // 打包到 float 后原样取回
+  std::vector<float> vector;
+  BinaryToVector(v1, vector);
+  ASSERT_EQ(1u, vector.size());
+  std::vector<uint8_t> bits;
+  VectorToBinary(vector, bits);
+  EXPECT_EQ(v1, bits);
+  EXPECT_EQ(8, VectorSize(256, DISTANCE_TYPE_HAMMING));
+  EXPECT_EQ(256, VectorSize(256, DISTANCE_TYPE_L2));
+
+  // hnswlib space 的结果与逐字节计算一致，覆盖 avx512 的 64 字节块和尾部
+  std::mt19937 rng(1);
+  for (size_t dim : {32, 256, 544, 1024}) {
+    HammingSpace space(dim);
+    ASSERT_EQ(dim / 8, space.get_data_size());
+    std::vector<uint8_t> a(dim / 8);
+    std::vector<uint8_t> b(dim / 8);
+    for (size_t i = 0; i < a.size(); ++i) {
+      a[i] = rng();
+      b[i] = rng();
+    }
+    float distance =
+        space.get_dist_func()(a.data(), b.data(), space.get_dist_func_param());
+    EXPECT_FLOAT_EQ(Hamming(a, b), distance);
+  }
+}
+
 }  // namespace vectordb
 
 int main(int argc, char **argv) {
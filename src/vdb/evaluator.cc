@@ -0,0 +1,469 @@
+#include "evaluator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+#include "distance.h"
+#include "ground_truth.h"
+#include "pb2json.h"
+#include "thread_pool.h"
+
+namespace vectordb {
+
+const uint32_t kGroundTruthMagic = 0x56475431;  // "VGT1"
+
+namespace {
+
+const char *IndexTypeName(int32_t index_type) {
+  switch (index_type) {
+    case INDEX_TYPE_HNSW:
+      return "hnsw";
+    case INDEX_TYPE_DISKANN:
+      return "diskann";
+    case INDEX_TYPE_PQ:
+      return "pq";
+    default:
+      return "flat";
+  }
+}
+
+}  // namespace
+
+Evaluator::Evaluator(TableSPtr table, const EvalParam &param)
+    : table_(table), param_(param), dim_(0), query_num_(0) {}
+
+Evaluator::~Evaluator() {}
+
+DistanceType Evaluator::TableDistanceType() const {
+  const vdb::IndexInfo &info = table_->param().default_index_info();
+  switch (info.index_type()) {
+    case INDEX_TYPE_FLAT:
+      return static_cast<DistanceType>(info.flat_param().distance_type());
+    case INDEX_TYPE_HNSW:
+      return static_cast<DistanceType>(info.hnsw_param().distance_type());
+    case INDEX_TYPE_DISKANN:
+      return static_cast<DistanceType>(info.diskann_param().distance_type());
+    case INDEX_TYPE_PQ:
+      return static_cast<DistanceType>(info.pq_param().distance_type());
+    default:
+      return kDefaultDistanceType;
+  }
+}
+
+RetNo Evaluator::Prepare() {
+  dim_ = table_->param().dim();
+  base_ids_.clear();
+  base_.clear();
+
+  RetNo ret = table_->ForEachVector(
+      [this](int64_t id, const std::vector<float> &vector) -> RetNo {
+        if (vector.size() != static_cast<size_t>(dim_)) {
+          return RET_ERROR;
+        }
+        base_ids_.push_back(id);
+        base_.insert(base_.end(), vector.begin(), vector.end());
+        return RET_OK;
+      });
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  if (base_ids_.empty()) {
+    return RET_ERROR;
+  }
+
+  // 从表中随机采样查询向量
+  std::vector<size_t> rows(base_ids_.size());
+  std::iota(rows.begin(), rows.end(), 0);
+  std::mt19937 rng(param_.seed);
+  std::shuffle(rows.begin(), rows.end(), rng);
+
+  query_num_ = std::min<int32_t>(param_.query_num, rows.size());
+  queries_.resize(static_cast<size_t>(query_num_) * dim_);
+  for (int32_t i = 0; i < query_num_; ++i) {
+    std::copy(base_.begin() + rows[i] * dim_,
+              base_.begin() + (rows[i] + 1) * dim_,
+              queries_.begin() + static_cast<size_t>(i) * dim_);
+  }
+
+  return RET_OK;
+}
+
+RetNo Evaluator::SetQueries(const std::vector<std::vector<float>> &queries) {
+  if (dim_ == 0 || queries.empty()) {
+    return RET_ERROR;
+  }
+
+  queries_.clear();
+  for (const auto &q : queries) {
+    if (q.size() != static_cast<size_t>(dim_)) {
+      return RET_ERROR;
+    }
+    queries_.insert(queries_.end(), q.begin(), q.end());
+
+    // 表中的向量已经归一化，真值也按归一化的查询计算
+    if (TableDistanceType() == DISTANCE_TYPE_COSINE) {
+      float *query = &queries_[queries_.size() - dim_];
+      Normalize(query, query, dim_);
+    }
+  }
+  query_num_ = queries.size();
+
+  gt_ids_.clear();
+  gt_distances_.clear();
+  return RET_OK;
+}
+
+// FNV-1a，覆盖向量、查询以及影响结果的参数
+uint64_t Evaluator::Fingerprint() const {
+  uint64_t h = 14695981039346656037ULL;
+  auto mix = [&h](const void *data, size_t len) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < len; ++i) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+    }
+  };
+
+  int32_t distance_type = TableDistanceType();
+  mix(&dim_, sizeof(dim_));
+  mix(&param_.k, sizeof(param_.k));
+  mix(&distance_type, sizeof(distance_type));
+  mix(base_ids_.data(), base_ids_.size() * sizeof(int64_t));
+  mix(base_.data(), base_.size() * sizeof(float));
+  mix(queries_.data(), queries_.size() * sizeof(float));
+  return h;
+}
+
+RetNo Evaluator::GroundTruth() {
+  if (dim_ == 0 || query_num_ == 0) {
+    return RET_ERROR;
+  }
+
+  if (!param_.cache_file.empty() && fs::exists(param_.cache_file)) {
+    if (LoadCache() == RET_OK) {
+      return RET_OK;
+    }
+  }
+
+  RetNo ret = BruteForce();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  if (!param_.cache_file.empty()) {
+    return SaveCache();
+  }
+  return RET_OK;
+}
+
+RetNo Evaluator::BruteForce() {
+  return ExactKnn(TableDistanceType(), dim_, base_, base_ids_, queries_,
+                  param_.k, param_.gt_threads, gt_ids_, gt_distances_);
+}
+
+RetNo Evaluator::LoadCache() {
+  std::ifstream file(param_.cache_file, std::ios::binary);
+  if (!file) {
+    return RET_ERROR;
+  }
+
+  uint32_t magic = 0;
+  int32_t k = 0;
+  int32_t query_num = 0;
+  uint64_t fingerprint = 0;
+  file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char *>(&k), sizeof(k));
+  file.read(reinterpret_cast<char *>(&query_num), sizeof(query_num));
+  file.read(reinterpret_cast<char *>(&fingerprint), sizeof(fingerprint));
+  if (!file || magic != kGroundTruthMagic || k != param_.k ||
+      query_num != query_num_ || fingerprint != Fingerprint()) {
+    return RET_ERROR;
+  }
+
+  gt_ids_.resize(static_cast<size_t>(query_num) * k);
+  gt_distances_.resize(static_cast<size_t>(query_num) * k);
+  file.read(reinterpret_cast<char *>(gt_ids_.data()),
+            gt_ids_.size() * sizeof(int64_t));
+  file.read(reinterpret_cast<char *>(gt_distances_.data()),
+            gt_distances_.size() * sizeof(float));
+  if (!file) {
+    gt_ids_.clear();
+    gt_distances_.clear();
+    return RET_ERROR;
+  }
+
+  return RET_OK;
+}
+
+RetNo Evaluator::SaveCache() const {
+  std::ofstream file(param_.cache_file, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return RET_ERROR;
+  }
+
+  uint64_t fingerprint = Fingerprint();
+  file.write(reinterpret_cast<const char *>(&kGroundTruthMagic),
+             sizeof(kGroundTruthMagic));
+  file.write(reinterpret_cast<const char *>(&param_.k), sizeof(param_.k));
+  file.write(reinterpret_cast<const char *>(&query_num_), sizeof(query_num_));
+  file.write(reinterpret_cast<const char *>(&fingerprint),
+             sizeof(fingerprint));
+  file.write(reinterpret_cast<const char *>(gt_ids_.data()),
+             gt_ids_.size() * sizeof(int64_t));
+  file.write(reinterpret_cast<const char *>(gt_distances_.data()),
+             gt_distances_.size() * sizeof(float));
+  file.close();
+
+  return file ? RET_OK : RET_ERROR;
+}
+
+double Evaluator::Recall(const std::vector<int64_t> &ids) const {
+  if (query_num_ == 0 ||
+      ids.size() != static_cast<size_t>(query_num_) * param_.k) {
+    return 0;
+  }
+
+  int64_t hit = 0;
+  int64_t total = 0;
+  for (int32_t q = 0; q < query_num_; ++q) {
+    std::unordered_set<int64_t> truth;
+    for (int32_t j = 0; j < param_.k; ++j) {
+      int64_t id = gt_ids_[q * param_.k + j];
+      if (id >= 0) {
+        truth.insert(id);
+      }
+    }
+    total += truth.size();
+
+    for (int32_t j = 0; j < param_.k; ++j) {
+      if (truth.count(ids[q * param_.k + j]) > 0) {
+        hit++;
+      }
+    }
+  }
+
+  return total == 0 ? 0 : static_cast<double>(hit) / total;
+}
+
+RetNo Evaluator::Evaluate(int32_t index_id, int32_t ef, EvalResult &result) {
+  ROptions options;
+  options.ef = ef;
+
+  std::vector<int64_t> all_ids(static_cast<size_t>(query_num_) * param_.k,
+                               -1);
+  auto search = [&](int64_t q) -> RetNo {
+    std::vector<float> query(queries_.begin() + q * dim_,
+                             queries_.begin() + (q + 1) * dim_);
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    RetNo ret = table_->Search(query, param_.k, ids, distances, scalars,
+                               options, index_id);
+    for (size_t j = 0; j < ids.size() && j < static_cast<size_t>(param_.k);
+         ++j) {
+      all_ids[q * param_.k + j] = ids[j];
+    }
+    return ret;
+  };
+
+  // 预热一次，同时让 ef 在并发查询前生效
+  RetNo ret = search(0);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  std::atomic<int32_t> errors(0);
+  auto start = std::chrono::steady_clock::now();
+  if (param_.search_threads <= 1) {
+    for (int32_t q = 0; q < query_num_; ++q) {
+      if (search(q) != RET_OK) {
+        errors++;
+      }
+    }
+  } else {
+    ThreadPool pool(param_.search_threads);
+    pool.ParallelFor(0, query_num_, [&](int64_t q) {
+      if (search(q) != RET_OK) {
+        errors++;
+      }
+    });
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  if (errors.load() > 0) {
+    return RET_ERROR;
+  }
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  result.ef = ef;
+  result.recall = Recall(all_ids);
+  result.qps = seconds > 0 ? query_num_ / seconds : 0;
+  return RET_OK;
+}
+
+namespace {
+
+// 评测完一个配置后删除它建的索引，出错提前返回时也删除
+class IndexDropper final {
+ public:
+  IndexDropper(Table *table, int32_t index_id, bool drop)
+      : table_(table), index_id_(index_id), drop_(drop) {}
+  ~IndexDropper() {
+    if (drop_) {
+      table_->DropIndexByID(index_id_);
+    }
+  }
+  IndexDropper(const IndexDropper &) = delete;
+  IndexDropper &operator=(const IndexDropper &) = delete;
+
+ private:
+  Table *table_;
+  int32_t index_id_;
+  bool drop_;
+};
+
+}  // namespace
+
+RetNo Evaluator::Sweep(const std::vector<EvalConfig> &configs,
+                       std::vector<EvalResult> &results) {
+  results.clear();
+  if (gt_ids_.empty()) {
+    RetNo ret = GroundTruth();
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  for (const auto &config : configs) {
+    auto start = std::chrono::steady_clock::now();
+    RetNo ret = RET_ERROR;
+    switch (config.index_info.index_type()) {
+      case INDEX_TYPE_FLAT:
+        ret = table_->BuildIndex(config.index_info.flat_param());
+        break;
+      case INDEX_TYPE_HNSW:
+        ret = table_->BuildIndex(config.index_info.hnsw_param());
+        break;
+      case INDEX_TYPE_DISKANN:
+        ret = table_->BuildIndex(config.index_info.diskann_param());
+        break;
+      case INDEX_TYPE_PQ:
+        ret = table_->BuildIndex(config.index_info.pq_param());
+        break;
+      default:
+        break;
+    }
+    if (ret != RET_OK) {
+      return ret;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double build_ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+
+    int32_t index_id = table_->IndexIDs().back();
+    IndexDropper dropper(table_.get(), index_id, param_.drop_index);
+
+    std::vector<int32_t> efs = config.search_efs;
+    if (efs.empty()) {
+      efs.push_back(0);
+    }
+    for (int32_t ef : efs) {
+      EvalResult result;
+      result.index_info = config.index_info;
+      result.build_ms = build_ms;
+      ret = Evaluate(index_id, ef, result);
+      if (ret != RET_OK) {
+        return ret;
+      }
+      results.push_back(result);
+    }
+  }
+
+  MarkPareto(results);
+  return RET_OK;
+}
+
+RetNo Evaluator::WriteReport(const std::vector<EvalResult> &results,
+                             const std::string &prefix) const {
+  std::ofstream csv(prefix + ".csv", std::ios::trunc);
+  if (!csv) {
+    return RET_ERROR;
+  }
+  csv << "index_type,M,ef_construction,ef,recall,qps,build_ms,pareto\n";
+  for (const auto &r : results) {
+    const vdb::IndexInfo &info = r.index_info;
+    csv << IndexTypeName(info.index_type()) << ","
+        << info.hnsw_param().m() << ","
+        << info.hnsw_param().ef_construction() << "," << r.ef << ","
+        << r.recall << "," << r.qps << "," << r.build_ms << ","
+        << (r.pareto ? 1 : 0) << "\n";
+  }
+  csv.close();
+
+  json j;
+  j["k"] = param_.k;
+  j["query_num"] = query_num_;
+  j["base_num"] = base_ids_.size();
+  j["results"] = json::array();
+  for (const auto &r : results) {
+    j["results"].push_back(EvalResultToJson(r));
+  }
+  std::ofstream file(prefix + ".json", std::ios::trunc);
+  if (!file) {
+    return RET_ERROR;
+  }
+  file << j.dump(2);
+  file.close();
+
+  return RET_OK;
+}
+
+void MarkPareto(std::vector<EvalResult> &results) {
+  for (auto &r : results) {
+    r.pareto = true;
+    for (const auto &o : results) {
+      bool not_worse = o.recall >= r.recall && o.qps >= r.qps &&
+                       o.build_ms <= r.build_ms;
+      bool better = o.recall > r.recall || o.qps > r.qps ||
+                    o.build_ms < r.build_ms;
+      if (not_worse && better) {
+        r.pareto = false;
+        break;
+      }
+    }
+  }
+}
+
+std::vector<EvalResult> Recommend(const std::vector<EvalResult> &results,
+                                  double min_recall) {
+  std::vector<EvalResult> rs;
+  for (const auto &r : results) {
+    if (r.pareto && r.recall >= min_recall) {
+      rs.push_back(r);
+    }
+  }
+  std::sort(rs.begin(), rs.end(),
+            [](const EvalResult &a, const EvalResult &b) {
+              return a.qps > b.qps;
+            });
+  return rs;
+}
+
+json EvalResultToJson(const EvalResult &result) {
+  json j;
+  j["index_info"] = IndexInfoToJson(result.index_info);
+  j["ef"] = result.ef;
+  j["recall"] = result.recall;
+  j["qps"] = result.qps;
+  j["build_ms"] = result.build_ms;
+  j["pareto"] = result.pareto;
+  return j;
+}
+
+}  // namespace vectordb
@@ -0,0 +1,118 @@
+#ifndef VECTORDB_EVALUATOR_H
+#define VECTORDB_EVALUATOR_H
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "retno.h"
+#include "table.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+struct EvalParam {
+  int32_t k = 10;
+  int32_t query_num = 100;
+  uint32_t seed = 0;
+
+  // threads used to compute ground truth, 0 means hardware_concurrency
+  int32_t gt_threads = 0;
+
+  // threads used to measure qps, 1 means single query latency
+  int32_t search_threads = 1;
+
+  // ground truth cache, empty means no cache
+  std::string cache_file;
+
+  // drop the indexes built by Sweep when it finishes
+  bool drop_index = true;
+};
+
+// one index configuration to sweep, every ef in search_efs is measured
+// against the same built index
+struct EvalConfig {
+  vdb::IndexInfo index_info;
+  std::vector<int32_t> search_efs;
+};
+
+struct EvalResult {
+  vdb::IndexInfo index_info;
+  int32_t ef = 0;
+  double recall = 0;
+  double qps = 0;
+  double build_ms = 0;
+  bool pareto = false;
+};
+
+// Recall evaluation harness: computes exact k-NN ground truth of a table
+// once, then sweeps index types and parameters and reports recall, qps and
+// build time of each configuration.
+class Evaluator final {
+ public:
+  Evaluator(TableSPtr table, const EvalParam &param);
+  ~Evaluator();
+
+  Evaluator(const Evaluator &) = delete;
+  Evaluator &operator=(const Evaluator &) = delete;
+
+  // load all vectors of the table into memory, then sample queries from them
+  RetNo Prepare();
+
+  // use the given queries instead of sampled ones, must be called after
+  // Prepare
+  RetNo SetQueries(const std::vector<std::vector<float>> &queries);
+
+  // brute force, or load from cache_file if it matches the table and queries
+  RetNo GroundTruth();
+
+  RetNo Sweep(const std::vector<EvalConfig> &configs,
+              std::vector<EvalResult> &results);
+
+  // write <prefix>.csv (for plotting recall/qps/build time) and <prefix>.json
+  RetNo WriteReport(const std::vector<EvalResult> &results,
+                    const std::string &prefix) const;
+
+  const std::vector<int64_t> &gt_ids() const { return gt_ids_; }
+  const std::vector<float> &gt_distances() const { return gt_distances_; }
+  int32_t query_num() const { return query_num_; }
+
+  // recall@k of ids (query_num * k, row major) against the ground truth
+  double Recall(const std::vector<int64_t> &ids) const;
+
+ private:
+  DistanceType TableDistanceType() const;
+  uint64_t Fingerprint() const;
+  RetNo LoadCache();
+  RetNo SaveCache() const;
+  RetNo BruteForce();
+  RetNo Evaluate(int32_t index_id, int32_t ef, EvalResult &result);
+
+ private:
+  TableSPtr table_;
+  EvalParam param_;
+  int32_t dim_;
+
+  std::vector<int64_t> base_ids_;
+  std::vector<float> base_;
+
+  int32_t query_num_;
+  std::vector<float> queries_;
+
+  std::vector<int64_t> gt_ids_;
+  std::vector<float> gt_distances_;
+};
+
+// mark the results not dominated by any other result, a result dominates
+// another one when it is not worse in recall, qps and build time
+void MarkPareto(std::vector<EvalResult> &results);
+
+// pareto optimal results with recall >= min_recall, highest qps first
+std::vector<EvalResult> Recommend(const std::vector<EvalResult> &results,
+                                  double min_recall);
+
+json EvalResultToJson(const EvalResult &result);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_EVALUATOR_H
@@ -0,0 +1,188 @@
+#include "evaluator.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+#include "common.h"
+#include "util.h"
+#include "vdb.pb.h"
+
+const std::string kTestDir = "/tmp/evaluator_test";
+const int32_t kDim = 16;
+
+static vectordb::TableSPtr NewTable(int32_t n) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir + "/table");
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(kDim);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_FLAT);
+  vdb::FlatParam flat_param = vectordb::DefaultFlatParam(kDim);
+  flat_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_flat_param()->CopyFrom(
+      flat_param);
+
+  auto table = std::make_shared<vectordb::Table>(param);
+
+  // 只写数据，索引由 Sweep 构建
+  vectordb::WOptions options;
+  options.write_vector_to_index = false;
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  for (int32_t i = 0; i < n; ++i) {
+    std::vector<float> v(kDim);
+    for (auto &x : v) {
+      x = dist(rng);
+    }
+    EXPECT_EQ(vectordb::RET_OK, table->Add(i, v, options));
+  }
+  return table;
+}
+
+// 测试暴力计算的真值，查询向量采样自表，最近邻应为自身
+TEST(EvaluatorTest, GroundTruth) {
+  auto table = NewTable(300);
+
+  vectordb::EvalParam param;
+  param.k = 5;
+  param.query_num = 20;
+  vectordb::Evaluator evaluator(table, param);
+  EXPECT_EQ(vectordb::RET_OK, evaluator.Prepare());
+  EXPECT_EQ(vectordb::RET_OK, evaluator.GroundTruth());
+
+  ASSERT_EQ(evaluator.gt_ids().size(), 20u * 5);
+  for (int32_t q = 0; q < 20; ++q) {
+    EXPECT_FLOAT_EQ(evaluator.gt_distances()[q * 5], 0.0);
+    for (int32_t j = 1; j < 5; ++j) {
+      EXPECT_LE(evaluator.gt_distances()[q * 5 + j - 1],
+                evaluator.gt_distances()[q * 5 + j]);
+    }
+  }
+
+  // 真值自身的召回率为 1
+  EXPECT_DOUBLE_EQ(evaluator.Recall(evaluator.gt_ids()), 1.0);
+}
+
+// 测试真值缓存
+TEST(EvaluatorTest, Cache) {
+  auto table = NewTable(200);
+
+  vectordb::EvalParam param;
+  param.k = 10;
+  param.query_num = 10;
+  param.cache_file = kTestDir + "/gt.bin";
+
+  std::vector<int64_t> gt_ids;
+  {
+    vectordb::Evaluator evaluator(table, param);
+    EXPECT_EQ(vectordb::RET_OK, evaluator.Prepare());
+    EXPECT_EQ(vectordb::RET_OK, evaluator.GroundTruth());
+    gt_ids = evaluator.gt_ids();
+  }
+  EXPECT_TRUE(fs::exists(param.cache_file));
+
+  {
+    vectordb::Evaluator evaluator(table, param);
+    EXPECT_EQ(vectordb::RET_OK, evaluator.Prepare());
+    EXPECT_EQ(vectordb::RET_OK, evaluator.GroundTruth());
+    EXPECT_EQ(evaluator.gt_ids(), gt_ids);
+  }
+
+  // k 不同时缓存失效，重新计算
+  param.k = 5;
+  {
+    vectordb::Evaluator evaluator(table, param);
+    EXPECT_EQ(vectordb::RET_OK, evaluator.Prepare());
+    EXPECT_EQ(vectordb::RET_OK, evaluator.GroundTruth());
+    EXPECT_EQ(evaluator.gt_ids().size(), 10u * 5);
+  }
+}
+
+// 测试参数扫描
+TEST(EvaluatorTest, Sweep) {
+  auto table = NewTable(500);
+
+  vectordb::EvalParam param;
+  param.k = 10;
+  param.query_num = 50;
+  vectordb::Evaluator evaluator(table, param);
+  EXPECT_EQ(vectordb::RET_OK, evaluator.Prepare());
+
+  std::vector<vectordb::EvalConfig> configs;
+  {
+    vectordb::EvalConfig config;
+    config.index_info.set_index_type(vectordb::INDEX_TYPE_FLAT);
+    vdb::FlatParam flat_param = vectordb::DefaultFlatParam(kDim);
+    flat_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+    config.index_info.mutable_flat_param()->CopyFrom(flat_param);
+    configs.push_back(config);
+  }
+  for (int32_t m : {4, 16}) {
+    vectordb::EvalConfig config;
+    config.index_info.set_index_type(vectordb::INDEX_TYPE_HNSW);
+    vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(kDim);
+    hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+    hnsw_param.set_m(m);
+    config.index_info.mutable_hnsw_param()->CopyFrom(hnsw_param);
+    config.search_efs = {10, 50};
+    configs.push_back(config);
+  }
+
+  std::vector<vectordb::EvalResult> results;
+  EXPECT_EQ(vectordb::RET_OK, evaluator.Sweep(configs, results));
+  ASSERT_EQ(results.size(), 5u);
+
+  // 暴力索引的召回率为 1
+  EXPECT_DOUBLE_EQ(results[0].recall, 1.0);
+  for (const auto &r : results) {
+    EXPECT_GT(r.qps, 0);
+    EXPECT_GT(r.recall, 0.5);
+  }
+
+  // 扫描构建的索引已删除
+  EXPECT_TRUE(table->IndexIDs().empty());
+
+  EXPECT_EQ(vectordb::RET_OK,
+            evaluator.WriteReport(results, kTestDir + "/report"));
+  EXPECT_TRUE(fs::exists(kTestDir + "/report.csv"));
+  EXPECT_TRUE(fs::exists(kTestDir + "/report.json"));
+
+  std::vector<vectordb::EvalResult> rs = vectordb::Recommend(results, 0.9);
+  for (const auto &r : rs) {
+    EXPECT_TRUE(r.pareto);
+    EXPECT_GE(r.recall, 0.9);
+  }
+}
+
+// 测试帕累托前沿
+TEST(EvaluatorTest, Pareto) {
+  std::vector<vectordb::EvalResult> results(3);
+  results[0].recall = 0.9;
+  results[0].qps = 1000;
+  results[0].build_ms = 10;
+
+  // 被 results[0] 支配
+  results[1].recall = 0.8;
+  results[1].qps = 900;
+  results[1].build_ms = 10;
+
+  results[2].recall = 0.99;
+  results[2].qps = 500;
+  results[2].build_ms = 20;
+
+  vectordb::MarkPareto(results);
+  EXPECT_TRUE(results[0].pareto);
+  EXPECT_FALSE(results[1].pareto);
+  EXPECT_TRUE(results[2].pareto);
+
+  std::vector<vectordb::EvalResult> rs = vectordb::Recommend(results, 0.85);
+  ASSERT_EQ(rs.size(), 2u);
+  EXPECT_DOUBLE_EQ(rs[0].qps, 1000);
+  EXPECT_DOUBLE_EQ(rs[1].qps, 500);
+}
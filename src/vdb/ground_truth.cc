@@ -0,0 +1,70 @@
+#include "ground_truth.h"
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include "hnswlib/hnswlib.h"
+#include "thread_pool.h"
+
+namespace vectordb {
+
+RetNo ExactKnn(DistanceType distance_type, int32_t dim,
+               const std::vector<float> &base,
+               const std::vector<int64_t> &base_ids,
+               const std::vector<float> &queries, int32_t k, int32_t threads,
+               std::vector<int64_t> &ids, std::vector<float> &distances) {
+  if (dim <= 0 || k < 0 || base.size() != base_ids.size() * dim ||
+      queries.size() % dim != 0) {
+    return RET_ERROR;
+  }
+
+  // 使用 hnswlib 的距离函数，编译器支持时为 SIMD 实现
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space;
+  switch (distance_type) {
+    case DISTANCE_TYPE_L2:
+      space = std::make_unique<hnswlib::L2Space>(dim);
+      break;
+    case DISTANCE_TYPE_INNER_PRODUCT:
+    case DISTANCE_TYPE_COSINE:
+      space = std::make_unique<hnswlib::InnerProductSpace>(dim);
+      break;
+    default:
+      return RET_ERROR;
+  }
+  hnswlib::DISTFUNC<float> dist_func = space->get_dist_func();
+  void *dist_param = space->get_dist_func_param();
+
+  int64_t query_num = queries.size() / dim;
+  int32_t found = std::min<int64_t>(k, base_ids.size());
+  ids.assign(query_num * k, -1);
+  distances.assign(query_num * k, 0);
+
+  ThreadPool pool(threads);
+  pool.ParallelFor(0, query_num, [&](int64_t q) {
+    const float *query = queries.data() + q * dim;
+
+    // 最大堆，保留距离最小的 k 个
+    std::priority_queue<std::pair<float, size_t>> heap;
+    for (size_t i = 0; i < base_ids.size(); ++i) {
+      float d = dist_func(query, base.data() + i * dim, dist_param);
+      if (static_cast<int32_t>(heap.size()) < found) {
+        heap.emplace(d, i);
+      } else if (found > 0 && d < heap.top().first) {
+        heap.pop();
+        heap.emplace(d, i);
+      }
+    }
+
+    for (int32_t j = static_cast<int32_t>(heap.size()) - 1; j >= 0; --j) {
+      ids[q * k + j] = base_ids[heap.top().second];
+      distances[q * k + j] = heap.top().first;
+      heap.pop();
+    }
+  });
+
+  return RET_OK;
+}
+
+}  // namespace vectordb
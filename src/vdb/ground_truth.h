@@ -0,0 +1,25 @@
+#ifndef VECTORDB_GROUND_TRUTH_H
+#define VECTORDB_GROUND_TRUTH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common.h"
+#include "retno.h"
+
+namespace vectordb {
+
+// Exact k-nearest neighbors of every query by brute force, using the same
+// distance functions as the hnsw index. base and queries are row major with
+// dim floats per vector. ids and distances get query_num * k entries sorted by
+// distance; when base has fewer than k vectors the rest of the ids are -1.
+// threads 0 means hardware_concurrency.
+RetNo ExactKnn(DistanceType distance_type, int32_t dim,
+               const std::vector<float> &base,
+               const std::vector<int64_t> &base_ids,
+               const std::vector<float> &queries, int32_t k, int32_t threads,
+               std::vector<int64_t> &ids, std::vector<float> &distances);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_GROUND_TRUTH_H
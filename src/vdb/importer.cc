@@ -0,0 +1,244 @@
+#include "importer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "thread_pool.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+VectorFile::VectorFile(const std::string &path, ImportFormat format,
+                       int32_t dim)
+    : path_(path),
+      format_(format),
+      dim_(dim),
+      fd_(-1),
+      data_(nullptr),
+      size_(0),
+      base_(nullptr),
+      stride_(0),
+      rows_(0) {}
+
+VectorFile::~VectorFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+RetNo VectorFile::Open() {
+  fd_ = open(path_.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    return RET_NOT_FOUND;
+  }
+
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    return RET_ERROR;
+  }
+  size_ = st.st_size;
+  if (size_ == 0) {
+    return RET_ERROR;
+  }
+
+  void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (addr == MAP_FAILED) {
+    return RET_ERROR;
+  }
+  data_ = static_cast<char *>(addr);
+
+  // 导入是顺序读，让内核加大预读
+  madvise(data_, size_, MADV_SEQUENTIAL);
+
+  switch (format_) {
+    case IMPORT_FORMAT_FVECS:
+      return ParseFvecs();
+    case IMPORT_FORMAT_NPY:
+      return ParseNpy();
+    case IMPORT_FORMAT_RAW:
+      return ParseRaw();
+    default:
+      return RET_ERROR;
+  }
+}
+
+RetNo VectorFile::ParseFvecs() {
+  if (size_ < sizeof(int32_t)) {
+    return RET_ERROR;
+  }
+
+  int32_t dim = 0;
+  memcpy(&dim, data_, sizeof(dim));
+  if (dim <= 0 || (dim_ > 0 && dim != dim_)) {
+    return RET_ERROR;
+  }
+  dim_ = dim;
+  stride_ = sizeof(int32_t) + dim_ * sizeof(float);
+  if (size_ % stride_ != 0) {
+    return RET_ERROR;
+  }
+  rows_ = size_ / stride_;
+  base_ = data_ + sizeof(int32_t);
+
+  // 只检查最后一行的维度，逐行检查会把整个文件读一遍
+  int32_t last_dim = 0;
+  memcpy(&last_dim, data_ + stride_ * (rows_ - 1), sizeof(last_dim));
+  if (last_dim != dim_) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
+RetNo VectorFile::ParseNpy() {
+  // magic(6) + major(1) + minor(1) + header_len(2 or 4) + header
+  const char kMagic[] = "\x93NUMPY";
+  if (size_ < 10 || memcmp(data_, kMagic, 6) != 0) {
+    return RET_ERROR;
+  }
+
+  uint8_t major = static_cast<uint8_t>(data_[6]);
+  size_t header_len = 0;
+  size_t header_start = 0;
+  if (major == 1) {
+    uint16_t len = 0;
+    memcpy(&len, data_ + 8, sizeof(len));
+    header_len = len;
+    header_start = 10;
+  } else if (major == 2 || major == 3) {
+    if (size_ < 12) {
+      return RET_ERROR;
+    }
+    uint32_t len = 0;
+    memcpy(&len, data_ + 8, sizeof(len));
+    header_len = len;
+    header_start = 12;
+  } else {
+    return RET_ERROR;
+  }
+  if (header_start + header_len > size_) {
+    return RET_ERROR;
+  }
+
+  // {'descr': '<f4', 'fortran_order': False, 'shape': (1000, 128), }
+  std::string header(data_ + header_start, header_len);
+  if (header.find("'<f4'") == std::string::npos ||
+      header.find("'fortran_order': False") == std::string::npos) {
+    return RET_ERROR;
+  }
+
+  size_t pos = header.find("'shape':");
+  if (pos == std::string::npos) {
+    return RET_ERROR;
+  }
+  size_t left = header.find('(', pos);
+  size_t right = header.find(')', pos);
+  if (left == std::string::npos || right == std::string::npos) {
+    return RET_ERROR;
+  }
+
+  std::vector<int64_t> shape;
+  std::string dims = header.substr(left + 1, right - left - 1);
+  size_t i = 0;
+  while (i < dims.size()) {
+    while (i < dims.size() && !isdigit(dims[i])) {
+      ++i;
+    }
+    if (i == dims.size()) {
+      break;
+    }
+    size_t end = i;
+    while (end < dims.size() && isdigit(dims[end])) {
+      ++end;
+    }
+    shape.push_back(std::stoll(dims.substr(i, end - i)));
+    i = end;
+  }
+  if (shape.size() != 2 || shape[1] <= 0 ||
+      (dim_ > 0 && shape[1] != dim_)) {
+    return RET_ERROR;
+  }
+
+  dim_ = shape[1];
+  rows_ = shape[0];
+  stride_ = dim_ * sizeof(float);
+  base_ = data_ + header_start + header_len;
+  if (header_start + header_len + stride_ * rows_ > size_) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
+RetNo VectorFile::ParseRaw() {
+  if (dim_ <= 0) {
+    return RET_ERROR;
+  }
+
+  stride_ = dim_ * sizeof(float);
+  if (size_ % stride_ != 0) {
+    return RET_ERROR;
+  }
+  rows_ = size_ / stride_;
+  base_ = data_;
+  return RET_OK;
+}
+
+namespace {
+
+bool KeyLess(const ImportKey &a, const ImportKey &b) {
+  int r = memcmp(a.data, b.data, std::min(a.size, b.size));
+  if (r != 0) {
+    return r < 0;
+  }
+  return a.size < b.size;
+}
+
+}  // namespace
+
+std::vector<ImportKey> SortedImportKeys(int64_t start_id, int64_t rows) {
+  std::vector<ImportKey> keys(rows);
+  if (rows <= 0) {
+    return keys;
+  }
+  ThreadPool &pool = DefaultThreadPool();
+
+  // 与 Table::Add 相同，key 为序列化后的 vdb::Id
+  int64_t chunks = std::min<int64_t>(pool.thread_num() + 1, rows);
+  int64_t chunk_size = (rows + chunks - 1) / chunks;
+  chunks = (rows + chunk_size - 1) / chunk_size;
+  pool.ParallelFor(0, chunks, [&](int64_t c) {
+    int64_t begin = c * chunk_size;
+    int64_t end = std::min(rows, begin + chunk_size);
+    vdb::Id id_obj;
+    for (int64_t i = begin; i < end; ++i) {
+      id_obj.set_id(start_id + i);
+      keys[i].size = id_obj.ByteSizeLong();
+      id_obj.SerializeToArray(keys[i].data, ImportKey::kMaxSize);
+      keys[i].row = i;
+    }
+    std::sort(keys.begin() + begin, keys.begin() + end, KeyLess);
+  });
+
+  // 各段已有序，两两归并
+  for (int64_t width = 1; width < chunks; width *= 2) {
+    int64_t merges = (chunks + 2 * width - 1) / (2 * width);
+    pool.ParallelFor(0, merges, [&](int64_t m) {
+      int64_t begin = std::min(rows, 2 * m * width * chunk_size);
+      int64_t middle = std::min(rows, begin + width * chunk_size);
+      int64_t end = std::min(rows, begin + 2 * width * chunk_size);
+      std::inplace_merge(keys.begin() + begin, keys.begin() + middle,
+                         keys.begin() + end, KeyLess);
+    });
+  }
+  return keys;
+}
+
+}  // namespace vectordb
@@ -0,0 +1,76 @@
+#ifndef VECTORDB_IMPORTER_H
+#define VECTORDB_IMPORTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "retno.h"
+
+namespace vectordb {
+
+struct ImportParam {
+  ImportFormat format = IMPORT_FORMAT_FVECS;
+  int32_t dim = 0;                // raw only, the other formats carry it
+  int64_t start_id = 0;           // row i gets id start_id + i
+  int64_t rows_per_sst = 1 << 20;
+  bool build_index = true;
+};
+
+// Read-only memory mapping of a vector file. Rows are float32 and are
+// addressed in place, nothing is copied.
+//   fvecs: each row is int32 dim followed by dim floats
+//   npy:   little endian float32 2-d array in C order
+//   raw:   rows of dim floats back to back
+class VectorFile final {
+ public:
+  VectorFile(const std::string &path, ImportFormat format, int32_t dim = 0);
+  ~VectorFile();
+
+  VectorFile(const VectorFile &) = delete;
+  VectorFile &operator=(const VectorFile &) = delete;
+
+  RetNo Open();
+
+  int64_t Rows() const { return rows_; }
+  int32_t Dim() const { return dim_; }
+  const float *Row(int64_t i) const {
+    return reinterpret_cast<const float *>(base_ + stride_ * i);
+  }
+
+ private:
+  RetNo ParseFvecs();
+  RetNo ParseNpy();
+  RetNo ParseRaw();
+
+ private:
+  std::string path_;
+  ImportFormat format_;
+  int32_t dim_;
+
+  int fd_;
+  char *data_;
+  size_t size_;
+
+  const char *base_;  // first float of row 0
+  size_t stride_;     // bytes between rows
+  int64_t rows_;
+};
+
+// a serialized vdb::Id, the key of the vector column family
+struct ImportKey {
+  static const int32_t kMaxSize = 11;  // tag + 10 bytes varint
+
+  char data[kMaxSize];
+  uint8_t size;
+  int64_t row;
+};
+
+// keys of rows [0, rows) with id start_id + row, in rocksdb bytewise
+// order, which is what SstFileWriter requires
+std::vector<ImportKey> SortedImportKeys(int64_t start_id, int64_t rows);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_IMPORTER_H
@@ -0,0 +1,237 @@
+#include "importer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "common.h"
+#include "distance.h"
+#include "table.h"
+#include "test_util.h"
+#include "util.h"
+#include "vdb.pb.h"
+
+const std::string kTestDir = "/tmp/importer_test";
+const int32_t kDim = 8;
+
+static std::string WriteFvecs(const std::vector<std::vector<float>> &vectors) {
+  std::string file = kTestDir + "/data.fvecs";
+  std::ofstream out(file, std::ios::binary);
+  for (const auto &v : vectors) {
+    int32_t dim = v.size();
+    out.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+    out.write(reinterpret_cast<const char *>(v.data()), dim * sizeof(float));
+  }
+  return file;
+}
+
+static std::string WriteNpy(const std::vector<std::vector<float>> &vectors) {
+  std::string file = kTestDir + "/data.npy";
+  std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" +
+                       std::to_string(vectors.size()) + ", " +
+                       std::to_string(kDim) + "), }";
+  // magic + version + header_len + header 按 64 字节对齐，以换行结尾
+  while ((10 + header.size() + 1) % 64 != 0) {
+    header += ' ';
+  }
+  header += '\n';
+  uint16_t header_len = header.size();
+
+  std::ofstream out(file, std::ios::binary);
+  out.write("\x93NUMPY\x01\x00", 8);
+  out.write(reinterpret_cast<const char *>(&header_len), sizeof(header_len));
+  out.write(header.data(), header.size());
+  for (const auto &v : vectors) {
+    out.write(reinterpret_cast<const char *>(v.data()), kDim * sizeof(float));
+  }
+  return file;
+}
+
+static std::string WriteRaw(const std::vector<std::vector<float>> &vectors) {
+  std::string file = kTestDir + "/data.raw";
+  std::ofstream out(file, std::ios::binary);
+  for (const auto &v : vectors) {
+    out.write(reinterpret_cast<const char *>(v.data()), kDim * sizeof(float));
+  }
+  return file;
+}
+
+static void ExpectRows(const std::string &file, vectordb::ImportFormat format,
+                       const std::vector<std::vector<float>> &vectors) {
+  int32_t dim = format == vectordb::IMPORT_FORMAT_RAW ? kDim : 0;
+  vectordb::VectorFile vf(file, format, dim);
+  ASSERT_EQ(vectordb::RET_OK, vf.Open());
+  EXPECT_EQ(kDim, vf.Dim());
+  ASSERT_EQ(static_cast<int64_t>(vectors.size()), vf.Rows());
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_EQ(0, memcmp(vectors[i].data(), vf.Row(i), kDim * sizeof(float)));
+  }
+}
+
+// 三种格式的文件都能按行原地读取
+TEST(ImporterTest, VectorFile) {
+  fs::remove_all(kTestDir);
+  fs::create_directories(kTestDir);
+  auto vectors = vectordb::RandomVectors(100, kDim);
+
+  ExpectRows(WriteFvecs(vectors), vectordb::IMPORT_FORMAT_FVECS, vectors);
+  ExpectRows(WriteNpy(vectors), vectordb::IMPORT_FORMAT_NPY, vectors);
+  ExpectRows(WriteRaw(vectors), vectordb::IMPORT_FORMAT_RAW, vectors);
+
+  // raw 格式必须给出维度
+  vectordb::VectorFile vf(kTestDir + "/data.raw", vectordb::IMPORT_FORMAT_RAW);
+  EXPECT_NE(vectordb::RET_OK, vf.Open());
+
+  vectordb::VectorFile missing(kTestDir + "/missing.fvecs",
+                               vectordb::IMPORT_FORMAT_FVECS);
+  EXPECT_EQ(vectordb::RET_NOT_FOUND, missing.Open());
+}
+
+// key 按字节序排列，且覆盖所有行
+TEST(ImporterTest, SortedImportKeys) {
+  auto keys = vectordb::SortedImportKeys(-50, 5000);
+  ASSERT_EQ(5000u, keys.size());
+
+  std::vector<bool> seen(5000, false);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::string key(keys[i].data, keys[i].size);
+    if (i > 0) {
+      std::string prev(keys[i - 1].data, keys[i - 1].size);
+      EXPECT_LT(prev, key);
+    }
+
+    vdb::Id id_obj;
+    ASSERT_TRUE(id_obj.ParseFromString(key));
+    EXPECT_EQ(-50 + keys[i].row, id_obj.id());
+    seen[keys[i].row] = true;
+  }
+  EXPECT_EQ(seen.end(), std::find(seen.begin(), seen.end(), false));
+}
+
+// 导入后可以按 id 读取，索引由文件直接构建
+TEST(ImporterTest, TableImport) {
+  fs::remove_all(kTestDir);
+  fs::create_directories(kTestDir);
+  auto vectors = vectordb::RandomVectors(3000, kDim);
+  std::string file = WriteFvecs(vectors);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir + "/table");
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(kDim);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(kDim);
+  hnsw_param.set_max_elements(1000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+
+  vectordb::ImportParam import_param;
+  import_param.start_id = 100;
+  import_param.rows_per_sst = 700;
+  EXPECT_EQ(vectordb::RET_OK, table.Import(file, import_param));
+  EXPECT_FALSE(fs::exists(kTestDir + "/table/import"));
+
+  int64_t count = 0;
+  auto counter = [&count](int64_t, const std::vector<float> &) {
+    ++count;
+    return vectordb::RET_OK;
+  };
+  EXPECT_EQ(vectordb::RET_OK, table.ForEachVector(counter));
+  EXPECT_EQ(3000, count);
+
+  for (int64_t row : {0, 1234, 2999}) {
+    std::vector<float> v;
+    std::string scalar;
+    EXPECT_EQ(vectordb::RET_OK, table.Get(100 + row, v, scalar));
+    EXPECT_EQ(vectors[row], v);
+
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[row], 1, ids, distances, scalars));
+    ASSERT_EQ(1u, ids.size());
+    EXPECT_EQ(100 + row, ids[0]);
+  }
+
+  // 已有索引的容量不够时先扩容再插入
+  import_param.start_id = 10000;
+  EXPECT_EQ(vectordb::RET_OK, table.Import(file, import_param));
+  count = 0;
+  EXPECT_EQ(vectordb::RET_OK, table.ForEachVector(counter));
+  EXPECT_EQ(6000, count);
+  {
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[5], 2, ids, distances, scalars));
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(std::vector<int64_t>({105, 10005}), ids);
+  }
+
+  // 维度不一致的文件被拒绝
+  vectordb::ImportParam raw_param;
+  raw_param.format = vectordb::IMPORT_FORMAT_RAW;
+  raw_param.dim = kDim / 2;
+  EXPECT_NE(vectordb::RET_OK, table.Import(WriteRaw(vectors), raw_param));
+}
+
+// cosine 表导入的向量与 Add 一样先归一化，保存和建索引的都是归一化后的
+TEST(ImporterTest, TableImportCosine) {
+  fs::remove_all(kTestDir);
+  fs::create_directories(kTestDir);
+  auto vectors = vectordb::RandomVectors(500, kDim);
+  for (auto &v : vectors) {
+    for (auto &x : v) {
+      x *= 10;
+    }
+  }
+  std::string file = WriteFvecs(vectors);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir + "/table");
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(kDim);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(kDim);
+  hnsw_param.set_max_elements(1000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_COSINE);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+
+  vectordb::ImportParam import_param;
+  EXPECT_EQ(vectordb::RET_OK, table.Import(file, import_param));
+
+  for (int64_t row : {0, 123, 499}) {
+    std::vector<float> v;
+    std::string scalar;
+    EXPECT_EQ(vectordb::RET_OK, table.Get(row, v, scalar));
+    std::vector<float> expected = vectors[row];
+    vectordb::Normalize(expected);
+    ASSERT_EQ(expected.size(), v.size());
+    for (int32_t d = 0; d < kDim; ++d) {
+      EXPECT_NEAR(expected[d], v[d], 1e-6);
+    }
+
+    // 自身的余弦距离为 0
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[row], 1, ids, distances, scalars));
+    ASSERT_EQ(1u, ids.size());
+    EXPECT_EQ(row, ids[0]);
+    EXPECT_NEAR(0.0f, distances[0], 1e-5);
+  }
+}
@@ -0,0 +1,158 @@
+#include "index_queue.h"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include <utility>
+
+#include "distance.h"
+#include "hnswlib/hnswlib.h"
+
+namespace vectordb {
+
+IndexQueue::IndexQueue(const IndexFunc &func, OpMetrics &metrics,
+                       int64_t max_pending)
+    : func_(func),
+      metrics_(metrics),
+      max_pending_(std::max<int64_t>(max_pending, 1)),
+      stop_(false) {
+  thread_ = std::thread(&IndexQueue::Run, this);
+}
+
+IndexQueue::~IndexQueue() {
+  {
+    std::lock_guard<std::mutex> lg(mu_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void IndexQueue::Push(int64_t id, const std::vector<float> &vector) {
+  std::unique_lock<std::mutex> ulk(mu_);
+  idle_cv_.wait(ulk, [this] {
+    return static_cast<int64_t>(entries_.size()) < max_pending_;
+  });
+  entries_.push_back(Entry{id, vector, std::chrono::steady_clock::now()});
+  cv_.notify_one();
+}
+
+void IndexQueue::Run() {
+  std::unique_lock<std::mutex> ulk(mu_);
+  while (true) {
+    cv_.wait(ulk, [this] { return stop_ || !entries_.empty(); });
+
+    // 停止前先把剩余的向量写入索引
+    if (entries_.empty()) {
+      return;
+    }
+
+    // deque 尾部插入不会使已有元素的引用失效，只有本线程会弹出
+    const Entry &entry = entries_.front();
+    ulk.unlock();
+
+    RetNo ret = func_(entry.id, entry.vector);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - entry.push_time)
+                  .count();
+    metrics_.Record(static_cast<uint64_t>(us), ret);
+
+    // 写入索引之后才出队，搜索期间不会漏掉这个向量
+    ulk.lock();
+    entries_.pop_front();
+    idle_cv_.notify_all();
+  }
+}
+
+void IndexQueue::Search(const std::vector<float> &vector, int32_t k,
+                        int32_t distance_type, std::vector<int64_t> &ids,
+                        std::vector<float> &distances) const {
+  ids.clear();
+  distances.clear();
+  if (k <= 0) {
+    return;
+  }
+
+  // 与索引使用相同的 hnswlib 距离函数，按编译选项走 SIMD 实现
+  hnswlib::L2Space l2_space(vector.size());
+  hnswlib::InnerProductSpace ip_space(vector.size());
+  HammingSpace hamming_space(vector.size() * kBitsPerFloat);
+  hnswlib::SpaceInterface<float> *space = &ip_space;
+  if (distance_type == DISTANCE_TYPE_L2) {
+    space = &l2_space;
+  } else if (distance_type == DISTANCE_TYPE_HAMMING) {
+    space = &hamming_space;
+  }
+  auto dist_func = space->get_dist_func();
+  void *dist_param = space->get_dist_func_param();
+
+  // 大顶堆保留最近的 k 个
+  std::priority_queue<std::pair<float, int64_t>> top;
+  std::unordered_set<int64_t> seen;
+  {
+    std::lock_guard<std::mutex> lg(mu_);
+
+    // 从新到旧扫描，重复写入的 id 只取最新的向量
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+      if (it->vector.size() != vector.size() || !seen.insert(it->id).second) {
+        continue;
+      }
+      float distance = dist_func(vector.data(), it->vector.data(), dist_param);
+      if (static_cast<int32_t>(top.size()) < k) {
+        top.emplace(distance, it->id);
+      } else if (distance < top.top().first) {
+        top.pop();
+        top.emplace(distance, it->id);
+      }
+    }
+  }
+
+  ids.resize(top.size());
+  distances.resize(top.size());
+  for (size_t i = top.size(); i > 0; --i) {
+    distances[i - 1] = top.top().first;
+    ids[i - 1] = top.top().second;
+    top.pop();
+  }
+}
+
+bool IndexQueue::Get(int64_t id, std::vector<float> &vector) const {
+  std::lock_guard<std::mutex> lg(mu_);
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    if (it->id == id) {
+      vector = it->vector;
+      return true;
+    }
+  }
+  return false;
+}
+
+void IndexQueue::WaitIdle() {
+  std::unique_lock<std::mutex> ulk(mu_);
+  idle_cv_.wait(ulk, [this] { return entries_.empty(); });
+}
+
+int64_t IndexQueue::Pending() const {
+  std::lock_guard<std::mutex> lg(mu_);
+  return entries_.size();
+}
+
+json IndexQueue::Stats() const {
+  std::lock_guard<std::mutex> lg(mu_);
+  json j;
+  j["pending"] = entries_.size();
+
+  // 最老的待索引向量已等待的时间，即索引落后于存储的程度
+  int64_t lag_us = 0;
+  if (!entries_.empty()) {
+    lag_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::steady_clock::now() - entries_.front().push_time)
+                 .count();
+  }
+  j["lag_us"] = lag_us;
+  return j;
+}
+
+}  // namespace vectordb
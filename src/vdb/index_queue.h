@@ -0,0 +1,90 @@
+#ifndef VECTORDB_INDEX_QUEUE_H
+#define VECTORDB_INDEX_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "metrics.h"
+#include "retno.h"
+
+namespace vectordb {
+
+// Vectors that are committed to rocksdb but not yet inserted into the
+// index. A background thread drains them in order through func.
+//
+// An entry is removed only after func returns, so a search that scans the
+// queue first and then the index sees every committed vector at least once.
+class IndexQueue final {
+ public:
+  using IndexFunc =
+      std::function<RetNo(int64_t id, const std::vector<float> &vector)>;
+
+  // Push blocks while max_pending vectors are waiting, which bounds the
+  // memory and the brute-force scan cost of the tail
+  static const int64_t kDefaultMaxPending = 1 << 16;
+
+  // every indexed vector records its queue latency into metrics
+  IndexQueue(const IndexFunc &func, OpMetrics &metrics,
+             int64_t max_pending = kDefaultMaxPending);
+
+  // index the remaining vectors, then stop the thread
+  ~IndexQueue();
+
+  IndexQueue(const IndexQueue &) = delete;
+  IndexQueue &operator=(const IndexQueue &) = delete;
+
+  void Push(int64_t id, const std::vector<float> &vector);
+
+  // input: v, k, distance_type
+  // output: ids, distances of the k closest pending vectors, sorted,
+  // an id pushed more than once uses its newest vector
+  void Search(const std::vector<float> &vector, int32_t k,
+              int32_t distance_type, std::vector<int64_t> &ids,
+              std::vector<float> &distances) const;
+
+  // newest pending vector of id, false if id is not pending
+  bool Get(int64_t id, std::vector<float> &vector) const;
+
+  // block until every pushed vector has been indexed
+  void WaitIdle();
+
+  int64_t Pending() const;
+
+  // pending count and age of the oldest pending vector
+  json Stats() const;
+
+ private:
+  void Run();
+
+  struct Entry {
+    int64_t id;
+    std::vector<float> vector;
+    std::chrono::steady_clock::time_point push_time;
+  };
+
+ private:
+  IndexFunc func_;
+  OpMetrics &metrics_;
+  int64_t max_pending_;
+
+  mutable std::mutex mu_;
+  std::condition_variable cv_;       // wakes the indexer
+  std::condition_variable idle_cv_;  // wakes Push and WaitIdle
+  std::deque<Entry> entries_;        // popped only by the indexer
+  bool stop_;
+  std::thread thread_;
+};
+
+using IndexQueueUPtr = std::unique_ptr<IndexQueue>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_INDEX_QUEUE_H
@@ -0,0 +1,119 @@
+#include "index_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "common.h"
+#include "metrics.h"
+
+// 索引函数在 gate 打开前阻塞，队列中的向量保持未索引状态
+class Gate {
+ public:
+  void Wait() {
+    std::unique_lock<std::mutex> ulk(mu_);
+    cv_.wait(ulk, [this] { return open_; });
+  }
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lg(mu_);
+      open_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool open_ = false;
+};
+
+// 未索引的向量可以被搜索和读取
+TEST(IndexQueueTest, SearchPending) {
+  Gate gate;
+  std::mutex mu;
+  std::map<int64_t, std::vector<float>> indexed;
+  vectordb::OpMetrics metrics;
+  vectordb::IndexQueue queue(
+      [&](int64_t id, const std::vector<float> &vector) {
+        gate.Wait();
+        std::lock_guard<std::mutex> lg(mu);
+        indexed[id] = vector;
+        return vectordb::RET_OK;
+      },
+      metrics);
+
+  for (int64_t id = 0; id < 10; ++id) {
+    queue.Push(id, std::vector<float>(4, static_cast<float>(id)));
+  }
+  // 同一 id 的新向量覆盖旧向量
+  queue.Push(3, std::vector<float>(4, 100.0f));
+  EXPECT_EQ(11, queue.Pending());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  queue.Search(std::vector<float>(4, 5.0f), 3, vectordb::DISTANCE_TYPE_L2, ids,
+               distances);
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ(5, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+  EXPECT_FLOAT_EQ(4.0f, distances[1]);
+  EXPECT_FLOAT_EQ(4.0f, distances[2]);
+
+  queue.Search(std::vector<float>(4, 100.0f), 1, vectordb::DISTANCE_TYPE_L2,
+               ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(3, ids[0]);
+
+  std::vector<float> vector;
+  EXPECT_TRUE(queue.Get(3, vector));
+  EXPECT_EQ(std::vector<float>(4, 100.0f), vector);
+  EXPECT_FALSE(queue.Get(10, vector));
+
+  json stats = queue.Stats();
+  EXPECT_EQ(11, stats["pending"].get<int64_t>());
+  EXPECT_GE(stats["lag_us"].get<int64_t>(), 0);
+
+  gate.Open();
+  queue.WaitIdle();
+  EXPECT_EQ(0, queue.Pending());
+  EXPECT_EQ(10u, indexed.size());
+  EXPECT_EQ(std::vector<float>(4, 100.0f), indexed[3]);
+  EXPECT_EQ(11u, metrics.count.load());
+  EXPECT_EQ(0u, metrics.errors.load());
+
+  queue.Search(std::vector<float>(4, 5.0f), 3, vectordb::DISTANCE_TYPE_L2, ids,
+               distances);
+  EXPECT_TRUE(ids.empty());
+}
+
+// Push 在队列满时等待，析构时写完剩余的向量
+TEST(IndexQueueTest, BackpressureAndDrain) {
+  std::atomic<int64_t> count{0};
+  vectordb::OpMetrics metrics;
+  {
+    vectordb::IndexQueue queue(
+        [&count](int64_t, const std::vector<float> &) {
+          ++count;
+          return count % 100 == 0 ? vectordb::RET_ERROR : vectordb::RET_OK;
+        },
+        metrics, 8);
+    for (int64_t id = 0; id < 1000; ++id) {
+      queue.Push(id, std::vector<float>(4, 1.0f));
+      EXPECT_LE(queue.Pending(), 8);
+    }
+  }
+  EXPECT_EQ(1000, count.load());
+  EXPECT_EQ(1000u, metrics.count.load());
+  EXPECT_EQ(10u, metrics.errors.load());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
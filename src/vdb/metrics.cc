@@ -0,0 +1,287 @@
+#include "metrics.h"
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace vectordb {
+
+const uint64_t Histogram::kBounds[Histogram::kBucketNum] = {
+    1,      2,      5,      10,      20,      50,      100,     200,
+    500,    1000,   2000,   5000,    10000,   20000,   50000,   100000,
+    200000, 500000, 1000000, 2000000, 5000000, UINT64_MAX};
+
+Histogram::Histogram() : count_(0), sum_(0), max_(0) {
+  for (int32_t i = 0; i < kBucketNum; ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::Record(uint64_t us) {
+  int32_t i = 0;
+  while (us > kBounds[i]) {
+    ++i;
+  }
+  buckets_[i].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(us, std::memory_order_relaxed);
+
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (us > max &&
+         !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+double Histogram::Percentile(double p) const {
+  uint64_t counts[kBucketNum];
+  uint64_t total = 0;
+  for (int32_t i = 0; i < kBucketNum; ++i) {
+    counts[i] = BucketCount(i);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  double threshold = total * p / 100.0;
+  uint64_t cumulative = 0;
+  for (int32_t i = 0; i < kBucketNum; ++i) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    if (cumulative + counts[i] >= threshold) {
+      double left = i == 0 ? 0 : kBounds[i - 1];
+      double right = i == kBucketNum - 1 ? Max() : kBounds[i];
+      if (right > Max()) {
+        right = Max();
+      }
+      if (right < left) {
+        return right;
+      }
+      double pos = (threshold - cumulative) / counts[i];
+      return left + (right - left) * pos;
+    }
+    cumulative += counts[i];
+  }
+  return Max();
+}
+
+json Histogram::ToJson() const {
+  json j;
+  j["count"] = Count();
+  j["sum_us"] = Sum();
+  j["max_us"] = Max();
+  j["p50_us"] = Percentile(50);
+  j["p90_us"] = Percentile(90);
+  j["p99_us"] = Percentile(99);
+  j["p999_us"] = Percentile(99.9);
+  j["buckets"] = json::array();
+  for (int32_t i = 0; i < kBucketNum; ++i) {
+    json b;
+    b["le"] = i == kBucketNum - 1 ? std::string("+Inf")
+                                  : std::to_string(kBounds[i]);
+    b["count"] = BucketCount(i);
+    j["buckets"].push_back(b);
+  }
+  return j;
+}
+
+void OpMetrics::Record(uint64_t us, RetNo ret) {
+  count.fetch_add(1, std::memory_order_relaxed);
+  if (ret == RET_PARTIAL) {
+    partial.fetch_add(1, std::memory_order_relaxed);
+  } else if (ret != RET_OK && ret != RET_NOT_FOUND) {
+    errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  latency.Record(us);
+}
+
+json OpMetrics::ToJson() const {
+  json j;
+  j["count"] = count.load(std::memory_order_relaxed);
+  j["errors"] = errors.load(std::memory_order_relaxed);
+  j["partial"] = partial.load(std::memory_order_relaxed);
+  j["latency"] = latency.ToJson();
+  return j;
+}
+
+json TableMetrics::ToJson() const {
+  json j;
+  j["add"] = add.ToJson();
+  j["get"] = get.ToJson();
+  j["search"] = search.ToJson();
+  j["range_search"] = range_search.ToJson();
+  j["build_index"] = build_index.ToJson();
+  j["import"] = import.ToJson();
+  j["write_group"] = write_group.ToJson();
+  j["async_index"] = async_index.ToJson();
+  return j;
+}
+
+json IndexMetrics::ToJson() const {
+  json j;
+  j["add"] = add.ToJson();
+  j["search"] = search.ToJson();
+  j["range_search"] = range_search.ToJson();
+  return j;
+}
+
+namespace {
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+struct Family {
+  std::string type;
+  std::vector<std::string> lines;
+};
+
+class PrometheusWriter {
+ public:
+  void Add(const std::string &name, const std::string &type,
+           const Labels &labels, const std::string &value) {
+    Family &family = families_[name];
+    family.type = type;
+    family.lines.push_back(name + LabelStr(labels) + " " + value);
+  }
+
+  // histogram 的 bucket 需要累计计数
+  void AddHistogram(const std::string &name, const Labels &labels,
+                    const json &h) {
+    Family &family = families_[name];
+    family.type = "histogram";
+
+    uint64_t cumulative = 0;
+    for (const auto &b : h["buckets"]) {
+      cumulative += b["count"].get<uint64_t>();
+      Labels bucket_labels = labels;
+      bucket_labels.emplace_back("le", b["le"].get<std::string>());
+      family.lines.push_back(name + "_bucket" + LabelStr(bucket_labels) +
+                             " " + std::to_string(cumulative));
+    }
+    family.lines.push_back(name + "_sum" + LabelStr(labels) + " " +
+                           std::to_string(h["sum_us"].get<uint64_t>()));
+    family.lines.push_back(name + "_count" + LabelStr(labels) + " " +
+                           std::to_string(h["count"].get<uint64_t>()));
+  }
+
+  void AddOps(const std::string &prefix, const Labels &labels,
+              const json &ops) {
+    for (auto it = ops.begin(); it != ops.end(); ++it) {
+      Labels op_labels = labels;
+      op_labels.emplace_back("op", it.key());
+      Add(prefix + "_ops_total", "counter", op_labels,
+          std::to_string(it.value()["count"].get<uint64_t>()));
+      Add(prefix + "_errors_total", "counter", op_labels,
+          std::to_string(it.value()["errors"].get<uint64_t>()));
+      Add(prefix + "_partial_total", "counter", op_labels,
+          std::to_string(it.value()["partial"].get<uint64_t>()));
+      AddHistogram(prefix + "_latency_us", op_labels, it.value()["latency"]);
+    }
+  }
+
+  std::string ToString() const {
+    std::string s;
+    for (const auto &family : families_) {
+      s += "# TYPE " + family.first + " " + family.second.type + "\n";
+      for (const auto &line : family.second.lines) {
+        s += line + "\n";
+      }
+    }
+    return s;
+  }
+
+ private:
+  static std::string LabelStr(const Labels &labels) {
+    if (labels.empty()) {
+      return "";
+    }
+    std::string s = "{";
+    for (size_t i = 0; i < labels.size(); ++i) {
+      if (i > 0) {
+        s += ",";
+      }
+      s += labels[i].first + "=\"" + labels[i].second + "\"";
+    }
+    s += "}";
+    return s;
+  }
+
+  std::map<std::string, Family> families_;
+};
+
+std::string ValueStr(const json &v) {
+  std::ostringstream oss;
+  if (v.is_number_unsigned()) {
+    oss << v.get<uint64_t>();
+  } else if (v.is_number_integer()) {
+    oss << v.get<int64_t>();
+  } else if (v.is_number()) {
+    oss << v.get<double>();
+  } else {
+    oss << 0;
+  }
+  return oss.str();
+}
+
+}  // namespace
+
+std::string StatsToPrometheus(const json &stats) {
+  PrometheusWriter writer;
+  if (!stats.contains("tables")) {
+    return writer.ToString();
+  }
+
+  for (auto t = stats["tables"].begin(); t != stats["tables"].end(); ++t) {
+    Labels table_labels = {{"table", t.key()}};
+    const json &table = t.value();
+
+    if (table.contains("ops")) {
+      writer.AddOps("vdb_table", table_labels, table["ops"]);
+    }
+
+    if (table.contains("rocksdb")) {
+      const json &rocksdb = table["rocksdb"];
+      for (auto cf = rocksdb.begin(); cf != rocksdb.end(); ++cf) {
+        Labels cf_labels = table_labels;
+        cf_labels.emplace_back("cf", cf.key());
+        for (auto p = cf.value().begin(); p != cf.value().end(); ++p) {
+          writer.Add("vdb_rocksdb_" + p.key(), "gauge", cf_labels,
+                     ValueStr(p.value()));
+        }
+      }
+    }
+
+    // 异步索引队列的积压和滞后
+    if (table.contains("index_queue")) {
+      const json &queue = table["index_queue"];
+      writer.Add("vdb_index_queue_pending", "gauge", table_labels,
+                 ValueStr(queue["pending"]));
+      writer.Add("vdb_index_queue_lag_us", "gauge", table_labels,
+                 ValueStr(queue["lag_us"]));
+    }
+
+    if (table.contains("indexes")) {
+      const json &indexes = table["indexes"];
+      for (auto i = indexes.begin(); i != indexes.end(); ++i) {
+        Labels index_labels = table_labels;
+        index_labels.emplace_back("index", i.key());
+        const json &index = i.value();
+        writer.Add("vdb_index_size", "gauge", index_labels,
+                   ValueStr(index["size"]));
+        writer.Add("vdb_index_memory_bytes", "gauge", index_labels,
+                   ValueStr(index["memory_bytes"]));
+        writer.Add("vdb_index_distance_computations_total", "counter",
+                   index_labels, ValueStr(index["distance_computations"]));
+        writer.Add("vdb_index_hops_total", "counter", index_labels,
+                   ValueStr(index["hops"]));
+        if (index.contains("ops")) {
+          writer.AddOps("vdb_index", index_labels, index["ops"]);
+        }
+      }
+    }
+  }
+
+  return writer.ToString();
+}
+
+}  // namespace vectordb
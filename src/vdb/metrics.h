@@ -0,0 +1,116 @@
+#ifndef VECTORDB_METRICS_H
+#define VECTORDB_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "common.h"
+#include "retno.h"
+
+namespace vectordb {
+
+enum StatsFormat {
+  STATS_FORMAT_JSON = 0,
+  STATS_FORMAT_PROMETHEUS,
+};
+
+// Lock-free latency histogram, fixed buckets in microseconds.
+class Histogram final {
+ public:
+  static const int32_t kBucketNum = 22;
+  static const uint64_t kBounds[kBucketNum];  // upper bounds, last is +inf
+
+  Histogram();
+
+  Histogram(const Histogram &) = delete;
+  Histogram &operator=(const Histogram &) = delete;
+
+  void Record(uint64_t us);
+
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+  uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+  uint64_t BucketCount(int32_t i) const {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+
+  // p in [0, 100], linear interpolation inside the bucket
+  double Percentile(double p) const;
+
+  json ToJson() const;
+
+ private:
+  std::atomic<uint64_t> buckets_[kBucketNum];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+// counters and latency of one kind of operation
+struct OpMetrics {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> partial{0};  // RET_PARTIAL, not counted as errors
+  Histogram latency;
+
+  void Record(uint64_t us, RetNo ret);
+  json ToJson() const;
+};
+
+// record the elapsed time of an operation into OpMetrics
+class OpTimer final {
+ public:
+  explicit OpTimer(OpMetrics &metrics)
+      : metrics_(metrics), start_(std::chrono::steady_clock::now()) {}
+
+  OpTimer(const OpTimer &) = delete;
+  OpTimer &operator=(const OpTimer &) = delete;
+
+  RetNo Done(RetNo ret) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start_)
+                  .count();
+    metrics_.Record(static_cast<uint64_t>(us), ret);
+    return ret;
+  }
+
+ private:
+  OpMetrics &metrics_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+struct TableMetrics {
+  OpMetrics add;
+  OpMetrics get;
+  OpMetrics search;
+  OpMetrics range_search;
+  OpMetrics build_index;
+  OpMetrics import;
+
+  // one rocksdb write per group of concurrent adds,
+  // add.count / write_group.count is the average group size
+  OpMetrics write_group;
+
+  // one per vector indexed by the async index queue, latency is the time
+  // it waited in the queue plus the index insert
+  OpMetrics async_index;
+
+  json ToJson() const;
+};
+
+struct IndexMetrics {
+  OpMetrics add;
+  OpMetrics search;
+  OpMetrics range_search;
+
+  json ToJson() const;
+};
+
+// convert the json returned by Vdb::Stats() to prometheus text format
+std::string StatsToPrometheus(const json &stats);
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_METRICS_H
@@ -0,0 +1,113 @@
+#include "metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace vectordb {
+
+TEST(MetricsTest, Histogram) {
+  Histogram h;
+  EXPECT_EQ(h.Count(), 0u);
+  EXPECT_DOUBLE_EQ(h.Percentile(99), 0);
+
+  for (uint64_t i = 1; i <= 100; ++i) {
+    h.Record(i);
+  }
+  EXPECT_EQ(h.Count(), 100u);
+  EXPECT_EQ(h.Sum(), 5050u);
+  EXPECT_EQ(h.Max(), 100u);
+
+  // 百分位在桶内线性插值，误差不超过桶宽
+  EXPECT_GT(h.Percentile(50), 20);
+  EXPECT_LE(h.Percentile(50), 100);
+  EXPECT_GT(h.Percentile(99), 50);
+  EXPECT_LE(h.Percentile(99), 100);
+  EXPECT_LE(h.Percentile(50), h.Percentile(90));
+  EXPECT_LE(h.Percentile(90), h.Percentile(99));
+
+  // 超出最大边界的值落入最后一个桶
+  h.Record(UINT64_MAX / 2);
+  EXPECT_EQ(h.BucketCount(Histogram::kBucketNum - 1), 1u);
+}
+
+TEST(MetricsTest, Concurrent) {
+  OpMetrics m;
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&m] {
+      for (int32_t i = 0; i < 1000; ++i) {
+        m.Record(i, i % 10 == 0 ? RET_ERROR : RET_OK);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(m.count.load(), 4000u);
+  EXPECT_EQ(m.errors.load(), 400u);
+  EXPECT_EQ(m.latency.Count(), 4000u);
+}
+
+TEST(MetricsTest, OpTimer) {
+  OpMetrics m;
+  {
+    OpTimer timer(m);
+    EXPECT_EQ(timer.Done(RET_NOT_FOUND), RET_NOT_FOUND);
+  }
+  EXPECT_EQ(m.count.load(), 1u);
+  EXPECT_EQ(m.errors.load(), 0u);
+
+  // partial 单独计数，不算作错误
+  {
+    OpTimer timer(m);
+    EXPECT_EQ(timer.Done(RET_PARTIAL), RET_PARTIAL);
+  }
+  EXPECT_EQ(m.count.load(), 2u);
+  EXPECT_EQ(m.errors.load(), 0u);
+  EXPECT_EQ(m.partial.load(), 1u);
+}
+
+TEST(MetricsTest, Prometheus) {
+  TableMetrics table_metrics;
+  table_metrics.search.Record(150, RET_OK);
+  table_metrics.search.Record(3000, RET_ERROR);
+
+  json stats;
+  stats["tables"]["t1"]["ops"] = table_metrics.ToJson();
+  stats["tables"]["t1"]["rocksdb"]["vector"]["estimate_num_keys"] = 10;
+  stats["tables"]["t1"]["indexes"]["0"]["size"] = 10;
+  stats["tables"]["t1"]["indexes"]["0"]["memory_bytes"] = 4096;
+  stats["tables"]["t1"]["indexes"]["0"]["distance_computations"] = 99;
+  stats["tables"]["t1"]["indexes"]["0"]["hops"] = 7;
+  stats["tables"]["t1"]["index_queue"]["pending"] = 3;
+  stats["tables"]["t1"]["index_queue"]["lag_us"] = 1200;
+
+  std::string text = StatsToPrometheus(stats);
+  std::cout << text << std::endl;
+  EXPECT_NE(text.find("# TYPE vdb_table_ops_total counter"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_table_ops_total{table=\"t1\",op=\"search\"} 2"),
+            std::string::npos);
+  EXPECT_NE(
+      text.find("vdb_table_errors_total{table=\"t1\",op=\"search\"} 1"),
+      std::string::npos);
+  EXPECT_NE(text.find("vdb_table_latency_us_bucket{table=\"t1\",op="
+                      "\"search\",le=\"200\"} 1"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_table_latency_us_bucket{table=\"t1\",op="
+                      "\"search\",le=\"+Inf\"} 2"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_rocksdb_estimate_num_keys{table=\"t1\",cf="
+                      "\"vector\"} 10"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_index_hops_total{table=\"t1\",index=\"0\"} 7"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_index_queue_pending{table=\"t1\"} 3"),
+            std::string::npos);
+  EXPECT_NE(text.find("vdb_index_queue_lag_us{table=\"t1\"} 1200"),
+            std::string::npos);
+}
+
+}  // namespace vectordb
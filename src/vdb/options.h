@@ -1,14 +1,92 @@
 #ifndef VECTORDB_OPTIONS_H
 #define VECTORDB_OPTIONS_H
 
+#include <chrono>
+#include <cstdint>
+
 namespace vectordb {
 
+struct SearchProfile;
+
 struct WOptions {
   bool write_vector_to_data = true;
   bool write_vector_to_index = true;
+
+  // fsync the WAL before returning
+  bool sync = false;
+
+  // skip the WAL, only for tables that can be rebuilt from the source,
+  // unflushed writes are lost on crash
+  bool disable_wal = false;
+
+  // return once the vector is in rocksdb, a background thread inserts it
+  // into the index, searches scan the not yet indexed vectors meanwhile
+  bool async_index = false;
+};
+
+struct ROptions {
+  // hnsw search depth, 0 means max(k, index default)
+  int32_t ef = 0;
+
+  // re-rank factor r, > 0 makes Table::Search take k * r candidates from
+  // the index and re-rank them by the exact distance to the fp32 vectors
+  // read from the vector column family, for indexes with approximate
+  // distances such as pq, 0 returns the index distances as they are
+  int32_t rerank = 0;
+
+  // steady clock time the search must finish by, the default means none.
+  // a search reaching it returns the best results so far with RET_PARTIAL,
+  // one that has not started by then does no work and returns RET_TIMEOUT
+  std::chrono::steady_clock::time_point deadline{};
+
+  // distance computations one index (shard or segment) may spend, 0 means
+  // no limit, reaching it returns the results so far with RET_PARTIAL
+  int64_t max_distance_computations = 0;
+
+  // filled with where the time of the search went when not nullptr,
+  // see SearchProfile, nothing is measured otherwise
+  SearchProfile *profile = nullptr;
+
+  // deadline = now + timeout
+  void SetTimeout(std::chrono::microseconds timeout) {
+    deadline = std::chrono::steady_clock::now() + timeout;
+  }
+
+  bool HasDeadline() const {
+    return deadline != std::chrono::steady_clock::time_point();
+  }
+
+  bool Expired() const {
+    return HasDeadline() && std::chrono::steady_clock::now() >= deadline;
+  }
 };
 
-struct ROptions {};
+// stop condition of one index search from the deadline and the budget of
+// ROptions, not thread safe
+class SearchLimit final {
+ public:
+  explicit SearchLimit(const ROptions &options)
+      : options_(options), computations_(0) {}
+
+  // no deadline and no budget, the index can use its own search
+  bool unlimited() const {
+    return !options_.HasDeadline() && options_.max_distance_computations <= 0;
+  }
+
+  // count n more distance computations, true once the search should stop
+  bool Exceeded(int64_t n) {
+    computations_ += n;
+    if (options_.max_distance_computations > 0 &&
+        computations_ >= options_.max_distance_computations) {
+      return true;
+    }
+    return options_.Expired();
+  }
+
+ private:
+  const ROptions &options_;
+  int64_t computations_;
+};
 
 }  // namespace vectordb
 
@@ -0,0 +1,328 @@
+#include "pq_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <queue>
+
+#include "search_profile.h"
+#include "thread_pool.h"
+
+namespace vectordb {
+
+namespace {
+
+const uint64_t kPqIndexMagic = 0x5844494e44495150ULL;  // "PQINDIDX"
+const uint64_t kPqRawMagic = 0x5741524e44495150ULL;    // "PQINDRAW"
+
+// 每块向量由一个线程扫描
+const size_t kScanChunk = 1 << 16;
+
+// 有限制时每扫描这么多向量检查一次，避免每个向量都读时钟
+const size_t kLimitBatch = 1024;
+
+}  // namespace
+
+PqIndex::PqIndex(const std::string &path, const vdb::PqParam &param)
+    : file_(path + "/pq.index"),
+      param_(param),
+      dim_(param.dim()),
+      train_size_(std::max(param.train_size() > 0 ? param.train_size()
+                                                  : kDefaultTrainSize,
+                           int32_t(ProductQuantizer::kCentroidNum))),
+      dist_func_(nullptr),
+      dist_param_(nullptr),
+      pq_(param.dim(), param.m() > 0 ? param.m() : std::max(1, dim_ / 4),
+          param.distance_type()),
+      trained_(false) {
+  if (param_.distance_type() == DISTANCE_TYPE_L2) {
+    space_ = std::make_unique<hnswlib::L2Space>(dim_);
+  } else {
+    space_ = std::make_unique<hnswlib::InnerProductSpace>(dim_);
+  }
+  dist_func_ = space_->get_dist_func();
+  dist_param_ = space_->get_dist_func_param();
+}
+
+RetNo PqIndex::Load() {
+  std::ifstream in(file_, std::ios::binary);
+  if (!in) {
+    return RET_OK;
+  }
+
+  uint64_t magic = 0;
+  uint32_t n = 0;
+  in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  in.read(reinterpret_cast<char *>(&n), sizeof(n));
+  if (!in || (magic != kPqIndexMagic && magic != kPqRawMagic)) {
+    return RET_ERROR;
+  }
+
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  ids_.resize(n);
+  in.read(reinterpret_cast<char *>(ids_.data()), n * sizeof(int64_t));
+  id_to_slot_.clear();
+  for (uint32_t i = 0; i < n; ++i) {
+    id_to_slot_[ids_[i]] = i;
+  }
+
+  // 未训练时保存的是原始向量，继续缓冲到 train_size
+  if (magic == kPqRawMagic) {
+    buffer_.resize(static_cast<size_t>(n) * dim_);
+    in.read(reinterpret_cast<char *>(buffer_.data()),
+            buffer_.size() * sizeof(float));
+    codes_.clear();
+    trained_ = false;
+    return in ? RET_OK : RET_ERROR;
+  }
+
+  RetNo ret = pq_.Load(in);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  codes_.resize(static_cast<size_t>(n) * pq_.code_size());
+  in.read(reinterpret_cast<char *>(codes_.data()), codes_.size());
+  if (!in) {
+    return RET_ERROR;
+  }
+
+  buffer_.clear();
+  trained_ = true;
+  return RET_OK;
+}
+
+RetNo PqIndex::Add(int64_t id, const std::vector<float> &vector) {
+  if (vector.size() != static_cast<size_t>(dim_)) {
+    return RET_ERROR;
+  }
+
+  if (trained_) {
+    // 码本训练后不再变化，编码不需要持有锁
+    std::vector<uint8_t> code(pq_.code_size());
+    pq_.Encode(vector.data(), code.data());
+
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    auto it = id_to_slot_.find(id);
+    uint32_t slot = 0;
+    if (it != id_to_slot_.end()) {
+      slot = it->second;
+    } else {
+      slot = ids_.size();
+      ids_.push_back(id);
+      codes_.resize(codes_.size() + code.size());
+      id_to_slot_[id] = slot;
+    }
+    memcpy(codes_.data() + slot * code.size(), code.data(), code.size());
+    return RET_OK;
+  }
+
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  if (trained_) {
+    // 等锁期间已经训练完成
+    ulk.unlock();
+    return Add(id, vector);
+  }
+
+  auto it = id_to_slot_.find(id);
+  if (it != id_to_slot_.end()) {
+    std::copy(vector.begin(), vector.end(),
+              buffer_.begin() + static_cast<size_t>(it->second) * dim_);
+    return RET_OK;
+  }
+  id_to_slot_[id] = ids_.size();
+  ids_.push_back(id);
+  buffer_.insert(buffer_.end(), vector.begin(), vector.end());
+
+  if (static_cast<int64_t>(ids_.size()) >= train_size_) {
+    return Train();
+  }
+  return RET_OK;
+}
+
+RetNo PqIndex::Train() {
+  size_t n = ids_.size();
+  if (n == 0) {
+    return RET_OK;
+  }
+
+  RetNo ret = pq_.Train(buffer_.data(), n);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  codes_.resize(n * pq_.code_size());
+  DefaultThreadPool().ParallelFor(0, n, [this](int64_t i) {
+    pq_.Encode(buffer_.data() + i * dim_, codes_.data() + i * pq_.code_size());
+  });
+
+  // 编码后释放原始向量
+  std::vector<float>().swap(buffer_);
+  trained_ = true;
+  return RET_OK;
+}
+
+RetNo PqIndex::Persist() {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  if (ids_.empty()) {
+    return RET_OK;
+  }
+
+  // 先写临时文件再改名，异常退出时旧文件仍然完整。
+  // 样本不足 train_size 时不训练，码本会很差，保存原始向量
+  const std::string tmp_file = file_ + ".tmp";
+  std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+  uint32_t n = ids_.size();
+  const uint64_t &magic = trained_ ? kPqIndexMagic : kPqRawMagic;
+  out.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+  out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  out.write(reinterpret_cast<const char *>(ids_.data()),
+            ids_.size() * sizeof(int64_t));
+  if (trained_) {
+    RetNo ret = pq_.Save(out);
+    if (ret != RET_OK) {
+      return ret;
+    }
+    out.write(reinterpret_cast<const char *>(codes_.data()), codes_.size());
+  } else {
+    out.write(reinterpret_cast<const char *>(buffer_.data()),
+              buffer_.size() * sizeof(float));
+  }
+  out.close();
+  if (!out) {
+    return RET_ERROR;
+  }
+  fs::rename(tmp_file, file_);
+  return RET_OK;
+}
+
+RetNo PqIndex::Search(const float *query, int32_t k,
+                      std::vector<int64_t> &ids,
+                      std::vector<float> &distances,
+                      const ROptions &options) const {
+  ids.clear();
+  distances.clear();
+
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  size_t n = ids_.size();
+  if (k <= 0 || n == 0) {
+    return RET_OK;
+  }
+
+  // 训练前直接用精确距离扫描缓冲区
+  bool trained = trained_;
+  std::vector<float> table;
+  if (trained) {
+    table.resize(pq_.table_size());
+    pq_.ComputeTable(query, table.data());
+  }
+  size_t code_size = pq_.code_size();
+  auto distance = [&](size_t i) {
+    if (trained) {
+      return pq_.TableDistance(table.data(), codes_.data() + i * code_size);
+    }
+    return dist_func_(query, buffer_.data() + i * dim_, dist_param_);
+  };
+
+  // 分块并行扫描，每块保留自己的 top-k。
+  // 各块共享一个限制，超出后所有块停止扫描
+  SearchLimit limit(options);
+  bool limited = !limit.unlimited();
+  std::mutex limit_mu;
+  std::atomic<bool> exceeded(false);
+  size_t chunks = (n + kScanChunk - 1) / kScanChunk;
+  std::vector<std::vector<std::pair<float, int64_t>>> tops(chunks);
+  std::vector<int64_t> scanned(chunks, 0);
+  auto scan = [&](int64_t c) {
+    std::priority_queue<std::pair<float, int64_t>> heap;
+    size_t end = std::min(n, (c + 1) * kScanChunk);
+    for (size_t i = c * kScanChunk; i < end; ++i) {
+      if (limited && (i + 1) % kLimitBatch == 0) {
+        std::lock_guard<std::mutex> lg(limit_mu);
+        if (exceeded || limit.Exceeded(kLimitBatch)) {
+          exceeded = true;
+          break;
+        }
+      }
+      scanned[c]++;
+      float d = distance(i);
+      if (static_cast<int32_t>(heap.size()) < k) {
+        heap.emplace(d, ids_[i]);
+      } else if (d < heap.top().first) {
+        heap.pop();
+        heap.emplace(d, ids_[i]);
+      }
+    }
+    tops[c].reserve(heap.size());
+    while (!heap.empty()) {
+      tops[c].push_back(heap.top());
+      heap.pop();
+    }
+  };
+  if (chunks == 1) {
+    scan(0);
+  } else {
+    DefaultThreadPool().ParallelFor(0, chunks, scan);
+  }
+
+  // 每个扫描的编码算一次距离，与 flat 的统计一致
+  if (options.profile) {
+    SearchProfile counts;
+    for (int64_t count : scanned) {
+      counts.distance_computations += count;
+      counts.visited += count;
+    }
+    options.profile->Add(counts);
+  }
+
+  std::vector<std::pair<float, int64_t>> results;
+  for (const auto &top : tops) {
+    results.insert(results.end(), top.begin(), top.end());
+  }
+  size_t top = std::min(results.size(), static_cast<size_t>(k));
+  std::partial_sort(results.begin(), results.begin() + top, results.end());
+
+  ids.resize(top);
+  distances.resize(top);
+  for (size_t i = 0; i < top; ++i) {
+    distances[i] = results[i].first;
+    ids[i] = results[i].second;
+  }
+  return exceeded ? RET_PARTIAL : RET_OK;
+}
+
+bool PqIndex::Contains(int64_t id) const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  return id_to_slot_.count(id) > 0;
+}
+
+int64_t PqIndex::Size() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  return ids_.size();
+}
+
+int64_t PqIndex::MemoryUsage() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  int64_t bytes = codes_.size() + buffer_.size() * sizeof(float) +
+                  ids_.size() * sizeof(int64_t);
+  if (trained_) {
+    bytes += static_cast<int64_t>(ProductQuantizer::kCentroidNum) * dim_ *
+             sizeof(float);
+  }
+  bytes += id_to_slot_.size() *
+           (sizeof(int64_t) + sizeof(uint32_t) + sizeof(void *));
+  return bytes;
+}
+
+json PqIndex::Stats() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  json j;
+  j["size"] = ids_.size();
+  j["trained"] = trained_.load();
+  j["m"] = pq_.m();
+  j["code_bytes"] = codes_.size();
+  j["buffer_bytes"] = buffer_.size() * sizeof(float);
+  return j;
+}
+
+}  // namespace vectordb
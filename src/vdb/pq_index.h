@@ -0,0 +1,91 @@
+#ifndef VECTORDB_PQ_INDEX_H
+#define VECTORDB_PQ_INDEX_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "hnswlib/hnswlib.h"
+#include "options.h"
+#include "quantizer.h"
+#include "retno.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+// Product-quantized flat index: only the m byte code of every vector is
+// kept, search scans all codes with table distances. The distances are
+// approximate, pair it with ROptions::rerank to re-rank the candidates
+// with the exact vectors from the table.
+//
+// Vectors are buffered in fp32 until train_size (at least kCentroidNum)
+// of them arrived, then the codebook is trained on the buffer and the
+// buffer is encoded and dropped. Until then search is exact and Persist
+// writes the raw buffer, a codebook is never trained on too few samples.
+//
+// The original vectors are not kept, GetVector and ForEachVector fail.
+class PqIndex final {
+ public:
+  static const int32_t kDefaultTrainSize = 10000;
+
+  PqIndex(const std::string &path, const vdb::PqParam &param);
+
+  PqIndex(const PqIndex &) = delete;
+  PqIndex &operator=(const PqIndex &) = delete;
+
+  // read path/pq.index if it exists
+  RetNo Load();
+
+  RetNo Add(int64_t id, const std::vector<float> &vector);
+
+  // write path/pq.index, the codes or the untrained buffer
+  RetNo Persist();
+
+  // under the deadline or distance budget of options the scan stops early
+  // and returns the best results so far with RET_PARTIAL
+  RetNo Search(const float *query, int32_t k, std::vector<int64_t> &ids,
+               std::vector<float> &distances,
+               const ROptions &options = ROptions()) const;
+
+  bool Contains(int64_t id) const;
+
+  int64_t Size() const;
+  int64_t MemoryUsage() const;
+  json Stats() const;
+
+ private:
+  // train on the buffered vectors and encode them, mu_ must be held
+  RetNo Train();
+
+ private:
+  std::string file_;
+  vdb::PqParam param_;
+  int32_t dim_;
+  int32_t train_size_;
+
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
+  hnswlib::DISTFUNC<float> dist_func_;
+  void *dist_param_;
+
+  mutable std::shared_mutex mu_;
+  ProductQuantizer pq_;
+  std::atomic<bool> trained_;
+
+  // slot i holds ids_[i] and codes_[i * m, (i + 1) * m), or
+  // buffer_[i * dim, (i + 1) * dim) before training
+  std::vector<int64_t> ids_;
+  std::vector<uint8_t> codes_;
+  std::vector<float> buffer_;
+  std::unordered_map<int64_t, uint32_t> id_to_slot_;
+};
+
+using PqIndexUPtr = std::unique_ptr<PqIndex>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_PQ_INDEX_H
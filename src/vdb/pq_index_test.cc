@@ -0,0 +1,200 @@
+#include "pq_index.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "distance.h"
+#include "search_profile.h"
+#include "test_util.h"
+
+const std::string kTestDir = "/tmp/pq_index_test";
+const int32_t kDim = 16;
+
+vdb::PqParam TestParam() {
+  vdb::PqParam param;
+  param.set_dim(kDim);
+  param.set_max_elements(10000);
+  param.set_m(8);
+  param.set_train_size(1000);
+  param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  return param;
+}
+
+void ResetDir() {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+  fs::create_directories(kTestDir);
+}
+
+// 训练前是精确搜索，覆盖写入以新向量为准
+TEST(PqIndexTest, BeforeTrain) {
+  ResetDir();
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(200, kDim, 1, 0.0f, 1.0f);
+  vectordb::PqIndex index(kTestDir, TestParam());
+  for (size_t i = 0; i < base.size(); ++i) {
+    ASSERT_EQ(vectordb::RET_OK, index.Add(i, base[i]));
+  }
+  EXPECT_EQ(200, index.Size());
+  EXPECT_FALSE(index.Stats()["trained"].get<bool>());
+  EXPECT_EQ(vectordb::RET_ERROR, index.Add(0, std::vector<float>(kDim + 1)));
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  ASSERT_EQ(vectordb::RET_OK, index.Search(base[3].data(), 5, ids, distances));
+  ASSERT_EQ(5u, ids.size());
+  EXPECT_EQ(3, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+  EXPECT_EQ(vectordb::BruteForce(base, base[3], 5),
+            std::set<int64_t>(ids.begin(), ids.end()));
+
+  std::vector<float> far(kDim, 10.0f);
+  index.Add(3, far);
+  EXPECT_EQ(200, index.Size());
+  index.Search(far.data(), 1, ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(3, ids[0]);
+
+  // 样本不足时 Persist 不训练，重新打开后仍是精确搜索
+  ASSERT_EQ(vectordb::RET_OK, index.Persist());
+  EXPECT_FALSE(index.Stats()["trained"].get<bool>());
+  vectordb::PqIndex reopened(kTestDir, TestParam());
+  ASSERT_EQ(vectordb::RET_OK, reopened.Load());
+  EXPECT_EQ(200, reopened.Size());
+  EXPECT_FALSE(reopened.Stats()["trained"].get<bool>());
+  reopened.Search(far.data(), 1, ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(3, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+
+  // 继续写入到 train_size 后训练
+  std::vector<std::vector<float>> more =
+      vectordb::RandomVectors(800, kDim, 4, 0.0f, 1.0f);
+  for (size_t i = 0; i < more.size(); ++i) {
+    ASSERT_EQ(vectordb::RET_OK, reopened.Add(200 + i, more[i]));
+  }
+  EXPECT_TRUE(reopened.Stats()["trained"].get<bool>());
+  EXPECT_EQ(1000, reopened.Size());
+}
+
+// train_size 不小于质心数
+TEST(PqIndexTest, MinTrainSize) {
+  ResetDir();
+  vdb::PqParam param = TestParam();
+  param.set_train_size(10);
+  vectordb::PqIndex index(kTestDir, param);
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(vectordb::ProductQuantizer::kCentroidNum, kDim,
+                              5, 0.0f, 1.0f);
+  for (size_t i = 0; i + 1 < base.size(); ++i) {
+    index.Add(i, base[i]);
+  }
+  EXPECT_FALSE(index.Stats()["trained"].get<bool>());
+  index.Add(base.size() - 1, base.back());
+  EXPECT_TRUE(index.Stats()["trained"].get<bool>());
+}
+
+// 达到 train_size 后训练，重新打开后的搜索结果不变
+TEST(PqIndexTest, TrainPersistLoad) {
+  ResetDir();
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(3000, kDim, 2, 0.0f, 1.0f);
+  std::vector<std::vector<float>> queries =
+      vectordb::RandomVectors(50, kDim, 3, 0.0f, 1.0f);
+  const int32_t k = 10;
+
+  std::vector<std::vector<int64_t>> before;
+  {
+    vectordb::PqIndex index(kTestDir, TestParam());
+    for (size_t i = 0; i < base.size(); ++i) {
+      ASSERT_EQ(vectordb::RET_OK, index.Add(i, base[i]));
+    }
+    json stats = index.Stats();
+    EXPECT_TRUE(stats["trained"].get<bool>());
+    EXPECT_EQ(3000 * 8, stats["code_bytes"].get<int64_t>());
+    EXPECT_EQ(0, stats["buffer_bytes"].get<int64_t>());
+    ASSERT_EQ(vectordb::RET_OK, index.Persist());
+
+    // 近似距离下召回前 k 需要更多候选
+    int32_t hits = 0;
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    for (const auto &query : queries) {
+      ASSERT_EQ(vectordb::RET_OK,
+                index.Search(query.data(), k * 10, ids, distances));
+      ASSERT_EQ(static_cast<size_t>(k * 10), ids.size());
+      EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+      std::set<int64_t> truth = vectordb::BruteForce(base, query, k);
+      for (int64_t id : ids) {
+        hits += truth.count(id);
+      }
+      before.push_back(ids);
+    }
+    EXPECT_GE(hits, 0.9 * k * queries.size());
+  }
+
+  vectordb::PqIndex index(kTestDir, TestParam());
+  ASSERT_EQ(vectordb::RET_OK, index.Load());
+  EXPECT_EQ(3000, index.Size());
+  EXPECT_TRUE(index.Stats()["trained"].get<bool>());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    index.Search(queries[i].data(), k * 10, ids, distances);
+    EXPECT_EQ(before[i], ids);
+  }
+
+  // 训练后的覆盖写入
+  std::vector<float> far(kDim, 10.0f);
+  index.Add(7, far);
+  EXPECT_EQ(3000, index.Size());
+  index.Search(far.data(), 1, ids, distances);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(7, ids[0]);
+}
+
+// 距离计算预算耗尽时返回已经扫描部分的结果
+TEST(PqIndexTest, SearchLimit) {
+  ResetDir();
+  std::vector<std::vector<float>> base =
+      vectordb::RandomVectors(3000, kDim, 6, 0.0f, 1.0f);
+  vectordb::PqIndex index(kTestDir, TestParam());
+  for (size_t i = 0; i < base.size(); ++i) {
+    index.Add(i, base[i]);
+  }
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  vectordb::ROptions options;
+  options.max_distance_computations = 1000000;
+  EXPECT_EQ(vectordb::RET_OK,
+            index.Search(base[0].data(), 10, ids, distances, options));
+  EXPECT_EQ(10u, ids.size());
+
+  options.max_distance_computations = 1;
+  EXPECT_EQ(vectordb::RET_PARTIAL,
+            index.Search(base[0].data(), 10, ids, distances, options));
+  EXPECT_EQ(10u, ids.size());
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+
+  // 不限制时每个编码计算一次距离
+  vectordb::SearchProfile profile;
+  options.max_distance_computations = 0;
+  options.profile = &profile;
+  EXPECT_EQ(vectordb::RET_OK,
+            index.Search(base[0].data(), 10, ids, distances, options));
+  EXPECT_EQ(3000, profile.distance_computations);
+  EXPECT_EQ(3000, profile.visited);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,208 @@
+#include "quantizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include "thread_pool.h"
+
+namespace vectordb {
+
+namespace {
+
+float SubL2(const float *a, const float *b, int32_t n) {
+  float distance = 0;
+  for (int32_t i = 0; i < n; ++i) {
+    float diff = a[i] - b[i];
+    distance += diff * diff;
+  }
+  return distance;
+}
+
+float SubDot(const float *a, const float *b, int32_t n) {
+  float dot = 0;
+  for (int32_t i = 0; i < n; ++i) {
+    dot += a[i] * b[i];
+  }
+  return dot;
+}
+
+}  // namespace
+
+ProductQuantizer::ProductQuantizer(int32_t dim, int32_t m,
+                                   int32_t distance_type)
+    : dim_(dim), m_(1), sub_dim_(dim), distance_type_(distance_type) {
+  for (int32_t i = std::min(std::max(m, 1), std::max(dim, 1)); i > 1; --i) {
+    if (dim % i == 0) {
+      m_ = i;
+      break;
+    }
+  }
+  sub_dim_ = dim_ / m_;
+}
+
+RetNo ProductQuantizer::Train(const float *data, int64_t n,
+                              int32_t iterations, int64_t max_samples) {
+  if (n <= 0 || dim_ <= 0) {
+    return RET_ERROR;
+  }
+
+  // 固定种子，同样的数据训练出同样的码本
+  std::mt19937 rng(1);
+  std::vector<int64_t> samples(n);
+  std::iota(samples.begin(), samples.end(), 0);
+  if (n > max_samples) {
+    std::shuffle(samples.begin(), samples.end(), rng);
+    samples.resize(max_samples);
+  }
+  int64_t sample_num = samples.size();
+  int32_t k = std::min<int64_t>(kCentroidNum, sample_num);
+
+  std::vector<int64_t> init(samples);
+  std::shuffle(init.begin(), init.end(), rng);
+
+  centroids_.assign(static_cast<size_t>(m_) * kCentroidNum * sub_dim_, 0);
+
+  // 各子空间独立做 k-means
+  DefaultThreadPool().ParallelFor(0, m_, [&](int64_t j) {
+    float *centroids = centroids_.data() + j * kCentroidNum * sub_dim_;
+    auto sub = [&](int64_t row) { return data + row * dim_ + j * sub_dim_; };
+
+    // 样本不足 256 个时，多余的中心复用已有的中心
+    for (int32_t c = 0; c < kCentroidNum; ++c) {
+      memcpy(centroids + c * sub_dim_, sub(init[c % k]),
+             sub_dim_ * sizeof(float));
+    }
+
+    std::vector<int32_t> assign(sample_num, 0);
+    std::vector<float> sums(static_cast<size_t>(k) * sub_dim_);
+    std::vector<int64_t> counts(k);
+    for (int32_t iter = 0; iter < iterations; ++iter) {
+      for (int64_t s = 0; s < sample_num; ++s) {
+        float best = std::numeric_limits<float>::max();
+        for (int32_t c = 0; c < k; ++c) {
+          float distance = SubL2(sub(samples[s]), centroids + c * sub_dim_,
+                                 sub_dim_);
+          if (distance < best) {
+            best = distance;
+            assign[s] = c;
+          }
+        }
+      }
+
+      std::fill(sums.begin(), sums.end(), 0);
+      std::fill(counts.begin(), counts.end(), 0);
+      for (int64_t s = 0; s < sample_num; ++s) {
+        const float *v = sub(samples[s]);
+        float *sum = sums.data() + assign[s] * sub_dim_;
+        for (int32_t d = 0; d < sub_dim_; ++d) {
+          sum[d] += v[d];
+        }
+        counts[assign[s]]++;
+      }
+
+      for (int32_t c = 0; c < k; ++c) {
+        float *centroid = centroids + c * sub_dim_;
+        if (counts[c] == 0) {
+          // 空簇换成一个随机样本
+          memcpy(centroid, sub(samples[(c * 7919 + iter) % sample_num]),
+                 sub_dim_ * sizeof(float));
+          continue;
+        }
+        for (int32_t d = 0; d < sub_dim_; ++d) {
+          centroid[d] = sums[c * sub_dim_ + d] / counts[c];
+        }
+      }
+    }
+
+    for (int32_t c = k; c < kCentroidNum; ++c) {
+      memcpy(centroids + c * sub_dim_, centroids + (c % k) * sub_dim_,
+             sub_dim_ * sizeof(float));
+    }
+  });
+
+  return RET_OK;
+}
+
+void ProductQuantizer::Encode(const float *vector, uint8_t *code) const {
+  for (int32_t j = 0; j < m_; ++j) {
+    const float *centroids = centroids_.data() + j * kCentroidNum * sub_dim_;
+    const float *v = vector + j * sub_dim_;
+    float best = std::numeric_limits<float>::max();
+    int32_t best_c = 0;
+    for (int32_t c = 0; c < kCentroidNum; ++c) {
+      float distance = SubL2(v, centroids + c * sub_dim_, sub_dim_);
+      if (distance < best) {
+        best = distance;
+        best_c = c;
+      }
+    }
+    code[j] = static_cast<uint8_t>(best_c);
+  }
+}
+
+void ProductQuantizer::Decode(const uint8_t *code, float *vector) const {
+  for (int32_t j = 0; j < m_; ++j) {
+    const float *centroid =
+        centroids_.data() + (j * kCentroidNum + code[j]) * sub_dim_;
+    memcpy(vector + j * sub_dim_, centroid, sub_dim_ * sizeof(float));
+  }
+}
+
+void ProductQuantizer::ComputeTable(const float *query, float *table) const {
+  for (int32_t j = 0; j < m_; ++j) {
+    const float *centroids = centroids_.data() + j * kCentroidNum * sub_dim_;
+    const float *q = query + j * sub_dim_;
+    float *t = table + j * kCentroidNum;
+    for (int32_t c = 0; c < kCentroidNum; ++c) {
+      if (distance_type_ == DISTANCE_TYPE_L2) {
+        t[c] = SubL2(q, centroids + c * sub_dim_, sub_dim_);
+      } else {
+        t[c] = -SubDot(q, centroids + c * sub_dim_, sub_dim_);
+      }
+    }
+  }
+}
+
+float ProductQuantizer::TableDistance(const float *table,
+                                      const uint8_t *code) const {
+  float distance = 0;
+  for (int32_t j = 0; j < m_; ++j) {
+    distance += table[j * kCentroidNum + code[j]];
+  }
+
+  // 与 hnswlib 的 InnerProductSpace 一致，距离为 1 - ip
+  if (distance_type_ != DISTANCE_TYPE_L2) {
+    distance += 1;
+  }
+  return distance;
+}
+
+RetNo ProductQuantizer::Save(std::ofstream &out) const {
+  out.write(reinterpret_cast<const char *>(&dim_), sizeof(dim_));
+  out.write(reinterpret_cast<const char *>(&m_), sizeof(m_));
+  out.write(reinterpret_cast<const char *>(&distance_type_),
+            sizeof(distance_type_));
+  out.write(reinterpret_cast<const char *>(centroids_.data()),
+            centroids_.size() * sizeof(float));
+  return out.good() ? RET_OK : RET_ERROR;
+}
+
+RetNo ProductQuantizer::Load(std::ifstream &in) {
+  in.read(reinterpret_cast<char *>(&dim_), sizeof(dim_));
+  in.read(reinterpret_cast<char *>(&m_), sizeof(m_));
+  in.read(reinterpret_cast<char *>(&distance_type_), sizeof(distance_type_));
+  if (!in.good() || dim_ <= 0 || m_ <= 0 || dim_ % m_ != 0) {
+    return RET_ERROR;
+  }
+
+  sub_dim_ = dim_ / m_;
+  centroids_.resize(static_cast<size_t>(m_) * kCentroidNum * sub_dim_);
+  in.read(reinterpret_cast<char *>(centroids_.data()),
+          centroids_.size() * sizeof(float));
+  return in.good() ? RET_OK : RET_ERROR;
+}
+
+}  // namespace vectordb
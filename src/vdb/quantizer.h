@@ -0,0 +1,61 @@
+#ifndef VECTORDB_QUANTIZER_H
+#define VECTORDB_QUANTIZER_H
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "common.h"
+#include "retno.h"
+
+namespace vectordb {
+
+// Product quantizer: the vector is cut into m sub-vectors and each one is
+// replaced by the id of its nearest centroid, one byte per sub-vector.
+//
+// Distances are asymmetric: the query stays in fp32, a per-query table
+// holds the distance terms to every centroid, and the distance to a code
+// is the sum of m table lookups. The result uses the same metric as the
+// hnswlib spaces, squared L2 or 1 - inner product.
+class ProductQuantizer final {
+ public:
+  static const int32_t kCentroidNum = 256;
+
+  // m is lowered to the largest divisor of dim not above it
+  ProductQuantizer(int32_t dim, int32_t m, int32_t distance_type);
+
+  // k-means on each sub-space, data holds n rows of dim floats,
+  // at most max_samples rows are used
+  RetNo Train(const float *data, int64_t n, int32_t iterations = 10,
+              int64_t max_samples = 65536);
+
+  void Encode(const float *vector, uint8_t *code) const;
+  void Decode(const uint8_t *code, float *vector) const;
+
+  // table must hold m * kCentroidNum floats
+  void ComputeTable(const float *query, float *table) const;
+  float TableDistance(const float *table, const uint8_t *code) const;
+
+  RetNo Save(std::ofstream &out) const;
+  RetNo Load(std::ifstream &in);
+
+  int32_t dim() const { return dim_; }
+  int32_t m() const { return m_; }
+  int32_t code_size() const { return m_; }
+  int32_t table_size() const { return m_ * kCentroidNum; }
+  bool trained() const { return !centroids_.empty(); }
+
+ private:
+  int32_t dim_;
+  int32_t m_;
+  int32_t sub_dim_;
+  int32_t distance_type_;
+
+  // m * kCentroidNum * sub_dim, centroids of sub-space j start at
+  // j * kCentroidNum * sub_dim
+  std::vector<float> centroids_;
+};
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_QUANTIZER_H
@@ -0,0 +1,94 @@
+#ifndef VECTORDB_SEARCH_CONTEXT_H
+#define VECTORDB_SEARCH_CONTEXT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+#include "vdb.pb.h"
+
+namespace vectordb {
+
+// Heaps and visited set of an index traversal, reused across searches.
+// Nodes are (distance, id), candidates is a min heap and top a max heap
+// on distance, both kept with std::push_heap / std::pop_heap.
+struct SearchScratch {
+  using Node = std::pair<float, int64_t>;
+
+  std::vector<Node> candidates;
+  std::vector<Node> top;
+
+  // node i was visited by the current search if visited[i] == visited_tag
+  std::vector<uint16_t> visited;
+  uint16_t visited_tag = 0;
+
+  void Clear() {
+    candidates.clear();
+    top.clear();
+  }
+
+  // start a new visited set over nodes [0, n), the array is only cleared
+  // when the tag wraps around
+  void NewVisited(size_t n) {
+    if (visited.size() < n) {
+      visited.resize(n, 0);
+    }
+    if (++visited_tag == 0) {
+      std::fill(visited.begin(), visited.end(), 0);
+      visited_tag = 1;
+    }
+  }
+};
+
+// Results and scratch buffers of a search, reused across searches.
+//
+// A search clears the buffers but keeps their capacity, so once a context
+// has served the largest k its caller uses, the table search path does not
+// allocate. Scalars are rocksdb values pinned in the block cache or the
+// memtable instead of string copies, they stay valid until the next search
+// with the same context or Reset.
+//
+// Not thread safe, keep one context per thread.
+struct SearchContext {
+  // ascending by distance, scalars[i] belongs to ids[i]
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<rocksdb::PinnableSlice> scalars;
+
+  size_t size() const { return ids.size(); }
+
+  // unpin the rocksdb values and clear the results, capacity is kept
+  void Reset() {
+    for (auto &scalar : scalars) {
+      scalar.Reset();
+    }
+    for (auto &vector : vectors) {
+      vector.Reset();
+    }
+    ids.clear();
+    distances.clear();
+  }
+
+  // scratch of the search path, contents are meaningless to the caller
+  std::vector<int64_t> tail_ids;
+  std::vector<float> tail_distances;
+  std::vector<std::pair<float, int64_t>> merge;
+  std::vector<std::vector<int64_t>> shard_ids;
+  std::vector<std::vector<float>> shard_distances;
+  SearchScratch scratch;
+  std::vector<SearchScratch> shard_scratch;
+  std::string keys;
+  std::vector<rocksdb::Slice> key_slices;
+  std::vector<rocksdb::Status> statuses;
+  std::vector<rocksdb::PinnableSlice> vectors;
+  vdb::Vec vec;
+  std::vector<float> query;
+};
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SEARCH_CONTEXT_H
@@ -0,0 +1,116 @@
+#ifndef VECTORDB_SEARCH_PROFILE_H
+#define VECTORDB_SEARCH_PROFILE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "common.h"
+
+namespace vectordb {
+
+// Where the time of one search went, filled when ROptions::profile points
+// to it. Times are microseconds, parallel shards and segments report the
+// slowest one, counters are summed over them.
+struct SearchProfile {
+  // index that served the query, -1 for a segmented table
+  int32_t index_id = -1;
+
+  // dimension check and query normalization
+  int64_t check_us = 0;
+  // index traversal, including the scan of the not yet indexed vectors
+  int64_t traversal_us = 0;
+  // scalar MultiGet
+  int64_t scalar_us = 0;
+  // merging shards, segments and the tail, re-ranking
+  int64_t assembly_us = 0;
+
+  // expanded graph nodes
+  int64_t hops = 0;
+  int64_t distance_computations = 0;
+  int64_t visited = 0;
+  // visited nodes kept out of the results, deleted ones
+  int64_t filter_rejections = 0;
+
+  void Reset() { *this = SearchProfile(); }
+
+  // add the profile of a step that ran after this one
+  void Add(const SearchProfile &other) {
+    check_us += other.check_us;
+    traversal_us += other.traversal_us;
+    scalar_us += other.scalar_us;
+    assembly_us += other.assembly_us;
+    hops += other.hops;
+    distance_computations += other.distance_computations;
+    visited += other.visited;
+    filter_rejections += other.filter_rejections;
+  }
+
+  // fold in the profile of a shard or segment searched in parallel
+  void Merge(const SearchProfile &other) {
+    check_us = std::max(check_us, other.check_us);
+    traversal_us = std::max(traversal_us, other.traversal_us);
+    scalar_us = std::max(scalar_us, other.scalar_us);
+    assembly_us = std::max(assembly_us, other.assembly_us);
+    hops += other.hops;
+    distance_computations += other.distance_computations;
+    visited += other.visited;
+    filter_rejections += other.filter_rejections;
+  }
+
+  json ToJson() const {
+    json j;
+    j["index_id"] = index_id;
+    j["check_us"] = check_us;
+    j["traversal_us"] = traversal_us;
+    j["scalar_us"] = scalar_us;
+    j["assembly_us"] = assembly_us;
+    j["hops"] = hops;
+    j["distance_computations"] = distance_computations;
+    j["visited"] = visited;
+    j["filter_rejections"] = filter_rejections;
+    return j;
+  }
+};
+
+// Adds the time between laps to fields of a profile, does nothing (and
+// does not read the clock) when the profile is nullptr.
+class ProfileTimer final {
+ public:
+  explicit ProfileTimer(SearchProfile *profile) : profile_(profile) {
+    if (profile_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ProfileTimer(const ProfileTimer &) = delete;
+  ProfileTimer &operator=(const ProfileTimer &) = delete;
+
+  // start a new lap without recording, for a step that fills the profile
+  // itself
+  void Restart() {
+    if (profile_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  // add the time since the last lap to field and start a new lap
+  void Lap(int64_t SearchProfile::*field) {
+    if (!profile_) {
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    profile_->*field +=
+        std::chrono::duration_cast<std::chrono::microseconds>(now - start_)
+            .count();
+    start_ = now;
+  }
+
+ private:
+  SearchProfile *profile_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SEARCH_PROFILE_H
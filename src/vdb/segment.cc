@@ -0,0 +1,778 @@
+#include "segment.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "pb2json.h"
+#include "search_profile.h"
+#include "thread_pool.h"
+#include "util.h"
+
+namespace vectordb {
+
+const std::string kSegmentManifestKey = "segment_manifest";
+
+// 封存和合并先写到临时目录，构建完成后改名
+const std::string kSegmentTmpSuffix = ".tmp";
+
+using SegmentSearchFunc = std::function<RetNo(
+    int32_t limit, std::vector<int64_t> &ids, std::vector<float> &distances)>;
+
+// growing segment 可能正在写入，查询都要持有 segment 的锁
+static bool SegmentContains(const Segment &segment, int64_t id) {
+  std::shared_lock<std::shared_mutex> slk(segment.mu);
+  return segment.index->Contains(id);
+}
+
+// segments 从旧到新排列，id 在更新的 segment 中也存在时，
+// segments[i] 中的向量已经被覆盖
+static bool Overwritten(const std::vector<SegmentSPtr> &segments, size_t i,
+                        int64_t id) {
+  for (size_t j = i + 1; j < segments.size(); ++j) {
+    if (SegmentContains(*segments[j], id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 搜索 segments[i] 并去掉被覆盖的 id。结果被 limit 截断、去掉之后又不够
+// limit 个时，加倍 limit 重新搜索，直到够了或者 segment 中没有更多结果
+static RetNo SearchLive(const std::vector<SegmentSPtr> &segments, size_t i,
+                        int32_t limit, const SegmentSearchFunc &search,
+                        std::vector<int64_t> &ids,
+                        std::vector<float> &distances) {
+  const Segment &segment = *segments[i];
+  std::vector<int64_t> found_ids;
+  std::vector<float> found_distances;
+  int32_t fetch = limit;
+  while (true) {
+    RetNo ret = RET_OK;
+    int32_t size = 0;
+    {
+      std::shared_lock<std::shared_mutex> slk(segment.mu);
+      ret = search(fetch, found_ids, found_distances);
+      size = segment.index->Size();
+    }
+
+    ids.clear();
+    distances.clear();
+    for (size_t j = 0; j < found_ids.size(); ++j) {
+      if (!Overwritten(segments, i, found_ids[j])) {
+        ids.push_back(found_ids[j]);
+        distances.push_back(found_distances[j]);
+      }
+    }
+
+    bool truncated = limit > 0 &&
+                     found_ids.size() >= static_cast<size_t>(fetch) &&
+                     fetch < size;
+    if (ret != RET_OK || !truncated ||
+        ids.size() >= static_cast<size_t>(limit)) {
+      return ret;
+    }
+    fetch = std::min(static_cast<int64_t>(fetch) * 2,
+                     static_cast<int64_t>(size));
+  }
+}
+
+SegmentManager::SegmentManager(const std::string &path,
+                               const vdb::TableParam &param,
+                               std::shared_ptr<rocksdb::DB> db)
+    : path_(path),
+      param_(param),
+      db_(db),
+      next_id_(0),
+      stop_(false),
+      pending_(false),
+      busy_(false) {}
+
+SegmentManager::~SegmentManager() {
+  {
+    std::unique_lock<std::mutex> ulk(task_mu_);
+    stop_ = true;
+  }
+  task_cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+RetNo SegmentManager::Init() {
+  std::string manifest_str;
+  rocksdb::Status status =
+      db_->Get(rocksdb::ReadOptions(), kSegmentManifestKey, &manifest_str);
+
+  RetNo ret = RET_OK;
+  if (status.ok()) {
+    ret = Load();
+  } else if (status.IsNotFound()) {
+    ret = New();
+  } else {
+    return RET_ERROR;
+  }
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  thread_ = std::thread(&SegmentManager::Run, this);
+
+  // 上次退出时未完成的封存
+  Schedule();
+  return RET_OK;
+}
+
+RetNo SegmentManager::New() {
+  fs::create_directories(path_);
+
+  vdb::IndexParam param;
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    param = NewIndexParam(INDEX_TYPE_FLAT,
+                          param_.segment_param().seal_threshold());
+  }
+  SegmentSPtr growing = NewGrowing(param);
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    growing_ = growing;
+  }
+  return PersistManifest();
+}
+
+RetNo SegmentManager::Load() {
+  std::string manifest_str;
+  rocksdb::Status status =
+      db_->Get(rocksdb::ReadOptions(), kSegmentManifestKey, &manifest_str);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+
+  vdb::SegmentManifest manifest;
+  if (!manifest.ParseFromString(manifest_str)) {
+    return RET_ERROR;
+  }
+
+  // 不在 manifest 中的目录是封存或合并到一半时退出的残留
+  std::unordered_set<std::string> listed;
+  for (const auto &meta : manifest.segments()) {
+    listed.insert(std::to_string(meta.id()));
+  }
+  for (const auto &entry : fs::directory_iterator(path_)) {
+    if (listed.count(entry.path().filename().string()) == 0) {
+      fs::remove_all(entry.path());
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> ulk(mu_);
+  next_id_ = manifest.next_id();
+  for (const auto &meta : manifest.segments()) {
+    SegmentSPtr segment = std::make_shared<Segment>();
+    segment->id = meta.id();
+    segment->state = static_cast<SegmentState>(meta.state());
+    segment->index = std::make_shared<VIndex>(meta.index_param());
+
+    if (segment->state == SEGMENT_STATE_GROWING) {
+      growing_ = segment;
+    } else {
+      sealed_.push_back(segment);
+    }
+  }
+
+  if (growing_) {
+    return RET_OK;
+  }
+
+  vdb::IndexParam param = NewIndexParam(
+      INDEX_TYPE_FLAT, param_.segment_param().seal_threshold());
+  ulk.unlock();
+  SegmentSPtr growing = NewGrowing(param);
+  ulk.lock();
+  growing_ = growing;
+  ulk.unlock();
+  return PersistManifest();
+}
+
+vdb::IndexParam SegmentManager::NewIndexParam(int32_t index_type,
+                                              int32_t max_elements) {
+  int32_t id = next_id_++;
+  std::string path = path_ + "/" + std::to_string(id);
+
+  // 分配过但未写入 manifest 的目录，是上次异常退出的残留
+  if (fs::exists(path)) {
+    fs::remove_all(path);
+  }
+  if (fs::exists(path + kSegmentTmpSuffix)) {
+    fs::remove_all(path + kSegmentTmpSuffix);
+  }
+
+  const vdb::IndexInfo &default_info = param_.default_index_info();
+  max_elements = std::max(max_elements, 1);
+
+  vdb::IndexParam param;
+  param.set_path(path);
+  param.set_id(id);
+  param.set_create_time(TimeStamp().MilliSeconds());
+  param.mutable_index_info()->set_index_type(index_type);
+  if (index_type == INDEX_TYPE_HNSW) {
+    vdb::HnswParam *hnsw_param =
+        param.mutable_index_info()->mutable_hnsw_param();
+    hnsw_param->CopyFrom(default_info.hnsw_param());
+    hnsw_param->set_max_elements(max_elements);
+  } else if (index_type == INDEX_TYPE_DISKANN) {
+    vdb::DiskAnnParam *diskann_param =
+        param.mutable_index_info()->mutable_diskann_param();
+    diskann_param->CopyFrom(default_info.diskann_param());
+    diskann_param->set_max_elements(max_elements);
+  } else if (index_type == INDEX_TYPE_PQ) {
+    vdb::PqParam *pq_param = param.mutable_index_info()->mutable_pq_param();
+    pq_param->CopyFrom(default_info.pq_param());
+    pq_param->set_max_elements(max_elements);
+  } else {
+    vdb::FlatParam *flat_param =
+        param.mutable_index_info()->mutable_flat_param();
+    flat_param->set_dim(IndexDim(default_info));
+    flat_param->set_max_elements(max_elements);
+    flat_param->set_distance_type(IndexDistanceType(default_info));
+  }
+  return param;
+}
+
+SegmentSPtr SegmentManager::NewGrowing(const vdb::IndexParam &param) {
+  SegmentSPtr segment = std::make_shared<Segment>();
+  segment->id = param.id();
+  segment->state = SEGMENT_STATE_GROWING;
+  segment->index = std::make_shared<VIndex>(param);
+
+  // 先落盘空索引，保证 manifest 中的 segment 都可以加载
+  segment->index->Persist();
+  return segment;
+}
+
+RetNo SegmentManager::PersistManifest() {
+  // 锁内只取 segment 列表，同步写 rocksdb 不挡住写入和搜索。
+  // manifest_mu_ 保证后取的 manifest 后写入
+  std::lock_guard<std::mutex> mlk(manifest_mu_);
+  vdb::SegmentManifest manifest;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    manifest.set_next_id(next_id_);
+    for (const auto &segment : sealed_) {
+      vdb::SegmentMeta *meta = manifest.add_segments();
+      meta->set_id(segment->id);
+      meta->set_state(segment->state);
+      *meta->mutable_index_param() = segment->index->param();
+    }
+    if (growing_) {
+      vdb::SegmentMeta *meta = manifest.add_segments();
+      meta->set_id(growing_->id);
+      meta->set_state(growing_->state);
+      *meta->mutable_index_param() = growing_->index->param();
+    }
+  }
+
+  std::string manifest_str;
+  if (!manifest.SerializeToString(&manifest_str)) {
+    return RET_ERROR;
+  }
+
+  rocksdb::WriteOptions write_options;
+  write_options.sync = true;
+  rocksdb::Status status =
+      db_->Put(write_options, kSegmentManifestKey, manifest_str);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
+RetNo SegmentManager::Add(int64_t id, const std::vector<float> &vector) {
+  // 写入之间串行，只等 growing segment 上的搜索，不等 hnsw segment 的搜索
+  std::lock_guard<std::mutex> alk(add_mu_);
+  SegmentSPtr growing;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    growing = growing_;
+  }
+
+  int32_t seal_threshold = param_.segment_param().seal_threshold();
+  {
+    std::unique_lock<std::shared_mutex> glk(growing->mu);
+    RetNo ret = growing->index->Add(id, vector);
+    if (ret != RET_OK) {
+      return ret;
+    }
+    if (growing->index->Size() < seal_threshold) {
+      return RET_OK;
+    }
+  }
+
+  // growing segment 已满，转为只读，由后台线程构建 hnsw。
+  // 新的 growing segment 在锁外创建，mu_ 只保护列表的替换
+  vdb::IndexParam param;
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    param = NewIndexParam(INDEX_TYPE_FLAT, seal_threshold);
+  }
+  SegmentSPtr next = NewGrowing(param);
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    growing->state = SEGMENT_STATE_SEALING;
+    sealed_.push_back(growing);
+    growing_ = next;
+  }
+
+  RetNo ret = PersistManifest();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  Schedule();
+  return RET_OK;
+}
+
+RetNo SegmentManager::Search(const std::vector<float> &vector, int32_t k,
+                             std::vector<int64_t> &ids,
+                             std::vector<float> &distances,
+                             const ROptions &options) {
+  ids.clear();
+  distances.clear();
+
+  // 只在取列表时持有 mu_，每个 segment 搜索时持有它自己的锁
+  std::vector<SegmentSPtr> segments = NonEmptySegments();
+  if (segments.empty() || k <= 0) {
+    return RET_OK;
+  }
+
+  size_t n = segments.size();
+  std::vector<std::vector<int64_t>> segment_ids(n);
+  std::vector<std::vector<float>> segment_distances(n);
+  std::vector<RetNo> rets(n, RET_OK);
+
+  // 统计时每个 segment 写自己的 profile
+  std::vector<SearchProfile> segment_profiles(options.profile ? n : 0);
+  std::vector<ROptions> segment_options(options.profile ? n : 0, options);
+  for (size_t i = 0; i < segment_options.size(); ++i) {
+    segment_options[i].profile = &segment_profiles[i];
+  }
+
+  // 同一 id 只取最新 segment 中的向量，每个 segment 去掉被覆盖的之后
+  // 仍然给出 k 个结果
+  auto search_one = [&](int64_t i) {
+    const ROptions &segment_option =
+        options.profile ? segment_options[i] : options;
+    auto search = [&](int32_t limit, std::vector<int64_t> &found_ids,
+                      std::vector<float> &found_distances) {
+      return segments[i]->index->Search(vector, limit, found_ids,
+                                        found_distances, segment_option);
+    };
+    rets[i] = SearchLive(segments, i, k, search, segment_ids[i],
+                         segment_distances[i]);
+  };
+  if (n == 1) {
+    search_one(0);
+  } else {
+    DefaultThreadPool().ParallelFor(0, n, search_one);
+  }
+
+  // 合并各 segment 的 top-k，超时或提前结束的 segment 仍然合并已有的结果
+  RetNo ret = RET_OK;
+  for (size_t i = 0; i < n; ++i) {
+    ret = i == 0 ? rets[i] : MergeSearchRet(ret, rets[i]);
+  }
+  if (ret != RET_OK && ret != RET_PARTIAL && ret != RET_TIMEOUT) {
+    return ret;
+  }
+  ProfileTimer profile_timer(options.profile);
+
+  std::vector<std::pair<float, int64_t>> results;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < segment_ids[i].size(); ++j) {
+      results.emplace_back(segment_distances[i][j], segment_ids[i][j]);
+    }
+  }
+  size_t top = std::min(results.size(), static_cast<size_t>(k));
+  std::partial_sort(results.begin(), results.begin() + top, results.end());
+
+  ids.reserve(top);
+  distances.reserve(top);
+  for (size_t i = 0; i < top; ++i) {
+    ids.push_back(results[i].second);
+    distances.push_back(results[i].first);
+  }
+
+  if (options.profile) {
+    SearchProfile slowest;
+    for (const auto &profile : segment_profiles) {
+      slowest.Merge(profile);
+    }
+    options.profile->Add(slowest);
+    profile_timer.Lap(&SearchProfile::assembly_us);
+  }
+  return ret;
+}
+
+RetNo SegmentManager::RangeSearch(const std::vector<float> &vector,
+                                  float radius, int32_t max_results,
+                                  std::vector<int64_t> &ids,
+                                  std::vector<float> &distances,
+                                  const ROptions &options) {
+  ids.clear();
+  distances.clear();
+
+  std::vector<SegmentSPtr> segments = NonEmptySegments();
+  if (segments.empty()) {
+    return RET_OK;
+  }
+
+  // 同一 id 只取最新 segment 中的向量
+  size_t n = segments.size();
+  std::vector<std::vector<int64_t>> segment_ids(n);
+  std::vector<std::vector<float>> segment_distances(n);
+  std::vector<RetNo> rets(n, RET_OK);
+  DefaultThreadPool().ParallelFor(0, n, [&](int64_t i) {
+    auto search = [&](int32_t limit, std::vector<int64_t> &found_ids,
+                      std::vector<float> &found_distances) {
+      return segments[i]->index->RangeSearch(vector, radius, limit, found_ids,
+                                             found_distances, options);
+    };
+    rets[i] = SearchLive(segments, i, max_results, search, segment_ids[i],
+                         segment_distances[i]);
+  });
+
+  std::vector<std::pair<float, int64_t>> results;
+  for (size_t i = 0; i < n; ++i) {
+    if (rets[i] != RET_OK) {
+      return rets[i];
+    }
+    for (size_t j = 0; j < segment_ids[i].size(); ++j) {
+      results.emplace_back(segment_distances[i][j], segment_ids[i][j]);
+    }
+  }
+  size_t top = results.size();
+  if (max_results > 0 && top > static_cast<size_t>(max_results)) {
+    top = max_results;
+  }
+  std::partial_sort(results.begin(), results.begin() + top, results.end());
+
+  ids.reserve(top);
+  distances.reserve(top);
+  for (size_t i = 0; i < top; ++i) {
+    ids.push_back(results[i].second);
+    distances.push_back(results[i].first);
+  }
+  return RET_OK;
+}
+
+RetNo SegmentManager::RangeSearch(const std::vector<float> &vector,
+                                  float radius, const RangeCallback &callback,
+                                  const ROptions &options) {
+  std::vector<SegmentSPtr> segments = NonEmptySegments();
+  bool stopped = false;
+  for (size_t i = 0; i < segments.size() && !stopped; ++i) {
+    // 跳过被更新的 segment 覆盖的 id
+    RangeCallback wrapper = [&segments, i, &callback, &stopped](
+                                int64_t id, float distance) {
+      if (Overwritten(segments, i, id)) {
+        return true;
+      }
+      stopped = !callback(id, distance);
+      return !stopped;
+    };
+    std::shared_lock<std::shared_mutex> slk(segments[i]->mu);
+    RetNo ret =
+        segments[i]->index->RangeSearch(vector, radius, wrapper, options);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+// 从旧到新，growing segment 在最后
+std::vector<SegmentSPtr> SegmentManager::Segments() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  std::vector<SegmentSPtr> segments(sealed_);
+  segments.push_back(growing_);
+  return segments;
+}
+
+std::vector<SegmentSPtr> SegmentManager::NonEmptySegments() const {
+  std::vector<SegmentSPtr> segments = Segments();
+  segments.erase(std::remove_if(segments.begin(), segments.end(),
+                                [](const SegmentSPtr &segment) {
+                                  std::shared_lock<std::shared_mutex> slk(
+                                      segment->mu);
+                                  return segment->index->Size() == 0;
+                                }),
+                 segments.end());
+  return segments;
+}
+
+RetNo SegmentManager::Persist() {
+  for (const auto &segment : Segments()) {
+    std::shared_lock<std::shared_mutex> slk(segment->mu);
+    segment->index->Persist();
+  }
+  return PersistManifest();
+}
+
+int32_t SegmentManager::Size() const {
+  int32_t size = 0;
+  for (const auto &segment : Segments()) {
+    std::shared_lock<std::shared_mutex> slk(segment->mu);
+    size += segment->index->Size();
+  }
+  return size;
+}
+
+int32_t SegmentManager::SegmentNum() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  return sealed_.size() + 1;
+}
+
+json SegmentManager::Stats() const {
+  std::shared_lock<std::shared_mutex> slk(mu_);
+  json j;
+  j["segments"] = json::array();
+  int32_t size = 0;
+  auto append = [&j, &size](const SegmentSPtr &segment) {
+    std::shared_lock<std::shared_mutex> segment_slk(segment->mu);
+    json s;
+    s["id"] = segment->id;
+    s["state"] = segment->state;
+    s["size"] = segment->index->Size();
+    s["memory_bytes"] = segment->index->MemoryUsage();
+    size += segment->index->Size();
+    j["segments"].push_back(s);
+  };
+  for (const auto &segment : sealed_) {
+    append(segment);
+  }
+  append(growing_);
+  j["size"] = size;
+  return j;
+}
+
+void SegmentManager::WaitIdle() {
+  std::unique_lock<std::mutex> ulk(task_mu_);
+  task_cv_.wait(ulk, [this] { return stop_ || (!pending_ && !busy_); });
+}
+
+void SegmentManager::Schedule() {
+  {
+    std::unique_lock<std::mutex> ulk(task_mu_);
+    pending_ = true;
+  }
+  task_cv_.notify_all();
+}
+
+void SegmentManager::Run() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> ulk(task_mu_);
+      task_cv_.wait(ulk, [this] { return stop_ || pending_; });
+      if (stop_) {
+        break;
+      }
+      pending_ = false;
+      busy_ = true;
+    }
+
+    std::vector<SegmentSPtr> sealing;
+    {
+      std::shared_lock<std::shared_mutex> slk(mu_);
+      for (const auto &segment : sealed_) {
+        if (segment->state == SEGMENT_STATE_SEALING) {
+          sealing.push_back(segment);
+        }
+      }
+    }
+    for (const auto &segment : sealing) {
+      Seal(segment);
+    }
+
+    if (param_.segment_param().compact_threshold() > 0) {
+      while (Compact() == RET_OK) {
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> ulk(task_mu_);
+      busy_ = false;
+    }
+    task_cv_.notify_all();
+  }
+}
+
+RetNo SegmentManager::BuildSealed(const std::vector<SegmentSPtr> &from,
+                                  SegmentSPtr &to) {
+  // from 从旧到新，同一 id 保留最后出现的向量
+  std::vector<int64_t> ids;
+  std::vector<std::vector<float>> vectors;
+  std::unordered_map<int64_t, size_t> pos;
+  for (const auto &segment : from) {
+    RetNo ret = segment->index->ForEachVector(
+        [&](int64_t id, const std::vector<float> &v) -> RetNo {
+          auto it = pos.find(id);
+          if (it != pos.end()) {
+            vectors[it->second] = v;
+            return RET_OK;
+          }
+          pos[id] = ids.size();
+          ids.push_back(id);
+          vectors.push_back(v);
+          return RET_OK;
+        });
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  // 丢弃已经被更新的 segment 覆盖的 id
+  std::vector<SegmentSPtr> newer;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    auto it = std::find(sealed_.begin(), sealed_.end(), from.back());
+    if (it == sealed_.end()) {
+      return RET_ERROR;
+    }
+    newer.assign(it + 1, sealed_.end());
+    newer.push_back(growing_);
+  }
+  size_t live = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    bool overwritten = false;
+    for (const auto &segment : newer) {
+      if (SegmentContains(*segment, ids[i])) {
+        overwritten = true;
+        break;
+      }
+    }
+    if (!overwritten) {
+      ids[live] = ids[i];
+      vectors[live].swap(vectors[i]);
+      ++live;
+    }
+  }
+  ids.resize(live);
+  vectors.resize(live);
+
+  vdb::IndexParam param;
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    param = NewIndexParam(param_.default_index_info().index_type(),
+                          ids.size());
+  }
+
+  // 在临时目录中构建，完成后改名，异常退出时不会留下不完整的 segment
+  vdb::IndexParam tmp_param = param;
+  tmp_param.set_path(param.path() + kSegmentTmpSuffix);
+  VIndexSPtr index = std::make_shared<VIndex>(tmp_param);
+  std::atomic<int32_t> errors(0);
+  DefaultThreadPool().ParallelFor(0, ids.size(), [&](int64_t i) {
+    if (index->Add(ids[i], vectors[i]) != RET_OK) {
+      errors++;
+    }
+  });
+  if (errors.load() > 0) {
+    index.reset();
+    fs::remove_all(tmp_param.path());
+    return RET_ERROR;
+  }
+  // 析构时落盘
+  index.reset();
+  fs::rename(tmp_param.path(), param.path());
+
+  to = std::make_shared<Segment>();
+  to->id = param.id();
+  to->state = SEGMENT_STATE_SEALED;
+  to->index = std::make_shared<VIndex>(param);
+  return RET_OK;
+}
+
+RetNo SegmentManager::Seal(SegmentSPtr sealing) {
+  SegmentSPtr sealed;
+  RetNo ret = BuildSealed({sealing}, sealed);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    auto it = std::find(sealed_.begin(), sealed_.end(), sealing);
+    if (it == sealed_.end()) {
+      return RET_ERROR;
+    }
+    *it = sealed;
+  }
+  ret = PersistManifest();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  RemoveSegmentFiles({sealing});
+  return RET_OK;
+}
+
+RetNo SegmentManager::Compact() {
+  // 只合并相邻的小 segment，合并结果放在原来的位置，保持从旧到新的顺序
+  std::vector<SegmentSPtr> candidates;
+  {
+    std::shared_lock<std::shared_mutex> slk(mu_);
+    for (const auto &segment : sealed_) {
+      if (segment->state == SEGMENT_STATE_SEALED &&
+          segment->index->Size() <
+              param_.segment_param().compact_threshold()) {
+        candidates.push_back(segment);
+      } else if (candidates.size() >= 2) {
+        break;
+      } else {
+        candidates.clear();
+      }
+    }
+  }
+  if (candidates.size() < 2) {
+    return RET_NOT_FOUND;
+  }
+
+  SegmentSPtr merged;
+  RetNo ret = BuildSealed(candidates, merged);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  {
+    std::unique_lock<std::shared_mutex> ulk(mu_);
+    auto pos = std::find(sealed_.begin(), sealed_.end(), candidates[0]);
+    if (pos == sealed_.end()) {
+      return RET_ERROR;
+    }
+    *pos = merged;
+    for (size_t i = 1; i < candidates.size(); ++i) {
+      sealed_.erase(
+          std::remove(sealed_.begin(), sealed_.end(), candidates[i]),
+          sealed_.end());
+    }
+  }
+  ret = PersistManifest();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  RemoveSegmentFiles(candidates);
+  return RET_OK;
+}
+
+void SegmentManager::RemoveSegmentFiles(
+    const std::vector<SegmentSPtr> &segments) {
+  for (const auto &segment : segments) {
+    const std::string &path = segment->index->param().path();
+    if (fs::exists(path)) {
+      fs::remove_all(path);
+    }
+  }
+}
+
+}  // namespace vectordb
@@ -0,0 +1,140 @@
+#ifndef VECTORDB_SEGMENT_H
+#define VECTORDB_SEGMENT_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "options.h"
+#include "retno.h"
+#include "rocksdb/db.h"
+#include "vdb.pb.h"
+#include "vindex.h"
+
+namespace vectordb {
+
+struct Segment {
+  int32_t id;
+  SegmentState state;  // guarded by SegmentManager::mu_
+  VIndexSPtr index;
+
+  // the growing segment is written under it, searches hold it shared
+  mutable std::shared_mutex mu;
+};
+
+using SegmentSPtr = std::shared_ptr<Segment>;
+
+// LSM-like vector layout of a table.
+// New vectors go to a small mutable flat segment (growing). When it reaches
+// seal_threshold it becomes immutable (sealing) and a background thread
+// builds an hnsw segment (sealed) from it. Small sealed segments are merged
+// by the same thread. Search fans out across all segments and merges top-k.
+//
+// Segments are ordered oldest first. An id added again lives in several
+// segments, the copy in the newest one wins in search, seal and compaction.
+// Seal and compaction build into path/<segment_id>.tmp and rename it, Init
+// removes the directories the manifest does not list.
+//
+// The segment list is stored in the default column family of the table's
+// rocksdb, each segment is a VIndex under path/<segment_id>.
+//
+// Search takes the segment list under a short lock and searches without
+// it, an add only waits for searches of the small growing segment.
+class SegmentManager final {
+ public:
+  SegmentManager(const std::string &path, const vdb::TableParam &param,
+                 std::shared_ptr<rocksdb::DB> db);
+  ~SegmentManager();
+
+  SegmentManager(const SegmentManager &) = delete;
+  SegmentManager &operator=(const SegmentManager &) = delete;
+
+  RetNo Init();
+
+  RetNo Add(int64_t id, const std::vector<float> &vector);
+
+  // input: v, k
+  // output: ids, distances
+  RetNo Search(const std::vector<float> &vector, int32_t k,
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               const ROptions &options = ROptions());
+
+  // input: v, radius
+  // output: ids, distances, see VIndex::RangeSearch
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    int32_t max_results, std::vector<int64_t> &ids,
+                    std::vector<float> &distances,
+                    const ROptions &options = ROptions());
+
+  // stream the results segment by segment
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    const RangeCallback &callback,
+                    const ROptions &options = ROptions());
+
+  RetNo Persist();
+
+  int32_t Size() const;
+  int32_t SegmentNum() const;
+  json Stats() const;
+
+  // block until the background thread has no seal or compaction to do
+  void WaitIdle();
+
+ private:
+  RetNo New();
+  RetNo Load();
+  SegmentSPtr NewGrowing(const vdb::IndexParam &param);
+
+  // mu_ must be held
+  vdb::IndexParam NewIndexParam(int32_t index_type, int32_t max_elements);
+
+  // mu_ must not be held, the manifest is taken under it
+  RetNo PersistManifest();
+
+  std::vector<SegmentSPtr> Segments() const;
+  std::vector<SegmentSPtr> NonEmptySegments() const;
+
+  void Run();
+  void Schedule();
+  RetNo Seal(SegmentSPtr sealing);
+  RetNo Compact();
+  RetNo BuildSealed(const std::vector<SegmentSPtr> &from, SegmentSPtr &to);
+  void RemoveSegmentFiles(const std::vector<SegmentSPtr> &segments);
+
+ private:
+  std::string path_;
+  vdb::TableParam param_;
+  std::shared_ptr<rocksdb::DB> db_;
+
+  // protect next_id_, growing_, sealed_ and the segment states
+  mutable std::shared_mutex mu_;
+  int32_t next_id_;
+  SegmentSPtr growing_;
+  std::vector<SegmentSPtr> sealed_;  // sealing and sealed, oldest first
+
+  // adds are serialized, the holder also moves a full growing segment to
+  // sealed_
+  std::mutex add_mu_;
+
+  // manifests are written in the order they are taken
+  std::mutex manifest_mu_;
+
+  // background seal and compaction
+  std::mutex task_mu_;
+  std::condition_variable task_cv_;
+  bool stop_;
+  bool pending_;
+  bool busy_;
+  std::thread thread_;
+};
+
+using SegmentManagerSPtr = std::shared_ptr<SegmentManager>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SEGMENT_H
@@ -0,0 +1,173 @@
+#include "segment.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "common.h"
+#include "table.h"
+#include "test_util.h"
+#include "util.h"
+#include "vdb.pb.h"
+
+const std::string kTestDir = "/tmp/segment_test";
+const int32_t kDim = 16;
+
+static vdb::TableParam NewTableParam(int32_t seal_threshold,
+                                     int32_t compact_threshold) {
+  vdb::TableParam param;
+  param.set_path(kTestDir + "/table");
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(kDim);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(kDim);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  param.mutable_segment_param()->set_seal_threshold(seal_threshold);
+  param.mutable_segment_param()->set_compact_threshold(compact_threshold);
+  return param;
+}
+
+// 写满的 growing segment 被封存为 hnsw，查询覆盖所有 segment
+TEST(SegmentTest, SealAndSearch) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(550, kDim);
+
+  vectordb::Table table(NewTableParam(100, 0));
+  ASSERT_TRUE(table.segments());
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Add(i, vectors[i], "scalar_" + std::to_string(i)));
+  }
+  table.segments()->WaitIdle();
+
+  EXPECT_EQ(550, table.segments()->Size());
+  EXPECT_EQ(6, table.segments()->SegmentNum());
+
+  json stats = table.Stats();
+  ASSERT_TRUE(stats.contains("segments"));
+  EXPECT_EQ(6u, stats["segments"]["segments"].size());
+  for (int32_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(vectordb::SEGMENT_STATE_SEALED,
+              stats["segments"]["segments"][i]["state"].get<int32_t>());
+  }
+
+  // 已封存和 growing 中的向量都能查到自身
+  for (int64_t id : {0, 150, 499, 520, 549}) {
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[id], 10, ids, distances, scalars));
+    ASSERT_EQ(10u, ids.size());
+    EXPECT_EQ(id, ids[0]);
+    EXPECT_EQ("scalar_" + std::to_string(id), scalars[0]);
+    for (size_t i = 1; i < distances.size(); ++i) {
+      EXPECT_LE(distances[i - 1], distances[i]);
+    }
+  }
+}
+
+// 小的 sealed segment 被合并
+TEST(SegmentTest, Compact) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(420, kDim);
+
+  vectordb::Table table(NewTableParam(100, 250));
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_EQ(vectordb::RET_OK, table.Add(i, vectors[i]));
+  }
+  table.segments()->WaitIdle();
+
+  // 4 个封存的 segment 两两合并后不小于 compact_threshold 的不再合并
+  EXPECT_EQ(420, table.segments()->Size());
+  EXPECT_LT(table.segments()->SegmentNum(), 5);
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  EXPECT_EQ(vectordb::RET_OK,
+            table.Search(vectors[42], 5, ids, distances, scalars));
+  ASSERT_EQ(5u, ids.size());
+  EXPECT_EQ(42, ids[0]);
+}
+
+// 重新打开表后 segment 布局和数据保持不变
+TEST(SegmentTest, Reload) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(250, kDim);
+
+  int32_t segment_num = 0;
+  {
+    vectordb::Table table(NewTableParam(100, 0));
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      EXPECT_EQ(vectordb::RET_OK, table.Add(i, vectors[i]));
+    }
+    table.segments()->WaitIdle();
+    EXPECT_EQ(vectordb::RET_OK, table.Persist());
+    segment_num = table.segments()->SegmentNum();
+  }
+
+  // 封存到一半时退出留下的临时目录
+  std::string orphan = kTestDir + "/table/segment/99.tmp";
+  fs::create_directories(orphan);
+
+  vectordb::Table table(NewTableParam(100, 0));
+  ASSERT_TRUE(table.segments());
+  table.segments()->WaitIdle();
+  EXPECT_FALSE(fs::exists(orphan));
+  EXPECT_EQ(250, table.segments()->Size());
+  EXPECT_EQ(segment_num, table.segments()->SegmentNum());
+
+  for (int64_t id : {7, 120, 249}) {
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[id], 3, ids, distances, scalars));
+    ASSERT_EQ(3u, ids.size());
+    EXPECT_EQ(id, ids[0]);
+  }
+}
+
+// 重新写入的 id 以最新的向量为准，封存和合并后也不会查到旧向量
+TEST(SegmentTest, Overwrite) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(350, kDim);
+
+  vectordb::Table table(NewTableParam(100, 250));
+  for (size_t i = 0; i < 150; ++i) {
+    EXPECT_EQ(vectordb::RET_OK, table.Add(i, vectors[i]));
+  }
+  std::vector<float> moved(vectors[5]);
+  for (auto &x : moved) {
+    x = -x;
+  }
+  EXPECT_EQ(vectordb::RET_OK, table.Add(5, moved));
+
+  auto check = [&]() {
+    std::vector<int64_t> ids;
+    std::vector<float> distances;
+    std::vector<std::string> scalars;
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(vectors[5], 10, ids, distances, scalars));
+    for (size_t i = 0; i < ids.size(); ++i) {
+      EXPECT_FALSE(ids[i] == 5 && distances[i] < 1e-6);
+    }
+    EXPECT_EQ(vectordb::RET_OK,
+              table.Search(moved, 1, ids, distances, scalars));
+    ASSERT_EQ(1u, ids.size());
+    EXPECT_EQ(5, ids[0]);
+  };
+  check();
+
+  // 新向量也被封存，之后旧的 segment 被合并
+  for (size_t i = 150; i < vectors.size(); ++i) {
+    EXPECT_EQ(vectordb::RET_OK, table.Add(i, vectors[i]));
+  }
+  table.segments()->WaitIdle();
+  check();
+}
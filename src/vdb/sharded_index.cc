@@ -0,0 +1,360 @@
+#include "sharded_index.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "search_profile.h"
+#include "thread_pool.h"
+
+namespace vectordb {
+
+namespace {
+
+// splitmix64 的混合函数，连续的 id 也能均匀分布
+uint64_t MixHash(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// 哈希分布不完全均匀，每个分片多预留 1/4 的容量
+int32_t ShardMaxElements(int32_t max_elements, int32_t shard_num) {
+  int64_t per_shard = (static_cast<int64_t>(max_elements) + shard_num - 1) /
+                      shard_num;
+  return static_cast<int32_t>(per_shard + per_shard / 4 + 64);
+}
+
+}  // namespace
+
+ShardedIndex::ShardedIndex(const vdb::IndexParam &param, int32_t shard_num)
+    : param_(param) {
+  if (shard_num <= 1) {
+    shards_.push_back(std::make_shared<VIndex>(param_));
+    return;
+  }
+
+  for (int32_t i = 0; i < shard_num; ++i) {
+    shards_.push_back(std::make_shared<VIndex>(ShardParam(i, shard_num)));
+  }
+}
+
+vdb::IndexParam ShardedIndex::ShardParam(int32_t i,
+                                         int32_t shard_num) const {
+  vdb::IndexParam param = param_;
+  param.set_path(param_.path() + "/shard_" + std::to_string(i));
+
+  vdb::IndexInfo *info = param.mutable_index_info();
+  switch (info->index_type()) {
+    case INDEX_TYPE_FLAT: {
+      info->mutable_flat_param()->set_max_elements(
+          ShardMaxElements(info->flat_param().max_elements(), shard_num));
+      break;
+    }
+
+    case INDEX_TYPE_HNSW: {
+      info->mutable_hnsw_param()->set_max_elements(
+          ShardMaxElements(info->hnsw_param().max_elements(), shard_num));
+      break;
+    }
+
+    case INDEX_TYPE_DISKANN: {
+      info->mutable_diskann_param()->set_max_elements(
+          ShardMaxElements(info->diskann_param().max_elements(), shard_num));
+      break;
+    }
+
+    case INDEX_TYPE_PQ: {
+      info->mutable_pq_param()->set_max_elements(
+          ShardMaxElements(info->pq_param().max_elements(), shard_num));
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+  return param;
+}
+
+int32_t ShardedIndex::ShardOf(int64_t id) const {
+  if (shards_.size() == 1) {
+    return 0;
+  }
+  return MixHash(static_cast<uint64_t>(id)) % shards_.size();
+}
+
+RetNo ShardedIndex::Add(int64_t id, const std::vector<float> &vector) {
+  OpTimer timer(metrics_.add);
+  return timer.Done(shards_[ShardOf(id)]->Add(id, vector));
+}
+
+RetNo ShardedIndex::Add(const std::vector<int64_t> &ids,
+                        const std::vector<std::vector<float>> &vectors) {
+  if (ids.size() != vectors.size()) {
+    return RET_ERROR;
+  }
+
+  OpTimer timer(metrics_.add);
+  std::vector<std::vector<size_t>> groups(shards_.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    groups[ShardOf(ids[i])].push_back(i);
+  }
+
+  // 每个分片由一个线程顺序写入，分片之间互不竞争
+  std::vector<RetNo> rets(shards_.size(), RET_OK);
+  DefaultThreadPool().ParallelFor(0, shards_.size(), [&](int64_t s) {
+    for (size_t i : groups[s]) {
+      rets[s] = shards_[s]->Add(ids[i], vectors[i]);
+      if (rets[s] != RET_OK) {
+        return;
+      }
+    }
+  });
+
+  for (RetNo ret : rets) {
+    if (ret != RET_OK) {
+      return timer.Done(ret);
+    }
+  }
+  return timer.Done(RET_OK);
+}
+
+RetNo ShardedIndex::Reserve(int64_t start_id, int64_t n) {
+  std::vector<int64_t> counts(shards_.size(), 0);
+  for (int64_t i = 0; i < n; ++i) {
+    counts[ShardOf(start_id + i)]++;
+  }
+  for (size_t s = 0; s < shards_.size(); ++s) {
+    RetNo ret = shards_[s]->Reserve(counts[s]);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+RetNo ShardedIndex::Persist() {
+  for (const auto &shard : shards_) {
+    RetNo ret = shard->Persist();
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+RetNo ShardedIndex::Search(const std::vector<float> &vector, int32_t k,
+                           std::vector<int64_t> &ids,
+                           std::vector<float> &distances,
+                           const ROptions &options) {
+  OpTimer timer(metrics_.search);
+  // 只用到 ctx 的缓冲区，按线程复用，分片任务不会再进入这里
+  thread_local SearchContext ctx;
+  return timer.Done(DoSearch(vector, k, ids, distances, options, ctx));
+}
+
+RetNo ShardedIndex::Search(const std::vector<float> &vector, int32_t k,
+                           SearchContext &ctx, const ROptions &options) {
+  OpTimer timer(metrics_.search);
+  return timer.Done(
+      DoSearch(vector, k, ctx.ids, ctx.distances, options, ctx));
+}
+
+RetNo ShardedIndex::DoSearch(const std::vector<float> &vector, int32_t k,
+                             std::vector<int64_t> &ids,
+                             std::vector<float> &distances,
+                             const ROptions &options, SearchContext &ctx) {
+  if (shards_.size() == 1) {
+    return shards_[0]->Search(vector, k, ids, distances, ctx.scratch, options);
+  }
+
+  // 分片结果和遍历用的堆写入 ctx 中复用的缓冲区
+  size_t n = shards_.size();
+  ctx.shard_ids.resize(n);
+  ctx.shard_distances.resize(n);
+  ctx.shard_scratch.resize(n);
+  std::atomic<RetNo> ret(RET_OK);
+
+  // 统计时每个分片写自己的 profile，不统计时不分配
+  std::vector<SearchProfile> shard_profiles(options.profile ? n : 0);
+  std::vector<ROptions> shard_options(options.profile ? n : 0, options);
+  for (size_t s = 0; s < shard_options.size(); ++s) {
+    shard_options[s].profile = &shard_profiles[s];
+  }
+
+  DefaultThreadPool().ParallelFor(0, n, [&](int64_t s) {
+    const ROptions &shard_option =
+        options.profile ? shard_options[s] : options;
+    RetNo shard_ret =
+        shards_[s]->Search(vector, k, ctx.shard_ids[s], ctx.shard_distances[s],
+                           ctx.shard_scratch[s], shard_option);
+    RetNo expected = ret.load();
+    while (!ret.compare_exchange_weak(expected,
+                                      MergeSearchRet(expected, shard_ret))) {
+    }
+  });
+  // 超时或提前结束的分片仍然合并已有的结果
+  if (ret != RET_OK && ret != RET_PARTIAL && ret != RET_TIMEOUT) {
+    return ret;
+  }
+  ProfileTimer profile_timer(options.profile);
+
+  // 每个分片最多 k 个结果，合并后取前 k 个
+  ctx.merge.clear();
+  for (size_t s = 0; s < n; ++s) {
+    for (size_t i = 0; i < ctx.shard_ids[s].size(); ++i) {
+      ctx.merge.emplace_back(ctx.shard_distances[s][i], ctx.shard_ids[s][i]);
+    }
+  }
+  size_t top =
+      std::min(ctx.merge.size(), static_cast<size_t>(std::max(k, 0)));
+  std::partial_sort(ctx.merge.begin(), ctx.merge.begin() + top,
+                    ctx.merge.end());
+
+  ids.resize(top);
+  distances.resize(top);
+  for (size_t i = 0; i < top; ++i) {
+    distances[i] = ctx.merge[i].first;
+    ids[i] = ctx.merge[i].second;
+  }
+
+  if (options.profile) {
+    SearchProfile slowest;
+    for (const auto &profile : shard_profiles) {
+      slowest.Merge(profile);
+    }
+    options.profile->Add(slowest);
+    profile_timer.Lap(&SearchProfile::assembly_us);
+  }
+  return ret;
+}
+
+RetNo ShardedIndex::RangeSearch(const std::vector<float> &vector,
+                                float radius, int32_t max_results,
+                                std::vector<int64_t> &ids,
+                                std::vector<float> &distances,
+                                const ROptions &options) {
+  if (shards_.size() == 1) {
+    return shards_[0]->RangeSearch(vector, radius, max_results, ids,
+                                   distances, options);
+  }
+
+  OpTimer timer(metrics_.range_search);
+  size_t n = shards_.size();
+  std::vector<std::vector<int64_t>> shard_ids(n);
+  std::vector<std::vector<float>> shard_distances(n);
+  std::vector<RetNo> rets(n, RET_OK);
+  DefaultThreadPool().ParallelFor(0, n, [&](int64_t s) {
+    rets[s] = shards_[s]->RangeSearch(vector, radius, max_results,
+                                      shard_ids[s], shard_distances[s],
+                                      options);
+  });
+
+  std::vector<std::pair<float, int64_t>> results;
+  for (size_t s = 0; s < n; ++s) {
+    if (rets[s] != RET_OK) {
+      return timer.Done(rets[s]);
+    }
+    for (size_t i = 0; i < shard_ids[s].size(); ++i) {
+      results.emplace_back(shard_distances[s][i], shard_ids[s][i]);
+    }
+  }
+
+  size_t top = results.size();
+  if (max_results > 0 && top > static_cast<size_t>(max_results)) {
+    top = max_results;
+  }
+  std::partial_sort(results.begin(), results.begin() + top, results.end());
+
+  ids.clear();
+  distances.clear();
+  ids.reserve(top);
+  distances.reserve(top);
+  for (size_t i = 0; i < top; ++i) {
+    ids.push_back(results[i].second);
+    distances.push_back(results[i].first);
+  }
+  return timer.Done(RET_OK);
+}
+
+RetNo ShardedIndex::RangeSearch(const std::vector<float> &vector,
+                                float radius, const RangeCallback &callback,
+                                const ROptions &options) {
+  bool stopped = false;
+  RangeCallback wrapper = [&callback, &stopped](int64_t id, float distance) {
+    stopped = !callback(id, distance);
+    return !stopped;
+  };
+
+  for (const auto &shard : shards_) {
+    RetNo ret = shard->RangeSearch(vector, radius, wrapper, options);
+    if (ret != RET_OK) {
+      return ret;
+    }
+    if (stopped) {
+      break;
+    }
+  }
+  return RET_OK;
+}
+
+RetNo ShardedIndex::GetVecByID(int64_t id, std::vector<float> &vector) {
+  return shards_[ShardOf(id)]->GetVecByID(id, vector);
+}
+
+int32_t ShardedIndex::Size() const {
+  int32_t size = 0;
+  for (const auto &shard : shards_) {
+    size += shard->Size();
+  }
+  return size;
+}
+
+int64_t ShardedIndex::MemoryUsage() const {
+  int64_t bytes = 0;
+  for (const auto &shard : shards_) {
+    bytes += shard->MemoryUsage();
+  }
+  return bytes;
+}
+
+json ShardedIndex::Stats() const {
+  if (shards_.size() == 1) {
+    return shards_[0]->Stats();
+  }
+
+  json j;
+  j["index_type"] = param_.index_info().index_type();
+  j["shard_num"] = shards_.size();
+  j["size"] = Size();
+  j["memory_bytes"] = MemoryUsage();
+
+  uint64_t distance_computations = 0;
+  uint64_t hops = 0;
+  j["shards"] = json::array();
+  for (const auto &shard : shards_) {
+    json s = shard->Stats();
+    distance_computations += s["distance_computations"].get<uint64_t>();
+    hops += s["hops"].get<uint64_t>();
+    j["shards"].push_back(s);
+  }
+  j["distance_computations"] = distance_computations;
+  j["hops"] = hops;
+  j["ops"] = metrics_.ToJson();
+  return j;
+}
+
+RetNo ShardedIndex::ForEachVector(
+    const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+        &func) {
+  for (const auto &shard : shards_) {
+    RetNo ret = shard->ForEachVector(func);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+}  // namespace vectordb
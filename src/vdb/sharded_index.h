@@ -0,0 +1,101 @@
+#ifndef VECTORDB_SHARDED_INDEX_H
+#define VECTORDB_SHARDED_INDEX_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "metrics.h"
+#include "options.h"
+#include "retno.h"
+#include "search_context.h"
+#include "vdb.pb.h"
+#include "vindex.h"
+
+namespace vectordb {
+
+// One index version of a table, split into shard_num independent VIndex
+// shards by id hash. Inserts into different shards don't contend, and a
+// search runs on all shards in parallel and merges the per-shard top-k.
+//
+// shard_num <= 1 keeps the single VIndex layout under param.path(),
+// otherwise shard i lives under param.path()/shard_<i>.
+class ShardedIndex final {
+ public:
+  ShardedIndex(const vdb::IndexParam &param, int32_t shard_num);
+  ~ShardedIndex() = default;
+
+  ShardedIndex(const ShardedIndex &) = delete;
+  ShardedIndex &operator=(const ShardedIndex &) = delete;
+
+  RetNo Add(int64_t id, const std::vector<float> &vector);
+
+  // group by shard, then insert into all shards in parallel
+  RetNo Add(const std::vector<int64_t> &ids,
+            const std::vector<std::vector<float>> &vectors);
+
+  // reserve every shard for the ids [start_id, start_id + n)
+  RetNo Reserve(int64_t start_id, int64_t n);
+
+  RetNo Persist();
+
+  // input: v, k
+  // output: ids, distances
+  RetNo Search(const std::vector<float> &vector, int32_t k,
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               const ROptions &options = ROptions());
+
+  // same as above, the results are left in ctx.ids, ctx.distances and the
+  // per shard results go to the scratch buffers of ctx
+  RetNo Search(const std::vector<float> &vector, int32_t k,
+               SearchContext &ctx, const ROptions &options = ROptions());
+
+  // input: v, radius
+  // output: ids, distances, see VIndex::RangeSearch
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    int32_t max_results, std::vector<int64_t> &ids,
+                    std::vector<float> &distances,
+                    const ROptions &options = ROptions());
+
+  // stream the results shard by shard
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    const RangeCallback &callback,
+                    const ROptions &options = ROptions());
+
+  // read from the owning shard only
+  RetNo GetVecByID(int64_t id, std::vector<float> &vector);
+
+  int32_t Size() const;
+  int64_t MemoryUsage() const;
+  json Stats() const;
+
+  // iterate all vectors shard by shard, stop when func returns not RET_OK
+  RetNo ForEachVector(
+      const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+          &func);
+
+  const vdb::IndexParam &param() const { return param_; }
+  int32_t ShardNum() const { return static_cast<int32_t>(shards_.size()); }
+  int32_t ShardOf(int64_t id) const;
+  VIndexSPtr Shard(int32_t i) const { return shards_[i]; }
+
+ private:
+  vdb::IndexParam ShardParam(int32_t i, int32_t shard_num) const;
+  RetNo DoSearch(const std::vector<float> &vector, int32_t k,
+                 std::vector<int64_t> &ids, std::vector<float> &distances,
+                 const ROptions &options, SearchContext &ctx);
+
+ private:
+  vdb::IndexParam param_;
+  std::vector<VIndexSPtr> shards_;
+
+  IndexMetrics metrics_;
+};
+
+using ShardedIndexSPtr = std::shared_ptr<ShardedIndex>;
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_SHARDED_INDEX_H
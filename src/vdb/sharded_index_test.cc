@@ -0,0 +1,112 @@
+#include "sharded_index.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "common.h"
+#include "test_util.h"
+#include "util.h"
+
+const std::string kTestDir = "/tmp/sharded_index_test";
+const int32_t kDim = 16;
+
+static vdb::IndexParam NewFlatParam(const std::string &path) {
+  vdb::IndexParam param;
+  param.set_path(path);
+  param.set_id(1);
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.mutable_index_info()->set_index_type(vectordb::INDEX_TYPE_FLAT);
+  param.mutable_index_info()->mutable_flat_param()->set_dim(kDim);
+  param.mutable_index_info()->mutable_flat_param()->set_max_elements(1000);
+  param.mutable_index_info()->mutable_flat_param()->set_distance_type(
+      vectordb::DISTANCE_TYPE_L2);
+  return param;
+}
+
+// 向量按 id 哈希分布到各分片，按 id 读取只访问所属分片
+TEST(ShardedIndexTest, Route) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(800, kDim);
+
+  vectordb::ShardedIndex index(NewFlatParam(kTestDir + "/sharded"), 4);
+  EXPECT_EQ(4, index.ShardNum());
+  EXPECT_TRUE(fs::exists(kTestDir + "/sharded/shard_3"));
+
+  std::vector<int64_t> ids;
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    ids.push_back(i);
+  }
+  EXPECT_EQ(vectordb::RET_OK, index.Add(ids, vectors));
+  EXPECT_EQ(800, index.Size());
+
+  for (int32_t s = 0; s < index.ShardNum(); ++s) {
+    // 连续 id 也应大致均匀
+    EXPECT_GT(index.Shard(s)->Size(), 100);
+  }
+
+  for (int64_t id : {0, 1, 399, 799}) {
+    std::vector<float> v;
+    EXPECT_EQ(vectordb::RET_OK, index.GetVecByID(id, v));
+    EXPECT_EQ(vectors[id], v);
+
+    int32_t owner = index.ShardOf(id);
+    EXPECT_EQ(vectordb::RET_OK, index.Shard(owner)->GetVecByID(id, v));
+    int32_t other = (owner + 1) % index.ShardNum();
+    EXPECT_NE(vectordb::RET_OK, index.Shard(other)->GetVecByID(id, v));
+  }
+}
+
+// 分片归并后的 top-k 与不分片的结果一致
+TEST(ShardedIndexTest, Search) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(500, kDim);
+
+  vectordb::ShardedIndex single(NewFlatParam(kTestDir + "/single"), 1);
+  vectordb::ShardedIndex sharded(NewFlatParam(kTestDir + "/sharded"), 8);
+  EXPECT_EQ(1, single.ShardNum());
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_EQ(vectordb::RET_OK, single.Add(i, vectors[i]));
+    EXPECT_EQ(vectordb::RET_OK, sharded.Add(i, vectors[i]));
+  }
+
+  auto queries = vectordb::RandomVectors(520, kDim);
+  for (size_t q = 500; q < queries.size(); ++q) {
+    std::vector<int64_t> ids1, ids2;
+    std::vector<float> distances1, distances2;
+    EXPECT_EQ(vectordb::RET_OK,
+              single.Search(queries[q], 10, ids1, distances1));
+    EXPECT_EQ(vectordb::RET_OK,
+              sharded.Search(queries[q], 10, ids2, distances2));
+    ASSERT_EQ(10u, ids2.size());
+    EXPECT_EQ(ids1, ids2);
+    EXPECT_EQ(distances1, distances2);
+  }
+}
+
+// 重新打开后各分片数据保持不变
+TEST(ShardedIndexTest, Reload) {
+  fs::remove_all(kTestDir);
+  auto vectors = vectordb::RandomVectors(300, kDim);
+
+  {
+    vectordb::ShardedIndex index(NewFlatParam(kTestDir + "/sharded"), 3);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      EXPECT_EQ(vectordb::RET_OK, index.Add(i, vectors[i]));
+    }
+    EXPECT_EQ(vectordb::RET_OK, index.Persist());
+  }
+
+  vectordb::ShardedIndex index(NewFlatParam(kTestDir + "/sharded"), 3);
+  EXPECT_EQ(300, index.Size());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  EXPECT_EQ(vectordb::RET_OK, index.Search(vectors[123], 1, ids, distances));
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(123, ids[0]);
+
+  json stats = index.Stats();
+  EXPECT_EQ(3, stats["shard_num"].get<int32_t>());
+  EXPECT_EQ(300, stats["size"].get<int32_t>());
+}
@@ -1,8 +1,15 @@
 #include "table.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "common.h"
+#include "rocksdb/sst_file_writer.h"
+#include "rocksdb/utilities/checkpoint.h"
+#include "thread_pool.h"
 #include "distance.h"
 #include "pb2json.h"
+#include "search_profile.h"
 #include "util.h"
 
 namespace vectordb {
@@ -13,6 +20,29 @@ const DistanceType kDefaultDistanceType = DISTANCE_TYPE_INNER_PRODUCT;
 const std::string kVectorColumnFamily = "vector";
 const std::string kScalarColumnFamily = "scalar";
 
+// leader 合并写入的上限，避免一个组的提交时间过长
+const size_t kMaxWriteGroupBytes = 1 << 20;
+
+// 序列化后的 vdb::Id 最多 11 字节：1 字节 tag 和 10 字节 varint
+const size_t kMaxIdKeySize = 11;
+
+namespace {
+
+// 重排时从索引取出的候选数
+int32_t SearchCandidates(int32_t k, const ROptions &options) {
+  if (options.rerank <= 0) {
+    return k;
+  }
+  int64_t candidates = static_cast<int64_t>(k) * options.rerank;
+  return static_cast<int32_t>(
+      std::min<int64_t>(candidates, std::numeric_limits<int32_t>::max()));
+}
+
+// 搜索开始后索引超时或提前结束，已有的结果照常返回，整体标记为 partial
+bool Partial(RetNo ret) { return ret == RET_PARTIAL || ret == RET_TIMEOUT; }
+
+}  // namespace
+
 Table::Table(const vdb::TableParam &param)
     : data_path_(param.path() + "/data"),
       index_path_(param.path() + "/index"),
@@ -22,6 +52,10 @@ Table::Table(const vdb::TableParam &param)
 }
 
 Table::~Table() {
+  // 先把队列中的向量写入索引，再停止后台封存线程，它会用到 data_
+  index_queue_.reset();
+  segments_.reset();
+
   PersistDescription();
 
   // 释放所有的列族句柄
@@ -44,11 +78,18 @@ void Table::Init() {
   if (ret != RET_OK) {
     assert(0);
   }
+
+  index_queue_ = std::make_unique<IndexQueue>(
+      [this](int64_t id, const std::vector<float> &vector) {
+        return AddToIndex(id, vector);
+      },
+      metrics_.async_index);
 }
 
 RetNo Table::LoadIndex() {
   for (const auto &index_param : param_.indexes()) {
-    VIndexSPtr index = std::make_shared<VIndex>(index_param);
+    ShardedIndexSPtr index =
+        std::make_shared<ShardedIndex>(index_param, param_.shard_num());
     indexes_[index_param.id()] = index;
   }
   return RET_OK;
@@ -128,9 +169,24 @@ RetNo Table::LoadData() {
   return RET_OK;
 }
 
+RetNo Table::InitSegments() {
+  if (param_.segment_param().seal_threshold() <= 0) {
+    return RET_OK;
+  }
+
+  segments_ = std::make_shared<SegmentManager>(param_.path() + "/segment",
+                                               param_, data_);
+  return segments_->Init();
+}
+
 RetNo Table::New() {
   Prepare();
   RetNo ret = NewData();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  ret = InitSegments();
   return ret;
 }
 
@@ -150,6 +206,11 @@ RetNo Table::Load() {
     return ret;
   }
 
+  ret = InitSegments();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
   return ret;
 }
 
@@ -165,59 +226,154 @@ void Table::Prepare() {
 RetNo Table::Add(int64_t id, std::vector<float> &vector,
                  const std::string &scalar, const WOptions &options,
                  bool normalize) {
-  if (normalize) {
+  OpTimer timer(metrics_.add);
+  return timer.Done(DoAdd(id, vector, scalar, options, normalize));
+}
+
+RetNo Table::DoAdd(int64_t id, std::vector<float> &vector,
+                   const std::string &scalar, const WOptions &options,
+                   bool normalize) {
+  // 二值向量的每一维是 0 或 1，归一化会破坏打包后的位
+  if (binary() && normalize) {
+    return RET_ERROR;
+  }
+
+  // cosine 表写入时归一化到线程缓冲，不修改调用方的向量
+  thread_local std::vector<float> normalized;
+  bool is_cosine = cosine();
+  if (is_cosine) {
+    normalized.resize(vector.size());
+    Normalize(vector.data(), normalized.data(), vector.size());
+  } else if (normalize) {
     Normalize(vector);
   }
+  const std::vector<float> &v = is_cosine ? normalized : vector;
 
   if (options.write_vector_to_data) {
     vdb::Id id_obj;
     id_obj.set_id(id);
     vdb::Vec vec_obj;
-    vec_obj.mutable_data()->Assign(vector.begin(), vector.end());
+    vec_obj.mutable_data()->Assign(v.begin(), v.end());
 
-    // 将ID和向量序列化
-    std::string id_str;
-    std::string vec_str;
-    if (!id_obj.SerializeToString(&id_str) ||
-        !vec_obj.SerializeToString(&vec_str)) {
+    // 在进入写队列之前序列化，leader 只负责拼批次
+    Writer w;
+    if (!id_obj.SerializeToString(&w.id_str) ||
+        !vec_obj.SerializeToString(&w.vec_str)) {
       return RET_ERROR;
     }
+    w.scalar = &scalar;
+    w.sync = options.sync;
+    w.disable_wal = options.disable_wal;
+    w.write_index = options.write_vector_to_index;
+
+    RetNo ret = GroupCommit(&w);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  // 异步模式交给后台线程写索引，在此之前由搜索扫描队列
+  if (options.write_vector_to_index && options.async_index) {
+    index_queue_->Push(id, v);
+    return RET_OK;
+  }
+
+  // 组提交后各写入线程并行插入索引
+  if (options.write_vector_to_index) {
+    return AddToIndex(id, v);
+  }
 
-    // 创建写批次以实现事务
-    rocksdb::WriteBatch batch;
+  return RET_OK;
+}
 
-    // 将向量数据添加到批次中
-    batch.Put(cf_handles_[kVectorColumnFamily], rocksdb::Slice(id_str),
-              rocksdb::Slice(vec_str));
+RetNo Table::GroupCommit(Writer *w) {
+  std::unique_lock<std::mutex> ulk(write_mutex_);
+  writers_.push_back(w);
+  while (!w->done && w != writers_.front()) {
+    w->cv.wait(ulk);
+  }
+  if (w->done) {
+    return w->ret;
+  }
 
-    // 如果有标量数据，也添加到批次中
-    if (!scalar.empty()) {
-      batch.Put(cf_handles_[kScalarColumnFamily], rocksdb::Slice(id_str),
-                rocksdb::Slice(scalar));
+  // w 是 leader，带上后面可以合并的写入
+  // sync 的写入不能并入非 sync 的组，WAL 开关必须一致
+  std::vector<Writer *> group;
+  size_t group_bytes = 0;
+  bool write_index = false;
+  for (Writer *writer : writers_) {
+    if (writer != w &&
+        ((writer->sync && !w->sync) ||
+         writer->disable_wal != w->disable_wal ||
+         group_bytes >= kMaxWriteGroupBytes)) {
+      break;
+    }
+    group.push_back(writer);
+    group_bytes += writer->id_str.size() + writer->vec_str.size() +
+                   writer->scalar->size();
+    write_index = write_index || writer->write_index;
+  }
+  ulk.unlock();
+
+  // 提交期间新来的写入继续排队，组成下一组
+  OpTimer timer(metrics_.write_group);
+  rocksdb::WriteBatch batch;
+  for (Writer *writer : group) {
+    batch.Put(cf_handles_[kVectorColumnFamily], rocksdb::Slice(writer->id_str),
+              rocksdb::Slice(writer->vec_str));
+    if (!writer->scalar->empty()) {
+      batch.Put(cf_handles_[kScalarColumnFamily],
+                rocksdb::Slice(writer->id_str),
+                rocksdb::Slice(*writer->scalar));
     }
+  }
 
-    // 作为一个事务提交批次
-    rocksdb::WriteOptions write_options;
-    rocksdb::Status status = data_->Write(write_options, &batch);
-    if (!status.ok()) {
-      return RET_ERROR;
+  rocksdb::WriteOptions write_options;
+  write_options.sync = w->sync;
+  write_options.disableWAL = w->disable_wal;
+  rocksdb::Status status = data_->Write(write_options, &batch);
+  RetNo ret = timer.Done(status.ok() ? RET_OK : RET_ERROR);
+
+  // 第一个索引由 leader 在唤醒组员之前创建，避免组员并发创建
+  if (ret == RET_OK && write_index && !segments_ && IndexIDs().empty()) {
+    ret = BuildIndex();
+  }
+
+  ulk.lock();
+  for (Writer *writer : group) {
+    writers_.pop_front();
+    writer->ret = ret;
+    writer->done = true;
+    if (writer != w) {
+      writer->cv.notify_one();
     }
   }
+  if (!writers_.empty()) {
+    writers_.front()->cv.notify_one();
+  }
+  return ret;
+}
 
-  if (options.write_vector_to_index) {
-    if (indexes_.empty()) {
-      RetNo ret = BuildIndex();
-      if (ret != RET_OK) {
-        return ret;
-      }
+RetNo Table::AddToIndex(int64_t id, const std::vector<float> &vector) {
+  // 分段表的向量只写入 growing segment
+  if (segments_) {
+    return segments_->Add(id, vector);
+  }
+
+  // 并发创建第一个索引时只有一个成功，其余的使用它
+  if (IndexIDs().empty()) {
+    RetNo ret = BuildIndex();
+    if (ret != RET_OK && IndexIDs().empty()) {
+      return ret;
     }
+  }
 
-    // 将向量添加到所有索引中
-    for (auto &index_pair : indexes_) {
-      RetNo ret = index_pair.second->Add(id, vector);
-      if (ret != RET_OK) {
-        return ret;
-      }
+  // 将向量添加到所有索引中
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
+  for (auto &index_pair : indexes_) {
+    RetNo ret = index_pair.second->Add(id, vector);
+    if (ret != RET_OK) {
+      return ret;
     }
   }
 
@@ -229,7 +385,23 @@ RetNo Table::Add(int64_t id, std::vector<float> &vector,
   return Add(id, vector, "", options, normalize);
 }
 
+RetNo Table::Add(int64_t id, const std::vector<uint8_t> &bits,
+                 const std::string &scalar, const WOptions &options) {
+  std::vector<float> vector;
+  RetNo ret = BinaryVector(bits, vector);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  return Add(id, vector, scalar, options, false);
+}
+
 RetNo Table::Get(int64_t id, std::vector<float> &vector, std::string &scalar) {
+  OpTimer timer(metrics_.get);
+  return timer.Done(DoGet(id, vector, scalar));
+}
+
+RetNo Table::DoGet(int64_t id, std::vector<float> &vector,
+                   std::string &scalar) {
   // 创建ID对象并序列化
   vdb::Id id_obj;
   id_obj.set_id(id);
@@ -276,11 +448,35 @@ RetNo Table::Get(int64_t id, std::vector<float> &vector, std::string &scalar) {
 }
 
 RetNo Table::Get(int64_t id, std::vector<float> &vector) {
+  OpTimer timer(metrics_.get);
+  return timer.Done(DoGetVector(id, vector));
+}
+
+RetNo Table::DoGetVector(int64_t id, std::vector<float> &vector) {
+  // 还未写入索引的向量比索引中的更新
+  if (index_queue_->Get(id, vector)) {
+    return RET_OK;
+  }
+
+  // 向量在最新索引的所属分片中，找不到时再读 rocksdb
+  {
+    std::shared_lock<std::shared_mutex> slk(index_mu_);
+    ShardedIndexSPtr index = NewestIndex();
+    if (index && index->GetVecByID(id, vector) == RET_OK) {
+      return RET_OK;
+    }
+  }
+
   std::string scalar;
-  return Get(id, vector, scalar);
+  return DoGet(id, vector, scalar);
 }
 
 RetNo Table::Get(int64_t id, std::string &scalar) {
+  OpTimer timer(metrics_.get);
+  return timer.Done(DoGet(id, scalar));
+}
+
+RetNo Table::DoGet(int64_t id, std::string &scalar) {
   // 创建ID对象并序列化
   vdb::Id id_obj;
   id_obj.set_id(id);
@@ -304,64 +500,277 @@ RetNo Table::Get(int64_t id, std::string &scalar) {
   return RET_OK;
 }
 
+RetNo Table::Get(int64_t id, std::vector<uint8_t> &bits) {
+  if (!binary()) {
+    return RET_ERROR;
+  }
+  std::vector<float> vector;
+  RetNo ret = Get(id, vector);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  VectorToBinary(vector, bits);
+  return RET_OK;
+}
+
+bool Table::cosine() const {
+  return IndexDistanceType(param_.default_index_info()) ==
+         DISTANCE_TYPE_COSINE;
+}
+
+const std::vector<float> &Table::Query(const std::vector<float> &v,
+                                       SearchContext &ctx) const {
+  if (!cosine()) {
+    return v;
+  }
+
+  // 队列扫描和重排直接用这个距离，与索引一样先归一化
+  ctx.query.resize(v.size());
+  Normalize(v.data(), ctx.query.data(), v.size());
+  return ctx.query;
+}
+
+bool Table::binary() const {
+  return IndexDistanceType(param_.default_index_info()) ==
+         DISTANCE_TYPE_HAMMING;
+}
+
+RetNo Table::BinaryVector(const std::vector<uint8_t> &bits,
+                          std::vector<float> &vector) const {
+  if (!binary() || static_cast<int64_t>(bits.size()) * 8 != param_.dim()) {
+    return RET_ERROR;
+  }
+  BinaryToVector(bits, vector);
+  return RET_OK;
+}
+
 RetNo Table::Search(const std::vector<float> &v, int32_t k,
                     std::vector<int64_t> &ids, std::vector<float> &distances,
                     std::vector<std::string> &scalars, const ROptions &options,
                     int32_t index_id) {
+  // 每个线程复用一个 context，结果拷贝到调用方的 vector 中
+  thread_local SearchContext ctx;
+  RetNo ret = Search(v, k, ctx, options, index_id);
+  ids.assign(ctx.ids.begin(), ctx.ids.end());
+  distances.assign(ctx.distances.begin(), ctx.distances.end());
+  scalars.resize(ctx.size());
+  for (size_t i = 0;
+       i < ctx.size() && (ret == RET_OK || ret == RET_PARTIAL); ++i) {
+    scalars[i].assign(ctx.scalars[i].data(), ctx.scalars[i].size());
+  }
+  ctx.Reset();
+  return ret;
+}
+
+RetNo Table::Search(const std::vector<uint8_t> &bits, int32_t k,
+                    std::vector<int64_t> &ids, std::vector<float> &distances,
+                    std::vector<std::string> &scalars, const ROptions &options,
+                    int32_t index_id) {
+  std::vector<float> v;
+  RetNo ret = BinaryVector(bits, v);
+  if (ret != RET_OK) {
+    return ret;
+  }
+  return Search(v, k, ids, distances, scalars, options, index_id);
+}
+
+RetNo Table::Search(const std::vector<float> &query, int32_t k,
+                    SearchContext &ctx, const ROptions &options,
+                    int32_t index_id) {
+  OpTimer timer(metrics_.search);
+  ctx.Reset();
+  if (options.profile) {
+    options.profile->Reset();
+  }
+
+  // 排队期间已经超时的请求直接丢弃
+  if (options.Expired()) {
+    return timer.Done(RET_TIMEOUT);
+  }
+
+  ProfileTimer profile_timer(options.profile);
+  const std::vector<float> &v = Query(query, ctx);
+  profile_timer.Lap(&SearchProfile::check_us);
+  if (index_id == -1 && segments_) {
+    // 先扫描未索引的向量再查索引，期间写入索引的向量至少出现在一边
+    index_queue_->Search(v, k, IndexDistanceType(param_.default_index_info()),
+                         ctx.tail_ids, ctx.tail_distances);
+    profile_timer.Lap(&SearchProfile::traversal_us);
+
+    // 各阶段的时间由 segment 自己统计
+    RetNo ret = segments_->Search(v, SearchCandidates(k, options), ctx.ids,
+                                  ctx.distances, options);
+    profile_timer.Restart();
+    bool partial = Partial(ret);
+    if (partial) {
+      ret = RET_OK;
+    }
+    if (ret == RET_OK && options.rerank > 0) {
+      ret = Rerank(v, k, IndexDistanceType(param_.default_index_info()), ctx);
+    }
+    if (ret != RET_OK) {
+      return timer.Done(ret);
+    }
+    MergeTail(k, ctx);
+    profile_timer.Lap(&SearchProfile::assembly_us);
+    ret = GetScalars(ctx);
+    profile_timer.Lap(&SearchProfile::scalar_us);
+    return timer.Done(ret == RET_OK && partial ? RET_PARTIAL : ret);
+  }
+
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
   if (index_id == -1) {
     index_id = MaxIndexID();
   }
 
   auto it = indexes_.find(index_id);
   if (it == indexes_.end()) {
-    return RET_ERROR;
+    return timer.Done(RET_ERROR);
+  }
+  if (options.profile) {
+    options.profile->index_id = index_id;
   }
-  return DoSearch(it->second, v, k, ids, distances, scalars, options);
+  return timer.Done(DoSearch(it->second, v, k, ctx, options));
 }
 
 RetNo Table::Search(int64_t id, int32_t k, std::vector<int64_t> &ids,
                     std::vector<float> &distances,
                     std::vector<std::string> &scalars, const ROptions &options,
                     int32_t index_id) {
-  if (index_id == -1) {
-    index_id = MaxIndexID();
-  }
-
+  // 查询向量按 Get 的顺序取，不计入 get 的统计
   std::vector<float> v;
-  RetNo ret = Get(id, v);
+  RetNo ret = DoGetVector(id, v);
   if (ret != RET_OK) {
     return ret;
   }
   return Search(v, k, ids, distances, scalars, options, index_id);
 }
 
+RetNo Table::RangeSearch(const std::vector<float> &v, float radius,
+                         int32_t max_results, std::vector<int64_t> &ids,
+                         std::vector<float> &distances,
+                         std::vector<std::string> &scalars,
+                         const ROptions &options, int32_t index_id) {
+  OpTimer timer(metrics_.range_search);
+  ids.clear();
+  distances.clear();
+  scalars.clear();
+
+  RetNo ret = RET_OK;
+  if (index_id == -1 && segments_) {
+    ret = segments_->RangeSearch(v, radius, max_results, ids, distances,
+                                 options);
+  } else {
+    std::shared_lock<std::shared_mutex> slk(index_mu_);
+    if (index_id == -1) {
+      index_id = MaxIndexID();
+    }
+    auto it = indexes_.find(index_id);
+    if (it == indexes_.end()) {
+      return timer.Done(RET_ERROR);
+    }
+    ret = it->second->RangeSearch(v, radius, max_results, ids, distances,
+                                  options);
+  }
+  if (ret != RET_OK) {
+    return timer.Done(ret);
+  }
+  return timer.Done(GetScalars(ids, scalars));
+}
+
+RetNo Table::RangeSearch(const std::vector<float> &v, float radius,
+                         const RangeCallback &callback,
+                         const ROptions &options, int32_t index_id) {
+  OpTimer timer(metrics_.range_search);
+  if (index_id == -1 && segments_) {
+    return timer.Done(segments_->RangeSearch(v, radius, callback, options));
+  }
+
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
+  if (index_id == -1) {
+    index_id = MaxIndexID();
+  }
+  auto it = indexes_.find(index_id);
+  if (it == indexes_.end()) {
+    return timer.Done(RET_ERROR);
+  }
+  return timer.Done(it->second->RangeSearch(v, radius, callback, options));
+}
+
 // input: v, k
-// output: ids, distances, scalars
-RetNo Table::DoSearch(VIndexSPtr index, const std::vector<float> &v, int32_t k,
-                      std::vector<int64_t> &ids, std::vector<float> &distances,
-                      std::vector<std::string> &scalars,
+// output: ctx.ids, ctx.distances, ctx.scalars
+RetNo Table::DoSearch(ShardedIndexSPtr index, const std::vector<float> &v,
+                      int32_t k, SearchContext &ctx,
                       const ROptions &options) {
   // 检查索引是否有效
   if (!index) {
     return RET_ERROR;
   }
 
-  // 清空输出参数
-  ids.clear();
-  distances.clear();
-  scalars.clear();
-
-  // 使用索引执行向量搜索
-  RetNo ret = index->Search(v, k, ids, distances);
+  // 先扫描未索引的向量再查索引，期间写入索引的向量至少出现在一边
+  ProfileTimer profile_timer(options.profile);
+  index_queue_->Search(v, k, IndexDistanceType(index->param().index_info()),
+                       ctx.tail_ids, ctx.tail_distances);
+  profile_timer.Lap(&SearchProfile::traversal_us);
+
+  // 使用索引执行向量搜索，重排时多取候选再按精确距离排序，
+  // 索引内各阶段的时间由索引自己统计
+  RetNo ret = index->Search(v, SearchCandidates(k, options), ctx, options);
+  profile_timer.Restart();
+  bool partial = Partial(ret);
+  if (partial) {
+    ret = RET_OK;
+  }
+  if (ret == RET_OK && options.rerank > 0) {
+    ret = Rerank(v, k, IndexDistanceType(index->param().index_info()), ctx);
+  }
   if (ret != RET_OK) {
     return ret;
   }
+  MergeTail(k, ctx);
+  profile_timer.Lap(&SearchProfile::assembly_us);
 
-  // 如果没有找到结果，直接返回成功
-  if (ids.empty()) {
-    return RET_OK;
+  ret = GetScalars(ctx);
+  profile_timer.Lap(&SearchProfile::scalar_us);
+  return ret == RET_OK && partial ? RET_PARTIAL : ret;
+}
+
+// 合并队列与索引的 top-k，队列中的 id 是更新的向量，以队列为准
+void Table::MergeTail(int32_t k, SearchContext &ctx) {
+  if (ctx.tail_ids.empty()) {
+    return;
   }
 
+  ctx.merge.clear();
+  for (size_t i = 0; i < ctx.tail_ids.size(); ++i) {
+    ctx.merge.emplace_back(ctx.tail_distances[i], ctx.tail_ids[i]);
+  }
+
+  // 队列结果最多 k 个，排序后二分查找
+  std::sort(ctx.tail_ids.begin(), ctx.tail_ids.end());
+  for (size_t i = 0; i < ctx.ids.size(); ++i) {
+    if (!std::binary_search(ctx.tail_ids.begin(), ctx.tail_ids.end(),
+                            ctx.ids[i])) {
+      ctx.merge.emplace_back(ctx.distances[i], ctx.ids[i]);
+    }
+  }
+  size_t top =
+      std::min(ctx.merge.size(), static_cast<size_t>(std::max(k, 0)));
+  std::partial_sort(ctx.merge.begin(), ctx.merge.begin() + top,
+                    ctx.merge.end());
+
+  ctx.ids.resize(top);
+  ctx.distances.resize(top);
+  for (size_t i = 0; i < top; ++i) {
+    ctx.ids[i] = ctx.merge[i].second;
+    ctx.distances[i] = ctx.merge[i].first;
+  }
+}
+
+RetNo Table::GetScalars(const std::vector<int64_t> &ids,
+                        std::vector<std::string> &scalars) {
+  scalars.clear();
+
   // 获取每个ID对应的标量数据
   for (const auto &id : ids) {
     // 创建ID对象并序列化
@@ -391,23 +800,141 @@ RetNo Table::DoSearch(VIndexSPtr index, const std::vector<float> &v, int32_t k,
   return RET_OK;
 }
 
+RetNo Table::SerializeKeys(SearchContext &ctx) {
+  // key 写入固定宽度的槽位，slice 指向 ctx.keys 不会失效
+  size_t n = ctx.ids.size();
+  ctx.keys.resize(n * kMaxIdKeySize);
+  ctx.key_slices.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    vdb::Id id_obj;
+    id_obj.set_id(ctx.ids[i]);
+    char *key = &ctx.keys[i * kMaxIdKeySize];
+    size_t size = id_obj.ByteSizeLong();
+    if (size > kMaxIdKeySize ||
+        !id_obj.SerializeToArray(key, static_cast<int>(size))) {
+      return RET_ERROR;
+    }
+    ctx.key_slices[i] = rocksdb::Slice(key, size);
+  }
+  return RET_OK;
+}
+
+RetNo Table::GetScalars(SearchContext &ctx) {
+  size_t n = ctx.ids.size();
+  ctx.scalars.resize(n);
+  if (n == 0) {
+    return RET_OK;
+  }
+  RetNo ret = SerializeKeys(ctx);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  // 一次 MultiGet 读取全部标量，值固定在 block cache 中不做拷贝
+  ctx.statuses.resize(n);
+  data_->MultiGet(rocksdb::ReadOptions(), cf_handles_[kScalarColumnFamily], n,
+                  ctx.key_slices.data(), ctx.scalars.data(),
+                  ctx.statuses.data());
+  for (size_t i = 0; i < n; ++i) {
+    // 标量不存在时为空
+    if (ctx.statuses[i].IsNotFound()) {
+      ctx.scalars[i].Reset();
+    } else if (!ctx.statuses[i].ok()) {
+      return RET_ERROR;
+    }
+  }
+
+  return RET_OK;
+}
+
+RetNo Table::Rerank(const std::vector<float> &v, int32_t k,
+                    int32_t distance_type, SearchContext &ctx) {
+  size_t n = ctx.ids.size();
+  if (n == 0) {
+    return RET_OK;
+  }
+  RetNo ret = SerializeKeys(ctx);
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  // 候选向量一次批量读出，热数据在 block cache 中
+  ctx.vectors.resize(n);
+  ctx.statuses.resize(n);
+  data_->MultiGet(rocksdb::ReadOptions(), cf_handles_[kVectorColumnFamily], n,
+                  ctx.key_slices.data(), ctx.vectors.data(),
+                  ctx.statuses.data());
+
+  // 与索引使用相同的 hnswlib 距离函数，按编译选项走 SIMD 实现
+  hnswlib::L2Space l2_space(v.size());
+  hnswlib::InnerProductSpace ip_space(v.size());
+  HammingSpace hamming_space(v.size() * kBitsPerFloat);
+  hnswlib::SpaceInterface<float> *space = &ip_space;
+  if (distance_type == DISTANCE_TYPE_L2) {
+    space = &l2_space;
+  } else if (distance_type == DISTANCE_TYPE_HAMMING) {
+    space = &hamming_space;
+  }
+  auto dist_func = space->get_dist_func();
+  void *dist_param = space->get_dist_func_param();
+
+  ctx.merge.clear();
+  for (size_t i = 0; i < n; ++i) {
+    // 索引中有但数据中已经没有的 id
+    if (ctx.statuses[i].IsNotFound()) {
+      continue;
+    }
+    if (!ctx.statuses[i].ok() ||
+        !ctx.vec.ParseFromArray(ctx.vectors[i].data(),
+                                static_cast<int>(ctx.vectors[i].size())) ||
+        ctx.vec.data_size() != static_cast<int>(v.size())) {
+      return RET_ERROR;
+    }
+    ctx.merge.emplace_back(
+        dist_func(v.data(), ctx.vec.data().data(), dist_param), ctx.ids[i]);
+    ctx.vectors[i].Reset();
+  }
+
+  size_t top =
+      std::min(ctx.merge.size(), static_cast<size_t>(std::max(k, 0)));
+  std::partial_sort(ctx.merge.begin(), ctx.merge.begin() + top,
+                    ctx.merge.end());
+  ctx.ids.resize(top);
+  ctx.distances.resize(top);
+  for (size_t i = 0; i < top; ++i) {
+    ctx.ids[i] = ctx.merge[i].second;
+    ctx.distances[i] = ctx.merge[i].first;
+  }
+  return RET_OK;
+}
+
 RetNo Table::BuildIndex() {
+  vdb::IndexParam param;
+  {
+    std::shared_lock<std::shared_mutex> slk(index_mu_);
+    param = DefaultIndexParam();
+  }
+
+  // 调用带参数的BuildIndex函数
+  OpTimer timer(metrics_.build_index);
+  return timer.Done(DoBuildIndex(param));
+}
+
+vdb::IndexParam Table::DefaultIndexParam() const {
   // 创建默认索引参数
   vdb::IndexParam param;
 
   // 设置索引ID为当前最大索引ID + 1
-  int32_t index_id = MaxIndexID() + 1;
+  int32_t index_id = NextIndexID();
   param.set_path(index_path_ + "/" + std::to_string(index_id));
   param.set_id(index_id);
   param.set_create_time(TimeStamp().MilliSeconds());
   param.mutable_index_info()->CopyFrom(param_.default_index_info());
-
-  // 调用带参数的BuildIndex函数
-  return DoBuildIndex(param);
+  return param;
 }
 
 RetNo Table::BuildIndex(const vdb::FlatParam &param) {
-  int32_t index_id = MaxIndexID() + 1;
+  int32_t index_id = NextIndexID();
   vdb::IndexParam param2;
   param2.set_path(index_path_ + "/" + std::to_string(index_id));
   param2.set_id(index_id);
@@ -415,11 +942,12 @@ RetNo Table::BuildIndex(const vdb::FlatParam &param) {
   param2.mutable_index_info()->set_index_type(INDEX_TYPE_FLAT);
   param2.mutable_index_info()->mutable_flat_param()->CopyFrom(param);
 
-  return DoBuildIndex(param2);
+  OpTimer timer(metrics_.build_index);
+  return timer.Done(DoBuildIndex(param2));
 }
 
 RetNo Table::BuildIndex(const vdb::HnswParam &param) {
-  int32_t index_id = MaxIndexID() + 1;
+  int32_t index_id = NextIndexID();
   vdb::IndexParam param2;
   param2.set_path(index_path_ + "/" + std::to_string(index_id));
   param2.set_id(index_id);
@@ -427,64 +955,101 @@ RetNo Table::BuildIndex(const vdb::HnswParam &param) {
   param2.mutable_index_info()->set_index_type(INDEX_TYPE_HNSW);
   param2.mutable_index_info()->mutable_hnsw_param()->CopyFrom(param);
 
-  return DoBuildIndex(param2);
+  OpTimer timer(metrics_.build_index);
+  return timer.Done(DoBuildIndex(param2));
 }
 
-RetNo Table::DoBuildIndex(const vdb::IndexParam &param) {
-  // 检查索引ID是否已存在
-  if (indexes_.find(param.id()) != indexes_.end()) {
-    return RET_ERROR;  // 索引ID已存在
-  }
+RetNo Table::BuildIndex(const vdb::DiskAnnParam &param) {
+  int32_t index_id = NextIndexID();
+  vdb::IndexParam param2;
+  param2.set_path(index_path_ + "/" + std::to_string(index_id));
+  param2.set_id(index_id);
+  param2.set_create_time(TimeStamp().MilliSeconds());
+  param2.mutable_index_info()->set_index_type(INDEX_TYPE_DISKANN);
+  param2.mutable_index_info()->mutable_diskann_param()->CopyFrom(param);
 
-  // 检查索引目录是否存在
-  if (fs::exists(param.path())) {
-    return RET_ERROR;
-  }
+  OpTimer timer(metrics_.build_index);
+  return timer.Done(DoBuildIndex(param2));
+}
 
-  // 创建索引实例
-  VIndexSPtr index = std::make_shared<VIndex>(param);
-  if (!index) {
+RetNo Table::BuildIndex(const vdb::PqParam &param) {
+  int32_t index_id = NextIndexID();
+  vdb::IndexParam param2;
+  param2.set_path(index_path_ + "/" + std::to_string(index_id));
+  param2.set_id(index_id);
+  param2.set_create_time(TimeStamp().MilliSeconds());
+  param2.mutable_index_info()->set_index_type(INDEX_TYPE_PQ);
+  param2.mutable_index_info()->mutable_pq_param()->CopyFrom(param);
+
+  OpTimer timer(metrics_.build_index);
+  return timer.Done(DoBuildIndex(param2));
+}
+
+RetNo Table::DoBuildIndex(const vdb::IndexParam &param) {
+  // 二进制表与 float 表的向量不能互相建索引，
+  // cosine 索引需要写入时已经归一化的向量
+  const vdb::IndexInfo &info = param.index_info();
+  if (!ValidIndexInfo(info) ||
+      (IndexDistanceType(info) == DISTANCE_TYPE_HAMMING) != binary() ||
+      (IndexDistanceType(info) == DISTANCE_TYPE_COSINE && !cosine())) {
     return RET_ERROR;
   }
 
-  // 将索引添加到表的索引集合中
-  indexes_[param.id()] = index;
+  // 先加入索引集合再填充，填充期间的新写入也会进入新索引
+  ShardedIndexSPtr index;
+  {
+    std::unique_lock<std::shared_mutex> ulk(index_mu_);
 
-  // 将索引添加到表参数中，以便持久化
-  vdb::IndexParam *index_param = param_.add_indexes();
-  *index_param = param;
+    // 检查索引ID是否已存在
+    if (indexes_.find(param.id()) != indexes_.end()) {
+      return RET_ERROR;  // 索引ID已存在
+    }
 
-  // 从数据库中读取所有向量并添加到索引中
-  rocksdb::Iterator *it = data_->NewIterator(rocksdb::ReadOptions(),
-                                             cf_handles_[kVectorColumnFamily]);
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    // 解析ID
-    vdb::Id id_obj;
-    if (!id_obj.ParseFromString(it->key().ToString())) {
-      delete it;
+    // 检查索引目录是否存在
+    if (fs::exists(param.path())) {
       return RET_ERROR;
     }
-    int64_t id = id_obj.id();
 
-    // 解析向量
-    vdb::Vec vec_obj;
-    if (!vec_obj.ParseFromString(it->value().ToString())) {
-      delete it;
+    // 创建索引实例
+    index = std::make_shared<ShardedIndex>(param, param_.shard_num());
+    if (!index) {
       return RET_ERROR;
     }
 
-    std::vector<float> vector(vec_obj.data().begin(), vec_obj.data().end());
+    // 将索引添加到表的索引集合中
+    indexes_[param.id()] = index;
+
+    // 将索引添加到表参数中，以便持久化
+    vdb::IndexParam *index_param = param_.add_indexes();
+    *index_param = param;
+  }
 
-    // 将向量添加到索引中
-    RetNo ret = index->Add(id, vector);
+  // 从数据库中分批读取向量，每批按分片并行写入索引
+  const size_t kBatchSize = 10000;
+  std::vector<int64_t> ids;
+  std::vector<std::vector<float>> vectors;
+  RetNo ret = ForEachVector(
+      [&](int64_t id, const std::vector<float> &vector) -> RetNo {
+        ids.push_back(id);
+        vectors.push_back(vector);
+        if (ids.size() < kBatchSize) {
+          return RET_OK;
+        }
+        RetNo add_ret = index->Add(ids, vectors);
+        ids.clear();
+        vectors.clear();
+        return add_ret;
+      });
+  if (ret != RET_OK) {
+    return ret;
+  }
+  if (!ids.empty()) {
+    ret = index->Add(ids, vectors);
     if (ret != RET_OK) {
-      delete it;
       return ret;
     }
   }
 
-  delete it;
-
   // 持久化表描述和索引
   PersistDescription();
   index->Persist();
@@ -492,7 +1057,195 @@ RetNo Table::DoBuildIndex(const vdb::IndexParam &param) {
   return RET_OK;
 }
 
+RetNo Table::Import(const std::string &file, const ImportParam &param) {
+  OpTimer timer(metrics_.import);
+  return timer.Done(DoImport(file, param));
+}
+
+RetNo Table::DoImport(const std::string &file, const ImportParam &param) {
+  VectorFile vectors(file, param.format, param.dim);
+  RetNo ret = vectors.Open();
+  if (ret != RET_OK) {
+    return ret;
+  }
+  if (vectors.Dim() != param_.dim()) {
+    return RET_ERROR;
+  }
+  if (vectors.Rows() == 0) {
+    return RET_OK;
+  }
+
+  // sst 文件内的 key 必须有序，各文件之间也不能重叠
+  std::vector<ImportKey> keys =
+      SortedImportKeys(param.start_id, vectors.Rows());
+
+  std::string sst_dir = param_.path() + "/import";
+  if (fs::exists(sst_dir)) {
+    fs::remove_all(sst_dir);
+  }
+  fs::create_directories(sst_dir);
+
+  int64_t rows_per_sst = std::max<int64_t>(param.rows_per_sst, 1);
+  int64_t file_num = (vectors.Rows() + rows_per_sst - 1) / rows_per_sst;
+  std::vector<std::string> sst_files(file_num);
+  std::vector<RetNo> rets(file_num, RET_OK);
+  DefaultThreadPool().ParallelFor(0, file_num, [&](int64_t f) {
+    int64_t begin = f * rows_per_sst;
+    int64_t end = std::min(vectors.Rows(), begin + rows_per_sst);
+    sst_files[f] = sst_dir + "/" + std::to_string(f) + ".sst";
+    rets[f] = WriteSst(vectors, keys, begin, end, sst_files[f]);
+  });
+  for (RetNo r : rets) {
+    if (r != RET_OK) {
+      fs::remove_all(sst_dir);
+      return r;
+    }
+  }
+
+  // 直接把文件移动到 rocksdb 的目录，不经过 WAL 和 memtable
+  rocksdb::IngestExternalFileOptions ingest_options;
+  ingest_options.move_files = true;
+  rocksdb::Status status = data_->IngestExternalFile(
+      cf_handles_[kVectorColumnFamily], sst_files, ingest_options);
+  fs::remove_all(sst_dir);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+
+  if (!param.build_index) {
+    return RET_OK;
+  }
+  return ImportIndex(vectors, param.start_id);
+}
+
+RetNo Table::WriteSst(const VectorFile &vectors,
+                      const std::vector<ImportKey> &keys, int64_t begin,
+                      int64_t end, const std::string &sst_file) {
+  rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), rocksdb::Options(),
+                                cf_handles_[kVectorColumnFamily]);
+  rocksdb::Status status = writer.Open(sst_file);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+
+  // cosine 表与 Add 一样保存归一化后的向量
+  bool is_cosine = cosine();
+  std::vector<float> normalized(is_cosine ? vectors.Dim() : 0);
+  vdb::Vec vec_obj;
+  std::string vec_str;
+  for (int64_t i = begin; i < end; ++i) {
+    const float *row = vectors.Row(keys[i].row);
+    if (is_cosine) {
+      Normalize(row, normalized.data(), vectors.Dim());
+      row = normalized.data();
+    }
+    vec_obj.mutable_data()->Assign(row, row + vectors.Dim());
+    if (!vec_obj.SerializeToString(&vec_str)) {
+      return RET_ERROR;
+    }
+
+    status = writer.Put(rocksdb::Slice(keys[i].data, keys[i].size),
+                        rocksdb::Slice(vec_str));
+    if (!status.ok()) {
+      return RET_ERROR;
+    }
+  }
+
+  status = writer.Finish();
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
+RetNo Table::ImportIndex(const VectorFile &vectors, int64_t start_id) {
+  int64_t rows = vectors.Rows();
+  int32_t dim = vectors.Dim();
+
+  // cosine 索引要求写入的向量已经归一化，与 sst 中保存的一致
+  bool is_cosine = cosine();
+  auto row_vector = [&](int64_t i, std::vector<float> &vector) {
+    vector.resize(dim);
+    if (is_cosine) {
+      Normalize(vectors.Row(i), vector.data(), dim);
+    } else {
+      vector.assign(vectors.Row(i), vectors.Row(i) + dim);
+    }
+  };
+
+  // 分段表按顺序写入 growing segment，由后台线程封存
+  if (segments_) {
+    std::vector<float> vector(dim);
+    for (int64_t i = 0; i < rows; ++i) {
+      row_vector(i, vector);
+      RetNo ret = segments_->Add(start_id + i, vector);
+      if (ret != RET_OK) {
+        return ret;
+      }
+    }
+    return RET_OK;
+  }
+
+  // 没有索引时新建一个，容量至少为导入的行数
+  std::unique_lock<std::shared_mutex> ulk(index_mu_);
+  if (indexes_.empty()) {
+    vdb::IndexParam param = DefaultIndexParam();
+    vdb::IndexInfo *info = param.mutable_index_info();
+    if (info->index_type() == INDEX_TYPE_HNSW) {
+      info->mutable_hnsw_param()->set_max_elements(
+          std::max<int64_t>(info->hnsw_param().max_elements(), rows));
+    } else if (info->index_type() == INDEX_TYPE_FLAT) {
+      info->mutable_flat_param()->set_max_elements(
+          std::max<int64_t>(info->flat_param().max_elements(), rows));
+    } else if (info->index_type() == INDEX_TYPE_DISKANN) {
+      info->mutable_diskann_param()->set_max_elements(
+          std::max<int64_t>(info->diskann_param().max_elements(), rows));
+    } else if (info->index_type() == INDEX_TYPE_PQ) {
+      info->mutable_pq_param()->set_max_elements(
+          std::max<int64_t>(info->pq_param().max_elements(), rows));
+    }
+
+    indexes_[param.id()] =
+        std::make_shared<ShardedIndex>(param, param_.shard_num());
+    *param_.add_indexes() = param;
+    WriteDescription();
+  }
+
+  // 容量不足时 hnswlib 在线程池的任务中抛异常，插入前先扩容，
+  // 扩容与搜索互斥
+  for (auto &index_pair : indexes_) {
+    RetNo ret = index_pair.second->Reserve(start_id, rows);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+  ulk.unlock();
+
+  // hnswlib 的 addPoint 是线程安全的，直接从映射的文件并行插入
+  std::atomic<int32_t> errors(0);
+  {
+    std::shared_lock<std::shared_mutex> slk(index_mu_);
+    DefaultThreadPool().ParallelFor(0, rows, [&](int64_t i) {
+      std::vector<float> vector;
+      row_vector(i, vector);
+      for (auto &index_pair : indexes_) {
+        if (index_pair.second->Add(start_id + i, vector) != RET_OK) {
+          errors++;
+        }
+      }
+    });
+  }
+  if (errors.load() > 0) {
+    return RET_ERROR;
+  }
+
+  PersistIndex();
+  return RET_OK;
+}
+
 RetNo Table::DropIndex(int32_t left) {
+  std::unique_lock<std::shared_mutex> ulk(index_mu_);
+
   // 如果没有索引或者要保留的索引数大于等于当前索引数，则不需要删除
   if (indexes_.empty() || left >= static_cast<int32_t>(indexes_.size())) {
     return RET_OK;
@@ -508,7 +1261,7 @@ RetNo Table::DropIndex(int32_t left) {
     }
     indexes_.clear();
     param_.clear_indexes();
-    PersistDescription();
+    WriteDescription();
     return RET_OK;
   }
 
@@ -546,10 +1299,74 @@ RetNo Table::DropIndex(int32_t left) {
   }
 
   // 持久化表描述
-  PersistDescription();
+  WriteDescription();
   return RET_OK;
 }
 
+RetNo Table::DropIndexByID(int32_t index_id) {
+  std::unique_lock<std::shared_mutex> ulk(index_mu_);
+  auto it = indexes_.find(index_id);
+  if (it == indexes_.end()) {
+    return RET_NOT_FOUND;
+  }
+
+  // 删除索引文件
+  if (fs::exists(it->second->param().path())) {
+    fs::remove_all(it->second->param().path());
+  }
+  indexes_.erase(it);
+
+  // 更新表参数中的索引列表
+  param_.clear_indexes();
+  for (const auto &index_pair : indexes_) {
+    vdb::IndexParam *index_param = param_.add_indexes();
+    *index_param = index_pair.second->param();
+  }
+
+  WriteDescription();
+  return RET_OK;
+}
+
+RetNo Table::ForEachVector(
+    const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+        &func) {
+  std::unique_ptr<rocksdb::Iterator> it(data_->NewIterator(
+      rocksdb::ReadOptions(), cf_handles_[kVectorColumnFamily]));
+  std::vector<float> vector;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    // 解析ID
+    vdb::Id id_obj;
+    if (!id_obj.ParseFromArray(it->key().data(), it->key().size())) {
+      return RET_ERROR;
+    }
+
+    // 解析向量
+    vdb::Vec vec_obj;
+    if (!vec_obj.ParseFromArray(it->value().data(), it->value().size())) {
+      return RET_ERROR;
+    }
+    vector.assign(vec_obj.data().begin(), vec_obj.data().end());
+
+    RetNo ret = func(id_obj.id(), vector);
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
+
+  if (!it->status().ok()) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
+ShardedIndexSPtr Table::NewestIndex() const {
+  auto it = indexes_.find(MaxIndexID());
+  if (it == indexes_.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
 int32_t Table::MaxIndexID() const {
   int32_t max_id = -1;
   for (const auto &index : indexes_) {
@@ -558,13 +1375,70 @@ int32_t Table::MaxIndexID() const {
   return max_id;
 }
 
+int32_t Table::NextIndexID() const {
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
+  return MaxIndexID() + 1;
+}
+
 RetNo Table::Persist() {
+  // 持久化的索引要包含所有已提交的向量
+  index_queue_->WaitIdle();
   PersistDescription();
   PersistIndex();
+  if (segments_) {
+    return segments_->Persist();
+  }
+  return RET_OK;
+}
+
+RetNo Table::SyncWal() {
+  rocksdb::Status status = data_->SyncWAL();
+  return status.ok() ? RET_OK : RET_ERROR;
+}
+
+RetNo Table::Checkpoint(const std::string &dir) {
+  if (fs::exists(dir)) {
+    return RET_ERROR;
+  }
+
+  RetNo ret = Persist();
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  fs::create_directories(dir);
+  ret = CheckpointRocksdb(data_.get(), dir + "/data");
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  // 索引文件（包括分段索引）在 Persist 之后不再变化，直接复制
+  std::error_code ec;
+  fs::copy(index_path_, dir + "/index", fs::copy_options::recursive, ec);
+  if (ec) {
+    return RET_ERROR;
+  }
+  std::string segment_path = param_.path() + "/segment";
+  if (fs::exists(segment_path)) {
+    fs::copy(segment_path, dir + "/segment", fs::copy_options::recursive,
+             ec);
+    if (ec) {
+      return RET_ERROR;
+    }
+  }
+  fs::copy_file(description_file_, dir + "/description.json", ec);
+  if (ec) {
+    return RET_ERROR;
+  }
   return RET_OK;
 }
 
 void Table::PersistDescription() {
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
+  WriteDescription();
+}
+
+void Table::WriteDescription() {
   std::ofstream file(description_file_);
   file << ToJson().dump(2);
   file.close();
@@ -578,12 +1452,14 @@ json Table::ToJson() const {
 }
 
 void Table::PersistIndex() {
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
   for (const auto &index : indexes_) {
     index.second->Persist();
   }
 }
 
 std::vector<int32_t> Table::IndexIDs() const {
+  std::shared_lock<std::shared_mutex> slk(index_mu_);
   std::vector<int32_t> ids;
   for (const auto &index : indexes_) {
     ids.push_back(index.first);
@@ -592,6 +1468,65 @@ std::vector<int32_t> Table::IndexIDs() const {
   return ids;
 }
 
+json Table::Stats() const {
+  json j;
+  j["ops"] = metrics_.ToJson();
+
+  // rocksdb 内部统计，按列族输出
+  const std::vector<std::string> properties = {
+      "rocksdb.estimate-num-keys",
+      "rocksdb.estimate-live-data-size",
+      "rocksdb.total-sst-files-size",
+      "rocksdb.cur-size-all-mem-tables",
+      "rocksdb.num-running-compactions",
+      "rocksdb.block-cache-usage",
+  };
+  j["rocksdb"] = json::object();
+  for (const auto &cf_pair : cf_handles_) {
+    json cf;
+    for (const auto &property : properties) {
+      uint64_t value = 0;
+      if (data_->GetIntProperty(cf_pair.second, property, &value)) {
+        // rocksdb.estimate-num-keys -> estimate_num_keys
+        std::string name = property.substr(std::string("rocksdb.").size());
+        std::replace(name.begin(), name.end(), '-', '_');
+        cf[name] = value;
+      }
+    }
+    j["rocksdb"][cf_pair.first] = cf;
+  }
+
+  j["indexes"] = json::object();
+  {
+    std::shared_lock<std::shared_mutex> slk(index_mu_);
+    for (const auto &index : indexes_) {
+      j["indexes"][std::to_string(index.first)] = index.second->Stats();
+    }
+  }
+
+  if (segments_) {
+    j["segments"] = segments_->Stats();
+  }
+
+  j["index_queue"] = index_queue_->Stats();
+  return j;
+}
+
+RetNo CheckpointRocksdb(rocksdb::DB *db, const std::string &dir) {
+  rocksdb::Checkpoint *checkpoint_ptr = nullptr;
+  rocksdb::Status status = rocksdb::Checkpoint::Create(db, &checkpoint_ptr);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+
+  std::unique_ptr<rocksdb::Checkpoint> checkpoint(checkpoint_ptr);
+  status = checkpoint->CreateCheckpoint(dir);
+  if (!status.ok()) {
+    return RET_ERROR;
+  }
+  return RET_OK;
+}
+
 vdb::FlatParam DefaultFlatParam(int32_t dim) {
   vdb::FlatParam param;
   param.set_dim(dim);
@@ -1,18 +1,30 @@
 #ifndef VECTORDB_TABLE_H
 #define VECTORDB_TABLE_H
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "common.h"
+#include "importer.h"
+#include "index_queue.h"
+#include "metrics.h"
 #include "options.h"
 #include "retno.h"
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/write_batch.h"
+#include "search_context.h"
+#include "segment.h"
+#include "sharded_index.h"
 #include "vdb.pb.h"
 #include "vindex.h"
 
@@ -35,18 +47,27 @@ class Table final {
   RetNo Add(int64_t id, std::vector<float> &vector,
             const WOptions &options = WOptions(), bool normalize = false);
 
+  // binary vector of a hamming table, bits.size() * 8 == dim
+  RetNo Add(int64_t id, const std::vector<uint8_t> &bits,
+            const std::string &scalar, const WOptions &options = WOptions());
+
   // input: id
   // output: vector, scalar
   RetNo Get(int64_t id, std::vector<float> &vector, std::string &scalar);
 
   // input: id
   // output: vector
+  // read from the owning shard of the newest index if it has the id
   RetNo Get(int64_t id, std::vector<float> &vector);
 
   // input: id
   // output: scalar
   RetNo Get(int64_t id, std::string &scalar);
 
+  // input: id
+  // output: bits, binary vector of a hamming table
+  RetNo Get(int64_t id, std::vector<uint8_t> &bits);
+
   // input: v, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -55,6 +76,21 @@ class Table final {
                std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, k
+  // output: ctx.ids, ctx.distances, ctx.scalars
+  // results and scratch live in ctx, scalars are pinned instead of copied,
+  // see SearchContext
+  RetNo Search(const std::vector<float> &v, int32_t k, SearchContext &ctx,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
+  // input: bits, k
+  // output: ids, distances (number of different bits), scalars
+  // binary query of a hamming table
+  RetNo Search(const std::vector<uint8_t> &bits, int32_t k,
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               std::vector<std::string> &scalars,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
   // input: id, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -62,21 +98,73 @@ class Table final {
                std::vector<float> &distances, std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, radius
+  // output: ids, distances, scalars of all vectors with distance <= radius,
+  // sorted, at most max_results (<= 0 means no limit) closest ones
+  // index_id: -1 means the newest index
+  RetNo RangeSearch(const std::vector<float> &v, float radius,
+                    int32_t max_results, std::vector<int64_t> &ids,
+                    std::vector<float> &distances,
+                    std::vector<std::string> &scalars,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
+  // input: v, radius
+  // output: ids and distances streamed to callback, no scalars
+  RetNo RangeSearch(const std::vector<float> &v, float radius,
+                    const RangeCallback &callback,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
   RetNo BuildIndex();
   RetNo BuildIndex(const vdb::FlatParam &param);
   RetNo BuildIndex(const vdb::HnswParam &param);
+  RetNo BuildIndex(const vdb::DiskAnnParam &param);
+  RetNo BuildIndex(const vdb::PqParam &param);
+
+  // bulk load a vector file: rows are written as sst files and ingested
+  // into the vector column family, then the index is built in parallel
+  // from the mapped file
+  RetNo Import(const std::string &file, const ImportParam &param);
 
   // the newest 'left' indexes will be kept
   RetNo DropIndex(int32_t left = 2);
 
+  RetNo DropIndexByID(int32_t index_id);
+
+  // iterate all vectors in the table, stop when func returns not RET_OK
+  RetNo ForEachVector(
+      const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+          &func);
+
   const vdb::TableParam &param() const { return param_; }
 
+  // hamming table, vectors are dim bits packed into dim / 32 floats,
+  // the float interfaces see them in this form, see BinaryToVector
+  bool binary() const;
+
   RetNo Persist();
+  // fsync the rocksdb WAL, the writes made so far survive a crash
+  RetNo SyncWal();
   void PersistDescription();
   void PersistIndex();
 
+  // persist the table and copy it into dir, which must not exist, the
+  // rocksdb data is a checkpoint (hard links where possible), the index
+  // files are copied. Writes must be stopped meanwhile.
+  RetNo Checkpoint(const std::string &dir);
+
   std::vector<int32_t> IndexIDs() const;
 
+  // nullptr if the table is not segmented (seal_threshold == 0)
+  SegmentManagerSPtr segments() const { return segments_; }
+
+  // block until every vector added with async_index is in the index
+  void WaitIndexQueue() { index_queue_->WaitIdle(); }
+
+  // operation metrics, rocksdb properties and per index stats
+  json Stats() const;
+
  private:
   void Init();
   RetNo New();
@@ -85,16 +173,83 @@ class Table final {
   RetNo LoadIndex();
   RetNo NewData();
   RetNo LoadData();
+  RetNo InitSegments();
+
+  // index_mu_ must be held
   int32_t MaxIndexID() const;
+  ShardedIndexSPtr NewestIndex() const;
+  vdb::IndexParam DefaultIndexParam() const;
+  void WriteDescription();
+
+  // MaxIndexID() + 1, takes index_mu_
+  int32_t NextIndexID() const;
   json ToJson() const;
   RetNo DoBuildIndex(const vdb::IndexParam &param);
+  RetNo DoImport(const std::string &file, const ImportParam &param);
+  RetNo WriteSst(const VectorFile &vectors, const std::vector<ImportKey> &keys,
+                 int64_t begin, int64_t end, const std::string &sst_file);
+  RetNo ImportIndex(const VectorFile &vectors, int64_t start_id);
+  RetNo DoAdd(int64_t id, std::vector<float> &vector, const std::string &scalar,
+              const WOptions &options, bool normalize);
+  RetNo AddToIndex(int64_t id, const std::vector<float> &vector);
+
+  // an add waiting in the write queue, the queue head (leader) merges
+  // the compatible ones behind it into one WriteBatch and commits it
+  struct Writer {
+    std::string id_str;
+    std::string vec_str;
+    const std::string *scalar = nullptr;
+    bool sync = false;
+    bool disable_wal = false;
+    bool write_index = false;
+
+    RetNo ret = RET_OK;
+    bool done = false;
+    std::condition_variable cv;
+  };
+  RetNo GroupCommit(Writer *w);
+  RetNo DoGet(int64_t id, std::vector<float> &vector, std::string &scalar);
+  RetNo DoGet(int64_t id, std::string &scalar);
+  // pending queue, then the newest index, then rocksdb; no metrics
+  RetNo DoGetVector(int64_t id, std::vector<float> &vector);
 
   // input: v, k
-  // output: ids, distances, scalars
-  RetNo DoSearch(VIndexSPtr index, const std::vector<float> &v, int32_t k,
-                 std::vector<int64_t> &ids, std::vector<float> &distances,
-                 std::vector<std::string> &scalars,
-                 const ROptions &options = ROptions());
+  // output: ctx.ids, ctx.distances, ctx.scalars
+  RetNo DoSearch(ShardedIndexSPtr index, const std::vector<float> &v,
+                 int32_t k, SearchContext &ctx, const ROptions &options);
+
+  // merge ctx.tail_ids, ctx.tail_distances (the top-k of the not yet
+  // indexed vectors) into ctx.ids, ctx.distances
+  static void MergeTail(int32_t k, SearchContext &ctx);
+
+  // input: ids
+  // output: scalars
+  RetNo GetScalars(const std::vector<int64_t> &ids,
+                   std::vector<std::string> &scalars);
+
+  // input: ctx.ids
+  // output: ctx.scalars, pinned
+  RetNo GetScalars(SearchContext &ctx);
+
+  // input: v, ctx.ids
+  // output: ctx.ids, ctx.distances, the k closest by exact distance to the
+  // vectors in the vector column family
+  RetNo Rerank(const std::vector<float> &v, int32_t k, int32_t distance_type,
+               SearchContext &ctx);
+
+  // serialized ctx.ids into ctx.keys, ctx.key_slices
+  static RetNo SerializeKeys(SearchContext &ctx);
+
+  // cosine table, vectors are normalized on ingest
+  bool cosine() const;
+
+  // v normalized into ctx.query for a cosine table, v itself otherwise
+  const std::vector<float> &Query(const std::vector<float> &v,
+                                  SearchContext &ctx) const;
+
+  // check bits against the table and pack them into vector
+  RetNo BinaryVector(const std::vector<uint8_t> &bits,
+                     std::vector<float> &vector) const;
 
  private:
   std::string data_path_;
@@ -103,10 +258,25 @@ class Table final {
   vdb::TableParam param_;
 
   std::shared_ptr<rocksdb::DB> data_;
-  std::unordered_map<int32_t, VIndexSPtr> indexes_;
+
+  // guards indexes_ and param_.indexes(). Adds and searches hold it shared
+  // while they use an index, building, dropping and growing an index hold
+  // it exclusive. The async index queue adds from its own thread.
+  mutable std::shared_mutex index_mu_;
+  std::unordered_map<int32_t, ShardedIndexSPtr> indexes_;
+  SegmentManagerSPtr segments_;
+  IndexQueueUPtr index_queue_;
   std::unordered_map<std::string, rocksdb::ColumnFamilyHandle *> cf_handles_;
+
+  std::mutex write_mutex_;
+  std::deque<Writer *> writers_;
+
+  TableMetrics metrics_;
 };
 
+// consistent copy of db in dir, which must not exist
+RetNo CheckpointRocksdb(rocksdb::DB *db, const std::string &dir);
+
 vdb::FlatParam DefaultFlatParam(int32_t dim);
 vdb::HnswParam DefaultHnswParam(int32_t dim);
 
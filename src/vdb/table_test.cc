@@ -2,10 +2,15 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "common.h"
+#include "distance.h"
+#include "search_profile.h"
 #include "util.h"
 #include "vdb.pb.h"
 
@@ -425,6 +430,448 @@ TEST(TableTest, MultipleIndices) {
   }
 }
 
+// 测试并发 Add 的组提交
+TEST(TableTest, GroupCommit) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_FLAT);
+  vdb::FlatParam flat_param = vectordb::DefaultFlatParam(16);
+  flat_param.set_max_elements(10000);
+  flat_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_flat_param()->CopyFrom(
+      flat_param);
+  vectordb::Table table(param);
+
+  // 每个线程使用不同的持久化选项，相同选项的写入会被合并
+  const int32_t kThreads = 8;
+  const int32_t kPerThread = 200;
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&table, t] {
+      vectordb::WOptions options;
+      options.sync = (t % 4 == 1);
+      options.disable_wal = (t % 4 == 2);
+      for (int32_t i = 0; i < kPerThread; ++i) {
+        int64_t id = t * kPerThread + i;
+        std::vector<float> vector(16, static_cast<float>(id));
+        EXPECT_EQ(vectordb::RET_OK,
+                  table.Add(id, vector, std::to_string(id), options));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int64_t id = 0; id < kThreads * kPerThread; ++id) {
+    std::vector<float> vector;
+    std::string scalar;
+    ASSERT_EQ(vectordb::RET_OK, table.Get(id, vector, scalar));
+    EXPECT_EQ(std::vector<float>(16, static_cast<float>(id)), vector);
+    EXPECT_EQ(std::to_string(id), scalar);
+  }
+
+  // 只创建了一个索引，所有向量都在其中
+  EXPECT_EQ(1u, table.IndexIDs().size());
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  std::vector<float> query(16, 777.0f);
+  EXPECT_EQ(vectordb::RET_OK, table.Search(query, 1, ids, distances, scalars));
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(777, ids[0]);
+
+  json ops = table.Stats()["ops"];
+  EXPECT_EQ(kThreads * kPerThread, ops["add"]["count"].get<int64_t>());
+  EXPECT_GE(kThreads * kPerThread, ops["write_group"]["count"].get<int64_t>());
+  EXPECT_EQ(0, ops["write_group"]["errors"].get<int64_t>());
+}
+
+// 按 id 搜索，查询向量从索引中取，不计入 get 的统计
+TEST(TableTest, SearchById) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_FLAT);
+  vdb::FlatParam flat_param = vectordb::DefaultFlatParam(16);
+  flat_param.set_max_elements(1000);
+  flat_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_flat_param()->CopyFrom(
+      flat_param);
+  vectordb::Table table(param);
+
+  for (int64_t id = 0; id < 100; ++id) {
+    std::vector<float> vector(16, static_cast<float>(id));
+    ASSERT_EQ(vectordb::RET_OK, table.Add(id, vector, std::to_string(id)));
+  }
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(int64_t(42), 3, ids, distances,
+                                           scalars, vectordb::ROptions()));
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ(42, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+  EXPECT_EQ("42", scalars[0]);
+
+  EXPECT_NE(vectordb::RET_OK, table.Search(int64_t(1000), 3, ids, distances,
+                                           scalars, vectordb::ROptions()));
+
+  json ops = table.Stats()["ops"];
+  EXPECT_EQ(0, ops["get"]["count"].get<int64_t>());
+  EXPECT_EQ(1, ops["search"]["count"].get<int64_t>());
+}
+
+// 测试异步索引，搜索能读到刚写入的向量
+TEST(TableTest, AsyncIndex) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(16);
+  hnsw_param.set_max_elements(10000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+
+  vectordb::WOptions options;
+  options.async_index = true;
+  for (int64_t id = 0; id < 2000; ++id) {
+    std::vector<float> vector(16, static_cast<float>(id));
+    ASSERT_EQ(vectordb::RET_OK, table.Add(id, vector, options));
+
+    // 不论是否已写入索引，都能搜到自己
+    if (id % 100 == 0) {
+      std::vector<int64_t> ids;
+      std::vector<float> distances;
+      std::vector<std::string> scalars;
+      ASSERT_EQ(vectordb::RET_OK,
+                table.Search(vector, 1, ids, distances, scalars));
+      ASSERT_EQ(1u, ids.size());
+      EXPECT_EQ(id, ids[0]);
+    }
+  }
+
+  // 覆盖写入后读到的是新向量
+  std::vector<float> updated(16, -1.0f);
+  ASSERT_EQ(vectordb::RET_OK, table.Add(5, updated, options));
+  std::vector<float> vector;
+  EXPECT_EQ(vectordb::RET_OK, table.Get(5, vector));
+  EXPECT_EQ(updated, vector);
+
+  table.WaitIndexQueue();
+  json stats = table.Stats();
+  EXPECT_EQ(0, stats["index_queue"]["pending"].get<int64_t>());
+  EXPECT_EQ(2001, stats["ops"]["async_index"]["count"].get<int64_t>());
+  EXPECT_EQ(0, stats["ops"]["async_index"]["errors"].get<int64_t>());
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  EXPECT_EQ(vectordb::RET_OK,
+            table.Search(updated, 1, ids, distances, scalars));
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(5, ids[0]);
+}
+
+// context 版本的搜索与 vector 版本结果一致，复用时不重新分配
+TEST(TableTest, SearchContext) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.set_shard_num(2);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(16);
+  hnsw_param.set_max_elements(10000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+
+  for (int64_t id = 0; id < 200; ++id) {
+    std::vector<float> vector(16, static_cast<float>(id));
+    std::string scalar = id % 2 == 0 ? "scalar_" + std::to_string(id) : "";
+    ASSERT_EQ(vectordb::RET_OK, table.Add(id, vector, scalar));
+  }
+
+  std::vector<float> query(16, 50.2f);
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  ASSERT_EQ(vectordb::RET_OK,
+            table.Search(query, 10, ids, distances, scalars));
+  ASSERT_EQ(10u, ids.size());
+  EXPECT_EQ(50, ids[0]);
+
+  vectordb::SearchContext ctx;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(query, 10, ctx));
+  ASSERT_EQ(10u, ctx.size());
+  EXPECT_EQ(ids, ctx.ids);
+  EXPECT_EQ(distances, ctx.distances);
+  for (size_t i = 0; i < ctx.size(); ++i) {
+    EXPECT_EQ(scalars[i], ctx.scalars[i].ToString());
+  }
+  EXPECT_EQ("scalar_50", ctx.scalars[0].ToString());
+  EXPECT_TRUE(ctx.scalars[1].empty());
+
+  // 再次搜索复用 ctx 的缓冲区
+  const int64_t *ids_data = ctx.ids.data();
+  const float *distances_data = ctx.distances.data();
+  ASSERT_EQ(vectordb::RET_OK,
+            table.Search(std::vector<float>(16, 120.0f), 10, ctx));
+  ASSERT_EQ(10u, ctx.size());
+  EXPECT_EQ(120, ctx.ids[0]);
+  EXPECT_EQ("scalar_120", ctx.scalars[0].ToString());
+  EXPECT_EQ(ids_data, ctx.ids.data());
+  EXPECT_EQ(distances_data, ctx.distances.data());
+
+  ctx.Reset();
+  EXPECT_EQ(0u, ctx.size());
+}
+
+// 开启 profile 时结果不变，并统计分片遍历的工作量
+TEST(TableTest, SearchProfile) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.set_shard_num(2);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(16);
+  hnsw_param.set_max_elements(10000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+
+  for (int64_t id = 0; id < 500; ++id) {
+    std::vector<float> vector(16, static_cast<float>(id));
+    ASSERT_EQ(vectordb::RET_OK,
+              table.Add(id, vector, "scalar_" + std::to_string(id)));
+  }
+
+  std::vector<float> query(16, 70.2f);
+  vectordb::SearchContext ctx;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(query, 10, ctx));
+  std::vector<int64_t> ids = ctx.ids;
+
+  vectordb::SearchProfile profile;
+  vectordb::ROptions options;
+  options.profile = &profile;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(query, 10, ctx, options));
+  EXPECT_EQ(ids, ctx.ids);
+  EXPECT_EQ("scalar_70", ctx.scalars[0].ToString());
+
+  std::vector<int32_t> index_ids = table.IndexIDs();
+  ASSERT_FALSE(index_ids.empty());
+  EXPECT_EQ(*std::max_element(index_ids.begin(), index_ids.end()),
+            profile.index_id);
+  EXPECT_GT(profile.hops, 0);
+  EXPECT_GE(profile.distance_computations, profile.visited);
+  EXPECT_GE(profile.visited, 10);
+  EXPECT_EQ(0, profile.filter_rejections);
+  EXPECT_GE(profile.traversal_us, 0);
+  EXPECT_TRUE(profile.ToJson().contains("scalar_us"));
+
+  // 每次搜索重新统计
+  int64_t visited = profile.visited;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(query, 10, ctx, options));
+  EXPECT_EQ(visited, profile.visited);
+}
+
+// pq 索引取 k * rerank 个候选，再按 vector 列族中的原始向量重排
+TEST(TableTest, SearchRerank) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.mutable_default_index_info()->set_index_type(vectordb::INDEX_TYPE_PQ);
+  vdb::PqParam* pq_param =
+      param.mutable_default_index_info()->mutable_pq_param();
+  pq_param->set_dim(16);
+  pq_param->set_max_elements(10000);
+  pq_param->set_m(4);
+  pq_param->set_train_size(500);
+  pq_param->set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  vectordb::Table table(param);
+
+  for (int64_t id = 0; id < 1000; ++id) {
+    std::vector<float> vector(16);
+    for (int32_t i = 0; i < 16; ++i) {
+      vector[i] = static_cast<float>((id * 31 + i * 17) % 97);
+    }
+    ASSERT_EQ(vectordb::RET_OK,
+              table.Add(id, vector, "scalar_" + std::to_string(id)));
+  }
+
+  std::vector<float> query(16);
+  for (int32_t i = 0; i < 16; ++i) {
+    query[i] = static_cast<float>((123 * 31 + i * 17) % 97);
+  }
+  vectordb::ROptions options;
+  options.rerank = 10;
+  vectordb::SearchContext ctx;
+  ASSERT_EQ(vectordb::RET_OK, table.Search(query, 5, ctx, options));
+  ASSERT_EQ(5u, ctx.size());
+  EXPECT_EQ(123, ctx.ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, ctx.distances[0]);
+  EXPECT_EQ("scalar_123", ctx.scalars[0].ToString());
+  EXPECT_TRUE(std::is_sorted(ctx.distances.begin(), ctx.distances.end()));
+
+  // 重排后的距离是精确距离
+  std::vector<float> vector;
+  for (size_t i = 0; i < ctx.size(); ++i) {
+    ASSERT_EQ(vectordb::RET_OK, table.Get(ctx.ids[i], vector));
+    float distance = 0;
+    for (int32_t j = 0; j < 16; ++j) {
+      distance += (vector[j] - query[j]) * (vector[j] - query[j]);
+    }
+    EXPECT_FLOAT_EQ(distance, ctx.distances[i]);
+  }
+}
+
+// cosine 表写入时归一化，查询自动归一化，距离是 1 - cos
+TEST(TableTest, Cosine) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(16);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_FLAT);
+  vdb::FlatParam* flat_param =
+      param.mutable_default_index_info()->mutable_flat_param();
+  flat_param->set_dim(16);
+  flat_param->set_max_elements(10000);
+  flat_param->set_distance_type(vectordb::DISTANCE_TYPE_COSINE);
+  vectordb::Table table(param);
+
+  for (int64_t id = 0; id < 50; ++id) {
+    std::vector<float> vector(16);
+    for (int32_t i = 0; i < 16; ++i) {
+      vector[i] = static_cast<float>((id * 7 + i * 3) % 11) + 1.0f;
+    }
+    std::vector<float> copy = vector;
+    ASSERT_EQ(vectordb::RET_OK, table.Add(id, vector));
+    EXPECT_EQ(copy, vector);
+  }
+
+  std::vector<float> stored;
+  ASSERT_EQ(vectordb::RET_OK, table.Get(7, stored));
+  EXPECT_NEAR(1.0f, vectordb::Norm(stored), 1e-5);
+
+  // 放大后的查询与原向量的 cos 为 1
+  std::vector<float> query(16);
+  for (int32_t i = 0; i < 16; ++i) {
+    query[i] = 100.0f * (static_cast<float>((7 * 7 + i * 3) % 11) + 1.0f);
+  }
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  ASSERT_EQ(vectordb::RET_OK,
+            table.Search(query, 3, ids, distances, scalars));
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ(7, ids[0]);
+  EXPECT_NEAR(0.0f, distances[0], 1e-5);
+  EXPECT_GT(distances[1], 0.0f);
+  EXPECT_LE(distances[2], 2.0f);
+
+  // 存储的向量已经归一化，可以再建 cosine 索引
+  vdb::FlatParam cosine_param = *flat_param;
+  EXPECT_EQ(vectordb::RET_OK, table.BuildIndex(cosine_param));
+}
+
+// hamming 表按位打包存储，距离是不同的位数
+TEST(TableTest, Hamming) {
+  fs::remove_all(kTestDir);
+
+  vdb::TableParam param;
+  param.set_path(kTestDir);
+  param.set_name("test_table");
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.set_dim(256);
+  param.mutable_default_index_info()->set_index_type(
+      vectordb::INDEX_TYPE_HNSW);
+  vdb::HnswParam hnsw_param = vectordb::DefaultHnswParam(256);
+  hnsw_param.set_max_elements(10000);
+  hnsw_param.set_distance_type(vectordb::DISTANCE_TYPE_HAMMING);
+  param.mutable_default_index_info()->mutable_hnsw_param()->CopyFrom(
+      hnsw_param);
+  vectordb::Table table(param);
+  EXPECT_TRUE(table.binary());
+
+  // id 的第 i 个字节取 id + i，相邻 id 的向量差别小
+  auto bits_of = [](int64_t id) {
+    std::vector<uint8_t> bits(32);
+    for (size_t i = 0; i < bits.size(); ++i) {
+      bits[i] = static_cast<uint8_t>(id + i);
+    }
+    return bits;
+  };
+  for (int64_t id = 0; id < 100; ++id) {
+    ASSERT_EQ(vectordb::RET_OK,
+              table.Add(id, bits_of(id), "scalar_" + std::to_string(id)));
+  }
+  EXPECT_EQ(vectordb::RET_ERROR,
+            table.Add(100, std::vector<uint8_t>(16), "short"));
+  // 二值表不能归一化
+  std::vector<float> unpacked(256, 1.0f);
+  EXPECT_EQ(vectordb::RET_ERROR,
+            table.Add(100, unpacked, "normalized", vectordb::WOptions(), true));
+
+  std::vector<uint8_t> bits;
+  ASSERT_EQ(vectordb::RET_OK, table.Get(42, bits));
+  EXPECT_EQ(bits_of(42), bits);
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  ASSERT_EQ(vectordb::RET_OK,
+            table.Search(bits_of(42), 3, ids, distances, scalars));
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ(42, ids[0]);
+  EXPECT_FLOAT_EQ(0.0f, distances[0]);
+  EXPECT_EQ("scalar_42", scalars[0]);
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+  EXPECT_EQ(vectordb::Hamming(bits_of(42), bits_of(ids[1])), distances[1]);
+
+  // float 参数的索引不能建在二进制表上
+  EXPECT_EQ(vectordb::RET_ERROR,
+            table.BuildIndex(vectordb::DefaultHnswParam(256)));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,61 @@
+#ifndef VECTORDB_TEST_UTIL_H
+#define VECTORDB_TEST_UTIL_H
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "common.h"
+#include "ground_truth.h"
+
+// Helpers shared by the index and segment tests.
+
+namespace vectordb {
+
+// n vectors with coordinates uniform in [lo, hi), the same seed gives the
+// same vectors
+inline std::vector<std::vector<float>> RandomVectors(int32_t n, int32_t dim,
+                                                     uint32_t seed = 1,
+                                                     float lo = -1.0f,
+                                                     float hi = 1.0f) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> dist(lo, hi);
+  std::vector<std::vector<float>> vectors(n, std::vector<float>(dim));
+  for (auto &vector : vectors) {
+    for (auto &x : vector) {
+      x = dist(rng);
+    }
+  }
+  return vectors;
+}
+
+// exact l2 top-k of query among base, the id of base[i] is i
+inline std::set<int64_t> BruteForce(
+    const std::vector<std::vector<float>> &base,
+    const std::vector<float> &query, int32_t k) {
+  int32_t dim = query.size();
+  std::vector<float> flat;
+  std::vector<int64_t> base_ids;
+  flat.reserve(base.size() * dim);
+  for (size_t i = 0; i < base.size(); ++i) {
+    flat.insert(flat.end(), base[i].begin(), base[i].end());
+    base_ids.push_back(i);
+  }
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  ExactKnn(DISTANCE_TYPE_L2, dim, flat, base_ids, query, k, 1, ids,
+           distances);
+  std::set<int64_t> result;
+  for (int64_t id : ids) {
+    if (id >= 0) {
+      result.insert(id);
+    }
+  }
+  return result;
+}
+
+}  // namespace vectordb
+
+#endif  // VECTORDB_TEST_UTIL_H
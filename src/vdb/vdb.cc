@@ -79,6 +79,16 @@ RetNo Vdb::CreateTable(const std::string &name, int32_t dim) {
 
 RetNo Vdb::CreateTable(const std::string &name,
                        const vdb::IndexInfo &default_index_info) {
+  vdb::TableInfo table_info;
+  table_info.set_name(name);
+  table_info.mutable_default_index_info()->CopyFrom(default_index_info);
+  return CreateTable(table_info);
+}
+
+RetNo Vdb::CreateTable(const vdb::TableInfo &table_info) {
+  const std::string &name = table_info.name();
+  const vdb::IndexInfo &default_index_info = table_info.default_index_info();
+
   vdb::TableParam param;
   param.set_path(param_.path() + "/" + name);
   param.set_name(name);
@@ -92,11 +102,23 @@ RetNo Vdb::CreateTable(const std::string &name,
     case INDEX_TYPE_HNSW:
       dim = default_index_info.hnsw_param().dim();
       break;
+    case INDEX_TYPE_DISKANN:
+      dim = default_index_info.diskann_param().dim();
+      break;
+    case INDEX_TYPE_PQ:
+      dim = default_index_info.pq_param().dim();
+      break;
     default:
       return RET_ERROR;
   }
+  if (!ValidIndexInfo(default_index_info)) {
+    logger->warn("invalid index info for table {}", name);
+    return RET_ERROR;
+  }
   param.set_dim(dim);
   param.mutable_default_index_info()->CopyFrom(default_index_info);
+  param.mutable_segment_param()->CopyFrom(table_info.segment_param());
+  param.set_shard_num(table_info.shard_num());
 
   if (tables_.find(param.name()) != tables_.end()) {
     logger->warn("table {} already exists", param.name());
@@ -174,6 +196,16 @@ RetNo Vdb::Add(const std::string &table_name, int64_t id,
   return Add(table_name, id, vector, "", options, normalize);
 }
 
+RetNo Vdb::Add(const std::string &table_name, int64_t id,
+               const std::vector<uint8_t> &bits, const std::string &scalar,
+               const WOptions &options) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    return RET_ERROR;
+  }
+  return table->Add(id, bits, scalar, options);
+}
+
 RetNo Vdb::Get(const std::string &table_name, int64_t id,
                std::vector<float> &vector, std::string &scalar) {
   TableSPtr table = GetTable(table_name);
@@ -206,6 +238,17 @@ RetNo Vdb::Get(const std::string &table_name, int64_t id, std::string &scalar) {
   return table->Get(id, scalar);
 }
 
+RetNo Vdb::Get(const std::string &table_name, int64_t id,
+               std::vector<uint8_t> &bits) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->Get(id, bits);
+}
+
 RetNo Vdb::Search(const std::string &table_name, const std::vector<float> &v,
                   int32_t k, std::vector<int64_t> &ids,
                   std::vector<float> &distances,
@@ -221,6 +264,32 @@ RetNo Vdb::Search(const std::string &table_name, const std::vector<float> &v,
   return table->Search(v, k, ids, distances, scalars, options, index_id);
 }
 
+RetNo Vdb::Search(const std::string &table_name, const std::vector<float> &v,
+                  int32_t k, SearchContext &ctx, const ROptions &options,
+                  int32_t index_id) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->Search(v, k, ctx, options, index_id);
+}
+
+RetNo Vdb::Search(const std::string &table_name,
+                  const std::vector<uint8_t> &bits, int32_t k,
+                  std::vector<int64_t> &ids, std::vector<float> &distances,
+                  std::vector<std::string> &scalars, const ROptions &options,
+                  int32_t index_id) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->Search(bits, k, ids, distances, scalars, options, index_id);
+}
+
 RetNo Vdb::Search(const std::string &table_name, int64_t id, int32_t k,
                   std::vector<int64_t> &ids, std::vector<float> &distances,
                   std::vector<std::string> &scalars, const ROptions &options,
@@ -235,6 +304,46 @@ RetNo Vdb::Search(const std::string &table_name, int64_t id, int32_t k,
   return table->Search(id, k, ids, distances, scalars, options, index_id);
 }
 
+RetNo Vdb::RangeSearch(const std::string &table_name,
+                       const std::vector<float> &v, float radius,
+                       int32_t max_results, std::vector<int64_t> &ids,
+                       std::vector<float> &distances,
+                       std::vector<std::string> &scalars,
+                       const ROptions &options, int32_t index_id) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->RangeSearch(v, radius, max_results, ids, distances, scalars,
+                            options, index_id);
+}
+
+RetNo Vdb::RangeSearch(const std::string &table_name,
+                       const std::vector<float> &v, float radius,
+                       const RangeCallback &callback, const ROptions &options,
+                       int32_t index_id) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->RangeSearch(v, radius, callback, options, index_id);
+}
+
+RetNo Vdb::Import(const std::string &table_name, const std::string &file,
+                  const ImportParam &param) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    logger->warn("table {} not found", table_name);
+    return RET_NOT_FOUND;
+  }
+
+  return table->Import(file, param);
+}
+
 RetNo Vdb::BuildIndex(const std::string &table_name) {
   TableSPtr table = GetTable(table_name);
   if (table == nullptr) {
@@ -264,6 +373,14 @@ RetNo Vdb::BuildIndex(const std::string &table_name,
       ret = table->BuildIndex(param.hnsw_param());
       break;
     }
+    case INDEX_TYPE_DISKANN: {
+      ret = table->BuildIndex(param.diskann_param());
+      break;
+    }
+    case INDEX_TYPE_PQ: {
+      ret = table->BuildIndex(param.pq_param());
+      break;
+    }
     default: {
       logger->error("invalid index type: {}", param.index_type());
       return RET_ERROR;
@@ -315,6 +432,30 @@ RetNo Vdb::Persist() {
   return RET_OK;
 }
 
+RetNo Vdb::Checkpoint(const std::string &dir) {
+  fs::create_directories(dir);
+  for (const auto &table : tables_) {
+    RetNo ret = table.second->Checkpoint(dir + "/" + table.first);
+    if (ret != RET_OK) {
+      logger->error("checkpoint table {} failed, ret: {}", table.first,
+                    RetNoToString(ret));
+      return ret;
+    }
+  }
+  return RET_OK;
+}
+
+json Vdb::Stats() const {
+  json j;
+  j["version"] = kVersion;
+  j["name"] = param_.name();
+  j["tables"] = json::object();
+  for (const auto &table : tables_) {
+    j["tables"][table.first] = table.second->Stats();
+  }
+  return j;
+}
+
 RetNo Vdb::Persist(const std::string &table_name) {
   TableSPtr table = GetTable(table_name);
   if (table == nullptr) {
@@ -324,4 +465,12 @@ RetNo Vdb::Persist(const std::string &table_name) {
   return table->Persist();
 }
 
+RetNo Vdb::SyncWal(const std::string &table_name) {
+  TableSPtr table = GetTable(table_name);
+  if (table == nullptr) {
+    return RET_NOT_FOUND;
+  }
+  return table->SyncWal();
+}
+
 }  // namespace vectordb
\ No newline at end of file
@@ -28,6 +28,7 @@ class Vdb final {
   RetNo CreateTable(const std::string &name, int32_t dim);
   RetNo CreateTable(const std::string &name,
                     const vdb::IndexInfo &default_index_info);
+  RetNo CreateTable(const vdb::TableInfo &table_info);
   RetNo DropTable(const std::string &name, bool delete_data = false);
 
   RetNo Add(const std::string &table_name, int64_t id,
@@ -38,6 +39,11 @@ class Vdb final {
             std::vector<float> &vector, const WOptions &options = WOptions(),
             bool normalize = false);
 
+  // binary vector of a hamming table, bits.size() * 8 == dim
+  RetNo Add(const std::string &table_name, int64_t id,
+            const std::vector<uint8_t> &bits, const std::string &scalar,
+            const WOptions &options = WOptions());
+
   // input: id
   // output: vector, scalar
   RetNo Get(const std::string &table_name, int64_t id,
@@ -52,6 +58,11 @@ class Vdb final {
   // output: scalar
   RetNo Get(const std::string &table_name, int64_t id, std::string &scalar);
 
+  // input: id
+  // output: bits, binary vector of a hamming table
+  RetNo Get(const std::string &table_name, int64_t id,
+            std::vector<uint8_t> &bits);
+
   // input: v, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -60,6 +71,20 @@ class Vdb final {
                std::vector<float> &distances, std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, k
+  // output: ctx.ids, ctx.distances, ctx.scalars, see SearchContext
+  RetNo Search(const std::string &table_name, const std::vector<float> &v,
+               int32_t k, SearchContext &ctx,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
+  // input: bits, k
+  // output: ids, distances (number of different bits), scalars
+  // binary query of a hamming table
+  RetNo Search(const std::string &table_name, const std::vector<uint8_t> &bits,
+               int32_t k, std::vector<int64_t> &ids,
+               std::vector<float> &distances, std::vector<std::string> &scalars,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
   // input: id, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -68,6 +93,28 @@ class Vdb final {
                std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, radius
+  // output: ids, distances, scalars of all vectors with distance <= radius,
+  // sorted, at most max_results (<= 0 means no limit) closest ones
+  // index_id: -1 means the newest index
+  RetNo RangeSearch(const std::string &table_name, const std::vector<float> &v,
+                    float radius, int32_t max_results,
+                    std::vector<int64_t> &ids, std::vector<float> &distances,
+                    std::vector<std::string> &scalars,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
+  // input: v, radius
+  // output: ids and distances streamed to callback, no scalars
+  RetNo RangeSearch(const std::string &table_name, const std::vector<float> &v,
+                    float radius, const RangeCallback &callback,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
+  // bulk load a fvecs/npy/raw file into the table
+  RetNo Import(const std::string &table_name, const std::string &file,
+               const ImportParam &param = ImportParam());
+
   RetNo BuildIndex(const std::string &table_name);
 
   RetNo BuildIndex(const std::string &table_name, const vdb::IndexInfo &param);
@@ -83,6 +130,13 @@ class Vdb final {
 
   RetNo Persist();
   RetNo Persist(const std::string &table_name);
+  RetNo SyncWal(const std::string &table_name);
+
+  // copy every table into dir/<table>, see Table::Checkpoint
+  RetNo Checkpoint(const std::string &dir);
+
+  // metrics of all tables and their indexes
+  json Stats() const;
 
  private:
   void Init();
@@ -68,12 +68,43 @@ RetNo Vectordb::Load() {
   InitLogger(log_path_ + "/vectordb.log");
 
   vdb::DBParam param = LoadMeta();
+  bool moved = !param.path().empty() && param.path() != data_path_;
+  if (moved) {
+    Relocate(param);
+  }
   vdb_ = std::make_shared<Vdb>(param);
+  if (moved) {
+    RetNo ret = PersistMeta();
+    if (ret != RET_OK) {
+      return ret;
+    }
+  }
 
   logger->info("load vectordb ok");
   return RET_OK;
 }
 
+void Vectordb::Relocate(vdb::DBParam &param) const {
+  // 元数据里保存的是绝对路径，目录整体移动后（比如安装了 raft 快照）
+  // 把旧的前缀换成当前位置
+  const std::string old_path = param.path();
+  auto relocate = [&](const std::string &path) {
+    if (path.compare(0, old_path.size(), old_path) != 0) {
+      return path;
+    }
+    return data_path_ + path.substr(old_path.size());
+  };
+
+  logger->info("vectordb moved from {} to {}", old_path, data_path_);
+  param.set_path(data_path_);
+  for (auto &table : *param.mutable_tables()) {
+    table.set_path(relocate(table.path()));
+    for (auto &index : *table.mutable_indexes()) {
+      index.set_path(relocate(index.path()));
+    }
+  }
+}
+
 void Vectordb::Prepare() {
   assert(!fs::exists(path_));
   fs::create_directories(path_);
@@ -136,6 +167,15 @@ RetNo Vectordb::CreateTable(const std::string &name,
   return PersistMeta();
 }
 
+RetNo Vectordb::CreateTable(const vdb::TableInfo &table_info) {
+  RetNo ret = vdb_->CreateTable(table_info);
+  if (ret != RET_OK) {
+    logger->error("create table failed, ret: {}", RetNoToString(ret));
+    return ret;
+  }
+  return PersistMeta();
+}
+
 RetNo Vectordb::DropTable(const std::string &name, bool delete_data) {
   RetNo ret = vdb_->DropTable(name, delete_data);
   if (ret != RET_OK) {
@@ -157,6 +197,12 @@ RetNo Vectordb::Add(const std::string &table_name, int64_t id,
   return vdb_->Add(table_name, id, vector, options, normalize);
 }
 
+RetNo Vectordb::Add(const std::string &table_name, int64_t id,
+                    const std::vector<uint8_t> &bits,
+                    const std::string &scalar, const WOptions &options) {
+  return vdb_->Add(table_name, id, bits, scalar, options);
+}
+
 // input: id
 // output: vector, scalar
 RetNo Vectordb::Get(const std::string &table_name, int64_t id,
@@ -178,6 +224,13 @@ RetNo Vectordb::Get(const std::string &table_name, int64_t id,
   return vdb_->Get(table_name, id, scalar);
 }
 
+// input: id
+// output: bits
+RetNo Vectordb::Get(const std::string &table_name, int64_t id,
+                    std::vector<uint8_t> &bits) {
+  return vdb_->Get(table_name, id, bits);
+}
+
 // input: v, k
 // output: ids, distances, scalars
 // index_id: -1 means the newest index
@@ -190,6 +243,28 @@ RetNo Vectordb::Search(const std::string &table_name,
                       index_id);
 }
 
+// input: v, k
+// output: ctx.ids, ctx.distances, ctx.scalars
+// index_id: -1 means the newest index
+RetNo Vectordb::Search(const std::string &table_name,
+                       const std::vector<float> &v, int32_t k,
+                       SearchContext &ctx, const ROptions &options,
+                       int32_t index_id) {
+  return vdb_->Search(table_name, v, k, ctx, options, index_id);
+}
+
+// input: bits, k
+// output: ids, distances, scalars
+// index_id: -1 means the newest index
+RetNo Vectordb::Search(const std::string &table_name,
+                       const std::vector<uint8_t> &bits, int32_t k,
+                       std::vector<int64_t> &ids, std::vector<float> &distances,
+                       std::vector<std::string> &scalars,
+                       const ROptions &options, int32_t index_id) {
+  return vdb_->Search(table_name, bits, k, ids, distances, scalars, options,
+                      index_id);
+}
+
 // input: id, k
 // output: ids, distances, scalars
 // index_id: -1 means the newest index
@@ -201,6 +276,34 @@ RetNo Vectordb::Search(const std::string &table_name, int64_t id, int32_t k,
                       index_id);
 }
 
+RetNo Vectordb::RangeSearch(const std::string &table_name,
+                            const std::vector<float> &v, float radius,
+                            int32_t max_results, std::vector<int64_t> &ids,
+                            std::vector<float> &distances,
+                            std::vector<std::string> &scalars,
+                            const ROptions &options, int32_t index_id) {
+  return vdb_->RangeSearch(table_name, v, radius, max_results, ids, distances,
+                           scalars, options, index_id);
+}
+
+RetNo Vectordb::RangeSearch(const std::string &table_name,
+                            const std::vector<float> &v, float radius,
+                            const RangeCallback &callback,
+                            const ROptions &options, int32_t index_id) {
+  return vdb_->RangeSearch(table_name, v, radius, callback, options,
+                           index_id);
+}
+
+RetNo Vectordb::Import(const std::string &table_name, const std::string &file,
+                       const ImportParam &param) {
+  RetNo ret = vdb_->Import(table_name, file, param);
+  if (ret != RET_OK) {
+    logger->error("import failed, ret: {}", RetNoToString(ret));
+    return ret;
+  }
+  return PersistMeta();
+}
+
 RetNo Vectordb::BuildIndex(const std::string &table_name) {
   RetNo ret = vdb_->BuildIndex(table_name);
   if (ret != RET_OK) {
@@ -244,4 +347,39 @@ RetNo Vectordb::Persist(const std::string &table_name) {
   return vdb_->Persist(table_name);
 }
 
+RetNo Vectordb::SyncWal(const std::string &table_name) {
+  return vdb_->SyncWal(table_name);
+}
+
+RetNo Vectordb::Checkpoint(const std::string &dir) {
+  if (fs::exists(dir)) {
+    logger->error("checkpoint dir {} already exists", dir);
+    return RET_ERROR;
+  }
+
+  fs::create_directories(dir + "/log");
+  RetNo ret = vdb_->Checkpoint(dir + "/data");
+  if (ret != RET_OK) {
+    return ret;
+  }
+
+  // 元数据最后复制，其中的表一定都已经在 data 里
+  ret = CheckpointRocksdb(meta_.get(), dir + "/meta");
+  if (ret != RET_OK) {
+    logger->error("checkpoint meta failed, ret: {}", RetNoToString(ret));
+    return ret;
+  }
+
+  logger->info("checkpoint vectordb to {} ok", dir);
+  return RET_OK;
+}
+
+std::string Vectordb::Stats(StatsFormat format) const {
+  json stats = vdb_->Stats();
+  if (format == STATS_FORMAT_PROMETHEUS) {
+    return StatsToPrometheus(stats);
+  }
+  return stats.dump(2);
+}
+
 }  // namespace vectordb
\ No newline at end of file
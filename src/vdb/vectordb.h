@@ -18,6 +18,7 @@ class Vectordb {
   RetNo CreateTable(const std::string &name, int32_t dim);
   RetNo CreateTable(const std::string &name,
                     const vdb::IndexInfo &default_index_info);
+  RetNo CreateTable(const vdb::TableInfo &table_info);
   RetNo DropTable(const std::string &name, bool delete_data = false);
 
   RetNo Add(const std::string &table_name, int64_t id,
@@ -28,6 +29,11 @@ class Vectordb {
             std::vector<float> &vector, const WOptions &options = WOptions(),
             bool normalize = false);
 
+  // binary vector of a hamming table, bits.size() * 8 == dim
+  RetNo Add(const std::string &table_name, int64_t id,
+            const std::vector<uint8_t> &bits, const std::string &scalar,
+            const WOptions &options = WOptions());
+
   // input: id
   // output: vector, scalar
   RetNo Get(const std::string &table_name, int64_t id,
@@ -42,6 +48,11 @@ class Vectordb {
   // output: scalar
   RetNo Get(const std::string &table_name, int64_t id, std::string &scalar);
 
+  // input: id
+  // output: bits, binary vector of a hamming table
+  RetNo Get(const std::string &table_name, int64_t id,
+            std::vector<uint8_t> &bits);
+
   // input: v, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -50,6 +61,22 @@ class Vectordb {
                std::vector<float> &distances, std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, k
+  // output: ctx.ids, ctx.distances, ctx.scalars
+  // reuse ctx across searches to avoid allocations, scalars are pinned
+  // slices valid until the next search with ctx, see SearchContext
+  RetNo Search(const std::string &table_name, const std::vector<float> &v,
+               int32_t k, SearchContext &ctx,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
+  // input: bits, k
+  // output: ids, distances (number of different bits), scalars
+  // binary query of a hamming table
+  RetNo Search(const std::string &table_name, const std::vector<uint8_t> &bits,
+               int32_t k, std::vector<int64_t> &ids,
+               std::vector<float> &distances, std::vector<std::string> &scalars,
+               const ROptions &options = ROptions(), int32_t index_id = -1);
+
   // input: id, k
   // output: ids, distances, scalars
   // index_id: -1 means the newest index
@@ -58,6 +85,28 @@ class Vectordb {
                std::vector<std::string> &scalars,
                const ROptions &options = ROptions(), int32_t index_id = -1);
 
+  // input: v, radius
+  // output: ids, distances, scalars of all vectors with distance <= radius,
+  // sorted, at most max_results (<= 0 means no limit) closest ones
+  // index_id: -1 means the newest index
+  RetNo RangeSearch(const std::string &table_name, const std::vector<float> &v,
+                    float radius, int32_t max_results,
+                    std::vector<int64_t> &ids, std::vector<float> &distances,
+                    std::vector<std::string> &scalars,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
+  // input: v, radius
+  // output: ids and distances streamed to callback, no scalars
+  RetNo RangeSearch(const std::string &table_name, const std::vector<float> &v,
+                    float radius, const RangeCallback &callback,
+                    const ROptions &options = ROptions(),
+                    int32_t index_id = -1);
+
+  // bulk load a fvecs/npy/raw file into the table
+  RetNo Import(const std::string &table_name, const std::string &file,
+               const ImportParam &param = ImportParam());
+
   RetNo BuildIndex(const std::string &table_name);
 
   RetNo BuildIndex(const std::string &table_name, const vdb::IndexInfo &param);
@@ -74,6 +123,17 @@ class Vectordb {
   RetNo Persist();
   RetNo Persist(const std::string &table_name);
 
+  // make the writes to the table durable, see WOptions::sync
+  RetNo SyncWal(const std::string &table_name);
+
+  // copy the whole db into dir, which must not exist, writes must be
+  // stopped meanwhile. A Vectordb opened at dir sees the same data, like
+  // any db directory moved to a new place.
+  RetNo Checkpoint(const std::string &dir);
+
+  // json, or prometheus text exposition format
+  std::string Stats(StatsFormat format = STATS_FORMAT_JSON) const;
+
  private:
   void Init();
   RetNo New();
@@ -82,6 +142,7 @@ class Vectordb {
 
   RetNo PersistMeta();
   vdb::DBParam LoadMeta();
+  void Relocate(vdb::DBParam &param) const;
 
  private:
   std::string name_;
@@ -94,6 +155,8 @@ class Vectordb {
   std::shared_ptr<rocksdb::DB> meta_;
 };
 
+using VectordbSPtr = std::shared_ptr<Vectordb>;
+
 }  // namespace vectordb
 
 #endif  // VECTORDB_VECTORDB_H
\ No newline at end of file
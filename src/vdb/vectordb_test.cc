@@ -205,6 +205,100 @@ TEST(VectordbTest, CreateTablesAndSearch) {
   fs::remove_all(kTestDir);
 }
 
+// 测试 Stats
+TEST(VectordbTest, Stats) {
+  fs::remove_all(kTestDir);
+
+  vectordb::Vectordb db("test_stats_db", kTestDir);
+  std::string table_name = "stats_table";
+  EXPECT_EQ(vectordb::RET_OK, db.CreateTable(table_name, 4));
+
+  for (int64_t i = 0; i < 10; ++i) {
+    std::vector<float> v = {i * 1.0f, i * 2.0f, i * 3.0f, i * 4.0f};
+    EXPECT_EQ(vectordb::RET_OK, db.Add(table_name, i, v, "scalar"));
+  }
+
+  std::vector<float> v;
+  EXPECT_EQ(vectordb::RET_OK, db.Get(table_name, 1, v));
+  EXPECT_EQ(vectordb::RET_NOT_FOUND, db.Get(table_name, 100, v));
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  EXPECT_EQ(vectordb::RET_OK,
+            db.Search(table_name, v, 3, ids, distances, scalars));
+
+  json stats = json::parse(db.Stats());
+  std::cout << stats.dump(2) << std::endl;
+  const json &table = stats["tables"][table_name];
+  EXPECT_EQ(table["ops"]["add"]["count"].get<uint64_t>(), 10u);
+  EXPECT_EQ(table["ops"]["get"]["count"].get<uint64_t>(), 2u);
+  EXPECT_EQ(table["ops"]["get"]["errors"].get<uint64_t>(), 0u);
+  EXPECT_EQ(table["ops"]["search"]["count"].get<uint64_t>(), 1u);
+  EXPECT_EQ(table["ops"]["build_index"]["count"].get<uint64_t>(), 1u);
+  EXPECT_TRUE(table["rocksdb"].contains("vector"));
+  ASSERT_EQ(table["indexes"].size(), 1u);
+  const json &index = table["indexes"].begin().value();
+  EXPECT_EQ(index["size"].get<int32_t>(), 10);
+  EXPECT_GT(index["memory_bytes"].get<int64_t>(), 0);
+  EXPECT_EQ(index["ops"]["search"]["count"].get<uint64_t>(), 1u);
+
+  std::string text = db.Stats(vectordb::STATS_FORMAT_PROMETHEUS);
+  EXPECT_NE(text.find("vdb_table_ops_total{table=\"stats_table\","
+                      "op=\"add\"} 10"),
+            std::string::npos);
+
+  fs::remove_all(kTestDir);
+}
+
+// checkpoint 出来的目录换个位置也能打开，数据和索引都在
+TEST(VectordbTest, Checkpoint) {
+  const std::string checkpoint_dir = kTestDir + "_checkpoint";
+  fs::remove_all(kTestDir);
+  fs::remove_all(checkpoint_dir);
+
+  std::string table_name = "checkpoint_table";
+  std::vector<float> query;
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  std::vector<std::string> scalars;
+  {
+    vectordb::Vectordb db("test_checkpoint_db", kTestDir);
+    EXPECT_EQ(vectordb::RET_OK, db.CreateTable(table_name, 4));
+    for (int64_t i = 0; i < 10; ++i) {
+      std::vector<float> v = {i * 1.0f, i * 2.0f, i * 3.0f, i * 4.0f};
+      EXPECT_EQ(vectordb::RET_OK,
+                db.Add(table_name, i, v, "scalar_" + std::to_string(i)));
+    }
+    EXPECT_EQ(vectordb::RET_OK, db.BuildIndex(table_name));
+
+    query = {1.0f, 2.0f, 3.0f, 4.0f};
+    EXPECT_EQ(vectordb::RET_OK,
+              db.Search(table_name, query, 3, ids, distances, scalars));
+    EXPECT_EQ(vectordb::RET_OK, db.Checkpoint(checkpoint_dir));
+    EXPECT_EQ(vectordb::RET_ERROR, db.Checkpoint(checkpoint_dir));
+  }
+  fs::remove_all(kTestDir);
+
+  vectordb::Vectordb copy("test_checkpoint_db", checkpoint_dir);
+  EXPECT_EQ(copy.Meta().path(), checkpoint_dir + "/data");
+  EXPECT_EQ(copy.IndexIDs(table_name).size(), 1u);
+
+  std::string scalar;
+  EXPECT_EQ(vectordb::RET_OK, copy.Get(table_name, 9, scalar));
+  EXPECT_EQ(scalar, "scalar_9");
+
+  std::vector<int64_t> copy_ids;
+  std::vector<float> copy_distances;
+  std::vector<std::string> copy_scalars;
+  EXPECT_EQ(vectordb::RET_OK, copy.Search(table_name, query, 3, copy_ids,
+                                          copy_distances, copy_scalars));
+  EXPECT_EQ(copy_ids, ids);
+  EXPECT_EQ(copy_scalars, scalars);
+
+  fs::remove_all(checkpoint_dir);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
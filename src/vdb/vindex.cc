@@ -1,12 +1,73 @@
 #include "vindex.h"
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
+#include <memory>
 
+#include "distance.h"
 #include "pb2json.h"
+#include "search_profile.h"
 #include "util.h"
 
 namespace vectordb {
 
+namespace {
+
+using Node = SearchScratch::Node;
+
+// candidates 是按距离的最小堆，top 是最大堆
+void PushCandidate(std::vector<Node> &heap, float distance, int64_t id) {
+  heap.emplace_back(distance, id);
+  std::push_heap(heap.begin(), heap.end(), std::greater<Node>());
+}
+
+void PopCandidate(std::vector<Node> &heap) {
+  std::pop_heap(heap.begin(), heap.end(), std::greater<Node>());
+  heap.pop_back();
+}
+
+void PushTop(std::vector<Node> &heap, float distance, int64_t id) {
+  heap.emplace_back(distance, id);
+  std::push_heap(heap.begin(), heap.end());
+}
+
+void PopTop(std::vector<Node> &heap) {
+  std::pop_heap(heap.begin(), heap.end());
+  heap.pop_back();
+}
+
+// 没有传入 scratch 的搜索借用本线程的 scratch，用完归还。
+// range search 的 visitor 可能在同一线程上再次搜索，所以是一个栈
+class ScratchLease {
+ public:
+  ScratchLease() {
+    auto &pool = Pool();
+    if (pool.empty()) {
+      scratch_ = std::make_unique<SearchScratch>();
+    } else {
+      scratch_ = std::move(pool.back());
+      pool.pop_back();
+    }
+  }
+  ~ScratchLease() { Pool().push_back(std::move(scratch_)); }
+
+  ScratchLease(const ScratchLease &) = delete;
+  ScratchLease &operator=(const ScratchLease &) = delete;
+
+  SearchScratch &get() { return *scratch_; }
+
+ private:
+  static std::vector<std::unique_ptr<SearchScratch>> &Pool() {
+    thread_local std::vector<std::unique_ptr<SearchScratch>> pool;
+    return pool;
+  }
+
+  std::unique_ptr<SearchScratch> scratch_;
+};
+
+}  // namespace
+
 VIndex::VIndex(const vdb::IndexParam &param)
     : data_path_(param.path() + "/data"),
       description_file_(param.path() + "/description.json"),
@@ -52,6 +113,41 @@ void VIndex::Prepare() {
 }
 
 RetNo VIndex::Add(int64_t id, const std::vector<float> &vector) {
+  OpTimer timer(metrics_.add);
+  return timer.Done(DoAdd(id, vector));
+}
+
+RetNo VIndex::Reserve(int64_t n) {
+  switch (param_.index_info().index_type()) {
+    case INDEX_TYPE_FLAT: {
+      hnswlib::BruteforceSearch<float> *flat_index =
+          static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+      if (flat_index->cur_element_count + n > flat_index->maxelements_) {
+        return RET_ERROR;
+      }
+      return RET_OK;
+    }
+
+    case INDEX_TYPE_HNSW: {
+      hnswlib::HierarchicalNSW<float> *hnsw_index =
+          static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+      size_t need = hnsw_index->getCurrentElementCount() + n;
+      if (need > hnsw_index->max_elements_) {
+        hnsw_index->resizeIndex(need);
+        param_.mutable_index_info()->mutable_hnsw_param()->set_max_elements(
+            need);
+      }
+      return RET_OK;
+    }
+
+    default: {
+      // diskann 和 pq 新增的向量暂存在内存中，没有容量限制
+      return RET_OK;
+    }
+  }
+}
+
+RetNo VIndex::DoAdd(int64_t id, const std::vector<float> &vector) {
   switch (param_.index_info().index_type()) {
     case INDEX_TYPE_FLAT:
     case INDEX_TYPE_HNSW: {
@@ -60,6 +156,16 @@ RetNo VIndex::Add(int64_t id, const std::vector<float> &vector) {
       return RET_OK;
     }
 
+    case INDEX_TYPE_DISKANN: {
+      assert(dindex_);
+      return dindex_->Add(id, vector);
+    }
+
+    case INDEX_TYPE_PQ: {
+      assert(pindex_);
+      return pindex_->Add(id, vector);
+    }
+
     default: {
       return RET_ERROR;
     }
@@ -68,7 +174,32 @@ RetNo VIndex::Add(int64_t id, const std::vector<float> &vector) {
 }
 
 RetNo VIndex::Search(const std::vector<float> &vector, int32_t k,
-                     std::vector<int64_t> &ids, std::vector<float> &distances) {
+                     std::vector<int64_t> &ids, std::vector<float> &distances,
+                     const ROptions &options) {
+  OpTimer timer(metrics_.search);
+  ScratchLease lease;
+  return timer.Done(DoSearch(vector, k, ids, distances, lease.get(), options));
+}
+
+RetNo VIndex::Search(const std::vector<float> &vector, int32_t k,
+                     std::vector<int64_t> &ids, std::vector<float> &distances,
+                     SearchScratch &scratch, const ROptions &options) {
+  OpTimer timer(metrics_.search);
+  return timer.Done(DoSearch(vector, k, ids, distances, scratch, options));
+}
+
+RetNo VIndex::DoSearch(const std::vector<float> &vector, int32_t k,
+                       std::vector<int64_t> &ids,
+                       std::vector<float> &distances, SearchScratch &scratch,
+                       const ROptions &options) {
+  // 排队期间已经超时的请求直接丢弃
+  if (options.Expired()) {
+    ids.clear();
+    distances.clear();
+    return RET_TIMEOUT;
+  }
+  ProfileTimer profile_timer(options.profile);
+
   // 检查向量维度
   int32_t dim = 0;
   switch (param_.index_info().index_type()) {
@@ -82,23 +213,70 @@ RetNo VIndex::Search(const std::vector<float> &vector, int32_t k,
       break;
     }
 
+    case INDEX_TYPE_DISKANN: {
+      dim = param_.index_info().diskann_param().dim();
+      break;
+    }
+
+    case INDEX_TYPE_PQ: {
+      dim = param_.index_info().pq_param().dim();
+      break;
+    }
+
     default: {
       return RET_ERROR;
     }
   }
 
+  // 二进制向量按位打包在 float 中
+  dim = VectorSize(dim, IndexDistanceType(param_.index_info()));
   if (vector.size() != static_cast<size_t>(dim)) {
     return RET_ERROR;
   }
 
   int32_t actual_k = std::min(k, Size());
-  std::priority_queue<std::pair<float, size_t>> results;
+  if (actual_k <= 0) {
+    ids.clear();
+    distances.clear();
+    return RET_OK;
+  }
+
+  thread_local std::vector<float> buffer;
+  const float *query = Query(vector, buffer);
+  profile_timer.Lap(&SearchProfile::check_us);
+
+  // diskann 直接返回升序结果，ef 作为候选列表长度，
+  // diskann 和 pq 在自己的循环中检查截止时间和距离计算预算
+  if (param_.index_info().index_type() == INDEX_TYPE_DISKANN) {
+    assert(dindex_);
+    RetNo ret =
+        dindex_->Search(query, actual_k, options.ef, ids, distances, options);
+    profile_timer.Lap(&SearchProfile::traversal_us);
+    return ret;
+  }
 
+  // pq 返回的是近似距离，需要精确排序时由调用方重排
+  if (param_.index_info().index_type() == INDEX_TYPE_PQ) {
+    assert(pindex_);
+    RetNo ret = pindex_->Search(query, actual_k, ids, distances, options);
+    profile_timer.Lap(&SearchProfile::traversal_us);
+    return ret;
+  }
+
+  // 不走 searchKnn：遍历用 scratch 中复用的堆和 visited 数组，
+  // ef 只作用于本次查询，不修改共享的图
+  SearchLimit limit(options);
+  bool exceeded = false;
   switch (param_.index_info().index_type()) {
-    case INDEX_TYPE_FLAT:
+    case INDEX_TYPE_FLAT: {
+      assert(hindex_);
+      exceeded = FlatSearch(query, actual_k, limit, options, scratch);
+      break;
+    }
+
     case INDEX_TYPE_HNSW: {
       assert(hindex_);
-      results = hindex_->searchKnn(vector.data(), actual_k);
+      exceeded = HnswSearch(query, actual_k, limit, options, scratch);
       break;
     }
 
@@ -107,28 +285,401 @@ RetNo VIndex::Search(const std::vector<float> &vector, int32_t k,
     }
   }
 
-  {
-    // 清空输出参数
-    ids.clear();
-    distances.clear();
+  // 最大堆排序后即为距离升序
+  std::vector<Node> &results = scratch.top;
+  std::sort_heap(results.begin(), results.end());
+  ids.resize(results.size());
+  distances.resize(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ids[i] = results[i].second;
+    distances[i] = results[i].first;
+  }
+  profile_timer.Lap(&SearchProfile::traversal_us);
+
+  return exceeded ? RET_PARTIAL : RET_OK;
+}
+
+RetNo VIndex::RangeSearch(const std::vector<float> &vector, float radius,
+                          int32_t max_results, std::vector<int64_t> &ids,
+                          std::vector<float> &distances,
+                          const ROptions &options) {
+  OpTimer timer(metrics_.range_search);
+  ids.clear();
+  distances.clear();
+
+  // 最大堆保留最近的 max_results 个，堆满后用堆顶收紧半径
+  ScratchLease lease;
+  std::vector<Node> &results = lease.get().top;
+  results.clear();
+  RetNo ret = DoRangeSearch(
+      vector, radius,
+      [&results, max_results](int64_t id, float distance, float &r) {
+        PushTop(results, distance, id);
+        if (max_results > 0) {
+          if (results.size() > static_cast<size_t>(max_results)) {
+            PopTop(results);
+          }
+          if (results.size() == static_cast<size_t>(max_results)) {
+            r = results.front().first;
+          }
+        }
+        return true;
+      },
+      options);
+  if (ret != RET_OK) {
+    return timer.Done(ret);
+  }
+
+  std::sort_heap(results.begin(), results.end());
+  ids.resize(results.size());
+  distances.resize(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    ids[i] = results[i].second;
+    distances[i] = results[i].first;
+  }
+  return timer.Done(RET_OK);
+}
+
+RetNo VIndex::RangeSearch(const std::vector<float> &vector, float radius,
+                          const RangeCallback &callback,
+                          const ROptions &options) {
+  OpTimer timer(metrics_.range_search);
+  return timer.Done(DoRangeSearch(
+      vector, radius,
+      [&callback](int64_t id, float distance, float &) {
+        return callback(id, distance);
+      },
+      options));
+}
+
+RetNo VIndex::DoRangeSearch(const std::vector<float> &vector, float radius,
+                            const RangeVisitor &visitor,
+                            const ROptions &options) {
+  if (vector.size() !=
+      static_cast<size_t>(IndexVectorSize(param_.index_info()))) {
+    return RET_ERROR;
+  }
+
+  // visitor 可能在同一线程上再次搜索，不使用 thread_local 的缓冲
+  std::vector<float> buffer;
+  const float *query = Query(vector, buffer);
+  ScratchLease lease;
+
+  switch (param_.index_info().index_type()) {
+    case INDEX_TYPE_FLAT: {
+      assert(hindex_);
+      FlatRangeSearch(query, radius, visitor);
+      return RET_OK;
+    }
 
-    // 预留空间
-    ids.reserve(results.size());
-    distances.reserve(results.size());
+    case INDEX_TYPE_HNSW: {
+      assert(hindex_);
+      HnswRangeSearch(query, radius, visitor, options, lease.get());
+      return RET_OK;
+    }
 
-    // 将结果填充到输出参数中
-    while (!results.empty()) {
-      ids.push_back(results.top().second);
-      distances.push_back(results.top().first);
-      results.pop();
+    default: {
+      return RET_ERROR;
     }
+  }
+}
 
-    // 由于优先队列是最大堆，结果需要反转以保持距离升序
-    std::reverse(ids.begin(), ids.end());
-    std::reverse(distances.begin(), distances.end());
+const float *VIndex::Query(const std::vector<float> &vector,
+                           std::vector<float> &buffer) const {
+  if (IndexDistanceType(param_.index_info()) != DISTANCE_TYPE_COSINE) {
+    return vector.data();
   }
 
-  return RET_OK;
+  // 存储的向量在写入时已经归一化，查询归一化后内积距离就是 1 - cos
+  buffer.resize(vector.size());
+  Normalize(vector.data(), buffer.data(), vector.size());
+  return buffer.data();
+}
+
+bool VIndex::FlatSearch(const float *query, int32_t k, SearchLimit &limit,
+                        const ROptions &options, SearchScratch &scratch) {
+  hnswlib::BruteforceSearch<float> *flat_index =
+      static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+  scratch.Clear();
+  std::vector<Node> &results = scratch.top;
+
+  // 每批检查一次截止时间，避免每个向量都读时钟
+  const size_t kBatch = 1024;
+  size_t count = flat_index->cur_element_count;
+  for (size_t begin = 0; begin < count; begin += kBatch) {
+    size_t end = std::min(count, begin + kBatch);
+    for (size_t i = begin; i < end; ++i) {
+      char *data_ptr = flat_index->data_ + flat_index->size_per_element_ * i;
+      float distance = flat_index->fstdistfunc_(query, data_ptr,
+                                                flat_index->dist_func_param_);
+      if (results.size() < static_cast<size_t>(k) ||
+          distance < results.front().first) {
+        hnswlib::labeltype label;
+        memcpy(&label, data_ptr + flat_index->data_size_, sizeof(label));
+        PushTop(results, distance, label);
+        if (results.size() > static_cast<size_t>(k)) {
+          PopTop(results);
+        }
+      }
+    }
+    if (options.profile) {
+      options.profile->distance_computations += end - begin;
+      options.profile->visited += end - begin;
+    }
+    if (end < count && limit.Exceeded(end - begin)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 本次查询的 ef，未指定时使用图上的默认值
+static size_t QueryEf(const hnswlib::HierarchicalNSW<float> *hnsw_index,
+                      const ROptions &options) {
+  return options.ef > 0 ? static_cast<size_t>(options.ef) : hnsw_index->ef_;
+}
+
+bool VIndex::HnswSearch(const float *query, int32_t k, SearchLimit &limit,
+                        const ROptions &options, SearchScratch &scratch) {
+  hnswlib::HierarchicalNSW<float> *hnsw_index =
+      static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+  scratch.Clear();
+  if (hnsw_index->cur_element_count == 0) {
+    return false;
+  }
+
+  auto distance_to = [hnsw_index, query](hnswlib::tableint id) {
+    return hnsw_index->fstdistfunc_(query, hnsw_index->getDataByInternalId(id),
+                                    hnsw_index->dist_func_param_);
+  };
+
+  // 本次查询的计数，结束时写入 options.profile
+  SearchProfile counts;
+
+  // 上层贪心下降，超出限制时以当前点作为第 0 层入口
+  bool exceeded = false;
+  hnswlib::tableint cur = hnsw_index->enterpoint_node_;
+  float cur_distance = distance_to(cur);
+  counts.distance_computations++;
+  for (int level = hnsw_index->maxlevel_; level > 0 && !exceeded; --level) {
+    bool changed = true;
+    while (changed && !exceeded) {
+      changed = false;
+      std::unique_lock<std::mutex> lock(hnsw_index->link_list_locks_[cur]);
+      hnswlib::linklistsizeint *data = hnsw_index->get_linklist(cur, level);
+      int size = hnsw_index->getListCount(data);
+      hnswlib::tableint *neighbors =
+          reinterpret_cast<hnswlib::tableint *>(data + 1);
+      hnsw_index->metric_hops++;
+      hnsw_index->metric_distance_computations += size;
+      counts.hops++;
+      counts.distance_computations += size;
+      for (int i = 0; i < size; ++i) {
+        float distance = distance_to(neighbors[i]);
+        if (distance < cur_distance) {
+          cur_distance = distance;
+          cur = neighbors[i];
+          changed = true;
+        }
+      }
+      exceeded = limit.Exceeded(size);
+    }
+  }
+
+  // 第 0 层与 searchKnn 相同的 best-first 扩展，已删除的点只用于导航，
+  // 每扩展一个点检查一次限制，超出时返回已经找到的最近点
+  size_t ef = std::max(QueryEf(hnsw_index, options), static_cast<size_t>(k));
+  std::vector<Node> &candidates = scratch.candidates;
+  std::vector<Node> &top = scratch.top;
+
+  // 并发插入的点也可能出现在邻居表中，按容量而不是当前点数分配
+  scratch.NewVisited(hnsw_index->max_elements_);
+  uint16_t *visited = scratch.visited.data();
+  uint16_t visited_tag = scratch.visited_tag;
+
+  auto keep = [&](hnswlib::tableint id, float distance) {
+    if (hnsw_index->isMarkedDeleted(id)) {
+      counts.filter_rejections++;
+      return;
+    }
+    PushTop(top, distance, id);
+    if (top.size() > ef) {
+      PopTop(top);
+    }
+  };
+
+  PushCandidate(candidates, cur_distance, cur);
+  visited[cur] = visited_tag;
+  counts.visited++;
+  keep(cur, cur_distance);
+
+  while (!candidates.empty() && !exceeded) {
+    Node candidate = candidates.front();
+    if (top.size() >= ef && candidate.first > top.front().first) {
+      break;
+    }
+    PopCandidate(candidates);
+
+    hnswlib::linklistsizeint *data =
+        hnsw_index->get_linklist0(candidate.second);
+    int size = hnsw_index->getListCount(data);
+    hnswlib::tableint *neighbors =
+        reinterpret_cast<hnswlib::tableint *>(data + 1);
+    hnsw_index->metric_hops++;
+    hnsw_index->metric_distance_computations += size;
+    counts.hops++;
+    for (int i = 0; i < size; ++i) {
+      hnswlib::tableint neighbor = neighbors[i];
+      if (visited[neighbor] == visited_tag) {
+        continue;
+      }
+      visited[neighbor] = visited_tag;
+      counts.visited++;
+      counts.distance_computations++;
+
+      float distance = distance_to(neighbor);
+      if (top.size() < ef || distance < top.front().first) {
+        PushCandidate(candidates, distance, neighbor);
+        keep(neighbor, distance);
+      }
+    }
+    exceeded = limit.Exceeded(size);
+  }
+
+  // 只改写 id，距离不变，堆的顺序仍然成立
+  while (top.size() > static_cast<size_t>(k)) {
+    PopTop(top);
+  }
+  for (Node &node : top) {
+    node.second = hnsw_index->getExternalLabel(node.second);
+  }
+  if (options.profile) {
+    options.profile->Add(counts);
+  }
+  return exceeded;
+}
+
+void VIndex::FlatRangeSearch(const float *query, float radius,
+                             const RangeVisitor &visitor) {
+  hnswlib::BruteforceSearch<float> *flat_index =
+      static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+
+  for (size_t i = 0; i < flat_index->cur_element_count; ++i) {
+    char *data_ptr = flat_index->data_ + flat_index->size_per_element_ * i;
+    float distance = flat_index->fstdistfunc_(query, data_ptr,
+                                              flat_index->dist_func_param_);
+    if (distance > radius) {
+      continue;
+    }
+
+    // label 紧跟在向量数据之后
+    hnswlib::labeltype label;
+    memcpy(&label, data_ptr + flat_index->data_size_, sizeof(label));
+    if (!visitor(label, distance, radius)) {
+      return;
+    }
+  }
+}
+
+void VIndex::HnswRangeSearch(const float *query, float radius,
+                             const RangeVisitor &visitor,
+                             const ROptions &options,
+                             SearchScratch &scratch) {
+  hnswlib::HierarchicalNSW<float> *hnsw_index =
+      static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+  if (hnsw_index->cur_element_count == 0) {
+    return;
+  }
+
+  auto distance_to = [hnsw_index, query](hnswlib::tableint id) {
+    return hnsw_index->fstdistfunc_(query, hnsw_index->getDataByInternalId(id),
+                                    hnsw_index->dist_func_param_);
+  };
+
+  // 与 searchKnn 相同，先在上层贪心下降到第 0 层的入口
+  hnswlib::tableint cur = hnsw_index->enterpoint_node_;
+  float cur_distance = distance_to(cur);
+  for (int level = hnsw_index->maxlevel_; level > 0; --level) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      std::unique_lock<std::mutex> lock(hnsw_index->link_list_locks_[cur]);
+      hnswlib::linklistsizeint *data = hnsw_index->get_linklist(cur, level);
+      int size = hnsw_index->getListCount(data);
+      hnswlib::tableint *neighbors =
+          reinterpret_cast<hnswlib::tableint *>(data + 1);
+      hnsw_index->metric_hops++;
+      hnsw_index->metric_distance_computations += size;
+      for (int i = 0; i < size; ++i) {
+        float distance = distance_to(neighbors[i]);
+        if (distance < cur_distance) {
+          cur_distance = distance;
+          cur = neighbors[i];
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // 第 0 层做 best-first 扩展：
+  // 半径内的点全部进入候选集，同时保留 ef 个最近点保证收敛程度不低于 knn，
+  // 直到最近的候选点同时超出半径和 ef 边界
+  size_t ef = QueryEf(hnsw_index, options);
+  scratch.Clear();
+  std::vector<Node> &candidates = scratch.candidates;
+  std::vector<Node> &top = scratch.top;
+
+  scratch.NewVisited(hnsw_index->max_elements_);
+  uint16_t *visited = scratch.visited.data();
+  uint16_t visited_tag = scratch.visited_tag;
+
+  bool stop = false;
+  auto visit = [&](hnswlib::tableint id, float distance) {
+    if (distance <= radius && !hnsw_index->isMarkedDeleted(id)) {
+      stop = !visitor(hnsw_index->getExternalLabel(id), distance, radius);
+    }
+  };
+
+  PushCandidate(candidates, cur_distance, cur);
+  PushTop(top, cur_distance, cur);
+  visited[cur] = visited_tag;
+  visit(cur, cur_distance);
+
+  while (!candidates.empty() && !stop) {
+    Node candidate = candidates.front();
+    float bound = top.size() >= ef ? std::max(radius, top.front().first)
+                                   : std::numeric_limits<float>::max();
+    if (candidate.first > bound) {
+      break;
+    }
+    PopCandidate(candidates);
+
+    hnswlib::linklistsizeint *data =
+        hnsw_index->get_linklist0(candidate.second);
+    int size = hnsw_index->getListCount(data);
+    hnswlib::tableint *neighbors =
+        reinterpret_cast<hnswlib::tableint *>(data + 1);
+    hnsw_index->metric_hops++;
+    hnsw_index->metric_distance_computations += size;
+    for (int i = 0; i < size && !stop; ++i) {
+      hnswlib::tableint neighbor = neighbors[i];
+      if (visited[neighbor] == visited_tag) {
+        continue;
+      }
+      visited[neighbor] = visited_tag;
+
+      float distance = distance_to(neighbor);
+      if (top.size() < ef || distance < top.front().first ||
+          distance <= radius) {
+        PushCandidate(candidates, distance, neighbor);
+        PushTop(top, distance, neighbor);
+        if (top.size() > ef) {
+          PopTop(top);
+        }
+        visit(neighbor, distance);
+      }
+    }
+  }
 }
 
 RetNo VIndex::GetVecByID(int64_t id, std::vector<float> &v) {
@@ -152,9 +703,9 @@ RetNo VIndex::GetVecByID(int64_t id, std::vector<float> &v) {
       // 获取向量数据
       char *data_ptr =
           flat_index->data_ + flat_index->size_per_element_ * internal_idx;
-      size_t dim = flat_index->data_size_ / sizeof(float);
-      assert(dim ==
-             static_cast<size_t>(param_.index_info().flat_param().dim()));
+      // 二进制向量按位打包，float 个数不等于 dim
+      size_t dim = IndexVectorSize(param_.index_info());
+      assert(dim * sizeof(float) == flat_index->data_size_);
 
       v.resize(dim);
       memcpy(v.data(), data_ptr, dim * sizeof(float));
@@ -177,7 +728,7 @@ RetNo VIndex::GetVecByID(int64_t id, std::vector<float> &v) {
       }
 
       // 获取向量数据
-      size_t dim = param_.index_info().hnsw_param().dim();
+      size_t dim = IndexVectorSize(param_.index_info());
 
       v.resize(dim);
       memcpy(v.data(), hnsw_index->getDataByInternalId(internal_idx),
@@ -185,6 +736,68 @@ RetNo VIndex::GetVecByID(int64_t id, std::vector<float> &v) {
       break;
     }
 
+    case INDEX_TYPE_DISKANN: {
+      assert(dindex_);
+      if (dindex_->GetVector(id, v) != RET_OK) {
+        return RET_ERROR;
+      }
+      break;
+    }
+
+    default: {
+      return RET_ERROR;
+    }
+  }
+
+  return RET_OK;
+}
+
+RetNo VIndex::ForEachVector(
+    const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+        &func) {
+  std::vector<float> v;
+  switch (param_.index_info().index_type()) {
+    case INDEX_TYPE_FLAT: {
+      hnswlib::BruteforceSearch<float> *flat_index =
+          static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+      size_t dim = flat_index->data_size_ / sizeof(float);
+      v.resize(dim);
+      for (const auto &pair : flat_index->dict_external_to_internal) {
+        char *data_ptr =
+            flat_index->data_ + flat_index->size_per_element_ * pair.second;
+        memcpy(v.data(), data_ptr, dim * sizeof(float));
+        RetNo ret = func(pair.first, v);
+        if (ret != RET_OK) {
+          return ret;
+        }
+      }
+      break;
+    }
+
+    case INDEX_TYPE_HNSW: {
+      hnswlib::HierarchicalNSW<float> *hnsw_index =
+          static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+      size_t dim = IndexVectorSize(param_.index_info());
+      v.resize(dim);
+      for (const auto &pair : hnsw_index->label_lookup_) {
+        if (hnsw_index->isMarkedDeleted(pair.second)) {
+          continue;
+        }
+        memcpy(v.data(), hnsw_index->getDataByInternalId(pair.second),
+               dim * sizeof(float));
+        RetNo ret = func(pair.first, v);
+        if (ret != RET_OK) {
+          return ret;
+        }
+      }
+      break;
+    }
+
+    case INDEX_TYPE_DISKANN: {
+      assert(dindex_);
+      return dindex_->ForEachVector(func);
+    }
+
     default: {
       return RET_ERROR;
     }
@@ -194,14 +807,14 @@ RetNo VIndex::GetVecByID(int64_t id, std::vector<float> &v) {
 }
 
 RetNo VIndex::Search(int64_t id, int32_t k, std::vector<int64_t> &ids,
-                     std::vector<float> &distances) {
+                     std::vector<float> &distances, const ROptions &options) {
   std::vector<float> v;
   RetNo ret = GetVecByID(id, v);
   if (ret != RET_OK) {
     return ret;
   }
 
-  ret = Search(v, k, ids, distances);
+  ret = Search(v, k, ids, distances, options);
   return ret;
 }
 
@@ -228,6 +841,44 @@ void VIndex::PersistIndex() {
   if (hindex_) {
     hindex_->saveIndex(hindex_file_);
   }
+  if (dindex_) {
+    dindex_->Persist();
+  }
+  if (pindex_) {
+    pindex_->Persist();
+  }
+}
+
+bool VIndex::Contains(int64_t id) const {
+  switch (param_.index_info().index_type()) {
+    case INDEX_TYPE_FLAT: {
+      hnswlib::BruteforceSearch<float> *flat_index =
+          static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+      std::unique_lock<std::mutex> ulk(flat_index->index_lock);
+      return flat_index->dict_external_to_internal.count(id) > 0;
+    }
+
+    case INDEX_TYPE_HNSW: {
+      hnswlib::HierarchicalNSW<float> *hnsw_index =
+          static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+      std::unique_lock<std::mutex> ulk(hnsw_index->label_lookup_lock);
+      auto it = hnsw_index->label_lookup_.find(id);
+      return it != hnsw_index->label_lookup_.end() &&
+             !hnsw_index->isMarkedDeleted(it->second);
+    }
+
+    case INDEX_TYPE_DISKANN: {
+      return dindex_->Contains(id);
+    }
+
+    case INDEX_TYPE_PQ: {
+      return pindex_->Contains(id);
+    }
+
+    default: {
+      return false;
+    }
+  }
 }
 
 int32_t VIndex::Size() const {
@@ -244,12 +895,95 @@ int32_t VIndex::Size() const {
       return hnsw_index->getCurrentElementCount();
     }
 
+    case INDEX_TYPE_DISKANN: {
+      return dindex_->Size();
+    }
+
+    case INDEX_TYPE_PQ: {
+      return pindex_->Size();
+    }
+
+    default: {
+      return 0;
+    }
+  }
+}
+
+int64_t VIndex::MemoryUsage() const {
+  switch (param_.index_info().index_type()) {
+    case INDEX_TYPE_FLAT: {
+      hnswlib::BruteforceSearch<float> *flat_index =
+          static_cast<hnswlib::BruteforceSearch<float> *>(hindex_.get());
+      int64_t bytes = flat_index->maxelements_ * flat_index->size_per_element_;
+      // 哈希表每个元素约为 key、value 与指针
+      bytes += flat_index->dict_external_to_internal.size() *
+               (sizeof(hnswlib::labeltype) + sizeof(size_t) + sizeof(void *));
+      return bytes;
+    }
+
+    case INDEX_TYPE_HNSW: {
+      hnswlib::HierarchicalNSW<float> *hnsw_index =
+          static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+      int64_t bytes =
+          hnsw_index->max_elements_ * hnsw_index->size_data_per_element_;
+      bytes += hnsw_index->max_elements_ * sizeof(void *);
+
+      // 上层的邻接表按层数分配
+      size_t count = hnsw_index->getCurrentElementCount();
+      for (size_t i = 0; i < count; ++i) {
+        int level = hnsw_index->element_levels_[i];
+        if (level > 0) {
+          bytes += hnsw_index->size_links_per_element_ * level;
+        }
+      }
+
+      bytes += hnsw_index->label_lookup_.size() *
+               (sizeof(hnswlib::labeltype) + sizeof(hnswlib::tableint) +
+                sizeof(void *));
+      return bytes;
+    }
+
+    case INDEX_TYPE_DISKANN: {
+      return dindex_->MemoryUsage();
+    }
+
+    case INDEX_TYPE_PQ: {
+      return pindex_->MemoryUsage();
+    }
+
     default: {
       return 0;
     }
   }
 }
 
+json VIndex::Stats() const {
+  json j;
+  j["index_type"] = param_.index_info().index_type();
+  j["size"] = Size();
+  j["memory_bytes"] = MemoryUsage();
+  j["distance_computations"] = 0;
+  j["hops"] = 0;
+  if (param_.index_info().index_type() == INDEX_TYPE_HNSW) {
+    hnswlib::HierarchicalNSW<float> *hnsw_index =
+        static_cast<hnswlib::HierarchicalNSW<float> *>(hindex_.get());
+    j["distance_computations"] =
+        hnsw_index->metric_distance_computations.load();
+    j["hops"] = hnsw_index->metric_hops.load();
+  }
+  if (param_.index_info().index_type() == INDEX_TYPE_DISKANN) {
+    json diskann = dindex_->Stats();
+    j["distance_computations"] = diskann["distance_computations"];
+    j["hops"] = diskann["hops"];
+    j["diskann"] = diskann;
+  }
+  if (param_.index_info().index_type() == INDEX_TYPE_PQ) {
+    j["pq"] = pindex_->Stats();
+  }
+  j["ops"] = metrics_.ToJson();
+  return j;
+}
+
 RetNo VIndex::NewIndex() {
   switch (param_.index_info().index_type()) {
     case INDEX_TYPE_FLAT: {
@@ -264,13 +998,23 @@ RetNo VIndex::NewIndex() {
         assert(hindex_);
 
       } else if (param_.index_info().flat_param().distance_type() ==
-                 DISTANCE_TYPE_INNER_PRODUCT) {
+                     DISTANCE_TYPE_INNER_PRODUCT ||
+                 param_.index_info().flat_param().distance_type() ==
+                     DISTANCE_TYPE_COSINE) {
         hspace_ = std::make_shared<hnswlib::InnerProductSpace>(
             param_.index_info().flat_param().dim());
         hindex_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
             hspace_.get(), param_.index_info().flat_param().max_elements());
         assert(hindex_);
 
+      } else if (param_.index_info().flat_param().distance_type() ==
+                 DISTANCE_TYPE_HAMMING) {
+        hspace_ = std::make_shared<HammingSpace>(
+            param_.index_info().flat_param().dim());
+        hindex_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
+            hspace_.get(), param_.index_info().flat_param().max_elements());
+        assert(hindex_);
+
       } else {
         return RET_ERROR;
       }
@@ -292,7 +1036,9 @@ RetNo VIndex::NewIndex() {
         assert(hindex_);
 
       } else if (param_.index_info().hnsw_param().distance_type() ==
-                 DISTANCE_TYPE_INNER_PRODUCT) {
+                     DISTANCE_TYPE_INNER_PRODUCT ||
+                 param_.index_info().hnsw_param().distance_type() ==
+                     DISTANCE_TYPE_COSINE) {
         hspace_ = std::make_shared<hnswlib::InnerProductSpace>(
             param_.index_info().hnsw_param().dim());
         hindex_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(
@@ -301,6 +1047,16 @@ RetNo VIndex::NewIndex() {
             param_.index_info().hnsw_param().ef_construction());
         assert(hindex_);
 
+      } else if (param_.index_info().hnsw_param().distance_type() ==
+                 DISTANCE_TYPE_HAMMING) {
+        hspace_ = std::make_shared<HammingSpace>(
+            param_.index_info().hnsw_param().dim());
+        hindex_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(
+            hspace_.get(), param_.index_info().hnsw_param().max_elements(),
+            param_.index_info().hnsw_param().m(),
+            param_.index_info().hnsw_param().ef_construction());
+        assert(hindex_);
+
       } else {
         return RET_ERROR;
       }
@@ -308,6 +1064,20 @@ RetNo VIndex::NewIndex() {
       break;
     }
 
+    case INDEX_TYPE_DISKANN: {
+      assert(param_.index_info().has_diskann_param());
+      dindex_ = std::make_unique<DiskAnnIndex>(
+          data_path_, param_.index_info().diskann_param());
+      break;
+    }
+
+    case INDEX_TYPE_PQ: {
+      assert(param_.index_info().has_pq_param());
+      pindex_ = std::make_unique<PqIndex>(data_path_,
+                                          param_.index_info().pq_param());
+      break;
+    }
+
     default: {
       return RET_ERROR;
     }
@@ -331,13 +1101,23 @@ RetNo VIndex::LoadIndex() {
         assert(hindex_);
 
       } else if (param_.index_info().flat_param().distance_type() ==
-                 DISTANCE_TYPE_INNER_PRODUCT) {
+                     DISTANCE_TYPE_INNER_PRODUCT ||
+                 param_.index_info().flat_param().distance_type() ==
+                     DISTANCE_TYPE_COSINE) {
         hspace_ = std::make_shared<hnswlib::InnerProductSpace>(
             param_.index_info().flat_param().dim());
         hindex_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
             hspace_.get(), hindex_file_);
         assert(hindex_);
 
+      } else if (param_.index_info().flat_param().distance_type() ==
+                 DISTANCE_TYPE_HAMMING) {
+        hspace_ = std::make_shared<HammingSpace>(
+            param_.index_info().flat_param().dim());
+        hindex_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
+            hspace_.get(), hindex_file_);
+        assert(hindex_);
+
       } else {
         return RET_ERROR;
       }
@@ -350,7 +1130,7 @@ RetNo VIndex::LoadIndex() {
       assert(param_.index_info().has_hnsw_param());
 
       if (param_.index_info().hnsw_param().distance_type() ==
-          DISTANCE_TYPE_INNER_PRODUCT) {
+          DISTANCE_TYPE_L2) {
         hspace_ = std::make_shared<hnswlib::L2Space>(
             param_.index_info().hnsw_param().dim());
         hindex_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(
@@ -358,13 +1138,23 @@ RetNo VIndex::LoadIndex() {
         assert(hindex_);
 
       } else if (param_.index_info().hnsw_param().distance_type() ==
-                 DISTANCE_TYPE_INNER_PRODUCT) {
+                     DISTANCE_TYPE_INNER_PRODUCT ||
+                 param_.index_info().hnsw_param().distance_type() ==
+                     DISTANCE_TYPE_COSINE) {
         hspace_ = std::make_shared<hnswlib::InnerProductSpace>(
             param_.index_info().hnsw_param().dim());
         hindex_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(
             hspace_.get(), hindex_file_);
         assert(hindex_);
 
+      } else if (param_.index_info().hnsw_param().distance_type() ==
+                 DISTANCE_TYPE_HAMMING) {
+        hspace_ = std::make_shared<HammingSpace>(
+            param_.index_info().hnsw_param().dim());
+        hindex_ = std::make_unique<hnswlib::HierarchicalNSW<float>>(
+            hspace_.get(), hindex_file_);
+        assert(hindex_);
+
       } else {
         return RET_ERROR;
       }
@@ -372,6 +1162,20 @@ RetNo VIndex::LoadIndex() {
       break;
     }
 
+    case INDEX_TYPE_DISKANN: {
+      assert(param_.index_info().has_diskann_param());
+      dindex_ = std::make_unique<DiskAnnIndex>(
+          data_path_, param_.index_info().diskann_param());
+      return dindex_->Load();
+    }
+
+    case INDEX_TYPE_PQ: {
+      assert(param_.index_info().has_pq_param());
+      pindex_ = std::make_unique<PqIndex>(data_path_,
+                                          param_.index_info().pq_param());
+      return pindex_->Load();
+    }
+
     default: {
       return RET_ERROR;
     }
@@ -380,4 +1184,50 @@ RetNo VIndex::LoadIndex() {
   return RET_OK;
 }
 
+int32_t IndexDim(const vdb::IndexInfo &info) {
+  switch (info.index_type()) {
+    case INDEX_TYPE_FLAT:
+      return info.flat_param().dim();
+    case INDEX_TYPE_HNSW:
+      return info.hnsw_param().dim();
+    case INDEX_TYPE_DISKANN:
+      return info.diskann_param().dim();
+    case INDEX_TYPE_PQ:
+      return info.pq_param().dim();
+    default:
+      return 0;
+  }
+}
+
+int32_t IndexDistanceType(const vdb::IndexInfo &info) {
+  switch (info.index_type()) {
+    case INDEX_TYPE_FLAT:
+      return info.flat_param().distance_type();
+    case INDEX_TYPE_HNSW:
+      return info.hnsw_param().distance_type();
+    case INDEX_TYPE_DISKANN:
+      return info.diskann_param().distance_type();
+    case INDEX_TYPE_PQ:
+      return info.pq_param().distance_type();
+    default:
+      return 0;
+  }
+}
+
+int32_t IndexVectorSize(const vdb::IndexInfo &info) {
+  return VectorSize(IndexDim(info), IndexDistanceType(info));
+}
+
+bool ValidIndexInfo(const vdb::IndexInfo &info) {
+  if (IndexDistanceType(info) != DISTANCE_TYPE_HAMMING) {
+    return true;
+  }
+
+  // diskann 和 pq 的量化只适用于 float 向量
+  int32_t dim = IndexDim(info);
+  return dim > 0 && dim % kBitsPerFloat == 0 &&
+         (info.index_type() == INDEX_TYPE_FLAT ||
+          info.index_type() == INDEX_TYPE_HNSW);
+}
+
 }  // namespace vectordb
\ No newline at end of file
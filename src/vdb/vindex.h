@@ -1,19 +1,30 @@
 #ifndef VECTORDB_VINDEX_H
 #define VECTORDB_VINDEX_H
 
+#include <functional>
 #include <string>
+#include <utility>
 
 #include "common.h"
+#include "diskann.h"
 #include "hnswlib/hnswlib.h"
+#include "metrics.h"
+#include "options.h"
+#include "pq_index.h"
 #include "retno.h"
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/write_batch.h"
+#include "search_context.h"
 #include "vdb.pb.h"
 
 namespace vectordb {
 
+// called for each range search result in no particular order,
+// return false to stop the search
+using RangeCallback = std::function<bool(int64_t id, float distance)>;
+
 class VIndex {
  public:
   VIndex(const vdb::IndexParam &param);
@@ -22,24 +33,66 @@ class VIndex {
   VIndex(const VIndex &) = delete;
   VIndex &operator=(const VIndex &) = delete;
 
+  // vectors of a cosine index must be normalized already, Table does it on
+  // ingest; queries are normalized by Search and RangeSearch
   RetNo Add(int64_t id, const std::vector<float> &vector);
+
+  // make room for n more vectors before adding them concurrently, hnsw
+  // grows the graph, flat fails when it is full, not thread safe
+  RetNo Reserve(int64_t n);
   RetNo Persist();
 
   // input: v, k
   // output: ids, distances, scalars
   RetNo Search(const std::vector<float> &vector, int32_t k,
-               std::vector<int64_t> &ids, std::vector<float> &distances);
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               const ROptions &options = ROptions());
+
+  // same as above, the heaps and visited set of scratch are reused, keep
+  // one scratch per thread
+  RetNo Search(const std::vector<float> &vector, int32_t k,
+               std::vector<int64_t> &ids, std::vector<float> &distances,
+               SearchScratch &scratch, const ROptions &options = ROptions());
 
   // input: id, k
   // output: ids, distances, scalars
   RetNo Search(int64_t id, int32_t k, std::vector<int64_t> &ids,
-               std::vector<float> &distances);
+               std::vector<float> &distances,
+               const ROptions &options = ROptions());
+
+  // input: v, radius
+  // output: ids, distances of all vectors with distance <= radius, sorted,
+  // at most max_results (<= 0 means no limit) closest ones are kept
+  // radius uses the same metric as the distances returned by Search
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    int32_t max_results, std::vector<int64_t> &ids,
+                    std::vector<float> &distances,
+                    const ROptions &options = ROptions());
+
+  // stream the results to callback as they are found
+  RetNo RangeSearch(const std::vector<float> &vector, float radius,
+                    const RangeCallback &callback,
+                    const ROptions &options = ROptions());
 
   int32_t Size() const;
 
+  // id has a live vector in the index
+  bool Contains(int64_t id) const;
+
+  // bytes allocated by the index data structures
+  int64_t MemoryUsage() const;
+
+  // counters, latency, distance computations and hops
+  json Stats() const;
+
   const vdb::IndexParam &param() const { return param_; }
   RetNo GetVecByID(int64_t id, std::vector<float> &vector);
 
+  // iterate all vectors in the index, stop when func returns not RET_OK
+  RetNo ForEachVector(
+      const std::function<RetNo(int64_t id, const std::vector<float> &vector)>
+          &func);
+
  private:
   void Init();
   RetNo New();
@@ -50,6 +103,32 @@ class VIndex {
   void PersistIndex();
   RetNo NewIndex();
   RetNo LoadIndex();
+  RetNo DoAdd(int64_t id, const std::vector<float> &vector);
+  RetNo DoSearch(const std::vector<float> &vector, int32_t k,
+                 std::vector<int64_t> &ids, std::vector<float> &distances,
+                 SearchScratch &scratch, const ROptions &options);
+
+  // visitor may lower radius while searching, return false to stop
+  using RangeVisitor =
+      std::function<bool(int64_t id, float distance, float &radius)>;
+  RetNo DoRangeSearch(const std::vector<float> &vector, float radius,
+                      const RangeVisitor &visitor, const ROptions &options);
+  // the query as the index sees it, normalized into buffer for cosine
+  const float *Query(const std::vector<float> &vector,
+                     std::vector<float> &buffer) const;
+  // knn of flat and hnsw under a deadline or distance budget, the best
+  // results so far are kept when limit is exceeded, return true if it was,
+  // also used to count the work for options.profile. The results are left
+  // in scratch.top, a max heap of (distance, label)
+  bool FlatSearch(const float *query, int32_t k, SearchLimit &limit,
+                  const ROptions &options, SearchScratch &scratch);
+  bool HnswSearch(const float *query, int32_t k, SearchLimit &limit,
+                  const ROptions &options, SearchScratch &scratch);
+  void FlatRangeSearch(const float *query, float radius,
+                       const RangeVisitor &visitor);
+  void HnswRangeSearch(const float *query, float radius,
+                       const RangeVisitor &visitor, const ROptions &options,
+                       SearchScratch &scratch);
 
  private:
   std::string data_path_;
@@ -60,10 +139,27 @@ class VIndex {
   std::string hindex_file_;
   std::unique_ptr<hnswlib::AlgorithmInterface<float>> hindex_;
   std::shared_ptr<hnswlib::SpaceInterface<float>> hspace_;
+
+  // diskann index, files under data_path_
+  DiskAnnIndexUPtr dindex_;
+
+  // pq index, codes only, file under data_path_
+  PqIndexUPtr pindex_;
+
+  IndexMetrics metrics_;
 };
 
 using VIndexSPtr = std::shared_ptr<VIndex>;
 
+int32_t IndexDim(const vdb::IndexInfo &info);
+int32_t IndexDistanceType(const vdb::IndexInfo &info);
+
+// number of floats of a vector, dim / 32 for packed binary vectors
+int32_t IndexVectorSize(const vdb::IndexInfo &info);
+
+// binary vectors need a multiple of 32 bits and a flat or hnsw index
+bool ValidIndexInfo(const vdb::IndexInfo &info);
+
 }  // namespace vectordb
 
 #endif  // VECTORDB_VINDEX_H
\ No newline at end of file
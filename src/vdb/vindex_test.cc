@@ -3,8 +3,12 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <experimental/filesystem>
 #include <fstream>
+#include <random>
+#include <set>
 #include <string>
 
 #include "common.h"
@@ -299,10 +303,47 @@ TEST(VIndexTest, LoadHNSWInnerProduct) {
 
   EXPECT_EQ(index.Size(), 3);
 
+  // 重新打开后仍按内积排序，按 L2 最近的是 1
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  EXPECT_EQ(vectordb::RET_OK, index.Search(std::vector<float>{1.0, 0.0, 0.0},
+                                           1, ids, distances));
+  ASSERT_EQ(ids.size(), 1u);
+  EXPECT_EQ(ids[0], 2);
+  EXPECT_FLOAT_EQ(distances[0], 1.0 - 4.0);
+
   // 清理测试目录
   // fs::remove_all(kTestDir);
 }
 
+// 测试 flat 索引的二进制向量 GetVecByID，64 位打包成 2 个 float
+TEST(VIndexTest, GetVecByIDHamming) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+
+  vdb::IndexParam param;
+  param.set_path(kTestDir);
+  param.set_id(1);
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.mutable_index_info()->set_index_type(vectordb::INDEX_TYPE_FLAT);
+  param.mutable_index_info()->mutable_flat_param()->set_dim(64);
+  param.mutable_index_info()->mutable_flat_param()->set_max_elements(100);
+  param.mutable_index_info()->mutable_flat_param()->set_distance_type(
+      vectordb::DISTANCE_TYPE_HAMMING);
+
+  vectordb::VIndex index(param);
+  uint32_t bits[2] = {0xdeadbeef, 0x12345678};
+  std::vector<float> vec(2);
+  memcpy(vec.data(), bits, sizeof(bits));
+  EXPECT_EQ(vectordb::RET_OK, index.Add(7, vec));
+
+  std::vector<float> got;
+  EXPECT_EQ(vectordb::RET_OK, index.GetVecByID(7, got));
+  ASSERT_EQ(got.size(), 2u);
+  EXPECT_EQ(0, memcmp(got.data(), bits, sizeof(bits)));
+}
+
 // 测试 VIndex 的 Search 方法, INDEX_TYPE_HNSW, DISTANCE_TYPE_INNER_PRODUCT
 TEST(VIndexTest, SearchHNSWInnerProduct) {
   { TEST_AddHNSWInnerProduct(); }
@@ -362,6 +403,195 @@ TEST(VIndexTest, SearchHNSWInnerProduct) {
   // fs::remove_all(kTestDir);
 }
 
+static vdb::IndexParam RangeIndexParam(vectordb::IndexType index_type,
+                                       int32_t dim) {
+  vdb::IndexParam param;
+  param.set_path(kTestDir);
+  param.set_id(1);
+  param.set_create_time(vectordb::TimeStamp().MilliSeconds());
+  param.mutable_index_info()->set_index_type(index_type);
+  if (index_type == vectordb::INDEX_TYPE_FLAT) {
+    auto flat_param = param.mutable_index_info()->mutable_flat_param();
+    flat_param->set_dim(dim);
+    flat_param->set_max_elements(2000);
+    flat_param->set_distance_type(vectordb::DISTANCE_TYPE_L2);
+  } else {
+    auto hnsw_param = param.mutable_index_info()->mutable_hnsw_param();
+    hnsw_param->set_dim(dim);
+    hnsw_param->set_max_elements(2000);
+    hnsw_param->set_distance_type(vectordb::DISTANCE_TYPE_L2);
+    hnsw_param->set_ef_construction(200);
+    hnsw_param->set_m(16);
+  }
+  return param;
+}
+
+// 测试 RangeSearch，与暴力计算的半径内结果比较
+static void TestRangeSearch(vectordb::IndexType index_type,
+                            double min_recall) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+
+  const int32_t dim = 8;
+  const int32_t n = 2000;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  std::vector<std::vector<float>> vectors(n, std::vector<float>(dim));
+  for (auto &v : vectors) {
+    for (auto &x : v) {
+      x = dist(rng);
+    }
+  }
+
+  vectordb::VIndex index(RangeIndexParam(index_type, dim));
+  for (int32_t i = 0; i < n; ++i) {
+    EXPECT_EQ(vectordb::RET_OK, index.Add(i, vectors[i]));
+  }
+
+  // 半径取第 50 近邻的距离
+  const std::vector<float> &query = vectors[123];
+  std::vector<std::pair<float, int64_t>> truth;
+  for (int32_t i = 0; i < n; ++i) {
+    float distance = 0;
+    for (int32_t d = 0; d < dim; ++d) {
+      float diff = vectors[i][d] - query[d];
+      distance += diff * diff;
+    }
+    truth.emplace_back(distance, i);
+  }
+  std::sort(truth.begin(), truth.end());
+  float radius = truth[49].first;
+  std::set<int64_t> expected;
+  for (const auto &pair : truth) {
+    if (pair.first <= radius) {
+      expected.insert(pair.second);
+    }
+  }
+
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  EXPECT_EQ(vectordb::RET_OK, index.RangeSearch(query, radius, 0, ids,
+                                                distances));
+  int32_t hit = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_LE(distances[i], radius);
+    if (i > 0) {
+      EXPECT_LE(distances[i - 1], distances[i]);
+    }
+    hit += expected.count(ids[i]);
+  }
+  EXPECT_GE(hit, expected.size() * min_recall);
+  size_t found = ids.size();
+
+  // max_results 只保留最近的结果
+  EXPECT_EQ(vectordb::RET_OK, index.RangeSearch(query, radius, 10, ids,
+                                                distances));
+  ASSERT_EQ(ids.size(), 10u);
+  EXPECT_EQ(ids[0], 123);
+
+  // 流式返回，回调返回 false 时停止
+  int32_t count = 0;
+  EXPECT_EQ(vectordb::RET_OK,
+            index.RangeSearch(query, radius, [&count](int64_t, float) {
+              return ++count < 5;
+            }));
+  EXPECT_EQ(count, 5);
+
+  // 复用同一个 scratch 与每次借用的结果相同
+  vectordb::SearchScratch scratch;
+  std::vector<int64_t> reused;
+  std::vector<float> reused_distances;
+  for (int32_t i = 0; i < 20; ++i) {
+    EXPECT_EQ(vectordb::RET_OK, index.Search(vectors[i], 10, ids, distances));
+    EXPECT_EQ(vectordb::RET_OK, index.Search(vectors[i], 10, reused,
+                                             reused_distances, scratch));
+    EXPECT_EQ(ids, reused);
+    EXPECT_EQ(distances, reused_distances);
+  }
+
+  // 回调中再次搜索不影响外层遍历的堆和 visited
+  count = 0;
+  EXPECT_EQ(vectordb::RET_OK,
+            index.RangeSearch(query, radius, [&](int64_t id, float) {
+              std::vector<int64_t> inner_ids;
+              std::vector<float> inner_distances;
+              index.Search(vectors[id], 1, inner_ids, inner_distances);
+              EXPECT_EQ(1u, inner_ids.size());
+              count++;
+              return true;
+            }));
+  EXPECT_EQ(found, static_cast<size_t>(count));
+}
+
+TEST(VIndexTest, RangeSearchFlat) {
+  TestRangeSearch(vectordb::INDEX_TYPE_FLAT, 1.0);
+}
+
+TEST(VIndexTest, RangeSearchHNSW) {
+  TestRangeSearch(vectordb::INDEX_TYPE_HNSW, 0.9);
+}
+
+// 测试截止时间与距离计算预算
+static void TestSearchLimit(vectordb::IndexType index_type) {
+  if (fs::exists(kTestDir)) {
+    fs::remove_all(kTestDir);
+  }
+
+  const int32_t dim = 8;
+  const int32_t n = 2000;
+  const int32_t k = 10;
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  vectordb::VIndex index(RangeIndexParam(index_type, dim));
+  std::vector<std::vector<float>> vectors(n, std::vector<float>(dim));
+  for (int32_t i = 0; i < n; ++i) {
+    for (auto &x : vectors[i]) {
+      x = dist(rng);
+    }
+    EXPECT_EQ(vectordb::RET_OK, index.Add(i, vectors[i]));
+  }
+  const std::vector<float> &query = vectors[321];
+
+  std::vector<int64_t> expected;
+  std::vector<float> expected_distances;
+  EXPECT_EQ(vectordb::RET_OK,
+            index.Search(query, k, expected, expected_distances));
+
+  // 限制足够宽松时与不限制的结果相同
+  vectordb::ROptions options;
+  options.SetTimeout(std::chrono::seconds(60));
+  options.max_distance_computations = 1000000;
+  std::vector<int64_t> ids;
+  std::vector<float> distances;
+  EXPECT_EQ(vectordb::RET_OK, index.Search(query, k, ids, distances, options));
+  EXPECT_EQ(expected, ids);
+
+  // 预算耗尽时返回已经找到的结果
+  options.max_distance_computations = 1;
+  EXPECT_EQ(vectordb::RET_PARTIAL,
+            index.Search(query, k, ids, distances, options));
+  EXPECT_FALSE(ids.empty());
+  EXPECT_LE(ids.size(), static_cast<size_t>(k));
+  EXPECT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+
+  // 开始前已经超时的请求不做任何工作
+  options.max_distance_computations = 0;
+  options.deadline = std::chrono::steady_clock::now();
+  EXPECT_EQ(vectordb::RET_TIMEOUT,
+            index.Search(query, k, ids, distances, options));
+  EXPECT_TRUE(ids.empty());
+  EXPECT_TRUE(distances.empty());
+}
+
+TEST(VIndexTest, SearchLimitFlat) {
+  TestSearchLimit(vectordb::INDEX_TYPE_FLAT);
+}
+
+TEST(VIndexTest, SearchLimitHNSW) {
+  TestSearchLimit(vectordb::INDEX_TYPE_HNSW);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();